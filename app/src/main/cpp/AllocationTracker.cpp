@@ -0,0 +1,153 @@
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+#include "AndroidOut.h"
+
+namespace {
+    std::atomic<int> gMode{AllocationTracker::kReport};
+    std::atomic<uint64_t> gTotalAllocations{0};
+
+    // Frame of the calling thread, only the thread between beginFrame() and endFrame() counts
+    thread_local bool tInFrame = false;
+    thread_local bool tSteadyState = false;
+    thread_local uint32_t tFrameAllocations = 0;
+
+    // Statistics, only touched by the thread running frames
+    uint64_t gFrames = 0;
+    uint64_t gFrameAllocations = 0;
+    uint32_t gMaxFrameAllocations = 0;
+    uint64_t gSteadyFrames = 0;
+    uint64_t gSteadyFramesAllocating = 0;
+    uint32_t gLastFrameAllocations = 0;
+}
+
+void AllocationTracker::setMode(Mode mode) {
+    gMode = mode;
+}
+
+void AllocationTracker::beginFrame(bool steadyState) {
+    tFrameAllocations = 0;
+    tSteadyState = steadyState;
+    tInFrame = true;
+}
+
+void AllocationTracker::leaveSteadyState() {
+    tSteadyState = false;
+}
+
+uint32_t AllocationTracker::endFrame() {
+    tInFrame = false;
+    const uint32_t allocations = tFrameAllocations;
+
+    gFrames++;
+    gFrameAllocations += allocations;
+    gMaxFrameAllocations = std::max(gMaxFrameAllocations, allocations);
+    gLastFrameAllocations = allocations;
+    if (tSteadyState) {
+        gSteadyFrames++;
+        if (allocations > 0) {
+            gSteadyFramesAllocating++;
+            if (gMode == kReport) {
+                aout << "Steady state frame " << gFrames << " made " << allocations
+                     << " heap allocations" << std::endl;
+            }
+        }
+    }
+    return allocations;
+}
+
+uint64_t AllocationTracker::getTotalAllocations() {
+    return gTotalAllocations;
+}
+
+std::string AllocationTracker::summarize() {
+    std::ostringstream summary;
+#if SCROLLER_TRACK_ALLOCATIONS
+    summary << "frames=" << gFrames
+            << " allocations/frame=" << (gFrames ? double(gFrameAllocations) / gFrames : 0.0)
+            << " max=" << gMaxFrameAllocations
+            << " last=" << gLastFrameAllocations
+            << " steady=" << gSteadyFrames
+            << " steadyAllocating=" << gSteadyFramesAllocating;
+#else
+    summary << "allocation tracking disabled";
+#endif
+    return summary.str();
+}
+
+#if SCROLLER_TRACK_ALLOCATIONS
+
+static inline void countAllocation() {
+    gTotalAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (tInFrame) {
+        tFrameAllocations++;
+        if (tSteadyState && gMode.load(std::memory_order_relaxed) == AllocationTracker::kTrap) {
+            // Break here so the debugger shows who allocated
+            __builtin_trap();
+        }
+    }
+}
+
+static void *trackedAllocate(size_t size) {
+    countAllocation();
+    void *pointer = malloc(size ? size : 1);
+    if (!pointer) {
+#if __cpp_exceptions
+        throw std::bad_alloc();
+#else
+        abort();
+#endif
+    }
+    return pointer;
+}
+
+// The aligned overloads are left to the runtime, nothing in the app over-aligns heap objects
+
+void *operator new(size_t size) {
+    return trackedAllocate(size);
+}
+
+void *operator new[](size_t size) {
+    return trackedAllocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    countAllocation();
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    countAllocation();
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    free(pointer);
+}
+
+#endif
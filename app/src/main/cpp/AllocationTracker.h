@@ -0,0 +1,68 @@
+#ifndef SCROLLER_ALLOCATIONTRACKER_H
+#define SCROLLER_ALLOCATIONTRACKER_H
+
+#include <cstdint>
+#include <string>
+
+/*!
+ * Heap allocations are tracked in debug builds unless the build says otherwise. Tracking replaces
+ * the global operator new and delete of the library with versions that count calls.
+ */
+#ifndef SCROLLER_TRACK_ALLOCATIONS
+#ifdef NDEBUG
+#define SCROLLER_TRACK_ALLOCATIONS 0
+#else
+#define SCROLLER_TRACK_ALLOCATIONS 1
+#endif
+#endif
+
+/*!
+ * Counts heap allocations made by the thread running a frame. A frame is a steady state frame when
+ * nothing happened that is allowed to allocate (input, a new map, a resized surface...). Those
+ * frames should not touch the system allocator at all, and depending on the mode an allocation in
+ * one is logged or stops the app right at the offending call.
+ *
+ * Without SCROLLER_TRACK_ALLOCATIONS every count stays zero.
+ */
+class AllocationTracker {
+public:
+    enum Mode {
+        // count only
+        kCount,
+        // log steady state frames that allocated
+        kReport,
+        // trap inside operator new when a steady state frame allocates, for the debugger
+        kTrap,
+    };
+
+    static void setMode(Mode mode);
+
+    /*!
+     * Starts counting allocations of the calling thread
+     * @param steadyState whether this frame is expected to be free of allocations
+     */
+    static void beginFrame(bool steadyState);
+
+    /*!
+     * Marks the current frame as one that may allocate, e.g. because input arrived
+     */
+    static void leaveSteadyState();
+
+    /*!
+     * Stops counting and updates the statistics
+     * @return the number of allocations made since @a beginFrame()
+     */
+    static uint32_t endFrame();
+
+    /*!
+     * @return allocations made by any thread since the app started
+     */
+    static uint64_t getTotalAllocations();
+
+    /*!
+     * @return a one line summary of the per frame allocation counts
+     */
+    static std::string summarize();
+};
+
+#endif //SCROLLER_ALLOCATIONTRACKER_H
@@ -1,16 +1,22 @@
 #ifndef ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 #define ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 
+#ifdef __ANDROID__
 #include <android/log.h>
+#else
+#include <cstdio>
+#endif
 #include <sstream>
 
 /*!
- * Use this to log strings out to logcat. Note that you should use std::endl to commit the line
+ * Use this to log strings out to logcat, or stderr on other platforms. Note that you should use
+ * std::endl to commit the line. Every thread has its own stream, so lines from different threads
+ * do not interleave.
  *
  * ex:
  *  aout << "Hello World" << std::endl;
  */
-extern std::ostream aout;
+extern thread_local std::ostream aout;
 
 /*!
  * Use this class to create an output stream that writes to logcat. By default, a global one is
@@ -26,7 +32,11 @@ public:
 
 protected:
     virtual int sync() override {
+#ifdef __ANDROID__
         __android_log_print(ANDROID_LOG_DEBUG, logTag_, "%s", str().c_str());
+#else
+        fprintf(stderr, "%s: %s", logTag_, str().c_str());
+#endif
         str("");
         return 0;
     }
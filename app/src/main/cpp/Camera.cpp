@@ -0,0 +1,83 @@
+#include "Camera.h"
+
+Camera::Camera()
+        : halfHeight_(1.f),
+          near_(-1.f),
+          far_(1.f),
+          width_(1),
+          height_(1),
+          zoom_(1.f),
+          positionX_(0.f),
+          positionY_(0.f),
+          dirty_(true),
+          version_(0),
+          viewProjection_(Mat4::identity()),
+          inverseViewProjection_(Mat4::identity()) {}
+
+void Camera::setProjection(float halfHeight, float near, float far) {
+    if (halfHeight != halfHeight_ || near != near_ || far != far_) {
+        halfHeight_ = halfHeight;
+        near_ = near;
+        far_ = far;
+        markDirty();
+    }
+}
+
+void Camera::setViewport(int width, int height) {
+    if ((width != width_ || height != height_) && width > 0 && height > 0) {
+        width_ = width;
+        height_ = height;
+        markDirty();
+    }
+}
+
+void Camera::setZoom(float zoom) {
+    if (zoom != zoom_ && zoom > 0.f) {
+        zoom_ = zoom;
+        markDirty();
+    }
+}
+
+void Camera::setPosition(float x, float y) {
+    if (x != positionX_ || y != positionY_) {
+        positionX_ = x;
+        positionY_ = y;
+        markDirty();
+    }
+}
+
+const Mat4 &Camera::getViewProjection() {
+    update();
+    return viewProjection_;
+}
+
+const Mat4 &Camera::getInverseViewProjection() {
+    update();
+    return inverseViewProjection_;
+}
+
+void Camera::screenToWorld(float screenX, float screenY, float &outX, float &outY) {
+    // Pixels to normalized device coordinates, y points up there
+    const float ndc[2] = {
+            screenX / float(width_) * 2.f - 1.f,
+            1.f - screenY / float(height_) * 2.f,
+    };
+    float world[2];
+    getInverseViewProjection().transformPoints(ndc, world, 1);
+    outX = world[0];
+    outY = world[1];
+}
+
+void Camera::update() {
+    if (!dirty_) {
+        return;
+    }
+    dirty_ = false;
+
+    const Mat4 projection = Mat4::orthographic(
+            halfHeight_ / zoom_, float(width_) / float(height_), near_, far_);
+    viewProjection_ = projection * Mat4::translation(positionX_, positionY_);
+    if (!viewProjection_.inverse(inverseViewProjection_)) {
+        inverseViewProjection_ = Mat4::identity();
+    }
+}
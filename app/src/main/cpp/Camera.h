@@ -0,0 +1,85 @@
+#ifndef SCROLLER_CAMERA_H
+#define SCROLLER_CAMERA_H
+
+#include <cstdint>
+
+#include "VectorMath.h"
+
+/*!
+ * A 2D camera looking at the grid through an orthographic projection. The combined
+ * view-projection and its inverse are only rebuilt after something changed, so asking for them
+ * every frame and for every touch is cheap.
+ */
+class Camera {
+public:
+    Camera();
+
+    /*!
+     * @param halfHeight half of the visible height at zoom 1
+     * @param near the distance of the near plane
+     * @param far the distance of the far plane
+     */
+    void setProjection(float halfHeight, float near, float far);
+
+    void setViewport(int width, int height);
+
+    /*!
+     * @param zoom larger values show less of the grid
+     */
+    void setZoom(float zoom);
+
+    /*!
+     * Offsets everything drawn, i.e. how far the grid is scrolled
+     */
+    void setPosition(float x, float y);
+
+    inline float getPositionX() const { return positionX_; }
+
+    inline float getPositionY() const { return positionY_; }
+
+    /*!
+     * @return screen pixels per unit of grid space at the current zoom
+     */
+    inline float getPixelsPerUnit() const { return float(height_) * zoom_ / (2.f * halfHeight_); }
+
+    const Mat4 &getViewProjection();
+
+    const Mat4 &getInverseViewProjection();
+
+    /*!
+     * Counts changes of the view-projection, so users can skip work when it did not change
+     */
+    inline uint32_t getVersion() const { return version_; }
+
+    /*!
+     * Maps a pixel to grid space (the space models are built in) through the inverse
+     * view-projection
+     * @param screenX pixels from the left edge
+     * @param screenY pixels from the top edge
+     */
+    void screenToWorld(float screenX, float screenY, float &outX, float &outY);
+
+private:
+    void update();
+
+    inline void markDirty() {
+        dirty_ = true;
+        version_++;
+    }
+
+    float halfHeight_;
+    float near_;
+    float far_;
+    int width_;
+    int height_;
+    float zoom_;
+    float positionX_;
+    float positionY_;
+
+    bool dirty_;
+    uint32_t version_;
+    Mat4 viewProjection_;
+    Mat4 inverseViewProjection_;
+};
+
+#endif //SCROLLER_CAMERA_H
@@ -0,0 +1,102 @@
+#include "DamageTracker.h"
+
+#include <algorithm>
+
+DamageTracker::DamageTracker() : width_(0), height_(0), frames_(), current_(0),
+                                 recordedFrames_(0) {
+    resize(0, 0);
+}
+
+void DamageTracker::resize(int width, int height) {
+    width_ = width;
+    height_ = height;
+    for (Frame &frame: frames_) {
+        frame.count = 0;
+        frame.full = false;
+    }
+    current_ = 0;
+    recordedFrames_ = 0;
+    addFull();
+}
+
+void DamageTracker::addFull() {
+    frames_[current_].full = true;
+}
+
+void DamageTracker::add(const Rect &rect) {
+    const Rect clipped = {std::max(rect.x0, 0), std::max(rect.y0, 0), std::min(rect.x1, width_),
+                          std::min(rect.y1, height_)};
+    if (clipped.empty() || frames_[current_].full) {
+        return;
+    }
+    addToFrame(frames_[current_], clipped);
+}
+
+int DamageTracker::getRedrawRects(int bufferAge, Rect *outRects) const {
+    // The buffer is unknown, from before the last resize or older than the damage kept
+    if (bufferAge <= 0 || bufferAge > recordedFrames_) {
+        outRects[0] = {0, 0, width_, height_};
+        return 1;
+    }
+    Frame combined = frames_[current_];
+    for (int age = 1; age < bufferAge && !combined.full; age++) {
+        const Frame &frame = frames_[(current_ + kMaxBufferAge - age) % kMaxBufferAge];
+        combined.full = frame.full;
+        for (int i = 0; i < frame.count; i++) {
+            addToFrame(combined, frame.rects[i]);
+        }
+    }
+    return writeRects(combined, outRects);
+}
+
+int DamageTracker::getFrameRects(Rect *outRects) const {
+    return writeRects(frames_[current_], outRects);
+}
+
+DamageTracker::Rect DamageTracker::getBounds(const Rect *rects, int count) {
+    if (count == 0) {
+        return {0, 0, 0, 0};
+    }
+    Rect bounds = rects[0];
+    for (int i = 1; i < count; i++) {
+        bounds.x0 = std::min(bounds.x0, rects[i].x0);
+        bounds.y0 = std::min(bounds.y0, rects[i].y0);
+        bounds.x1 = std::max(bounds.x1, rects[i].x1);
+        bounds.y1 = std::max(bounds.y1, rects[i].y1);
+    }
+    return bounds;
+}
+
+void DamageTracker::endFrame() {
+    current_ = (current_ + 1) % kMaxBufferAge;
+    frames_[current_].count = 0;
+    frames_[current_].full = false;
+    recordedFrames_ = std::min(recordedFrames_ + 1, kMaxBufferAge);
+}
+
+void DamageTracker::addToFrame(Frame &frame, const Rect &rect) {
+    // A rectangle inside one already there adds nothing, common for units that stand still
+    for (int i = 0; i < frame.count; i++) {
+        const Rect &existing = frame.rects[i];
+        if (rect.x0 >= existing.x0 && rect.y0 >= existing.y0 && rect.x1 <= existing.x1
+            && rect.y1 <= existing.y1) {
+            return;
+        }
+    }
+    if (frame.count == kMaxRects) {
+        frame.rects[0] = getBounds(frame.rects, frame.count);
+        frame.count = 1;
+        addToFrame(frame, rect);
+        return;
+    }
+    frame.rects[frame.count++] = rect;
+}
+
+int DamageTracker::writeRects(const Frame &frame, Rect *outRects) const {
+    if (frame.full) {
+        outRects[0] = {0, 0, width_, height_};
+        return 1;
+    }
+    std::copy(frame.rects, frame.rects + frame.count, outRects);
+    return frame.count;
+}
@@ -0,0 +1,104 @@
+#ifndef SCROLLER_DAMAGETRACKER_H
+#define SCROLLER_DAMAGETRACKER_H
+
+/*!
+ * Collects the parts of the surface that change in a frame, so that a frame only redraws those
+ * and the compositor only recomposes those.
+ *
+ * A back buffer that is redrawn holds the frame from as many frames ago as its age (from
+ * EGL_BUFFER_AGE_KHR), so it has to be redrawn wherever any of the frames since then changed.
+ * The damage of the last kMaxBufferAge frames is kept for that. A frame keeps up to kMaxRects
+ * rectangles, more are merged into their bounds.
+ */
+class DamageTracker {
+public:
+    struct Rect {
+        int x0, y0, x1, y1; // inclusive-exclusive pixel bounds, y up like GL window coordinates
+
+        inline bool empty() const { return x1 <= x0 || y1 <= y0; }
+
+        inline int getWidth() const { return x1 - x0; }
+
+        inline int getHeight() const { return y1 - y0; }
+    };
+
+    //! Rectangles per frame before they are merged, eglSetDamageRegionKHR takes a short list
+    static constexpr int kMaxRects = 8;
+    //! Frames of damage kept, buffers older than that are redrawn completely
+    static constexpr int kMaxBufferAge = 4;
+
+    DamageTracker();
+
+    /*!
+     * Starts over for a surface of a new size, everything is damaged
+     */
+    void resize(int width, int height);
+
+    /*!
+     * Damages the whole surface this frame
+     */
+    void addFull();
+
+    /*!
+     * Damages a rectangle this frame, clipped to the surface
+     */
+    void add(const Rect &rect);
+
+    /*!
+     * @return true if this frame damaged the whole surface so far
+     */
+    inline bool isFull() const { return frames_[current_].full; }
+
+    /*!
+     * What a back buffer needs redrawn: the damage of this frame and of the frames since the
+     * buffer was last drawn
+     * @param bufferAge the age of the back buffer, 0 if its contents are unknown
+     * @param outRects receives up to kMaxRects rectangles
+     * @return the number of rectangles, the whole surface is one rectangle. 0 if nothing changed.
+     */
+    int getRedrawRects(int bufferAge, Rect *outRects) const;
+
+    /*!
+     * What changed since the previous frame, for the compositor
+     * @param outRects receives up to kMaxRects rectangles
+     * @return the number of rectangles, 0 if nothing changed
+     */
+    int getFrameRects(Rect *outRects) const;
+
+    /*!
+     * @return the smallest rectangle around @a rects, empty if @a count is 0
+     */
+    static Rect getBounds(const Rect *rects, int count);
+
+    /*!
+     * Keeps the damage of this frame for the buffers drawn next and starts a new frame
+     */
+    void endFrame();
+
+private:
+    struct Frame {
+        Rect rects[kMaxRects];
+        int count;
+        bool full;
+    };
+
+    /*!
+     * Adds a clipped, non-empty rectangle to @a frame, merging once it has kMaxRects
+     */
+    static void addToFrame(Frame &frame, const Rect &rect);
+
+    /*!
+     * Writes @a frame out as a list of rectangles
+     */
+    int writeRects(const Frame &frame, Rect *outRects) const;
+
+    int width_;
+    int height_;
+    //! the damage of the last frames, a ring with frames_[current_] the frame being drawn
+    Frame frames_[kMaxBufferAge];
+    int current_;
+    //! frames recorded since the last resize, older buffers are from another surface size
+    int recordedFrames_;
+};
+
+#endif //SCROLLER_DAMAGETRACKER_H
@@ -0,0 +1,213 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+
+#ifdef __ANDROID__
+#include <android/choreographer.h>
+#include <dlfcn.h>
+#endif
+
+#include "AndroidOut.h"
+#include "Metrics.h"
+#include "SimulationClock.h"
+
+/*!
+ * Vsync intervals shorter than this are taken as noise, no display refreshes faster than 250 Hz
+ */
+static constexpr int64_t kMinRefreshNanos = 4000000;
+
+#ifdef __ANDROID__
+
+/*!
+ * AChoreographer_postFrameCallback64 needs API level 29, above the app's minimum, and the older
+ * call passes the timestamp as a long, which is 32 bits on 32 bit ABIs. Both are looked up at
+ * runtime, the older one only where its timestamp fits.
+ *
+ * A posted callback cannot be taken back, so the callbacks outlive pacers: they hand vsyncs to the
+ * pacer that is current, and stop posting themselves once there is none.
+ */
+namespace {
+    typedef void (*PostFrameCallback64Function)(AChoreographer *, AChoreographer_frameCallback64,
+                                                void *);
+    typedef void (*PostFrameCallbackFunction)(AChoreographer *, AChoreographer_frameCallback,
+                                              void *);
+
+    struct ChoreographerApi {
+        PostFrameCallback64Function postFrameCallback64 = nullptr;
+        PostFrameCallbackFunction postFrameCallback = nullptr;
+
+        ChoreographerApi() {
+            void *library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+            if (library) {
+                postFrameCallback64 = reinterpret_cast<PostFrameCallback64Function>(
+                        dlsym(library, "AChoreographer_postFrameCallback64"));
+                if (sizeof(long) >= sizeof(int64_t)) {
+                    postFrameCallback = reinterpret_cast<PostFrameCallbackFunction>(
+                            dlsym(library, "AChoreographer_postFrameCallback"));
+                }
+            }
+        }
+    };
+
+    const ChoreographerApi &choreographerApi() {
+        static ChoreographerApi api;
+        return api;
+    }
+
+    //! the pacer vsyncs go to, null once it is gone
+    FramePacer *gVsyncPacer = nullptr;
+    bool gCallbackPosted = false;
+
+    bool postFrameCallback();
+
+    void onFrame(int64_t frameTimeNanos) {
+        gCallbackPosted = false;
+        if (gVsyncPacer) {
+            gVsyncPacer->onVsync(frameTimeNanos);
+            postFrameCallback();
+        }
+    }
+
+    void onFrame64(int64_t frameTimeNanos, void *) {
+        onFrame(frameTimeNanos);
+    }
+
+    void onFrameLong(long frameTimeNanos, void *) {
+        onFrame(int64_t(frameTimeNanos));
+    }
+
+    bool postFrameCallback() {
+        if (gCallbackPosted) {
+            return true;
+        }
+        AChoreographer *choreographer = AChoreographer_getInstance();
+        if (!choreographer) {
+            return false;
+        }
+        const ChoreographerApi &api = choreographerApi();
+        if (api.postFrameCallback64) {
+            api.postFrameCallback64(choreographer, onFrame64, nullptr);
+        } else if (api.postFrameCallback) {
+            api.postFrameCallback(choreographer, onFrameLong, nullptr);
+        } else {
+            return false;
+        }
+        gCallbackPosted = true;
+        return true;
+    }
+}
+
+#endif
+
+FramePacer::FramePacer()
+        : simulated_(true), simulatedOriginNanos_(SimulationClock::nowNanos()), targetRate_(0),
+          refreshesPerFrame_(1), refreshNanos_(kDefaultRefreshNanos), drawNanos_(0),
+          latestVsyncNanos_(0), nextFrameVsyncNanos_(0), started_(false), jankyFrames_(0),
+          missedVsyncs_(0) {
+#ifdef __ANDROID__
+    gVsyncPacer = this;
+    simulated_ = !postFrameCallback();
+    if (simulated_) {
+        gVsyncPacer = nullptr;
+    }
+#endif
+    updateRefreshesPerFrame();
+    aout << "Frame pacing on " << (simulated_ ? "a simulated clock" : "Choreographer") << std::endl;
+}
+
+FramePacer::~FramePacer() {
+#ifdef __ANDROID__
+    if (gVsyncPacer == this) {
+        gVsyncPacer = nullptr;
+    }
+#endif
+}
+
+void FramePacer::setTargetRate(int framesPerSecond) {
+    targetRate_ = std::max(0, framesPerSecond);
+    updateRefreshesPerFrame();
+}
+
+void FramePacer::onVsync(int64_t vsyncNanos) {
+    static Metrics::Gauge &refreshRate = Metrics::gauge("frame_pacer.refresh_rate", "Hz");
+    const int64_t interval = latestVsyncNanos_ ? vsyncNanos - latestVsyncNanos_ : 0;
+    latestVsyncNanos_ = std::max(latestVsyncNanos_, vsyncNanos);
+
+    // Callbacks that were held up skip vsyncs, so intervals are whole refresh periods. Shorter ones
+    // mean a faster display, longer ones are ignored, erring on a faster refresh.
+    if (interval < kMinRefreshNanos) {
+        return;
+    }
+    const int64_t previous = refreshNanos_;
+    if (interval < refreshNanos_ * 3 / 4) {
+        refreshNanos_ = interval;
+    } else if (interval < refreshNanos_ * 3 / 2) {
+        refreshNanos_ += (interval - refreshNanos_) / 16;
+    }
+    if (refreshNanos_ != previous) {
+        refreshRate.set((1000000000 + refreshNanos_ / 2) / refreshNanos_);
+        updateRefreshesPerFrame();
+    }
+}
+
+int FramePacer::getWaitMillis(int64_t nowNanos) {
+    if (simulated_) {
+        takeSimulatedVsync(nowNanos);
+    }
+    // Vsyncs are a little early for the one a frame is due on, timestamps jitter
+    if (!started_ || latestVsyncNanos_ >= nextFrameVsyncNanos_ - refreshNanos_ / 2) {
+        return 0;
+    }
+    // Choreographer wakes the loop up for the vsync, the wait only bounds a late callback
+    const int64_t waitNanos = nextFrameVsyncNanos_ - nowNanos;
+    return int(std::clamp<int64_t>((waitNanos + 999999) / 1000000, 1,
+                                   refreshNanos_ / 1000000 + 1));
+}
+
+void FramePacer::beginFrame(int64_t nowNanos) {
+    static Metrics::Counter &jankyFrames = Metrics::counter("frame_pacer.janky_frames");
+    static Metrics::Counter &missedVsyncs = Metrics::counter("frame_pacer.missed_vsyncs");
+    if (simulated_) {
+        takeSimulatedVsync(nowNanos);
+    }
+    // Before the first vsync arrived the frame starts now
+    const int64_t vsync = latestVsyncNanos_ ? latestVsyncNanos_ : nowNanos;
+
+    const int64_t lateNanos = vsync - nextFrameVsyncNanos_;
+    if (started_ && lateNanos > refreshNanos_ / 2) {
+        const uint64_t late = uint64_t((lateNanos + refreshNanos_ / 2) / refreshNanos_);
+        jankyFrames_++;
+        missedVsyncs_ += late;
+        jankyFrames.add();
+        missedVsyncs.add(late);
+    }
+    nextFrameVsyncNanos_ = vsync + getFramePeriodNanos();
+    started_ = true;
+}
+
+void FramePacer::endFrame(int64_t drawNanos) {
+    // Drawing gets slower at once when the scene changes, the estimate rises faster than it falls
+    drawNanos_ += (drawNanos - drawNanos_) / (drawNanos > drawNanos_ ? 2 : 16);
+}
+
+int64_t FramePacer::getDeadlineNanos() const {
+    return nextFrameVsyncNanos_ - drawNanos_;
+}
+
+int64_t FramePacer::getPresentationNanos() const {
+    return nextFrameVsyncNanos_ - refreshNanos_ / 2;
+}
+
+void FramePacer::takeSimulatedVsync(int64_t nowNanos) {
+    const int64_t elapsed = std::max<int64_t>(0, nowNanos - simulatedOriginNanos_);
+    onVsync(simulatedOriginNanos_ + elapsed / refreshNanos_ * refreshNanos_);
+}
+
+void FramePacer::updateRefreshesPerFrame() {
+    static Metrics::Gauge &frameRate = Metrics::gauge("frame_pacer.frame_rate", "Hz");
+    // The nearest whole number of refreshes, never faster than the display
+    const int64_t targetNanos = targetRate_ > 0 ? 1000000000 / targetRate_ : 0;
+    refreshesPerFrame_ = int(std::max<int64_t>(1, (targetNanos + refreshNanos_ / 2)
+                                                  / refreshNanos_));
+    frameRate.set((1000000000 + getFramePeriodNanos() / 2) / getFramePeriodNanos());
+}
@@ -0,0 +1,123 @@
+#ifndef SCROLLER_FRAMEPACER_H
+#define SCROLLER_FRAMEPACER_H
+
+#include <cstdint>
+
+/*!
+ * Starts frames on vsync at a target rate and tells the compositor when to show them, so that
+ * every frame stays on screen equally long instead of frames being drawn as fast as the loop spins.
+ *
+ * Vsyncs come from Choreographer on Android and from a simulated 60 Hz clock elsewhere, or where
+ * Choreographer is not available. A frame takes a whole number of refresh periods, the target
+ * rate is rounded to that: 30 Hz on a 60 Hz display starts a frame on every second vsync, 90 Hz
+ * on a 60 Hz display on every vsync. The refresh period is learnt from the vsync timestamps.
+ *
+ * A frame that starts after the vsync it was due on is janky, the previous frame stayed on screen
+ * for longer. Those are counted, as are the vsyncs they were late by.
+ *
+ * Everything runs on the thread the pacer was created on, the thread that renders. On Android that
+ * thread needs a looper, the Choreographer callbacks are delivered through it.
+ */
+class FramePacer {
+public:
+    //! Refresh period assumed until vsyncs were measured, and the one simulated, 60 Hz
+    static constexpr int64_t kDefaultRefreshNanos = 16666667;
+
+    FramePacer();
+
+    /*!
+     * Stops taking vsyncs from Choreographer
+     */
+    ~FramePacer();
+
+    FramePacer(const FramePacer &) = delete;
+
+    FramePacer &operator=(const FramePacer &) = delete;
+
+    /*!
+     * @param framesPerSecond the frames per second to aim for, such as 30, 60, 90 or 120. 0 starts
+     *     a frame on every vsync.
+     */
+    void setTargetRate(int framesPerSecond);
+
+    inline int getTargetRate() const { return targetRate_; }
+
+    /*!
+     * Takes the timestamp of a vsync, from SimulationClock::nowNanos()'s clock
+     */
+    void onVsync(int64_t vsyncNanos);
+
+    /*!
+     * @return how long the loop can wait for the next frame in milliseconds, 0 if it is due now
+     */
+    int getWaitMillis(int64_t nowNanos);
+
+    /*!
+     * Starts a frame on the latest vsync, counting how late it is if it was due earlier
+     */
+    void beginFrame(int64_t nowNanos);
+
+    /*!
+     * Learns how long drawing takes from a frame that was just swapped
+     * @param drawNanos how long drawing the frame took up to the swap
+     */
+    void endFrame(int64_t drawNanos);
+
+    /*!
+     * @return when the frame has to start drawing to be done in its slot, the end of the slot
+     *     minus the time drawing usually takes
+     */
+    int64_t getDeadlineNanos() const;
+
+    /*!
+     * @return when the frame should be shown, for eglPresentationTimeANDROID. Half a refresh
+     *     period before the vsync that ends the frame's slot, the compositor shows a frame on the
+     *     first vsync at or after its time.
+     */
+    int64_t getPresentationNanos() const;
+
+    inline int64_t getRefreshNanos() const { return refreshNanos_; }
+
+    //! a whole number of refresh periods
+    inline int64_t getFramePeriodNanos() const { return refreshNanos_ * refreshesPerFrame_; }
+
+    //! frames that started after the vsync they were due on
+    inline uint64_t getJankyFrames() const { return jankyFrames_; }
+
+    //! vsyncs the janky frames started late by, each kept the previous frame on screen longer
+    inline uint64_t getMissedVsyncs() const { return missedVsyncs_; }
+
+    //! true if vsyncs come from a simulated clock
+    inline bool isSimulated() const { return simulated_; }
+
+private:
+    /*!
+     * Takes the latest vsync of the simulated clock
+     */
+    void takeSimulatedVsync(int64_t nowNanos);
+
+    /*!
+     * Refreshes per frame for the target rate at the current refresh period
+     */
+    void updateRefreshesPerFrame();
+
+    bool simulated_;
+    //! the simulated vsyncs are this plus whole refresh periods
+    int64_t simulatedOriginNanos_;
+
+    int targetRate_;
+    int refreshesPerFrame_;
+    int64_t refreshNanos_;
+    //! running estimate of drawing a frame up to the swap
+    int64_t drawNanos_;
+
+    int64_t latestVsyncNanos_;
+    //! the vsync the next frame is due on, which ends the current frame's slot
+    int64_t nextFrameVsyncNanos_;
+    bool started_;
+
+    uint64_t jankyFrames_;
+    uint64_t missedVsyncs_;
+};
+
+#endif //SCROLLER_FRAMEPACER_H
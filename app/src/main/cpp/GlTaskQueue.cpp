@@ -0,0 +1,86 @@
+#include "GlTaskQueue.h"
+
+#include <utility>
+
+#include "Metrics.h"
+#include "SimulationClock.h"
+#include "Trace.h"
+
+void GlTaskQueue::post(const char *name, Priority priority, Step step) {
+    queues_[priority].push_back(Task{name, std::move(step), 0, 0});
+}
+
+int GlTaskQueue::run(int64_t deadlineNanos) {
+    SCROLLER_TRACE_SCOPE("GlTaskQueue::run");
+    static Metrics::Counter &forcedSteps = Metrics::counter("gl_tasks.forced_steps");
+    static Metrics::Histogram &frameTime = Metrics::histogram("gl_tasks.frame_time", "us");
+    static Metrics::Gauge &queued = Metrics::gauge("gl_tasks.queued", "tasks");
+    const int64_t start = SimulationClock::nowNanos();
+
+    int steps = 0;
+    bool outOfTime = false;
+    for (int priority = 0; priority < kPriorityCount; priority++) {
+        std::deque<Task> &queue = queues_[priority];
+        while (!queue.empty()) {
+            Task &task = queue.front();
+            const bool fits = priority == kPriorityUrgent
+                              || (!outOfTime
+                                  && SimulationClock::nowNanos() + task.stepNanos <= deadlineNanos);
+            if (!fits && task.skippedFrames < kMaxSkippedFrames) {
+                // Lower priorities wait as well, they must not take the time this one is missing
+                task.skippedFrames++;
+                outOfTime = true;
+                break;
+            }
+            runStep(queue);
+            steps++;
+            if (!fits) {
+                forcedSteps.add();
+                outOfTime = true;
+                break;
+            }
+        }
+    }
+
+    if (steps > 0) {
+        frameTime.record(uint64_t(SimulationClock::nowNanos() - start) / 1000);
+    }
+    queued.set(int64_t(size()));
+    return steps;
+}
+
+void GlTaskQueue::clear() {
+    for (std::deque<Task> &queue: queues_) {
+        queue.clear();
+    }
+}
+
+size_t GlTaskQueue::size() const {
+    size_t count = 0;
+    for (const std::deque<Task> &queue: queues_) {
+        count += queue.size();
+    }
+    return count;
+}
+
+void GlTaskQueue::runStep(std::deque<Task> &queue) {
+    static Metrics::Counter &stepsRun = Metrics::counter("gl_tasks.steps");
+    // A step may post more tasks, which leaves references to the deque's elements valid
+    Task &task = queue.front();
+    const int64_t start = SimulationClock::nowNanos();
+    bool finished;
+    {
+        SCROLLER_TRACE_SCOPE(task.name);
+        finished = task.step();
+    }
+    const int64_t stepNanos = SimulationClock::nowNanos() - start;
+    stepsRun.add();
+
+    if (finished) {
+        queue.pop_front();
+        return;
+    }
+    // Steps of one task cost about the same, recent ones count most
+    task.stepNanos = task.stepNanos == 0 ? stepNanos : (task.stepNanos * 3 + stepNanos) / 4;
+    task.skippedFrames = 0;
+}
@@ -0,0 +1,84 @@
+#ifndef SCROLLER_GLTASKQUEUE_H
+#define SCROLLER_GLTASKQUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/*!
+ * Work that has to run on the GL thread, such as texture uploads, spread over frames so that it
+ * fits into the time a frame has left before its vsync deadline.
+ *
+ * A task is a function that does one step of the work per call and returns true once the task is
+ * finished, a large upload uploads a band of rows per step. run() is called once per frame and
+ * runs steps, the highest priority first, while the next step is expected to finish before the
+ * deadline. The expected time of a step is learnt from the previous steps of the same task.
+ *
+ * Everything runs on the GL thread, tasks are posted and run there.
+ */
+class GlTaskQueue {
+public:
+    enum Priority {
+        //! needed by this frame, runs regardless of the deadline
+        kPriorityUrgent,
+        //! visible once done, e.g. a texture that is drawn as soon as it exists
+        kPriorityVisible,
+        //! preparing something not shown yet
+        kPriorityBackground,
+        kPriorityCount,
+    };
+
+    //! Frames a task may go without a step before it runs one regardless of the deadline
+    static constexpr int kMaxSkippedFrames = 8;
+
+    /*!
+     * One step of a task
+     * @return true once the task is finished
+     */
+    using Step = std::function<bool()>;
+
+    /*!
+     * Queues a task behind the tasks of the same priority
+     * @param name names the task in traces, must outlive the task
+     */
+    void post(const char *name, Priority priority, Step step);
+
+    /*!
+     * Runs steps until the next one would likely miss @a deadlineNanos or no task is left. Urgent
+     * tasks run to the end, and a task that was skipped for kMaxSkippedFrames frames runs a step
+     * even when the frame has no time left, so nothing waits forever.
+     * @param deadlineNanos when the frame has to start drawing, from SimulationClock::nowNanos()
+     * @return the steps that ran
+     */
+    int run(int64_t deadlineNanos);
+
+    /*!
+     * Drops every task without running it. Tasks hold GL objects, so this needs the context.
+     */
+    void clear();
+
+    /*!
+     * @return the tasks not finished yet
+     */
+    size_t size() const;
+
+    inline bool empty() const { return size() == 0; }
+
+private:
+    struct Task {
+        const char *name;
+        Step step;
+        //! running average of the steps of this task, 0 before the first one
+        int64_t stepNanos;
+        int skippedFrames;
+    };
+
+    /*!
+     * Runs one step of the task at the front of @a queue and removes the task once it finished
+     */
+    void runStep(std::deque<Task> &queue);
+
+    std::deque<Task> queues_[kPriorityCount];
+};
+
+#endif //SCROLLER_GLTASKQUEUE_H
@@ -0,0 +1,50 @@
+#ifndef SCROLLER_GRIDLAYOUT_H
+#define SCROLLER_GRIDLAYOUT_H
+
+#include <algorithm>
+#include <cmath>
+
+/*!
+ * Where map cells are in world space. The grid is square, sized by the longer side of the map and
+ * centered on the origin, with row 0 at the top.
+ */
+struct GridLayout {
+    //! Distance between the centers of two neighbouring cells
+    static constexpr float kCellSpacing = 0.4f;
+    //! Cells are drawn slightly smaller than the spacing so the grid lines stay visible
+    static constexpr float kCellFill = 0.8f;
+
+    int width;
+    int height;
+    //! Half the size of the grid
+    float extent;
+
+    static inline GridLayout forMap(int width, int height) {
+        return {width, height, std::max(width, height) * kCellSpacing * 0.5f};
+    }
+
+    static constexpr float cellSize() { return kCellSpacing * kCellFill; }
+
+    /*!
+     * @param x a column, fractional for things between two cells
+     */
+    inline float cellCenterX(float x) const { return -extent + (x + 0.5f) * kCellSpacing; }
+
+    /*!
+     * @param y a row, fractional for things between two cells
+     */
+    inline float cellCenterY(float y) const { return extent - (y + 0.5f) * kCellSpacing; }
+
+    /*!
+     * Finds the cell whose center is closest to a point in world space (grid space, scrolling
+     * already removed)
+     * @return false if the point is outside the map, the cell is still written
+     */
+    inline bool worldToCell(float worldX, float worldY, int &outX, int &outY) const {
+        outX = int(std::round((worldX + extent) / kCellSpacing - 0.5f));
+        outY = int(std::round((extent - worldY) / kCellSpacing - 0.5f));
+        return outX >= 0 && outX < width && outY >= 0 && outY < height;
+    }
+};
+
+#endif //SCROLLER_GRIDLAYOUT_H
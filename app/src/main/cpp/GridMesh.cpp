@@ -0,0 +1,130 @@
+#include "GridMesh.h"
+
+#include <atomic>
+#include <cstdint>
+
+#include "Parallel.h"
+#include "Trace.h"
+
+/*!
+ * How a map cell is drawn, also the index into kCellColors
+ */
+enum CellKind : uint8_t {
+    kCellEmpty,
+    kCellObject,
+    kCellGreen,
+    kCellBlue,
+    kCellYellow,
+};
+
+static constexpr Vector3 kCellColors[] = {
+        {0.2f, 0.2f, 0.2f}, // Dark gray for empty
+        {1.0f, 0.5f, 0.0f}, // Orange for objects
+        {0.0f, 1.0f, 0.0f}, // Green
+        {0.0f, 0.0f, 1.0f}, // Blue
+        {1.0f, 1.0f, 0.0f}, // Yellow
+};
+
+static CellKind classifyCell(char cellType) {
+    switch (cellType) {
+        case 'o':
+        case 'O':
+            return kCellObject;
+        case '1':
+            return kCellGreen;
+        case '2':
+            return kCellBlue;
+        case '3':
+            return kCellYellow;
+        case ' ':
+        default:
+            return kCellEmpty;
+    }
+}
+
+void GridMesh::build(const MapData &map,
+                     const GridLayout &layout,
+                     ScratchArena &scratch,
+                     MeshBuilder<Vertex, Model> &builder,
+                     std::vector<Model> &outLines,
+                     std::vector<Model> &outTriangles) {
+    SCROLLER_TRACE_SCOPE("GridMesh::build");
+
+    // Classify every cell once and count them, so each mesh is reserved exactly once
+    const size_t cellCount = size_t(map.width) * map.height;
+    scratch.reset();
+    CellKind *cellKinds = scratch.allocate<CellKind>(cellCount);
+    std::atomic<size_t> objectCount(0);
+    Parallel::forEachSlice(map.height, cellCount >= Parallel::kMinCells,
+                           [&map, cellKinds, &objectCount](int begin, int end) {
+        size_t objects = 0;
+        for (size_t i = size_t(begin) * map.width; i < size_t(end) * map.width; i++) {
+            cellKinds[i] = classifyCell(map.data[i]);
+            objects += cellKinds[i] == kCellObject;
+        }
+        objectCount.fetch_add(objects, std::memory_order_relaxed);
+    });
+
+    const float half = GridLayout::cellSize() / 2;
+
+    // Objects are filled squares, everything else is just an outline
+    for (bool filled: {false, true}) {
+        builder.begin(filled ? MeshBuilder<Vertex, Model>::kQuad
+                             : MeshBuilder<Vertex, Model>::kOutline,
+                      filled ? objectCount.load() : cellCount - objectCount.load(),
+                      filled ? outTriangles : outLines);
+
+        for (int y = 0; y < map.height; y++) {
+            float cellY = layout.cellCenterY(float(y));
+            for (int x = 0; x < map.width; x++) {
+                CellKind kind = cellKinds[y * map.width + x];
+                if ((kind == kCellObject) != filled) {
+                    continue;
+                }
+
+                float cellX = layout.cellCenterX(float(x));
+                const Vector3 &cellColor = kCellColors[kind];
+                Vertex topLeft(Vector3{cellX - half, cellY + half, 0}, cellColor);
+                Vertex topRight(Vector3{cellX + half, cellY + half, 0}, cellColor);
+                Vertex bottomRight(Vector3{cellX + half, cellY - half, 0}, cellColor);
+                Vertex bottomLeft(Vector3{cellX - half, cellY - half, 0}, cellColor);
+                if (filled) {
+                    builder.addQuad(topLeft, topRight, bottomRight, bottomLeft);
+                } else {
+                    builder.addOutline(topLeft, topRight, bottomRight, bottomLeft);
+                }
+            }
+        }
+        builder.finish();
+    }
+}
+
+void GridMesh::buildEmpty(int gridSize,
+                          MeshBuilder<Vertex, Model> &builder,
+                          std::vector<Model> &outLines) {
+    const float gridExtent = GridLayout::forMap(gridSize, gridSize).extent;
+    const float gridSpacing = GridLayout::kCellSpacing;
+
+    // Default white color for grid lines
+    const Vector3 gridColor = {1.0f, 1.0f, 1.0f};
+    builder.begin(MeshBuilder<Vertex, Model>::kLine, 2 * (gridSize + 1), outLines);
+
+    // Create vertical lines
+    for (int i = 0; i <= gridSize; i++) {
+        float x = -gridExtent + i * gridSpacing;
+        builder.addLine(Vertex(Vector3{x, -gridExtent, 0}, gridColor),
+                        Vertex(Vector3{x, gridExtent, 0}, gridColor));
+    }
+
+    // Create horizontal lines
+    for (int i = 0; i <= gridSize; i++) {
+        float y = -gridExtent + i * gridSpacing;
+        builder.addLine(Vertex(Vector3{-gridExtent, y, 0}, gridColor),
+                        Vertex(Vector3{gridExtent, y, 0}, gridColor));
+    }
+    builder.finish();
+}
+
+Vector3 GridMesh::getCellColor(char cellType) {
+    return kCellColors[classifyCell(cellType)];
+}
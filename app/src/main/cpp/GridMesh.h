@@ -0,0 +1,44 @@
+#ifndef SCROLLER_GRIDMESH_H
+#define SCROLLER_GRIDMESH_H
+
+#include <vector>
+
+#include "GridLayout.h"
+#include "MapData.h"
+#include "MeshBuilder.h"
+#include "Model.h"
+#include "ScratchArena.h"
+
+/*!
+ * Builds the static map meshes: a colored outline per cell and filled squares for objects. Tanks
+ * are drawn separately on top of the outline of the cell they are in.
+ */
+class GridMesh {
+public:
+    /*!
+     * Builds the cell meshes of a map. The builder should have recycled the old models already.
+     * @param scratch holds the cell classification, it is reset first
+     * @param outLines receives the outline models, drawn with GL_LINES
+     * @param outTriangles receives the object models, drawn with GL_TRIANGLES
+     */
+    static void build(const MapData &map,
+                      const GridLayout &layout,
+                      ScratchArena &scratch,
+                      MeshBuilder<Vertex, Model> &builder,
+                      std::vector<Model> &outLines,
+                      std::vector<Model> &outTriangles);
+
+    /*!
+     * Builds white grid lines for @a gridSize by @a gridSize cells, shown while there is no map
+     */
+    static void buildEmpty(int gridSize,
+                           MeshBuilder<Vertex, Model> &builder,
+                           std::vector<Model> &outLines);
+
+    /*!
+     * @return the color a cell is drawn in, tanks are drawn on top of an empty cell
+     */
+    static Vector3 getCellColor(char cellType);
+};
+
+#endif //SCROLLER_GRIDMESH_H
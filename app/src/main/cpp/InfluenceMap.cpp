@@ -0,0 +1,140 @@
+#include "InfluenceMap.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCROLLER_INFLUENCE_NEON 1
+#elif defined(__SSE2__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define SCROLLER_INFLUENCE_SSE2 1
+#endif
+
+InfluenceMap::InfluenceMap() : width_(0), height_(0), cellsPerTexel_(1), stride_(0),
+                               kernel_(), dirty_{INT_MAX, INT_MAX, INT_MIN, INT_MIN} {
+    // A tent in both directions, so neighbouring units blend into one smooth blob
+    for (int dy = -kRadius; dy <= kRadius; dy++) {
+        for (int dx = -kRadius; dx <= kRadius; dx++) {
+            kernel_[dy + kRadius][dx + kRadius] =
+                    uint16_t((kRadius + 1 - std::abs(dx)) * (kRadius + 1 - std::abs(dy)));
+        }
+    }
+}
+
+void InfluenceMap::reset(int mapWidth, int mapHeight, int cellsPerTexel) {
+    cellsPerTexel_ = std::max(1, cellsPerTexel);
+    width_ = (mapWidth + cellsPerTexel_ - 1) / cellsPerTexel_;
+    height_ = (mapHeight + cellsPerTexel_ - 1) / cellsPerTexel_;
+    stride_ = size_t(width_) + 2 * kRadius + kKernelLanes;
+    weights_.assign(stride_ * (height_ + 2 * kRadius), 0);
+    units_.clear();
+
+    // The texture starts out undefined, so the first export covers everything
+    dirty_ = {0, 0, width_, height_};
+}
+
+void InfluenceMap::setUnit(int unitId, int cellX, int cellY) {
+    if (unitId < 0 || width_ == 0 || height_ == 0) {
+        return;
+    }
+    if (size_t(unitId) >= units_.size()) {
+        units_.resize(unitId + 1, Unit{false, 0, 0});
+    }
+
+    const int x = std::clamp(cellX / cellsPerTexel_, 0, width_ - 1);
+    const int y = std::clamp(cellY / cellsPerTexel_, 0, height_ - 1);
+    Unit &unit = units_[unitId];
+    if (unit.active && unit.x == x && unit.y == y) {
+        return;
+    }
+
+    if (unit.active) {
+        stamp(unit.x, unit.y, false);
+    }
+    unit = {true, x, y};
+    stamp(x, y, true);
+}
+
+void InfluenceMap::removeUnit(int unitId) {
+    if (unitId < 0 || size_t(unitId) >= units_.size() || !units_[unitId].active) {
+        return;
+    }
+    Unit &unit = units_[unitId];
+    stamp(unit.x, unit.y, false);
+    unit.active = false;
+}
+
+bool InfluenceMap::takeDirtyRect(Rect &outRect) {
+    outRect = {std::max(dirty_.x0, 0), std::max(dirty_.y0, 0), std::min(dirty_.x1, width_),
+               std::min(dirty_.y1, height_)};
+    dirty_ = {INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+    return !outRect.empty();
+}
+
+void InfluenceMap::exportMask(const Rect &rect, uint8_t *outMask, int stride) const {
+    for (int y = rect.y0; y < rect.y1; y++) {
+        const uint16_t *weights = &weights_[getIndex(rect.x0, y)];
+        uint8_t *out = outMask + size_t(y - rect.y0) * stride;
+        const int count = rect.x1 - rect.x0;
+        int x = 0;
+
+        // min(weight, kPeak) * 255 >> kPeakShift, 8 texels at a time
+#if SCROLLER_INFLUENCE_NEON
+        const uint16x8_t peak = vdupq_n_u16(kPeak);
+        for (; x + 8 <= count; x += 8) {
+            const uint16x8_t clamped = vminq_u16(vld1q_u16(weights + x), peak);
+            vst1_u8(out + x, vmovn_u16(vshrq_n_u16(vmulq_n_u16(clamped, 255), kPeakShift)));
+        }
+#elif SCROLLER_INFLUENCE_SSE2
+        const __m128i peak = _mm_set1_epi16(kPeak);
+        const __m128i scale = _mm_set1_epi16(255);
+        for (; x + 8 <= count; x += 8) {
+            const __m128i loaded = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + x));
+            // SSE2 has no unsigned 16 bit min, but a saturating subtract does the same
+            const __m128i clamped = _mm_sub_epi16(loaded, _mm_subs_epu16(loaded, peak));
+            const __m128i scaled = _mm_srli_epi16(_mm_mullo_epi16(clamped, scale), kPeakShift);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x),
+                             _mm_packus_epi16(scaled, scaled));
+        }
+#endif
+
+        for (; x < count; x++) {
+            out[x] = uint8_t(std::min(weights[x], kPeak) * 255 >> kPeakShift);
+        }
+    }
+}
+
+size_t InfluenceMap::getMemoryBytes() const {
+    return weights_.capacity() * sizeof(uint16_t) + units_.capacity() * sizeof(Unit);
+}
+
+void InfluenceMap::stamp(int x, int y, bool add) {
+    // The border keeps the kernel inside the grid, the lanes past the kernel add 0
+    uint16_t *row = &weights_[getIndex(x - kRadius, y - kRadius)];
+    for (int ky = 0; ky < 2 * kRadius + 1; ky++, row += stride_) {
+#if SCROLLER_INFLUENCE_NEON
+        const uint16x8_t kernel = vld1q_u16(kernel_[ky]);
+        const uint16x8_t weights = vld1q_u16(row);
+        vst1q_u16(row, add ? vaddq_u16(weights, kernel) : vsubq_u16(weights, kernel));
+#elif SCROLLER_INFLUENCE_SSE2
+        const __m128i kernel = _mm_loadu_si128(reinterpret_cast<const __m128i *>(kernel_[ky]));
+        const __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(row),
+                         add ? _mm_add_epi16(weights, kernel) : _mm_sub_epi16(weights, kernel));
+#else
+        for (int kx = 0; kx < kKernelLanes; kx++) {
+            row[kx] = uint16_t(add ? row[kx] + kernel_[ky][kx] : row[kx] - kernel_[ky][kx]);
+        }
+#endif
+    }
+    markDirty(x, y);
+}
+
+void InfluenceMap::markDirty(int x, int y) {
+    dirty_.x0 = std::min(dirty_.x0, x - kRadius);
+    dirty_.y0 = std::min(dirty_.y0, y - kRadius);
+    dirty_.x1 = std::max(dirty_.x1, x + kRadius + 1);
+    dirty_.y1 = std::max(dirty_.y1, y + kRadius + 1);
+}
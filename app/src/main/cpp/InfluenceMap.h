@@ -0,0 +1,116 @@
+#ifndef SCROLLER_INFLUENCEMAP_H
+#define SCROLLER_INFLUENCEMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Unit density at a lower resolution than the map, for the heat map overlay that shows where tanks
+ * cluster.
+ *
+ * Every unit adds a tent shaped kernel around its texel to a grid of 16 bit weights. A unit that
+ * moves to another texel subtracts the kernel at its old texel and adds it at the new one, so a
+ * tick only touches (2 * kRadius + 1)^2 weights per moved unit, whatever the number of units. The
+ * grid has a border of kRadius texels on every side so kernels are never clipped, and each kernel
+ * row is one 8 lane NEON or SSE2 add.
+ *
+ * Weights are exact until 65535, more than 4000 units stacked on one texel. exportMask() saturates
+ * long before that, at kPeak.
+ */
+class InfluenceMap {
+public:
+    //! Kernel radius in texels
+    static constexpr int kRadius = 3;
+    //! Weight of a unit at its own texel
+    static constexpr uint16_t kUnitWeight = (kRadius + 1) * (kRadius + 1);
+    //! Weights at or above kPeak are exported as 255, about four units on the same texel
+    static constexpr int kPeakShift = 6;
+    static constexpr uint16_t kPeak = 1 << kPeakShift;
+
+    struct Rect {
+        int x0, y0, x1, y1; // inclusive-exclusive texel bounds
+
+        inline bool empty() const { return x1 <= x0 || y1 <= y0; }
+    };
+
+    InfluenceMap();
+
+    /*!
+     * Drops all units and sizes the grid for a map
+     * @param cellsPerTexel how many map cells one texel covers in each direction
+     */
+    void reset(int mapWidth, int mapHeight, int cellsPerTexel);
+
+    /*!
+     * Adds a unit or moves an existing one, only changes the weights if its texel changed
+     * @param unitId a small, dense, caller assigned id
+     */
+    void setUnit(int unitId, int cellX, int cellY);
+
+    void removeUnit(int unitId);
+
+    /*!
+     * Returns and clears the region of the grid that changed since the last call
+     * @return false if nothing changed
+     */
+    bool takeDirtyRect(Rect &outRect);
+
+    /*!
+     * Writes the density of a region as one byte per texel, 0 for no units and 255 for kPeak or
+     * more
+     * @param outMask destination for the first row of @a rect
+     * @param stride bytes between two rows in @a outMask
+     */
+    void exportMask(const Rect &rect, uint8_t *outMask, int stride) const;
+
+    /*!
+     * @return the weight of a texel
+     */
+    inline uint16_t getWeight(int x, int y) const { return weights_[getIndex(x, y)]; }
+
+    //! Size of the grid in texels
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    inline int getCellsPerTexel() const { return cellsPerTexel_; }
+
+    /*!
+     * @return the bytes of CPU memory held by the grid and the units
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    //! Kernel rows are padded to one vector of 8 weights
+    static constexpr int kKernelLanes = 8;
+    static_assert(2 * kRadius + 1 <= kKernelLanes, "kernel rows must fit one vector");
+
+    struct Unit {
+        bool active;
+        int x, y; // texel
+    };
+
+    /*!
+     * Adds or subtracts the kernel centered on a texel
+     */
+    void stamp(int x, int y, bool add);
+
+    void markDirty(int x, int y);
+
+    inline size_t getIndex(int x, int y) const {
+        return size_t(y + kRadius) * stride_ + size_t(x + kRadius);
+    }
+
+    int width_;
+    int height_;
+    int cellsPerTexel_;
+    //! weights per row, the grid plus the borders plus room for the last vector of a row
+    size_t stride_;
+    std::vector<uint16_t> weights_;
+    uint16_t kernel_[2 * kRadius + 1][kKernelLanes];
+    std::vector<Unit> units_;
+    Rect dirty_;
+};
+
+#endif //SCROLLER_INFLUENCEMAP_H
@@ -0,0 +1,231 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Metrics.h"
+
+struct JobSystem::Job {
+    std::function<void()> work;
+    bool background = false;
+    //! unfinished dependencies, plus one until schedule() registered them all
+    std::atomic<int> blockers{1};
+    std::atomic<bool> done{false};
+    //! guards done against new dependents and the dependents themselves
+    std::mutex mutex;
+    std::vector<Handle> dependents;
+};
+
+//! The pool and the worker index of the calling thread, if it is a worker
+static thread_local JobSystem *tPool = nullptr;
+static thread_local int tWorker = -1;
+
+JobSystem &JobSystem::instance() {
+    static JobSystem pool(std::clamp(int(std::thread::hardware_concurrency()) - 1, 1,
+                                     kMaxThreads - 1));
+    return pool;
+}
+
+JobSystem::JobSystem(int workerCount) : queued_(0), queuedShared_(0), queuedBackground_(0), stopping_(false) {
+    workerCount = std::max(1, workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    // Workers steal from each other, so they only start once all deques exist
+    for (int i = 0; i < workerCount; i++) {
+        workers_[i]->thread = std::thread(&JobSystem::runWorker, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker: workers_) {
+        worker->thread.join();
+    }
+}
+
+JobSystem::Handle JobSystem::schedule(std::function<void()> work,
+                                      const std::vector<Handle> &dependencies, bool background) {
+    Handle job = std::make_shared<Job>();
+    job->work = std::move(work);
+    job->background = background;
+    for (const Handle &dependency: dependencies) {
+        if (!dependency) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->done.load(std::memory_order_relaxed)) {
+            job->blockers.fetch_add(1, std::memory_order_relaxed);
+            dependency->dependents.push_back(job);
+        }
+    }
+    release(job);
+    return job;
+}
+
+JobSystem::Handle JobSystem::parallelFor(int count, int sliceSize,
+                                         std::function<void(int begin, int end)> work,
+                                         const std::vector<Handle> &dependencies) {
+    if (count <= 0) {
+        return schedule(nullptr, dependencies);
+    }
+    sliceSize = std::max(1, sliceSize);
+    if (sliceSize >= count) {
+        return schedule([work = std::move(work), count]() { work(0, count); }, dependencies);
+    }
+
+    // Slices share one copy of the work, it may capture a lot
+    auto shared = std::make_shared<std::function<void(int, int)>>(std::move(work));
+    std::vector<Handle> slices;
+    slices.reserve((count + sliceSize - 1) / sliceSize);
+    for (int begin = 0; begin < count; begin += sliceSize) {
+        const int end = std::min(count, begin + sliceSize);
+        slices.push_back(schedule([shared, begin, end]() { (*shared)(begin, end); },
+                                  dependencies));
+    }
+    return schedule(nullptr, slices);
+}
+
+bool JobSystem::isDone(const Handle &job) {
+    return !job || job->done.load(std::memory_order_acquire);
+}
+
+void JobSystem::wait(const Handle &job) {
+    const int worker = tPool == this ? tWorker : -1;
+    while (!isDone(job)) {
+        if (Handle next = take(worker, false)) {
+            run(next);
+            continue;
+        }
+        // Other threads do not steal, jobs in the worker deques are no reason for them to wake up
+        const std::atomic<int> &takeable = worker >= 0 ? queued_ : queuedShared_;
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait(lock, [&job, &takeable]() {
+            return isDone(job) || takeable.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+
+void JobSystem::runWorker(int index) {
+    tPool = this;
+    tWorker = index;
+    while (true) {
+        if (Handle job = take(index, true)) {
+            run(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait(lock, [this]() {
+            return stopping_ || queued_.load(std::memory_order_acquire) > 0
+                   || queuedBackground_.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping_ && queued_.load() == 0 && queuedBackground_.load() == 0) {
+            return;
+        }
+    }
+}
+
+void JobSystem::push(const Handle &job) {
+    if (job->background) {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        background_.push_back(job);
+        queuedBackground_.fetch_add(1, std::memory_order_release);
+    } else if (tPool == this) {
+        Worker &worker = *workers_[tWorker];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(job);
+        queued_.fetch_add(1, std::memory_order_release);
+    } else {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        shared_.push_back(job);
+        queuedShared_.fetch_add(1, std::memory_order_release);
+        queued_.fetch_add(1, std::memory_order_release);
+    }
+
+    // Taking the lock orders the count before the check of every sleeper
+    { std::lock_guard<std::mutex> lock(wakeMutex_); }
+    wake_.notify_all();
+}
+
+void JobSystem::release(const Handle &job) {
+    if (job->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        push(job);
+    }
+}
+
+JobSystem::Handle JobSystem::take(int worker, bool allowBackground) {
+    static Metrics::Counter &steals = Metrics::counter("jobs.steals");
+    Handle job;
+    if (worker >= 0) {
+        Worker &own = *workers_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+        }
+    }
+    if (!job) {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        if (!shared_.empty()) {
+            job = std::move(shared_.front());
+            shared_.pop_front();
+            queuedShared_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    // Victims are tried starting after the thief, so thieves spread out over the deques. Other
+    // threads do not steal, a worker's deque holds the nested parts of whatever long job it runs.
+    const int workerCount = worker >= 0 ? int(workers_.size()) : 0;
+    for (int i = 1; !job && i <= workerCount; i++) {
+        const int victim = (std::max(worker, 0) + i) % workerCount;
+        if (victim == worker) {
+            continue;
+        }
+        Worker &other = *workers_[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.jobs.empty()) {
+            job = std::move(other.jobs.front());
+            other.jobs.pop_front();
+            steals.add();
+        }
+    }
+    if (job) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    if (allowBackground) {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        if (!background_.empty()) {
+            job = std::move(background_.front());
+            background_.pop_front();
+            queuedBackground_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    return job;
+}
+
+void JobSystem::run(const Handle &job) {
+    static Metrics::Counter &jobsRun = Metrics::counter("jobs.run");
+    if (job->work) {
+        job->work();
+        // Captures are released right away, not when the last handle goes
+        job->work = nullptr;
+    }
+    jobsRun.add();
+
+    std::vector<Handle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done.store(true, std::memory_order_release);
+        dependents.swap(job->dependents);
+    }
+    for (const Handle &dependent: dependents) {
+        release(dependent);
+    }
+
+    { std::lock_guard<std::mutex> lock(wakeMutex_); }
+    wake_.notify_all();
+}
@@ -0,0 +1,132 @@
+#ifndef SCROLLER_JOBSYSTEM_H
+#define SCROLLER_JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * One pool of worker threads shared by everything that leaves the loop thread: map parsing and
+ * generation, the region tables, mesh preparation and the downloads.
+ *
+ * Every worker owns a deque. Jobs a worker schedules go to the back of its own deque and it takes
+ * them from the back again, so nested work stays in its cache, while idle workers steal from the
+ * front of the other deques. Jobs scheduled from other threads go to a shared queue.
+ *
+ * A job can depend on other jobs and only becomes runnable once they all finished, so a whole graph
+ * is scheduled up front. wait() runs other jobs while it waits, so a job may wait for the jobs it
+ * scheduled without tying up its worker. Background jobs, which may block or run for a long time,
+ * are only ever run by the workers, never by a thread helping in wait(). Threads outside the pool,
+ * such as the render thread, only help with the shared queue and never steal the nested work of a
+ * worker's job. Long work the render thread starts, downloading and building a map, freeing one or
+ * loading tiles, is scheduled as background jobs and polled with isDone() once per frame. The
+ * render thread only waits for short work it scheduled itself, such as Parallel's slices.
+ *
+ * Jobs are meant to be coarse, a slice of a map rather than a cell.
+ */
+class JobSystem {
+public:
+    struct Job;
+    //! A scheduled job, null counts as a finished job
+    using Handle = std::shared_ptr<Job>;
+
+    //! Threads working on one parallelFor(), the one waiting included. More only fight over memory
+    //! bandwidth.
+    static constexpr int kMaxThreads = 8;
+
+    /*!
+     * @return the pool shared by the whole process, started on first use with a worker per core
+     *         but one, up to kMaxThreads - 1
+     */
+    static JobSystem &instance();
+
+    explicit JobSystem(int workerCount);
+
+    /*!
+     * Runs the jobs still queued, then stops the workers
+     */
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    /*!
+     * Queues @a work to run once all @a dependencies finished
+     * @param background the job may block, e.g. on the network, so only workers run it
+     */
+    Handle schedule(std::function<void()> work, const std::vector<Handle> &dependencies = {},
+                    bool background = false);
+
+    /*!
+     * Calls @a work on consecutive slices [begin, end) of [0, count), one job per slice
+     * @return a job that finishes once every slice ran
+     */
+    Handle parallelFor(int count, int sliceSize, std::function<void(int begin, int end)> work,
+                       const std::vector<Handle> &dependencies = {});
+
+    /*!
+     * @return true once a job ran, never blocks
+     */
+    static bool isDone(const Handle &job);
+
+    /*!
+     * Returns once a job ran, running other jobs in the meantime. Threads outside the pool only
+     * help with jobs of the shared queue and sleep while the workers run the rest.
+     */
+    void wait(const Handle &job);
+
+    /*!
+     * @return the workers plus the thread that waits
+     */
+    inline int getThreadCount() const { return int(workers_.size()) + 1; }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Handle> jobs;
+        std::thread thread;
+    };
+
+    void runWorker(int index);
+
+    /*!
+     * Queues a job whose dependencies all finished
+     */
+    void push(const Handle &job);
+
+    /*!
+     * Releases one of the blockers of a job and queues it once none are left
+     */
+    void release(const Handle &job);
+
+    /*!
+     * Takes the next job: the own deque, the shared queue, the other deques, the background queue
+     * @param worker the index of the calling worker, -1 for other threads
+     */
+    Handle take(int worker, bool allowBackground);
+
+    void run(const Handle &job);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    //! jobs scheduled from threads outside the pool and background jobs
+    std::mutex sharedMutex_;
+    std::deque<Handle> shared_;
+    std::deque<Handle> background_;
+    //! queued jobs, for sleeping threads to tell whether there is something for them
+    std::atomic<int> queued_;
+    //! the part of queued_ in shared_, all that threads outside the pool can take
+    std::atomic<int> queuedShared_;
+    std::atomic<int> queuedBackground_;
+    //! idle workers and waiting threads sleep here until a job is queued or finished
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+};
+
+#endif //SCROLLER_JOBSYSTEM_H
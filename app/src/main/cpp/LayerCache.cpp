@@ -0,0 +1,194 @@
+#include "LayerCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "AndroidOut.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Utility.h"
+#include "VectorMath.h"
+
+//! The texel a layer pixel lands on along an axis of @a size texels
+static inline int wrap(int64_t pixel, int size) {
+    const int64_t texel = pixel % size;
+    return int(texel < 0 ? texel + size : texel);
+}
+
+std::unique_ptr<LayerCache> LayerCache::create(int width, int height) {
+    const int textureWidth = width + 2 * kMarginPixels;
+    const int textureHeight = height + 2 * kMarginPixels;
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (width <= 0 || height <= 0 || textureWidth > maxTextureSize
+        || textureHeight > maxTextureSize) {
+        aout << "Layer cache " << textureWidth << "x" << textureHeight << " not supported (max "
+             << maxTextureSize << ")" << std::endl;
+        return nullptr;
+    }
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Texels map to pixels one to one, and the quad's texture coordinates wrap around the edges
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, textureWidth, textureHeight);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE || !Utility::checkAndLogGlError()) {
+        aout << "Layer cache framebuffer incomplete: " << status << std::endl;
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
+        return nullptr;
+    }
+
+    return std::unique_ptr<LayerCache>(new LayerCache(texture, framebuffer, width, height));
+}
+
+LayerCache::~LayerCache() {
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteTextures(1, &texture_);
+}
+
+void LayerCache::update(float centerX, float centerY, float pixelsPerUnit,
+                        uint64_t contentVersion, const float *clearColor,
+                        const DrawFunction &draw) {
+    SCROLLER_TRACE_SCOPE("LayerCache::update");
+    static Metrics::Counter &fullRedraws = Metrics::counter("layer_cache.full_redraws");
+    static Metrics::Counter &stripRedraws = Metrics::counter("layer_cache.strip_redraws");
+
+    viewX_ = double(centerX) * pixelsPerUnit - width_ * 0.5;
+    viewY_ = double(centerY) * pixelsPerUnit - height_ * 0.5;
+    const PixelRect view = {
+            int64_t(std::floor(viewX_)), int64_t(std::floor(viewY_)),
+            int64_t(std::ceil(viewX_)) + width_, int64_t(std::ceil(viewY_)) + height_};
+
+    const bool redrawAll = !valid_ || pixelsPerUnit != pixelsPerUnit_
+                           || contentVersion != contentVersion_;
+    if (!redrawAll && view.x0 >= covered_.x0 && view.y0 >= covered_.y0 && view.x1 <= covered_.x1
+        && view.y1 <= covered_.y1) {
+        buildQuad();
+        return;
+    }
+
+    // The covered area is centered on the view again, a margin of scrolling in every direction
+    const PixelRect next = {
+            view.x0 - kMarginPixels, view.y0 - kMarginPixels,
+            view.x0 - kMarginPixels + textureWidth_, view.y0 - kMarginPixels + textureHeight_};
+    const PixelRect overlap = {
+            std::max(next.x0, covered_.x0), std::max(next.y0, covered_.y0),
+            std::min(next.x1, covered_.x1), std::min(next.y1, covered_.y1)};
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glEnable(GL_SCISSOR_TEST);
+    pixelsPerUnit_ = pixelsPerUnit;
+    if (redrawAll || overlap.empty()) {
+        drawRect(next, clearColor, draw);
+        fullRedraws.add();
+    } else {
+        // Both areas have the same size, so at most one strip per axis came into view. The texels
+        // of the overlap already hold it, they are where its pixels wrap around to.
+        const PixelRect strips[] = {
+                {next.x0, next.y0, overlap.x0, next.y1},
+                {overlap.x1, next.y0, next.x1, next.y1},
+                {overlap.x0, next.y0, overlap.x1, overlap.y0},
+                {overlap.x0, overlap.y1, overlap.x1, next.y1},
+        };
+        for (const PixelRect &strip: strips) {
+            if (!strip.empty()) {
+                drawRect(strip, clearColor, draw);
+                stripRedraws.add();
+            }
+        }
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width_, height_);
+
+    covered_ = next;
+    contentVersion_ = contentVersion;
+    valid_ = true;
+    buildQuad();
+}
+
+void LayerCache::draw(const TextureShader &shader, const float *viewProjection) const {
+    glDisable(GL_BLEND);
+    shader.activate();
+    shader.setViewProjectionMatrix(viewProjection);
+    shader.setTexture(texture_);
+    for (const auto &model: quad_) {
+        shader.drawTexturedModel(model);
+    }
+    glEnable(GL_BLEND);
+}
+
+void LayerCache::getCoveredArea(float centerX, float centerY, float pixelsPerUnit,
+                                float &outLeft, float &outBottom, float &outRight,
+                                float &outTop) const {
+    // The covered area contains the view, so it reaches at most two margins past it
+    const float halfWidth = (width_ * 0.5f + 2 * kMarginPixels + 1) / pixelsPerUnit;
+    const float halfHeight = (height_ * 0.5f + 2 * kMarginPixels + 1) / pixelsPerUnit;
+    outLeft = centerX - halfWidth;
+    outRight = centerX + halfWidth;
+    outBottom = centerY - halfHeight;
+    outTop = centerY + halfHeight;
+}
+
+void LayerCache::drawRect(const PixelRect &rect, const float *clearColor,
+                          const DrawFunction &draw) const {
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    for (int64_t y = rect.y0; y < rect.y1;) {
+        const int texelY = wrap(y, textureHeight_);
+        const int height = int(std::min<int64_t>(rect.y1 - y, textureHeight_ - texelY));
+        for (int64_t x = rect.x0; x < rect.x1;) {
+            const int texelX = wrap(x, textureWidth_);
+            const int width = int(std::min<int64_t>(rect.x1 - x, textureWidth_ - texelX));
+
+            // The piece's part of grid space fills the viewport, the scissor keeps wide lines in
+            glViewport(texelX, texelY, width, height);
+            glScissor(texelX, texelY, width, height);
+            glClear(GL_COLOR_BUFFER_BIT);
+            const float centerX = float((double(x) + width * 0.5) / pixelsPerUnit_);
+            const float centerY = float((double(y) + height * 0.5) / pixelsPerUnit_);
+            const Mat4 viewProjection =
+                    Mat4::scale(2.f * pixelsPerUnit_ / float(width),
+                                2.f * pixelsPerUnit_ / float(height))
+                    * Mat4::translation(-centerX, -centerY);
+            draw(viewProjection.data());
+            x += width;
+        }
+        y += height;
+    }
+}
+
+void LayerCache::buildQuad() {
+    // The view's corners in grid space, textured with the texels its pixels wrap around to
+    const float left = float(viewX_ / pixelsPerUnit_);
+    const float bottom = float(viewY_ / pixelsPerUnit_);
+    const float right = float((viewX_ + width_) / pixelsPerUnit_);
+    const float top = float((viewY_ + height_) / pixelsPerUnit_);
+    const float u0 = float((wrap(covered_.x0, textureWidth_) + (viewX_ - covered_.x0))
+                           / textureWidth_);
+    const float v0 = float((wrap(covered_.y0, textureHeight_) + (viewY_ - covered_.y0))
+                           / textureHeight_);
+    const float u1 = u0 + float(width_) / textureWidth_;
+    const float v1 = v0 + float(height_) / textureHeight_;
+
+    quadBuilder_.recycle(quad_);
+    quadBuilder_.begin(MeshBuilder<TexturedVertex, TexturedModel>::kQuad, 1, quad_);
+    quadBuilder_.addQuad(TexturedVertex(Vector3{left, top, 0}, Vector2{u0, v1}),
+                         TexturedVertex(Vector3{right, top, 0}, Vector2{u1, v1}),
+                         TexturedVertex(Vector3{right, bottom, 0}, Vector2{u1, v0}),
+                         TexturedVertex(Vector3{left, bottom, 0}, Vector2{u0, v0}));
+    quadBuilder_.finish();
+}
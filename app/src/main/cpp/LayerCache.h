@@ -0,0 +1,130 @@
+#ifndef SCROLLER_LAYERCACHE_H
+#define SCROLLER_LAYERCACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <GLES3/gl3.h>
+
+#include "MeshBuilder.h"
+#include "Model.h"
+#include "TextureShader.h"
+
+/*!
+ * Keeps a layer that rarely changes, such as the map itself, rendered into a texture the size of
+ * the viewport plus a margin on every side, and draws it from there with the current scroll.
+ *
+ * The texture is used as a ring buffer: a pixel of the layer always lands on the texel at its
+ * position modulo the texture size. Scrolling within the margin only changes the texture
+ * coordinates of the quad the layer is drawn with. Once the view leaves the covered area, the area
+ * is moved to the view again, and only the strips that came into it are drawn. Everything is drawn
+ * again when the zoom or the content changes.
+ */
+class LayerCache {
+public:
+    //! Pixels covered past every edge of the viewport, scrolling this far draws nothing
+    static constexpr int kMarginPixels = 128;
+
+    /*!
+     * Draws the layer, usually more than once per update, each time into a part of the texture
+     * @param viewProjection maps the part of grid space that is drawn, sixteen floats column major
+     */
+    using DrawFunction = std::function<void(const float *viewProjection)>;
+
+    /*!
+     * @param width, height the viewport in pixels
+     * @return the cache, or null if the texture exceeds the maximum size or the framebuffer is not
+     *         supported
+     */
+    static std::unique_ptr<LayerCache> create(int width, int height);
+
+    /*!
+     * Frees the texture and the framebuffer, needs the GL context
+     */
+    ~LayerCache();
+
+    /*!
+     * Brings the texture up to date for a view. Restores the default framebuffer and the viewport
+     * before it returns, and leaves whichever program @a draw used active.
+     * @param centerX, centerY the center of the view in grid space
+     * @param pixelsPerUnit screen pixels per unit of grid space, changes with the zoom
+     * @param contentVersion changes whenever the layer looks different
+     * @param clearColor what the layer is drawn on
+     */
+    void update(float centerX, float centerY, float pixelsPerUnit, uint64_t contentVersion,
+                const float *clearColor, const DrawFunction &draw);
+
+    /*!
+     * Draws the layer over the whole viewport, as of the last update(). Turns blending off while
+     * it draws, the texture is opaque. Leaves @a shader active.
+     */
+    void draw(const TextureShader &shader, const float *viewProjection) const;
+
+    /*!
+     * Forgets the contents, the next update() draws everything
+     */
+    inline void invalidate() { valid_ = false; }
+
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    inline size_t getTextureBytes() const { return size_t(textureWidth_) * textureHeight_ * 4; }
+
+    /*!
+     * @return the area the texture may hold after an update(), in grid space, to have whatever
+     *         the layer streams in loaded there
+     */
+    void getCoveredArea(float centerX, float centerY, float pixelsPerUnit, float &outLeft,
+                        float &outBottom, float &outRight, float &outTop) const;
+
+private:
+    //! A rectangle of layer pixels, which sit on a grid through the origin of grid space. y is up.
+    struct PixelRect {
+        int64_t x0;
+        int64_t y0;
+        int64_t x1;
+        int64_t y1;
+
+        inline bool empty() const { return x0 >= x1 || y0 >= y1; }
+    };
+
+    inline LayerCache(GLuint texture, GLuint framebuffer, int width, int height)
+            : texture_(texture), framebuffer_(framebuffer), width_(width), height_(height),
+              textureWidth_(width + 2 * kMarginPixels),
+              textureHeight_(height + 2 * kMarginPixels), valid_(false), pixelsPerUnit_(0.f),
+              contentVersion_(0), covered_{0, 0, 0, 0}, viewX_(0.0), viewY_(0.0) {}
+
+    /*!
+     * Draws a rectangle of the layer into the texels it wraps around to, which takes up to four
+     * pieces where it crosses the edges of the texture
+     */
+    void drawRect(const PixelRect &rect, const float *clearColor, const DrawFunction &draw) const;
+
+    /*!
+     * Rebuilds the quad draw() uses for the view at viewX_, viewY_
+     */
+    void buildQuad();
+
+    GLuint texture_;
+    GLuint framebuffer_;
+    int width_;
+    int height_;
+    int textureWidth_;
+    int textureHeight_;
+
+    bool valid_;
+    float pixelsPerUnit_;
+    uint64_t contentVersion_;
+    //! the layer pixels the texture holds, textureWidth_ x textureHeight_ of them
+    PixelRect covered_;
+    //! the bottom left corner of the view in layer pixels, rarely a whole pixel
+    double viewX_;
+    double viewY_;
+
+    MeshBuilder<TexturedVertex, TexturedModel> quadBuilder_;
+    std::vector<TexturedModel> quad_;
+};
+
+#endif //SCROLLER_LAYERCACHE_H
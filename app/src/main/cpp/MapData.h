@@ -0,0 +1,16 @@
+#ifndef SCROLLER_MAPDATA_H
+#define SCROLLER_MAPDATA_H
+
+#include <vector>
+
+/*!
+ * A map as a row major grid of cell characters: 'x'/'X' tanks, 'o'/'O' objects, '1' to '3'
+ * colored cells and ' ' for empty cells.
+ */
+struct MapData {
+    std::vector<char> data;
+    int width;
+    int height;
+};
+
+#endif //SCROLLER_MAPDATA_H
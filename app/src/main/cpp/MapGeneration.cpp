@@ -0,0 +1,46 @@
+#include "MapGeneration.h"
+
+#include "AndroidOut.h"
+#include "GridLayout.h"
+#include "GridMesh.h"
+#include "JobSystem.h"
+#include "MeshBuilder.h"
+#include "ScratchArena.h"
+#include "TileStore.h"
+#include "Trace.h"
+
+std::unique_ptr<MapGeneration> MapGeneration::build(MapData map, const std::string &tilePath) {
+    SCROLLER_TRACE_SCOPE("MapGeneration::build");
+    auto generation = std::make_unique<MapGeneration>();
+    generation->map = std::move(map);
+    MapGeneration *built = generation.get();
+    const MapData &cells = built->map;
+
+    if (size_t(cells.width) * cells.height > kMaxMeshCells) {
+        if (!tilePath.empty() && TileStore::write(tilePath, cells)) {
+            built->tiled = true;
+            return generation;
+        }
+        aout << "Failed to write the map tiles, drawing the map as a mesh" << std::endl;
+    }
+
+    // The tables and the mesh only read the map, so they are built side by side
+    JobSystem &jobs = JobSystem::instance();
+    std::vector<JobSystem::Handle> parts;
+    if (size_t(cells.width) * cells.height <= kMaxMeshCells) {
+        parts.push_back(jobs.schedule([built]() { built->regionStats.rebuild(built->map); }));
+        parts.push_back(jobs.schedule([built]() { built->regions.rebuild(built->map); }));
+    }
+    ScratchArena scratch;
+    MeshBuilder<Vertex, Model> builder;
+    GridMesh::build(cells, GridLayout::forMap(cells.width, cells.height), scratch, builder,
+                    built->lines, built->triangles);
+    for (const JobSystem::Handle &part: parts) {
+        jobs.wait(part);
+    }
+
+    aout << "Built " << built->lines.size() << " line and " << built->triangles.size()
+         << " triangle models for a " << cells.width << "x" << cells.height << " map"
+         << std::endl;
+    return generation;
+}
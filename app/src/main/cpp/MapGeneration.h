@@ -0,0 +1,46 @@
+#ifndef SCROLLER_MAPGENERATION_H
+#define SCROLLER_MAPGENERATION_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MapData.h"
+#include "Model.h"
+#include "RegionLabeler.h"
+#include "RegionStats.h"
+
+/*!
+ * A map together with everything derived from it that is too slow to build within a frame: the
+ * cell meshes, the region tables and, for maps too large for a mesh, the tile file.
+ *
+ * build() runs on any thread, usually as a job while the previous map stays on screen. The
+ * renderer then adopts a finished generation at a frame boundary by swapping its contents with
+ * its own, which only exchanges pointers, and frees the previous generation on a job.
+ */
+struct MapGeneration {
+    //! Maps with more cells than this are written to a tile file and streamed through a
+    //! TileCache, a mesh per cell would not fit in GPU memory. Their region tables are left empty,
+    //! tables of 32 bit counts and labels are too much memory as well. The map itself stays in
+    //! memory, the simulation reads it.
+    static constexpr size_t kMaxMeshCells = 1024 * 1024;
+
+    MapData map;
+    //! cell outlines drawn with GL_LINES, and objects drawn with GL_TRIANGLES
+    std::vector<Model> lines;
+    std::vector<Model> triangles;
+    RegionStats regionStats;
+    RegionLabeler regions;
+    //! true if the map was written to a tile file instead of a mesh
+    bool tiled = false;
+
+    /*!
+     * Builds the meshes and tables of a map
+     * @param tilePath the file maps with more than kMaxMeshCells cells are written to, or empty
+     *                 if there is nowhere to write it. Without a tile file such maps get a mesh.
+     */
+    static std::unique_ptr<MapGeneration> build(MapData map, const std::string &tilePath);
+};
+
+#endif //SCROLLER_MAPGENERATION_H
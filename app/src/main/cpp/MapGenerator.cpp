@@ -0,0 +1,226 @@
+#include "MapGenerator.h"
+
+#include <algorithm>
+
+#include "PackedCells.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+//! Noise samples the thresholds are picked from
+static constexpr int kThresholdSamples = 4096;
+
+//! Octaves of the fractal noise, each half the size and half the weight of the one before
+static constexpr int kOctaves = 3;
+static constexpr int kOctaveWeightSum = 4 + 2 + 1;
+
+static inline uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/*!
+ * Smoothstep of @a t in [0, 256], in the same range
+ */
+static inline int32_t smooth(int32_t t) {
+    return (t * t * (768 - 2 * t)) >> 16;
+}
+
+static inline int32_t lerp(int32_t a, int32_t b, int32_t t) {
+    return a + (b - a) * t / 256;
+}
+
+MapGenerator::MapGenerator(const Params &params) : params_(params) {
+    params_.width = std::clamp(params_.width, 1, kMaxSize);
+    params_.height = std::clamp(params_.height, 1, kMaxSize);
+    params_.objectDensity = std::clamp(params_.objectDensity, 0.f, 1.f);
+    params_.tankDensity = std::clamp(params_.tankDensity, 0.f, 1.f);
+    params_.colorDensity = std::clamp(params_.colorDensity, 0.f, 1.f);
+    params_.featureSize = std::clamp(params_.featureSize, 1, 1024);
+
+    // Tanks only go where there are no objects and colors where there is neither, so their
+    // densities among the cells left over are raised to keep the overall densities
+    const float objectFree = 1.f - params_.objectDensity;
+    const float unitFree = objectFree - params_.tankDensity;
+    const float tankShare = objectFree > 0.f
+                            ? std::min(1.f, params_.tankDensity / objectFree) : 0.f;
+    const float colorShare = unitFree > 0.f ? std::min(1.f, params_.colorDensity / unitFree) : 0.f;
+    objectThreshold_ = findThreshold(kFieldTerrain, params_.featureSize, params_.objectDensity);
+    colorThreshold_ = findThreshold(kFieldColor, params_.featureSize, colorShare);
+
+    // Probabilities are scaled by the mean of cluster^4, so clusters do not change the density
+    uint64_t total = 0;
+    for (int i = 0; i < kThresholdSamples; i++) {
+        const int x = hash(kFieldCluster, kOctaves, i, 0) % params_.width;
+        const int y = hash(kFieldCluster, kOctaves, i, 1) % params_.height;
+        const uint64_t cluster = sample(kFieldCluster, params_.featureSize * 4, x, y);
+        const uint64_t squared = cluster * cluster >> 16;
+        total += squared * squared >> 16;
+    }
+    tankMean_ = std::max<uint64_t>(1, total / kThresholdSamples);
+    tankDensity_ = uint64_t(tankShare * kNoiseOne);
+}
+
+void MapGenerator::generate(MapData &outMap) const {
+    SCROLLER_TRACE_SCOPE("MapGenerator::generate");
+    outMap.width = params_.width;
+    outMap.height = params_.height;
+    outMap.data.resize(size_t(params_.width) * params_.height);
+    Parallel::forEachSlice(params_.height, outMap.data.size() >= Parallel::kMinCells,
+                           [this, &outMap](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            generateRow(y, &outMap.data[size_t(y) * params_.width]);
+        }
+    });
+}
+
+void MapGenerator::generateRow(int y, char *outRow) const {
+    const int width = params_.width;
+    std::vector<int32_t> terrain(width);
+    std::vector<int32_t> color(width);
+    std::vector<int32_t> hue(width);
+    std::vector<int32_t> cluster(width);
+    sampleRow(kFieldTerrain, params_.featureSize, y, terrain.data());
+    sampleRow(kFieldColor, params_.featureSize, y, color.data());
+    sampleRow(kFieldHue, params_.featureSize * 2, y, hue.data());
+    sampleRow(kFieldCluster, params_.featureSize * 4, y, cluster.data());
+
+    for (int x = 0; x < width; x++) {
+        const uint64_t squared = uint64_t(cluster[x]) * uint64_t(cluster[x]) >> 16;
+        const uint64_t weight = squared * squared >> 16;
+        if (terrain[x] >= objectThreshold_) {
+            outRow[x] = 'o';
+        } else if (uint64_t(hash(kFieldTank, 0, x, y)) * tankMean_ < tankDensity_ * weight) {
+            outRow[x] = 'x';
+        } else if (color[x] >= colorThreshold_) {
+            // Patches of one color, as hue changes slower than the patches
+            outRow[x] = char('1' + std::min(2, hue[x] * 3 / kNoiseOne));
+        } else {
+            outRow[x] = ' ';
+        }
+    }
+}
+
+std::string MapGenerator::toJSON(const MapData &map) {
+    std::string json = "{\"dimensions\": {\"rows\": " + std::to_string(map.height)
+                       + ", \"columns\": " + std::to_string(map.width) + "}, \"data\": [";
+    json.reserve(json.size() + size_t(map.width) * map.height * 5 + 4 * map.height);
+    for (int y = 0; y < map.height; y++) {
+        json += y ? ", [" : "[";
+        for (int x = 0; x < map.width; x++) {
+            json += x ? ", \"" : "\"";
+            json += map.data[size_t(y) * map.width + x];
+            json += '"';
+        }
+        json += ']';
+    }
+    json += "]}";
+    return json;
+}
+
+std::string MapGenerator::toCSV(const MapData &map) {
+    // Empty cells are written as a space, so a row never ends in an empty field
+    std::string csv;
+    csv.reserve(size_t(map.width) * 2 * map.height);
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (x) {
+                csv += ',';
+            }
+            csv += map.data[size_t(y) * map.width + x];
+        }
+        csv += '\n';
+    }
+    return csv;
+}
+
+bool MapGenerator::toPacked(const MapData &map, std::vector<uint8_t> &outData) {
+    outData.clear();
+    PackedCells packed;
+    if (!PackedCells::pack(map, packed)) {
+        return false;
+    }
+    packed.serialize(outData);
+    return true;
+}
+
+void MapGenerator::sampleRow(Field field, int scale, int y, int32_t *outValues) const {
+    const int width = params_.width;
+    std::fill(outValues, outValues + width, 0);
+    std::vector<int32_t> columns(size_t(width) + 2);
+    std::vector<int32_t> steps;
+
+    for (int octave = 0; octave < kOctaves; octave++) {
+        const int step = std::max(1, scale >> octave);
+        const int weight = 4 >> octave;
+
+        // Lattice values are blended vertically once per column, then across within the row
+        const int latticeY = y / step;
+        const int32_t fractionY = smooth((y % step) * 256 / step);
+        const int columnCount = width / step + 2;
+        for (int column = 0; column < columnCount; column++) {
+            columns[column] = lerp(hash(field, octave, column, latticeY),
+                                   hash(field, octave, column, latticeY + 1), fractionY);
+        }
+        steps.resize(step);
+        for (int i = 0; i < step; i++) {
+            steps[i] = smooth(i * 256 / step);
+        }
+
+        for (int x = 0, column = 0; x < width; column++) {
+            const int end = std::min(width, x + step);
+            for (int i = 0; x < end; x++, i++) {
+                outValues[x] += weight * lerp(columns[column], columns[column + 1], steps[i]);
+            }
+        }
+    }
+
+    for (int x = 0; x < width; x++) {
+        outValues[x] /= kOctaveWeightSum;
+    }
+}
+
+int32_t MapGenerator::sample(Field field, int scale, int x, int y) const {
+    int32_t value = 0;
+    for (int octave = 0; octave < kOctaves; octave++) {
+        const int step = std::max(1, scale >> octave);
+        const int latticeX = x / step;
+        const int latticeY = y / step;
+        const int32_t fractionX = smooth((x % step) * 256 / step);
+        const int32_t fractionY = smooth((y % step) * 256 / step);
+        const int32_t left = lerp(hash(field, octave, latticeX, latticeY),
+                                  hash(field, octave, latticeX, latticeY + 1), fractionY);
+        const int32_t right = lerp(hash(field, octave, latticeX + 1, latticeY),
+                                   hash(field, octave, latticeX + 1, latticeY + 1), fractionY);
+        value += (4 >> octave) * lerp(left, right, fractionX);
+    }
+    return value / kOctaveWeightSum;
+}
+
+int32_t MapGenerator::findThreshold(Field field, int scale, float above) const {
+    const int index = std::clamp(int((1.f - above) * kThresholdSamples), 0, kThresholdSamples);
+    if (index == kThresholdSamples) {
+        // Nothing reaches a value the noise never takes
+        return kNoiseOne;
+    }
+
+    std::vector<int32_t> samples(kThresholdSamples);
+    for (int i = 0; i < kThresholdSamples; i++) {
+        const int x = hash(field, kOctaves, i, 0) % params_.width;
+        const int y = hash(field, kOctaves, i, 1) % params_.height;
+        samples[i] = sample(field, scale, x, y);
+    }
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return index == 0 ? 0 : samples[index];
+}
+
+int32_t MapGenerator::hash(Field field, int octave, int x, int y) const {
+    uint32_t h = params_.seed * 0x9e3779b1u
+                 ^ (uint32_t(field) * 0x85ebca77u + uint32_t(octave) * 0xc2b2ae3du);
+    h = mix(h ^ uint32_t(x) * 0x27d4eb2fu);
+    h = mix(h ^ uint32_t(y) * 0x165667b1u);
+    return int32_t(h >> 16);
+}
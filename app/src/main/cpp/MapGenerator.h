@@ -0,0 +1,115 @@
+#ifndef SCROLLER_MAPGENERATOR_H
+#define SCROLLER_MAPGENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MapData.h"
+
+/*!
+ * Repeatable synthetic maps of any size up to kMaxSize x kMaxSize, for benchmarks, stress tests,
+ * replays and the offline fallback. The same parameters always give the same map, on every
+ * platform.
+ *
+ * Objects form blobs where a fractal value noise is high, colored cells form patches the same way,
+ * and tanks gather in clusters driven by a coarser noise. The noise thresholds are picked from a
+ * sample of the noise, so the densities in Params hold on average for any seed.
+ *
+ * Every cell only depends on the parameters and its position, so rows can be generated in any
+ * order and on any thread. Maps too large for memory are written row by row, e.g. with
+ * TileStore::write().
+ */
+class MapGenerator {
+public:
+    static constexpr int kMaxSize = 16384;
+
+    struct Params {
+        uint32_t seed = 1;
+        int width = 256;
+        int height = 256;
+        //! fraction of cells that are objects
+        float objectDensity = 0.15f;
+        //! fraction of cells that are tanks
+        float tankDensity = 0.01f;
+        //! fraction of cells that are colored
+        float colorDensity = 0.05f;
+        //! size in cells of the largest blobs of objects and colors
+        int featureSize = 16;
+    };
+
+    /*!
+     * Clamps the parameters to what the generator supports and samples the noise thresholds
+     */
+    explicit MapGenerator(const Params &params);
+
+    inline const Params &getParams() const { return params_; }
+
+    /*!
+     * Generates the whole map, on several threads for large maps
+     */
+    void generate(MapData &outMap) const;
+
+    /*!
+     * Generates the @a width cells of row @a y
+     */
+    void generateRow(int y, char *outRow) const;
+
+    /*!
+     * @return the map in the JSON form MapParser::parseJSON() reads
+     */
+    static std::string toJSON(const MapData &map);
+
+    /*!
+     * @return the map in the CSV form MapParser::parseCSV() reads
+     */
+    static std::string toCSV(const MapData &map);
+
+    /*!
+     * Writes the map in the PackedCells form MapParser::parsePacked() reads
+     * @return false if the map uses too many cell values to be packed
+     */
+    static bool toPacked(const MapData &map, std::vector<uint8_t> &outData);
+
+private:
+    //! Noise fields, each with its own seed
+    enum Field : uint32_t {
+        kFieldTerrain,
+        kFieldColor,
+        kFieldHue,
+        kFieldCluster,
+        kFieldTank,
+    };
+
+    //! Noise values are 16 bit fixed point, integer math keeps maps identical on every platform
+    static constexpr int kNoiseOne = 1 << 16;
+
+    /*!
+     * Fractal value noise in [0, kNoiseOne) for one row, three octaves from @a scale cells down
+     */
+    void sampleRow(Field field, int scale, int y, int32_t *outValues) const;
+
+    /*!
+     * @return the noise at one cell
+     */
+    int32_t sample(Field field, int scale, int x, int y) const;
+
+    /*!
+     * @return the value that a fraction @a above of the noise samples reach
+     */
+    int32_t findThreshold(Field field, int scale, float above) const;
+
+    /*!
+     * @return a hash in [0, kNoiseOne)
+     */
+    int32_t hash(Field field, int octave, int x, int y) const;
+
+    Params params_;
+    int32_t objectThreshold_;
+    int32_t colorThreshold_;
+    //! a tank lands on a free cell with probability tankDensity_ * cluster^4 / tankMean_
+    uint64_t tankDensity_;
+    uint64_t tankMean_;
+};
+
+#endif //SCROLLER_MAPGENERATOR_H
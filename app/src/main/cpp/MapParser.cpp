@@ -0,0 +1,220 @@
+#include "MapParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+#include "AndroidOut.h"
+#include "Metrics.h"
+#include "PackedCells.h"
+#include "Trace.h"
+
+bool MapParser::parseCSV(const char *csvData, MapData &mapData) {
+    SCROLLER_TRACE_SCOPE("MapParser::parseCSV");
+    aout << "Parsing CSV data..." << std::endl;
+    
+    std::vector<std::vector<char>> grid;
+    std::istringstream stream(csvData);
+    std::string line;
+    int maxWidth = 0;
+
+    while (std::getline(stream, line)) {
+        if (line.empty()) continue;
+        
+        std::vector<char> row;
+        std::istringstream lineStream(line);
+        std::string cell;
+        
+        while (std::getline(lineStream, cell, ',')) {
+            // Remove whitespace
+            cell.erase(0, cell.find_first_not_of(" \t\r\n"));
+            cell.erase(cell.find_last_not_of(" \t\r\n") + 1);
+            
+            if (!cell.empty()) {
+                row.push_back(cell[0]);
+            } else {
+                row.push_back(' '); // Empty cell
+            }
+        }
+        
+        if (!row.empty()) {
+            grid.push_back(row);
+            maxWidth = std::max(maxWidth, (int)row.size());
+        }
+    }
+
+    // Normalize grid (make all rows same width)
+    for (auto& row : grid) {
+        while (row.size() < (size_t)maxWidth) {
+            row.push_back(' ');
+        }
+    }
+
+    // Convert to MapData
+    mapData.width = maxWidth;
+    mapData.height = grid.size();
+    mapData.data.resize(mapData.width * mapData.height);
+
+    for (int y = 0; y < mapData.height; y++) {
+        for (int x = 0; x < mapData.width; x++) {
+            mapData.data[y * mapData.width + x] = grid[y][x];
+        }
+    }
+
+    aout << "Successfully parsed CSV data: " << mapData.width << "x" << mapData.height << std::endl;
+    return true;
+}
+
+bool MapParser::parseJSON(const char *jsonData, MapData &mapData) {
+    SCROLLER_TRACE_SCOPE("MapParser::parseJSON");
+    const auto parseStart = std::chrono::steady_clock::now();
+    aout << "Parsing JSON data..." << std::endl;
+    
+    // Simple JSON parsing - look for the "data" array
+    std::string jsonStr(jsonData);
+    
+    // Find the "data" field
+    size_t dataPos = jsonStr.find("\"data\"");
+    if (dataPos == std::string::npos) {
+        aout << "Failed to find 'data' field in JSON" << std::endl;
+        return false;
+    }
+    
+    // Find the opening bracket of the data array
+    size_t arrayStart = jsonStr.find('[', dataPos);
+    if (arrayStart == std::string::npos) {
+        aout << "Failed to find data array start" << std::endl;
+        return false;
+    }
+    
+    // Find the dimensions
+    size_t dimensionsPos = jsonStr.find("\"dimensions\"");
+    int width = 10, height = 10; // Default values
+    
+    if (dimensionsPos != std::string::npos) {
+        size_t rowsPos = jsonStr.find("\"rows\"", dimensionsPos);
+        size_t colsPos = jsonStr.find("\"columns\"", dimensionsPos);
+        
+        if (rowsPos != std::string::npos) {
+            size_t colonPos = jsonStr.find(':', rowsPos);
+            if (colonPos != std::string::npos) {
+                size_t numStart = colonPos + 1;
+                size_t numEnd = jsonStr.find_first_of(",}", numStart);
+                if (numEnd != std::string::npos) {
+                    std::string numStr = jsonStr.substr(numStart, numEnd - numStart);
+                    // Remove whitespace
+                    numStr.erase(0, numStr.find_first_not_of(" \t\r\n"));
+                    numStr.erase(numStr.find_last_not_of(" \t\r\n") + 1);
+                    height = std::stoi(numStr);
+                }
+            }
+        }
+        
+        if (colsPos != std::string::npos) {
+            size_t colonPos = jsonStr.find(':', colsPos);
+            if (colonPos != std::string::npos) {
+                size_t numStart = colonPos + 1;
+                size_t numEnd = jsonStr.find_first_of(",}", numStart);
+                if (numEnd != std::string::npos) {
+                    std::string numStr = jsonStr.substr(numStart, numEnd - numStart);
+                    // Remove whitespace
+                    numStr.erase(0, numStr.find_first_not_of(" \t\r\n"));
+                    numStr.erase(numStr.find_last_not_of(" \t\r\n") + 1);
+                    width = std::stoi(numStr);
+                }
+            }
+        }
+    }
+    
+    aout << "Detected dimensions: " << width << "x" << height << std::endl;
+    
+    // Parse the data array manually
+    std::vector<std::vector<char>> grid;
+    size_t pos = arrayStart + 1;
+    
+    // Parse each row
+    for (int row = 0; row < height; row++) {
+        std::vector<char> rowData;
+        
+        // Find the start of this row's array
+        size_t rowStart = jsonStr.find('[', pos);
+        if (rowStart == std::string::npos) break;
+        
+        size_t rowEnd = jsonStr.find(']', rowStart);
+        if (rowEnd == std::string::npos) break;
+        
+        // Parse elements in this row
+        size_t elementPos = rowStart + 1;
+        for (int col = 0; col < width; col++) {
+            // Find the next string element
+            size_t quoteStart = jsonStr.find('"', elementPos);
+            if (quoteStart == std::string::npos || quoteStart > rowEnd) {
+                rowData.push_back(' '); // Empty cell
+                continue;
+            }
+            
+            size_t quoteEnd = jsonStr.find('"', quoteStart + 1);
+            if (quoteEnd == std::string::npos || quoteEnd > rowEnd) {
+                rowData.push_back(' '); // Empty cell
+                continue;
+            }
+            
+            // Extract the cell value
+            std::string cellValue = jsonStr.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
+            
+            if (!cellValue.empty()) {
+                rowData.push_back(cellValue[0]);
+            } else {
+                rowData.push_back(' '); // Empty cell
+            }
+            
+            elementPos = quoteEnd + 1;
+        }
+        
+        grid.push_back(rowData);
+        pos = rowEnd + 1;
+    }
+    
+    // Convert to MapData
+    mapData.width = width;
+    mapData.height = height;
+    mapData.data.resize(mapData.width * mapData.height);
+    
+    for (int y = 0; y < mapData.height; y++) {
+        for (int x = 0; x < mapData.width; x++) {
+            if ((size_t)y < grid.size() && (size_t)x < grid[y].size()) {
+                mapData.data[y * mapData.width + x] = grid[y][x];
+            } else {
+                mapData.data[y * mapData.width + x] = ' '; // Default empty
+            }
+        }
+    }
+    
+    // Throughput of the parse itself
+    const double parseSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - parseStart).count();
+    Metrics::counter("parse.json_bytes", "bytes").add(jsonStr.size());
+    if (parseSeconds > 0.0) {
+        Metrics::histogram("parse.json_throughput", "KiB/s").record(
+                uint64_t(jsonStr.size() / 1024.0 / parseSeconds));
+    }
+
+    aout << "Successfully parsed JSON data: " << mapData.width << "x" << mapData.height << std::endl;
+    return true;
+}
+
+bool MapParser::parsePacked(const uint8_t *data, size_t size, MapData &mapData) {
+    SCROLLER_TRACE_SCOPE("MapParser::parsePacked");
+    PackedCells cells;
+    if (!PackedCells::deserialize(data, size, cells)) {
+        aout << "Failed to parse packed map of " << size << " bytes" << std::endl;
+        return false;
+    }
+    cells.unpack(mapData);
+    Metrics::counter("parse.packed_bytes", "bytes").add(size);
+
+    aout << "Successfully parsed packed map: " << mapData.width << "x" << mapData.height
+         << ", " << cells.getBitsPerCell() << " bits per cell" << std::endl;
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef SCROLLER_MAPPARSER_H
+#define SCROLLER_MAPPARSER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MapData.h"
+
+/*!
+ * Turns the map formats served by the backend into MapData. The parsers only log errors, never the
+ * content, so they can run on large maps and in benchmarks.
+ */
+class MapParser {
+public:
+    /*!
+     * Parses a map of the form {"dimensions": {"rows": .., "columns": ..}, "data": [["x", ..], ..]}
+     * @return false if the data array is missing
+     */
+    static bool parseJSON(const char *jsonData, MapData &mapData);
+
+    /*!
+     * Parses one map row per line with comma separated cells, short rows are padded with empty
+     * cells
+     */
+    static bool parseCSV(const char *csvData, MapData &mapData);
+
+    /*!
+     * Parses the binary form of PackedCells, 2 or 4 bits per cell
+     * @return false if the data is truncated or malformed
+     */
+    static bool parsePacked(const uint8_t *data, size_t size, MapData &mapData);
+};
+
+#endif //SCROLLER_MAPPARSER_H
@@ -0,0 +1,197 @@
+#ifndef SCROLLER_MESHBUILDER_H
+#define SCROLLER_MESHBUILDER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "Metrics.h"
+#include "Model.h"
+
+/*!
+ * Builds models out of primitives of one shape (quads, outlines or lines) without growing vectors
+ * while it goes. The caller counts its primitives first and calls @a begin() once, which reserves
+ * exactly what is needed. Finished storage is moved into the models, and @a recycle() takes it
+ * back from the previous generation of models, so rebuilding a mesh of the same size or smaller
+ * does not allocate.
+ *
+ * Index is 16 bit, so a mesh is split into several models once it needs more vertices than an
+ * index can address.
+ *
+ * @tparam TVertex the vertex type, Vertex or TexturedVertex
+ * @tparam TModel the model type holding TVertex, Model or TexturedModel
+ */
+template<typename TVertex, typename TModel>
+class MeshBuilder {
+public:
+    static constexpr size_t kMaxVerticesPerModel = size_t(std::numeric_limits<Index>::max()) + 1;
+
+    /*!
+     * The shape every primitive of a build has
+     */
+    enum Primitive {
+        // two vertices drawn with GL_LINES
+        kLine,
+        // four corners drawn as two triangles
+        kQuad,
+        // four corners drawn as four lines with GL_LINES
+        kOutline,
+    };
+
+    inline MeshBuilder() : primitive_(kQuad), remaining_(0), chunkRemaining_(0), out_(nullptr) {}
+
+    /*!
+     * Takes the storage of @a models back for reuse and clears @a models
+     */
+    void recycle(std::vector<TModel> &models) {
+        for (auto &model: models) {
+            spares_.emplace_back();
+            model.releaseStorage(spares_.back().vertices, spares_.back().indices);
+        }
+        models.clear();
+    }
+
+    /*!
+     * Starts a build. Models are appended to @a outModels as they fill up, so anything already in
+     * there should be recycled first.
+     * @param primitive the shape of every primitive added until @a finish()
+     * @param count the exact number of primitives that will be added
+     */
+    void begin(Primitive primitive, size_t count, std::vector<TModel> &outModels) {
+        primitive_ = primitive;
+        remaining_ = count;
+        chunkRemaining_ = 0;
+        out_ = &outModels;
+        // worst case, so appending models never reallocates the vector in the middle of a build
+        outModels.reserve(outModels.size() + count / primitivesPerModel() + 1);
+    }
+
+    inline void addLine(const TVertex &a, const TVertex &b) {
+        Index base = nextPrimitive();
+        vertices_.push_back(a);
+        vertices_.push_back(b);
+        indices_.push_back(base);
+        indices_.push_back(base + 1);
+    }
+
+    /*!
+     * Adds a quad from its corners in clockwise order starting at the top left
+     */
+    inline void addQuad(const TVertex &topLeft, const TVertex &topRight,
+                        const TVertex &bottomRight, const TVertex &bottomLeft) {
+        Index base = addCorners(topLeft, topRight, bottomRight, bottomLeft);
+        indices_.push_back(base);     indices_.push_back(base + 1); indices_.push_back(base + 2);
+        indices_.push_back(base);     indices_.push_back(base + 2); indices_.push_back(base + 3);
+    }
+
+    /*!
+     * Adds the four edges of a quad, corners in clockwise order starting at the top left
+     */
+    inline void addOutline(const TVertex &topLeft, const TVertex &topRight,
+                           const TVertex &bottomRight, const TVertex &bottomLeft) {
+        Index base = addCorners(topLeft, topRight, bottomRight, bottomLeft);
+        indices_.push_back(base);     indices_.push_back(base + 1); // Top
+        indices_.push_back(base + 1); indices_.push_back(base + 2); // Right
+        indices_.push_back(base + 2); indices_.push_back(base + 3); // Bottom
+        indices_.push_back(base + 3); indices_.push_back(base);     // Left
+    }
+
+    /*!
+     * Moves the last partially filled model into the output
+     */
+    void finish() {
+        flushModel();
+        out_ = nullptr;
+    }
+
+private:
+    struct Storage {
+        std::vector<TVertex> vertices;
+        std::vector<Index> indices;
+    };
+
+    inline size_t verticesPerPrimitive() const { return primitive_ == kLine ? 2 : 4; }
+
+    inline size_t indicesPerPrimitive() const {
+        return primitive_ == kLine ? 2 : (primitive_ == kQuad ? 6 : 8);
+    }
+
+    inline size_t primitivesPerModel() const {
+        return kMaxVerticesPerModel / verticesPerPrimitive();
+    }
+
+    /*!
+     * Makes room for one more primitive, starting a new model if the current one is full
+     * @return the index of the primitive's first vertex
+     */
+    inline Index nextPrimitive() {
+        if (chunkRemaining_ == 0) {
+            startModel();
+        }
+        chunkRemaining_--;
+        return Index(vertices_.size());
+    }
+
+    inline Index addCorners(const TVertex &topLeft, const TVertex &topRight,
+                            const TVertex &bottomRight, const TVertex &bottomLeft) {
+        Index base = nextPrimitive();
+        vertices_.push_back(topLeft);
+        vertices_.push_back(topRight);
+        vertices_.push_back(bottomRight);
+        vertices_.push_back(bottomLeft);
+        return base;
+    }
+
+    void startModel() {
+        flushModel();
+
+        // Reuse the storage of an old model if there is one, reserve() is then a no-op as long as
+        // the mesh did not grow
+        if (!spares_.empty()) {
+            vertices_ = std::move(spares_.back().vertices);
+            indices_ = std::move(spares_.back().indices);
+            spares_.pop_back();
+        }
+        vertices_.clear();
+        indices_.clear();
+
+        // remaining_ is only zero if more primitives are added than were announced to begin()
+        chunkRemaining_ = std::max<size_t>(1, std::min(remaining_, primitivesPerModel()));
+        remaining_ -= std::min(remaining_, chunkRemaining_);
+
+        // A hit is a rebuild that fits into storage it already had
+        static Metrics::CacheCounter &storageReuse = Metrics::cache("mesh.storage_reuse");
+        const size_t vertexCount = chunkRemaining_ * verticesPerPrimitive();
+        const size_t indexCount = chunkRemaining_ * indicesPerPrimitive();
+        if (vertices_.capacity() >= vertexCount && indices_.capacity() >= indexCount) {
+            storageReuse.hit();
+        } else {
+            storageReuse.miss();
+        }
+        vertices_.reserve(vertexCount);
+        indices_.reserve(indexCount);
+    }
+
+    void flushModel() {
+        if (out_ && !vertices_.empty()) {
+            out_->emplace_back(std::move(vertices_), std::move(indices_));
+            vertices_.clear();
+            indices_.clear();
+        }
+        chunkRemaining_ = 0;
+    }
+
+    Primitive primitive_;
+    // primitives announced to begin() that are not part of a started model yet
+    size_t remaining_;
+    // primitives the current model still has room for
+    size_t chunkRemaining_;
+    std::vector<TModel> *out_;
+
+    std::vector<TVertex> vertices_;
+    std::vector<Index> indices_;
+    std::vector<Storage> spares_;
+};
+
+#endif //SCROLLER_MESHBUILDER_H
@@ -0,0 +1,353 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#if SCROLLER_METRICS_HTTP
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "AndroidOut.h"
+
+namespace {
+    enum MetricType {
+        kTypeCounter,
+        kTypeGauge,
+        kTypeCache,
+        kTypeHistogram,
+    };
+
+    struct Entry {
+        MetricType type;
+        const char *name;
+        const char *unit;
+        void *metric;
+    };
+
+    /*!
+     * Metrics are appended to a fixed table and never removed, so dumps can walk the published
+     * part of it without taking the lock.
+     */
+    constexpr int kMaxMetrics = 256;
+    Entry gEntries[kMaxMetrics];
+    std::atomic<int> gEntryCount{0};
+    std::mutex gCreateMutex;
+
+    void *findOrCreate(MetricType type, const char *name, const char *unit) {
+        std::lock_guard<std::mutex> lock(gCreateMutex);
+        const int count = gEntryCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; i++) {
+            if (strcmp(gEntries[i].name, name) == 0) {
+                if (gEntries[i].type != type) {
+                    aout << "Metric " << name << " requested with two different types" << std::endl;
+                    abort();
+                }
+                return gEntries[i].metric;
+            }
+        }
+        if (count == kMaxMetrics) {
+            aout << "Too many metrics, cannot create " << name << std::endl;
+            abort();
+        }
+
+        void *metric = nullptr;
+        switch (type) {
+            case kTypeCounter:
+                metric = new Metrics::Counter();
+                break;
+            case kTypeGauge:
+                metric = new Metrics::Gauge();
+                break;
+            case kTypeCache:
+                metric = new Metrics::CacheCounter();
+                break;
+            case kTypeHistogram:
+                metric = new Metrics::Histogram();
+                break;
+        }
+        gEntries[count] = {type, name, unit, metric};
+        gEntryCount.store(count + 1, std::memory_order_release);
+        return metric;
+    }
+}
+
+double Metrics::CacheCounter::getHitRate() const {
+    const uint64_t hits = getHits();
+    const uint64_t lookups = hits + getMisses();
+    return lookups ? double(hits) / lookups : 0.0;
+}
+
+int Metrics::Histogram::getBucketIndex(uint64_t value) {
+    if (value < kLinearCount) {
+        return int(value);
+    }
+    // The highest set bit picks the power of two, the next four bits the bucket inside it
+    const int highestBit = 63 - __builtin_clzll(value);
+    const int shift = highestBit - (kLinearBits - 1);
+    const int subBucket = int(value >> shift) - kSubBuckets;
+    return kLinearCount + (highestBit - kLinearBits) * kSubBuckets + subBucket;
+}
+
+uint64_t Metrics::Histogram::getBucketStart(int index) {
+    if (index < kLinearCount) {
+        return uint64_t(index);
+    }
+    const int offset = index - kLinearCount;
+    const int highestBit = kLinearBits + offset / kSubBuckets;
+    const uint64_t mantissa = uint64_t(kSubBuckets + offset % kSubBuckets);
+    return mantissa << (highestBit - (kLinearBits - 1));
+}
+
+void Metrics::Histogram::record(uint64_t value) {
+    buckets_[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+double Metrics::Histogram::getMean() const {
+    const uint64_t count = getCount();
+    return count ? double(sum_.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+uint64_t Metrics::Histogram::getPercentile(double percentile) const {
+    // Buckets keep changing while this runs, so work on one pass over them
+    uint64_t total = 0;
+    uint64_t counts[kBucketCount];
+    for (int i = 0; i < kBucketCount; i++) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const uint64_t rank = std::max<uint64_t>(1, uint64_t(percentile * total + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            if (i < kLinearCount) {
+                return uint64_t(i);
+            }
+            const uint64_t start = getBucketStart(i);
+            const uint64_t end = i + 1 < kBucketCount ? getBucketStart(i + 1) : UINT64_MAX;
+            return std::min(start + (end - start) / 2, getMax());
+        }
+    }
+    return getMax();
+}
+
+Metrics::Counter &Metrics::counter(const char *name, const char *unit) {
+    return *static_cast<Counter *>(findOrCreate(kTypeCounter, name, unit));
+}
+
+Metrics::Gauge &Metrics::gauge(const char *name, const char *unit) {
+    return *static_cast<Gauge *>(findOrCreate(kTypeGauge, name, unit));
+}
+
+Metrics::CacheCounter &Metrics::cache(const char *name) {
+    return *static_cast<CacheCounter *>(findOrCreate(kTypeCache, name, ""));
+}
+
+Metrics::Histogram &Metrics::histogram(const char *name, const char *unit) {
+    return *static_cast<Histogram *>(findOrCreate(kTypeHistogram, name, unit));
+}
+
+std::string Metrics::dumpText() {
+    std::ostringstream dump;
+    const int count = gEntryCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        const Entry &entry = gEntries[i];
+        dump << entry.name << ":";
+        switch (entry.type) {
+            case kTypeCounter:
+                dump << " " << static_cast<Counter *>(entry.metric)->get();
+                break;
+            case kTypeGauge:
+                dump << " " << static_cast<Gauge *>(entry.metric)->get();
+                break;
+            case kTypeCache: {
+                auto *cache = static_cast<CacheCounter *>(entry.metric);
+                dump << " hits=" << cache->getHits() << " misses=" << cache->getMisses()
+                     << " rate=" << cache->getHitRate();
+                break;
+            }
+            case kTypeHistogram: {
+                auto *histogram = static_cast<Histogram *>(entry.metric);
+                dump << " count=" << histogram->getCount()
+                     << " mean=" << histogram->getMean()
+                     << " p50=" << histogram->getPercentile(0.50)
+                     << " p90=" << histogram->getPercentile(0.90)
+                     << " p99=" << histogram->getPercentile(0.99)
+                     << " max=" << histogram->getMax();
+                break;
+            }
+        }
+        if (entry.unit[0]) {
+            dump << " " << entry.unit;
+        }
+        dump << "\n";
+    }
+    return dump.str();
+}
+
+std::string Metrics::dumpJson() {
+    std::ostringstream dump;
+    dump << "{";
+    const int count = gEntryCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        const Entry &entry = gEntries[i];
+        dump << (i ? ",\n" : "\n") << "  \"" << entry.name << "\": {\"unit\": \"" << entry.unit
+             << "\", ";
+        switch (entry.type) {
+            case kTypeCounter:
+                dump << "\"counter\": " << static_cast<Counter *>(entry.metric)->get();
+                break;
+            case kTypeGauge:
+                dump << "\"gauge\": " << static_cast<Gauge *>(entry.metric)->get();
+                break;
+            case kTypeCache: {
+                auto *cache = static_cast<CacheCounter *>(entry.metric);
+                dump << "\"hits\": " << cache->getHits() << ", \"misses\": " << cache->getMisses()
+                     << ", \"hit_rate\": " << cache->getHitRate();
+                break;
+            }
+            case kTypeHistogram: {
+                auto *histogram = static_cast<Histogram *>(entry.metric);
+                dump << "\"count\": " << histogram->getCount()
+                     << ", \"mean\": " << histogram->getMean()
+                     << ", \"p50\": " << histogram->getPercentile(0.50)
+                     << ", \"p90\": " << histogram->getPercentile(0.90)
+                     << ", \"p99\": " << histogram->getPercentile(0.99)
+                     << ", \"max\": " << histogram->getMax();
+                break;
+            }
+        }
+        dump << "}";
+    }
+    dump << "\n}\n";
+    return dump.str();
+}
+
+void Metrics::logDump() {
+    // One line per metric, logcat truncates long messages
+    std::istringstream lines(dumpText());
+    std::string line;
+    while (std::getline(lines, line)) {
+        aout << "metric " << line << std::endl;
+    }
+}
+
+bool Metrics::writeDump(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        aout << "Failed to write metrics to " << path << std::endl;
+        return false;
+    }
+    std::string json = dumpJson();
+    fwrite(json.data(), 1, json.size(), file);
+    fclose(file);
+    return true;
+}
+
+#if SCROLLER_METRICS_HTTP
+
+namespace {
+    std::mutex gHttpMutex;
+    int gListenSocket = -1;
+    std::thread gHttpThread;
+
+    void serveHttp(int listenSocket) {
+        while (true) {
+            int client = accept(listenSocket, nullptr, nullptr);
+            if (client < 0) {
+                // The listening socket was shut down by stopHttpEndpoint()
+                return;
+            }
+
+            // The request itself does not matter, every path gets the dump
+            char request[1024];
+            recv(client, request, sizeof(request), 0);
+
+            std::string body = Metrics::dumpJson();
+            std::string response = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n"
+                                   "Content-Length: " + std::to_string(body.size()) +
+                                   "\r\nConnection: close\r\n\r\n" + body;
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t result = send(client, response.data() + sent, response.size() - sent, 0);
+                if (result <= 0) {
+                    break;
+                }
+                sent += size_t(result);
+            }
+            close(client);
+        }
+    }
+}
+
+bool Metrics::startHttpEndpoint(int port) {
+    std::lock_guard<std::mutex> lock(gHttpMutex);
+    if (gListenSocket >= 0) {
+        return true;
+    }
+
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        aout << "Failed to create metrics socket" << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(uint16_t(port));
+    if (bind(listenSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || listen(listenSocket, 4) != 0) {
+        aout << "Failed to serve metrics on port " << port << std::endl;
+        close(listenSocket);
+        return false;
+    }
+
+    gListenSocket = listenSocket;
+    gHttpThread = std::thread(serveHttp, listenSocket);
+    aout << "Serving metrics on 127.0.0.1:" << port << std::endl;
+    return true;
+}
+
+void Metrics::stopHttpEndpoint() {
+    std::lock_guard<std::mutex> lock(gHttpMutex);
+    if (gListenSocket < 0) {
+        return;
+    }
+    shutdown(gListenSocket, SHUT_RDWR);
+    close(gListenSocket);
+    gListenSocket = -1;
+    if (gHttpThread.joinable()) {
+        gHttpThread.join();
+    }
+}
+
+#else
+
+bool Metrics::startHttpEndpoint(int) {
+    return false;
+}
+
+void Metrics::stopHttpEndpoint() {}
+
+#endif
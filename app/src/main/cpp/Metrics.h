@@ -0,0 +1,184 @@
+#ifndef SCROLLER_METRICS_H
+#define SCROLLER_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*!
+ * The metrics HTTP endpoint is only served in debug builds unless the build says otherwise.
+ */
+#ifndef SCROLLER_METRICS_HTTP
+#ifdef NDEBUG
+#define SCROLLER_METRICS_HTTP 0
+#else
+#define SCROLLER_METRICS_HTTP 1
+#endif
+#endif
+
+/*!
+ * Process wide telemetry. Metrics are created by name on first use and live until the process
+ * exits, so the usual pattern is to look one up once and keep the reference:
+ *
+ *  static Metrics::Counter &drawCalls = Metrics::counter("render.draw_calls");
+ *  drawCalls.add();
+ *
+ * Recording is lock free and safe from any thread. Only creating a metric takes a lock.
+ */
+namespace Metrics {
+    /*!
+     * A monotonically increasing count
+     */
+    class Counter {
+    public:
+        inline void add(uint64_t amount = 1) {
+            value_.fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        inline uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    /*!
+     * A value that goes up and down, e.g. the size of something
+     */
+    class Gauge {
+    public:
+        inline void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+
+        inline void add(int64_t amount) { value_.fetch_add(amount, std::memory_order_relaxed); }
+
+        inline int64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> value_{0};
+    };
+
+    /*!
+     * Hits and misses of a cache
+     */
+    class CacheCounter {
+    public:
+        inline void hit() { hits_.fetch_add(1, std::memory_order_relaxed); }
+
+        inline void miss() { misses_.fetch_add(1, std::memory_order_relaxed); }
+
+        inline uint64_t getHits() const { return hits_.load(std::memory_order_relaxed); }
+
+        inline uint64_t getMisses() const { return misses_.load(std::memory_order_relaxed); }
+
+        /*!
+         * @return hits over lookups, 0 without lookups
+         */
+        double getHitRate() const;
+
+    private:
+        std::atomic<uint64_t> hits_{0};
+        std::atomic<uint64_t> misses_{0};
+    };
+
+    /*!
+     * A distribution of non negative values in log-linear buckets (like HdrHistogram): values
+     * below 32 are exact, above that every power of two is split into 16 buckets, so reported
+     * percentiles are within about 3% of the true value over the whole 64 bit range.
+     */
+    class Histogram {
+    public:
+        static constexpr int kLinearBits = 5;
+        static constexpr int kLinearCount = 1 << kLinearBits;
+        static constexpr int kSubBuckets = kLinearCount / 2;
+        static constexpr int kBucketCount = kLinearCount + (64 - kLinearBits) * kSubBuckets;
+
+        void record(uint64_t value);
+
+        inline uint64_t getCount() const { return count_.load(std::memory_order_relaxed); }
+
+        inline uint64_t getMax() const { return max_.load(std::memory_order_relaxed); }
+
+        double getMean() const;
+
+        /*!
+         * @param percentile between 0 and 1
+         * @return the middle of the bucket holding the percentile, 0 without values
+         */
+        uint64_t getPercentile(double percentile) const;
+
+        static int getBucketIndex(uint64_t value);
+
+        /*!
+         * @return the smallest value of a bucket
+         */
+        static uint64_t getBucketStart(int index);
+
+    private:
+        std::atomic<uint64_t> buckets_[kBucketCount] = {};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+    };
+
+    /*!
+     * Records the time from construction to destruction into a histogram, in microseconds
+     */
+    class ScopedTimer {
+    public:
+        inline explicit ScopedTimer(Histogram &histogram)
+                : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+        inline ~ScopedTimer() {
+            histogram_.record(uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start_).count()));
+        }
+
+    private:
+        Histogram &histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    /*!
+     * Finds or creates a metric. Names are dotted paths like "render.draw_calls" and must outlive
+     * the process (string literals). Asking for an existing name with a different type is a bug
+     * and aborts.
+     * @param unit printed next to the values in dumps
+     */
+    Counter &counter(const char *name, const char *unit = "");
+    Gauge &gauge(const char *name, const char *unit = "");
+    CacheCounter &cache(const char *name);
+    Histogram &histogram(const char *name, const char *unit);
+
+    /*!
+     * @return every metric, one per line
+     */
+    std::string dumpText();
+
+    /*!
+     * @return every metric as a JSON object keyed by name
+     */
+    std::string dumpJson();
+
+    /*!
+     * Writes @a dumpText() to logcat
+     */
+    void logDump();
+
+    /*!
+     * Writes @a dumpJson() to a file
+     * @return false if the file could not be written
+     */
+    bool writeDump(const std::string &path);
+
+    /*!
+     * Serves @a dumpJson() to any HTTP request on 127.0.0.1 from a background thread, e.g. for
+     * "adb forward tcp:8686 tcp:8686 && curl localhost:8686". Only available with
+     * SCROLLER_METRICS_HTTP.
+     * @return false if the endpoint is disabled or the port is taken
+     */
+    bool startHttpEndpoint(int port);
+
+    void stopHttpEndpoint();
+}
+
+#endif //SCROLLER_METRICS_H
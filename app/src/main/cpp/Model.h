@@ -50,7 +50,7 @@ public:
         return vertices_.data();
     }
 
-    inline const size_t getIndexCount() const {
+    inline size_t getIndexCount() const {
         return indices_.size();
     }
 
@@ -58,6 +58,21 @@ public:
         return indices_.data();
     }
 
+    /*!
+     * Moves the model's storage out so it can be refilled without allocating, see MeshBuilder
+     */
+    inline void releaseStorage(std::vector<Vertex> &outVertices, std::vector<Index> &outIndices) {
+        outVertices = std::move(vertices_);
+        outIndices = std::move(indices_);
+    }
+
+    /*!
+     * @return the bytes of CPU memory the model holds, including spare capacity
+     */
+    inline size_t getMemoryBytes() const {
+        return vertices_.capacity() * sizeof(Vertex) + indices_.capacity() * sizeof(Index);
+    }
+
 private:
     std::vector<Vertex> vertices_;
     std::vector<Index> indices_;
@@ -75,7 +90,7 @@ public:
         return vertices_.data();
     }
 
-    inline const size_t getIndexCount() const {
+    inline size_t getIndexCount() const {
         return indices_.size();
     }
 
@@ -83,6 +98,21 @@ public:
         return indices_.data();
     }
 
+    /*!
+     * Moves the model's storage out so it can be refilled without allocating, see MeshBuilder
+     */
+    inline void releaseStorage(std::vector<TexturedVertex> &outVertices, std::vector<Index> &outIndices) {
+        outVertices = std::move(vertices_);
+        outIndices = std::move(indices_);
+    }
+
+    /*!
+     * @return the bytes of CPU memory the model holds, including spare capacity
+     */
+    inline size_t getMemoryBytes() const {
+        return vertices_.capacity() * sizeof(TexturedVertex) + indices_.capacity() * sizeof(Index);
+    }
+
 private:
     std::vector<TexturedVertex> vertices_;
     std::vector<Index> indices_;
@@ -1,5 +1,8 @@
 #include "NetworkDownloader.h"
 #include "AndroidOut.h"
+#include "MapParser.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <jni.h>
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <sstream>
@@ -21,6 +24,8 @@ size_t NetworkDownloader::WriteImageCallback(void* contents, size_t size, size_t
 }
 
 bool NetworkDownloader::downloadCSV(const std::string& url, MapData& mapData) {
+    SCROLLER_TRACE_SCOPE("NetworkDownloader::downloadCSV");
+    Metrics::ScopedTimer latency(Metrics::histogram("network.request_latency", "us"));
     aout << "NetworkDownloader::downloadCSV called with URL: " << url << std::endl;
     
     if (!g_app) {
@@ -147,7 +152,7 @@ bool NetworkDownloader::downloadCSV(const std::string& url, MapData& mapData) {
     aout << "Downloaded CSV data, size: " << strlen(csvData) << std::endl;
     
     // Parse the CSV data
-    bool parseResult = parseCSVData(csvData, mapData);
+    bool parseResult = MapParser::parseCSV(csvData, mapData);
     
     // Cleanup
     env->ReleaseStringUTFChars(result_str, csvData);
@@ -163,6 +168,8 @@ bool NetworkDownloader::downloadCSV(const std::string& url, MapData& mapData) {
 }
 
 bool NetworkDownloader::downloadJSON(const std::string& url, MapData& mapData) {
+    SCROLLER_TRACE_SCOPE("NetworkDownloader::downloadJSON");
+    Metrics::ScopedTimer latency(Metrics::histogram("network.request_latency", "us"));
     aout << "NetworkDownloader::downloadJSON called with URL: " << url << std::endl;
     
     if (!g_app) {
@@ -287,9 +294,10 @@ bool NetworkDownloader::downloadJSON(const std::string& url, MapData& mapData) {
     }
     
     aout << "Downloaded JSON data, size: " << strlen(jsonData) << std::endl;
+    aout << "JSON data: " << jsonData << std::endl;
     
     // Parse the JSON data
-    bool parseResult = parseJSONData(jsonData, mapData);
+    bool parseResult = MapParser::parseJSON(jsonData, mapData);
     
     // Cleanup
     env->ReleaseStringUTFChars(result_str, jsonData);
@@ -304,8 +312,35 @@ bool NetworkDownloader::downloadJSON(const std::string& url, MapData& mapData) {
     return parseResult;
 }
 
+bool NetworkDownloader::downloadPacked(const std::string& url, MapData& mapData,
+                                       std::vector<uint8_t>& body) {
+    SCROLLER_TRACE_SCOPE("NetworkDownloader::downloadPacked");
+    aout << "NetworkDownloader::downloadPacked called with URL: " << url << std::endl;
+
+    body.clear();
+    if (!downloadBinary(url, "network: packed map", "network.packed_map_bytes", body)) {
+        return false;
+    }
+    if (MapParser::parsePacked(body.data(), body.size(), mapData)) {
+        return true;
+    }
+    // A server that does not know the packed form sends the map as JSON
+    body.push_back('\0');
+    const bool parsed = MapParser::parseJSON(reinterpret_cast<const char*>(body.data()), mapData);
+    body.pop_back();
+    return parsed;
+}
+
 bool NetworkDownloader::downloadImage(const std::string& url, std::vector<uint8_t>& imageData) {
-    aout << "NetworkDownloader::downloadImage called with URL: " << url << std::endl;
+    SCROLLER_TRACE_SCOPE("NetworkDownloader::downloadImage");
+    return downloadBinary(url, "network: tank image", "network.image_bytes", imageData);
+}
+
+bool NetworkDownloader::downloadBinary(const std::string& url, const char* spanName,
+                                       const char* bytesMetric, std::vector<uint8_t>& data) {
+    SCROLLER_TRACE_SCOPE(spanName);
+    Metrics::ScopedTimer latency(Metrics::histogram("network.request_latency", "us"));
+    aout << "NetworkDownloader::downloadBinary called with URL: " << url << std::endl;
     
     if (!g_app || !g_app->activity) {
         aout << "No app activity available for JNI calls" << std::endl;
@@ -391,7 +426,7 @@ bool NetworkDownloader::downloadImage(const std::string& url, std::vector<uint8_
     jbyteArray result_array = (jbyteArray)env->CallStaticObjectMethod(networkHelperClass, downloadImageDataMethod, jUrl);
     
     if (env->ExceptionCheck()) {
-        aout << "Exception occurred during image download" << std::endl;
+        aout << "Exception occurred during download" << std::endl;
         env->ExceptionDescribe();
         env->ExceptionClear();
         env->DeleteLocalRef(jUrl);
@@ -404,7 +439,7 @@ bool NetworkDownloader::downloadImage(const std::string& url, std::vector<uint8_
     }
     
     if (!result_array) {
-        aout << "Image download failed - null result" << std::endl;
+        aout << "Download failed - null result" << std::endl;
         env->DeleteLocalRef(jUrl);
         env->DeleteLocalRef(className);
         env->DeleteLocalRef(classLoader);
@@ -418,9 +453,9 @@ bool NetworkDownloader::downloadImage(const std::string& url, std::vector<uint8_
     jsize arrayLength = env->GetArrayLength(result_array);
     jbyte* arrayPtr = env->GetByteArrayElements(result_array, nullptr);
     
-    imageData.clear();
-    imageData.resize(arrayLength);
-    memcpy(imageData.data(), arrayPtr, arrayLength);
+    data.clear();
+    data.resize(arrayLength);
+    memcpy(data.data(), arrayPtr, arrayLength);
     
     env->ReleaseByteArrayElements(result_array, arrayPtr, JNI_ABORT);
     env->DeleteLocalRef(jUrl);
@@ -431,11 +466,14 @@ bool NetworkDownloader::downloadImage(const std::string& url, std::vector<uint8_
     env->DeleteLocalRef(activityClass);
     vm->DetachCurrentThread();
 
-    aout << "Successfully downloaded image data, size: " << imageData.size() << " bytes" << std::endl;
+    Metrics::counter(bytesMetric).add(data.size());
+    aout << "Successfully downloaded " << data.size() << " bytes" << std::endl;
     return true;
 }
 
 bool NetworkDownloader::postJSON(const std::string& url, const std::string& jsonData, std::string& response) {
+    SCROLLER_TRACE_SCOPE("NetworkDownloader::postJSON");
+    Metrics::ScopedTimer latency(Metrics::histogram("network.request_latency", "us"));
     aout << "NetworkDownloader::postJSON called with URL: " << url << std::endl;
     aout << "JSON data: " << jsonData << std::endl;
     
@@ -567,196 +605,62 @@ bool NetworkDownloader::postJSON(const std::string& url, const std::string& json
     return true;
 }
 
-bool NetworkDownloader::parseCSVData(const char* csvData, MapData& mapData) {
-    aout << "Parsing CSV data..." << std::endl;
-    
-    std::vector<std::vector<char>> grid;
-    std::istringstream stream(csvData);
-    std::string line;
-    int maxWidth = 0;
-
-    while (std::getline(stream, line)) {
-        if (line.empty()) continue;
-        
-        std::vector<char> row;
-        std::istringstream lineStream(line);
-        std::string cell;
-        
-        while (std::getline(lineStream, cell, ',')) {
-            // Remove whitespace
-            cell.erase(0, cell.find_first_not_of(" \t\r\n"));
-            cell.erase(cell.find_last_not_of(" \t\r\n") + 1);
-            
-            if (!cell.empty()) {
-                row.push_back(cell[0]);
-            } else {
-                row.push_back(' '); // Empty cell
-            }
-        }
-        
-        if (!row.empty()) {
-            grid.push_back(row);
-            maxWidth = std::max(maxWidth, (int)row.size());
-        }
-    }
-
-    // Normalize grid (make all rows same width)
-    for (auto& row : grid) {
-        while (row.size() < maxWidth) {
-            row.push_back(' ');
-        }
-    }
-
-    // Convert to MapData
-    mapData.width = maxWidth;
-    mapData.height = grid.size();
-    mapData.data.resize(mapData.width * mapData.height);
-
-    for (int y = 0; y < mapData.height; y++) {
-        for (int x = 0; x < mapData.width; x++) {
-            mapData.data[y * mapData.width + x] = grid[y][x];
-        }
-    }
-
-    aout << "Successfully parsed CSV data: " << mapData.width << "x" << mapData.height << std::endl;
-    return true;
-}
+void NetworkDownloader::setCancelled(bool cancelled) {
+    SCROLLER_TRACE_SCOPE("NetworkDownloader::setCancelled");
+    aout << "NetworkDownloader::setCancelled: " << cancelled << std::endl;
 
-bool NetworkDownloader::parseJSONData(const char* jsonData, MapData& mapData) {
-    aout << "Parsing JSON data..." << std::endl;
-    aout << "JSON data: " << jsonData << std::endl;
-    
-    // Simple JSON parsing - look for the "data" array
-    std::string jsonStr(jsonData);
-    
-    // Find the "data" field
-    size_t dataPos = jsonStr.find("\"data\"");
-    if (dataPos == std::string::npos) {
-        aout << "Failed to find 'data' field in JSON" << std::endl;
-        return false;
-    }
-    
-    // Find the opening bracket of the data array
-    size_t arrayStart = jsonStr.find('[', dataPos);
-    if (arrayStart == std::string::npos) {
-        aout << "Failed to find data array start" << std::endl;
-        return false;
-    }
-    
-    // Find the dimensions
-    size_t dimensionsPos = jsonStr.find("\"dimensions\"");
-    int width = 10, height = 10; // Default values
-    
-    if (dimensionsPos != std::string::npos) {
-        size_t rowsPos = jsonStr.find("\"rows\"", dimensionsPos);
-        size_t colsPos = jsonStr.find("\"columns\"", dimensionsPos);
-        
-        if (rowsPos != std::string::npos) {
-            size_t colonPos = jsonStr.find(':', rowsPos);
-            if (colonPos != std::string::npos) {
-                size_t numStart = colonPos + 1;
-                size_t numEnd = jsonStr.find_first_of(",}", numStart);
-                if (numEnd != std::string::npos) {
-                    std::string numStr = jsonStr.substr(numStart, numEnd - numStart);
-                    // Remove whitespace
-                    numStr.erase(0, numStr.find_first_not_of(" \t\r\n"));
-                    numStr.erase(numStr.find_last_not_of(" \t\r\n") + 1);
-                    height = std::stoi(numStr);
-                }
-            }
-        }
-        
-        if (colsPos != std::string::npos) {
-            size_t colonPos = jsonStr.find(':', colsPos);
-            if (colonPos != std::string::npos) {
-                size_t numStart = colonPos + 1;
-                size_t numEnd = jsonStr.find_first_of(",}", numStart);
-                if (numEnd != std::string::npos) {
-                    std::string numStr = jsonStr.substr(numStart, numEnd - numStart);
-                    // Remove whitespace
-                    numStr.erase(0, numStr.find_first_not_of(" \t\r\n"));
-                    numStr.erase(numStr.find_last_not_of(" \t\r\n") + 1);
-                    width = std::stoi(numStr);
-                }
-            }
-        }
-    }
-    
-    aout << "Detected dimensions: " << width << "x" << height << std::endl;
-    
-    // Parse the data array manually
-    std::vector<std::vector<char>> grid;
-    size_t pos = arrayStart + 1;
-    
-    // Parse each row
-    for (int row = 0; row < height; row++) {
-        std::vector<char> rowData;
-        
-        // Find the start of this row's array
-        size_t rowStart = jsonStr.find('[', pos);
-        if (rowStart == std::string::npos) break;
-        
-        size_t rowEnd = jsonStr.find(']', rowStart);
-        if (rowEnd == std::string::npos) break;
-        
-        // Parse elements in this row
-        size_t elementPos = rowStart + 1;
-        for (int col = 0; col < width; col++) {
-            // Find the next string element
-            size_t quoteStart = jsonStr.find('"', elementPos);
-            if (quoteStart == std::string::npos || quoteStart > rowEnd) {
-                rowData.push_back(' '); // Empty cell
-                continue;
-            }
-            
-            size_t quoteEnd = jsonStr.find('"', quoteStart + 1);
-            if (quoteEnd == std::string::npos || quoteEnd > rowEnd) {
-                rowData.push_back(' '); // Empty cell
-                continue;
-            }
-            
-            // Extract the cell value
-            std::string cellValue = jsonStr.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
-            
-            if (!cellValue.empty()) {
-                rowData.push_back(cellValue[0]);
-            } else {
-                rowData.push_back(' '); // Empty cell
-            }
-            
-            elementPos = quoteEnd + 1;
-        }
-        
-        grid.push_back(rowData);
-        pos = rowEnd + 1;
-    }
-    
-    // Convert to MapData
-    mapData.width = width;
-    mapData.height = height;
-    mapData.data.resize(mapData.width * mapData.height);
-    
-    for (int y = 0; y < mapData.height; y++) {
-        for (int x = 0; x < mapData.width; x++) {
-            if (y < grid.size() && x < grid[y].size()) {
-                mapData.data[y * mapData.width + x] = grid[y][x];
-            } else {
-                mapData.data[y * mapData.width + x] = ' '; // Default empty
-            }
-        }
-    }
-    
-    aout << "Successfully parsed JSON data: " << mapData.width << "x" << mapData.height << std::endl;
-    
-    // Debug: Print the parsed grid
-    for (int y = 0; y < mapData.height; y++) {
-        std::string row = "";
-        for (int x = 0; x < mapData.width; x++) {
-            char cell = mapData.data[y * mapData.width + x];
-            row += (cell == ' ') ? '.' : cell; // Show empty cells as dots for visibility
-        }
-        aout << "Row " << y << ": '" << row << "'" << std::endl;
+    if (!g_app || !g_app->activity) {
+        aout << "No app activity available for JNI calls" << std::endl;
+        return;
     }
-    
-    return true;
-}
\ No newline at end of file
+
+    JNIEnv* env;
+    JavaVM* vm = g_app->activity->vm;
+    jint result = vm->AttachCurrentThread(&env, nullptr);
+    if (result != JNI_OK) {
+        aout << "Failed to attach to Java VM: " << result << std::endl;
+        return;
+    }
+
+    // Get the activity class and its class loader
+    jobject activityObject = g_app->activity->javaGameActivity;
+    jclass activityClass = env->GetObjectClass(activityObject);
+    jmethodID getClassLoaderMethod = env->GetMethodID(activityClass, "getClassLoader", "()Ljava/lang/ClassLoader;");
+    jobject classLoader = getClassLoaderMethod
+                          ? env->CallObjectMethod(activityObject, getClassLoaderMethod) : nullptr;
+    if (!classLoader) {
+        aout << "Failed to get class loader" << std::endl;
+        env->ExceptionClear();
+        env->DeleteLocalRef(activityClass);
+        vm->DetachCurrentThread();
+        return;
+    }
+
+    // Load the NetworkHelper class
+    jclass classLoaderClass = env->FindClass("java/lang/ClassLoader");
+    jmethodID loadClassMethod = env->GetMethodID(classLoaderClass, "loadClass", "(Ljava/lang/String;)Ljava/lang/Class;");
+    jstring className = env->NewStringUTF("com.example.scroller.NetworkHelper");
+    jclass networkHelperClass = loadClassMethod
+            ? (jclass)env->CallObjectMethod(classLoader, loadClassMethod, className) : nullptr;
+    jmethodID setCancelledMethod = networkHelperClass && !env->ExceptionCheck()
+            ? env->GetStaticMethodID(networkHelperClass, "setCancelled", "(Z)V") : nullptr;
+
+    if (setCancelledMethod) {
+        env->CallStaticVoidMethod(networkHelperClass, setCancelledMethod, jboolean(cancelled));
+    } else {
+        aout << "Failed to find NetworkHelper.setCancelled" << std::endl;
+    }
+    if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+
+    if (networkHelperClass) {
+        env->DeleteLocalRef(networkHelperClass);
+    }
+    env->DeleteLocalRef(className);
+    env->DeleteLocalRef(classLoader);
+    env->DeleteLocalRef(classLoaderClass);
+    env->DeleteLocalRef(activityClass);
+    vm->DetachCurrentThread();
+}
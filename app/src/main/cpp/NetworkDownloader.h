@@ -5,24 +5,41 @@
 #include <vector>
 #include <functional>
 
+#include "MapData.h"
+
 class NetworkDownloader {
 public:
-    struct MapData {
-        std::vector<char> data;
-        int width;
-        int height;
-    };
+    typedef ::MapData MapData;
 
     static bool downloadCSV(const std::string& url, MapData& mapData);
     static bool downloadJSON(const std::string& url, MapData& mapData);
+    /*!
+     * Downloads a map in the PackedCells form MapParser::parsePacked() reads. A server that does
+     * not know the form sends JSON instead, which is parsed as such.
+     * @param body receives the response as it came, packed or JSON
+     */
+    static bool downloadPacked(const std::string& url, MapData& mapData,
+                               std::vector<uint8_t>& body);
     static bool downloadImage(const std::string& url, std::vector<uint8_t>& imageData);
     static bool postJSON(const std::string& url, const std::string& jsonData, std::string& response);
+    /*!
+     * Aborts the binary downloads in flight and fails new ones until called again with false.
+     * Called before waiting for a download that is no longer wanted, so the wait is not bounded
+     * by the network timeouts.
+     */
+    static void setCancelled(bool cancelled);
 
 private:
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp);
     static size_t WriteImageCallback(void* contents, size_t size, size_t nmemb, std::vector<uint8_t>* userp);
-    static bool parseCSVData(const char* csvData, MapData& mapData);
-    static bool parseJSONData(const char* jsonData, MapData& mapData);
+
+    /*!
+     * Downloads @a url as bytes through NetworkHelper.downloadImageData
+     * @param spanName names the request in traces
+     * @param bytesMetric the counter the downloaded bytes are added to
+     */
+    static bool downloadBinary(const std::string& url, const char* spanName,
+                               const char* bytesMetric, std::vector<uint8_t>& data);
 };
 
 #endif //SCROLLER_NETWORKDOWNLOADER_H
\ No newline at end of file
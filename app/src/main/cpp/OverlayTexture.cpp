@@ -0,0 +1,55 @@
+#include "OverlayTexture.h"
+
+#include "AndroidOut.h"
+#include "Utility.h"
+
+std::unique_ptr<OverlayTexture> OverlayTexture::create(int width, int height, GLenum format,
+                                                       GLint filter) {
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (width <= 0 || height <= 0 || width > maxTextureSize || height > maxTextureSize) {
+        aout << "Overlay texture " << width << "x" << height << " not supported (max "
+             << maxTextureSize << ")" << std::endl;
+        return nullptr;
+    }
+
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Immutable storage, contents are filled with upload()
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (!Utility::checkAndLogGlError()) {
+        glDeleteTextures(1, &textureId);
+        return nullptr;
+    }
+
+    return std::unique_ptr<OverlayTexture>(new OverlayTexture(textureId, width, height, format));
+}
+
+OverlayTexture::~OverlayTexture() {
+    glDeleteTextures(1, &textureID_);
+    textureID_ = 0;
+}
+
+void OverlayTexture::upload(int x, int y, int width, int height, const void *pixels,
+                            int stride) const {
+    const bool singleChannel = format_ == GL_R8;
+
+    glBindTexture(GL_TEXTURE_2D, textureID_);
+    // R8 rows are rarely a multiple of four bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                    singleChannel ? GL_RED : GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
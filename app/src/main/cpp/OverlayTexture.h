@@ -0,0 +1,49 @@
+#ifndef SCROLLER_OVERLAYTEXTURE_H
+#define SCROLLER_OVERLAYTEXTURE_H
+
+#include <memory>
+#include <GLES3/gl3.h>
+
+/*!
+ * A small, CPU-generated texture laid over the map (usually one texel per map cell), such as the fog
+ * of war mask. Regions can be re-uploaded individually so that only what changed is sent to the GPU.
+ */
+class OverlayTexture {
+public:
+    /*!
+     * Creates a texture with undefined contents
+     * @param width the width in texels
+     * @param height the height in texels
+     * @param format GL_R8 for single channel masks or GL_RGBA8 for colored overlays
+     * @param filter GL_NEAREST keeps cell edges sharp, GL_LINEAR smooths overlays coarser than cells
+     * @return the texture, or null if it exceeds the maximum texture size
+     */
+    static std::unique_ptr<OverlayTexture> create(int width, int height, GLenum format,
+                                                  GLint filter = GL_NEAREST);
+
+    ~OverlayTexture();
+
+    /*!
+     * Uploads a region of the texture
+     * @param pixels the first texel of the region
+     * @param stride the distance between two rows of @a pixels in texels
+     */
+    void upload(int x, int y, int width, int height, const void *pixels, int stride) const;
+
+    constexpr GLuint getTextureID() const { return textureID_; }
+
+    constexpr int getWidth() const { return width_; }
+
+    constexpr int getHeight() const { return height_; }
+
+private:
+    inline OverlayTexture(GLuint textureId, int width, int height, GLenum format)
+            : textureID_(textureId), width_(width), height_(height), format_(format) {}
+
+    GLuint textureID_;
+    int width_;
+    int height_;
+    GLenum format_;
+};
+
+#endif //SCROLLER_OVERLAYTEXTURE_H
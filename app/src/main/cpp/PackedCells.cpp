@@ -0,0 +1,376 @@
+#include "PackedCells.h"
+
+#include <cstring>
+
+static constexpr char kMagic[4] = {'P', 'C', 'E', 'L'};
+static constexpr uint8_t kFormatVersion = 1;
+static constexpr size_t kHeaderBytes = 16;
+//! Largest width or height deserialize() accepts
+static constexpr uint32_t kMaxSide = 1u << 16;
+
+static void appendUint32(std::vector<uint8_t> &out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(uint8_t(value >> (i * 8)));
+    }
+}
+
+static uint32_t readUint32(const uint8_t *data) {
+    return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16
+           | uint32_t(data[3]) << 24;
+}
+
+#if SCROLLER_PACK_NEON
+/*!
+ * Palette indices of 16 cells. Lanes of @a matched are set for cells found in the palette.
+ */
+static inline uint8x16_t toIndices(uint8x16_t cells, const char *palette, int paletteSize,
+                                   uint8x16_t &matched) {
+    uint8x16_t indices = vdupq_n_u8(0);
+    for (int i = 0; i < paletteSize; i++) {
+        const uint8x16_t equal = vceqq_u8(cells, vdupq_n_u8(uint8_t(palette[i])));
+        indices = vorrq_u8(indices, vandq_u8(equal, vdupq_n_u8(uint8_t(i))));
+        matched = vorrq_u8(matched, equal);
+    }
+    return indices;
+}
+#elif SCROLLER_PACK_SSE2
+static inline __m128i toIndices(__m128i cells, const char *palette, int paletteSize,
+                                __m128i &matched) {
+    __m128i indices = _mm_setzero_si128();
+    for (int i = 0; i < paletteSize; i++) {
+        const __m128i equal = _mm_cmpeq_epi8(cells, _mm_set1_epi8(palette[i]));
+        indices = _mm_or_si128(indices, _mm_and_si128(equal, _mm_set1_epi8(char(i))));
+        matched = _mm_or_si128(matched, equal);
+    }
+    return indices;
+}
+#endif
+
+PackedCells::PackedCells() {
+    reset(0, 0);
+}
+
+bool PackedCells::pack(const MapData &map, PackedCells &outCells) {
+    bool used[256] = {};
+    for (char cell: map.data) {
+        used[uint8_t(cell)] = true;
+    }
+
+    // Empty first, so a zeroed row is an empty row
+    std::vector<char> palette;
+    if (used[uint8_t(' ')]) {
+        palette.push_back(' ');
+    }
+    for (int value = 0; value < 256; value++) {
+        if (used[value] && char(value) != ' ') {
+            palette.push_back(char(value));
+        }
+    }
+    if (palette.size() > size_t(kMaxPalette)) {
+        outCells = PackedCells();
+        return false;
+    }
+    if (palette.empty()) {
+        palette.push_back(' ');
+    }
+
+    outCells.palette_ = std::move(palette);
+    outCells.setLayout(map.width, map.height, outCells.palette_.size() <= 4 ? 2 : 4);
+    outCells.updateTables();
+    for (int y = 0; y < map.height; y++) {
+        outCells.packRow(y, &map.data[size_t(y) * map.width]);
+    }
+    return true;
+}
+
+void PackedCells::reset(int width, int height, char fill) {
+    palette_.assign(1, fill);
+    setLayout(width, height, 2);
+    updateTables();
+}
+
+void PackedCells::unpack(MapData &outMap) const {
+    outMap.width = width_;
+    outMap.height = height_;
+    outMap.data.resize(size_t(width_) * height_);
+    for (int y = 0; y < height_; y++) {
+        unpackRow(y, &outMap.data[size_t(y) * width_]);
+    }
+}
+
+void PackedCells::unpackRow(int y, char *outCells) const {
+    const uint8_t *row = getRow(y);
+    size_t byte = 0;
+
+    // 16 packed bytes per iteration: 32 cells of 4 bits or 64 cells of 2 bits
+#if SCROLLER_PACK_NEON || SCROLLER_PACK_SSSE3
+    const size_t fullBytes = size_t(width_ >> cellsPerByteShift_);
+#if SCROLLER_PACK_NEON
+    const uint8x16_t table = vld1q_u8(reinterpret_cast<const uint8_t *>(paletteTable_));
+    auto *out = reinterpret_cast<uint8_t *>(outCells);
+    if (bits_ == 4) {
+        const uint8x16_t lowMask = vdupq_n_u8(0x0f);
+        for (; byte + 16 <= fullBytes; byte += 16) {
+            const uint8x16_t packed = vld1q_u8(row + byte);
+            uint8x16x2_t cells;
+            cells.val[0] = vqtbl1q_u8(table, vandq_u8(packed, lowMask));
+            cells.val[1] = vqtbl1q_u8(table, vshrq_n_u8(packed, 4));
+            vst2q_u8(out + byte * 2, cells);
+        }
+    } else {
+        const uint8x16_t lowMask = vdupq_n_u8(0x03);
+        for (; byte + 16 <= fullBytes; byte += 16) {
+            const uint8x16_t packed = vld1q_u8(row + byte);
+            uint8x16x4_t cells;
+            cells.val[0] = vqtbl1q_u8(table, vandq_u8(packed, lowMask));
+            cells.val[1] = vqtbl1q_u8(table, vandq_u8(vshrq_n_u8(packed, 2), lowMask));
+            cells.val[2] = vqtbl1q_u8(table, vandq_u8(vshrq_n_u8(packed, 4), lowMask));
+            cells.val[3] = vqtbl1q_u8(table, vshrq_n_u8(packed, 6));
+            vst4q_u8(out + byte * 4, cells);
+        }
+    }
+#else
+    const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i *>(paletteTable_));
+    auto *out = reinterpret_cast<__m128i *>(outCells);
+    if (bits_ == 4) {
+        const __m128i lowMask = _mm_set1_epi8(0x0f);
+        for (; byte + 16 <= fullBytes; byte += 16) {
+            const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + byte));
+            const __m128i low = _mm_shuffle_epi8(table, _mm_and_si128(packed, lowMask));
+            const __m128i high = _mm_shuffle_epi8(
+                    table, _mm_and_si128(_mm_srli_epi16(packed, 4), lowMask));
+            _mm_storeu_si128(out + byte / 8, _mm_unpacklo_epi8(low, high));
+            _mm_storeu_si128(out + byte / 8 + 1, _mm_unpackhi_epi8(low, high));
+        }
+    } else {
+        const __m128i lowMask = _mm_set1_epi8(0x03);
+        for (; byte + 16 <= fullBytes; byte += 16) {
+            const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + byte));
+            const __m128i cell0 = _mm_shuffle_epi8(table, _mm_and_si128(packed, lowMask));
+            const __m128i cell1 = _mm_shuffle_epi8(
+                    table, _mm_and_si128(_mm_srli_epi16(packed, 2), lowMask));
+            const __m128i cell2 = _mm_shuffle_epi8(
+                    table, _mm_and_si128(_mm_srli_epi16(packed, 4), lowMask));
+            const __m128i cell3 = _mm_shuffle_epi8(
+                    table, _mm_and_si128(_mm_srli_epi16(packed, 6), lowMask));
+            const __m128i low01 = _mm_unpacklo_epi8(cell0, cell1);
+            const __m128i high01 = _mm_unpackhi_epi8(cell0, cell1);
+            const __m128i low23 = _mm_unpacklo_epi8(cell2, cell3);
+            const __m128i high23 = _mm_unpackhi_epi8(cell2, cell3);
+            _mm_storeu_si128(out + byte / 4, _mm_unpacklo_epi16(low01, low23));
+            _mm_storeu_si128(out + byte / 4 + 1, _mm_unpackhi_epi16(low01, low23));
+            _mm_storeu_si128(out + byte / 4 + 2, _mm_unpacklo_epi16(high01, high23));
+            _mm_storeu_si128(out + byte / 4 + 3, _mm_unpackhi_epi16(high01, high23));
+        }
+    }
+#endif
+#endif
+
+    // The rest a byte at a time from the expansion table, the last byte may be partly used
+    int x = int(byte) << cellsPerByteShift_;
+    if (bits_ == 4) {
+        for (; x + 2 <= width_; x += 2, byte++) {
+            memcpy(outCells + x, &expand_[row[byte]], 2);
+        }
+    } else {
+        for (; x + 4 <= width_; x += 4, byte++) {
+            memcpy(outCells + x, &expand_[row[byte]], 4);
+        }
+    }
+    if (x < width_) {
+        memcpy(outCells + x, &expand_[row[byte]], size_t(width_ - x));
+    }
+}
+
+bool PackedCells::packRow(int y, const char *cells) {
+    uint8_t *row = &cells_[size_t(y) * rowBytes_];
+    const int paletteSize = int(palette_.size());
+    size_t byte = 0;
+    bool valid = true;
+
+    // 16 packed bytes per iteration, see unpackRow()
+#if SCROLLER_PACK_NEON
+    const size_t fullBytes = size_t(width_ >> cellsPerByteShift_);
+    const auto *in = reinterpret_cast<const uint8_t *>(cells);
+    uint8x16_t matched = vdupq_n_u8(0xff);
+    if (bits_ == 4) {
+        for (; byte + 16 <= fullBytes && valid; byte += 16) {
+            const uint8x16x2_t pairs = vld2q_u8(in + byte * 2);
+            uint8x16_t found = vdupq_n_u8(0);
+            const uint8x16_t low = toIndices(pairs.val[0], palette_.data(), paletteSize, found);
+            matched = vandq_u8(matched, found);
+            found = vdupq_n_u8(0);
+            const uint8x16_t high = toIndices(pairs.val[1], palette_.data(), paletteSize, found);
+            matched = vandq_u8(matched, found);
+            vst1q_u8(row + byte, vorrq_u8(low, vshlq_n_u8(high, 4)));
+            valid = vminvq_u8(matched) == 0xff;
+        }
+    } else {
+        for (; byte + 16 <= fullBytes && valid; byte += 16) {
+            const uint8x16x4_t quads = vld4q_u8(in + byte * 4);
+            uint8x16_t packed = vdupq_n_u8(0);
+            for (int i = 0; i < 4; i++) {
+                uint8x16_t found = vdupq_n_u8(0);
+                const uint8x16_t indices = toIndices(
+                        quads.val[i], palette_.data(), paletteSize, found);
+                matched = vandq_u8(matched, found);
+                packed = vorrq_u8(packed, vshlq_u8(indices, vdupq_n_s8(int8_t(i * 2))));
+            }
+            vst1q_u8(row + byte, packed);
+            valid = vminvq_u8(matched) == 0xff;
+        }
+    }
+#elif SCROLLER_PACK_SSE2
+    const size_t fullBytes = size_t(width_ >> cellsPerByteShift_);
+    const auto *in = reinterpret_cast<const __m128i *>(cells);
+    const __m128i byteMask = bits_ == 4 ? _mm_set1_epi16(0xff) : _mm_set1_epi32(0xff);
+    for (; byte + 16 <= fullBytes && valid; byte += 16) {
+        __m128i found = _mm_setzero_si128();
+        __m128i packed;
+        if (bits_ == 4) {
+            // Two cells per 16 bit lane become one byte
+            __m128i pairs[2];
+            for (int i = 0; i < 2; i++) {
+                const __m128i indices = toIndices(_mm_loadu_si128(in + byte / 8 + i),
+                                                  palette_.data(), paletteSize, found);
+                valid = valid && _mm_movemask_epi8(found) == 0xffff;
+                found = _mm_setzero_si128();
+                pairs[i] = _mm_and_si128(_mm_or_si128(indices, _mm_srli_epi16(indices, 4)),
+                                         byteMask);
+            }
+            packed = _mm_packus_epi16(pairs[0], pairs[1]);
+        } else {
+            // Four cells per 32 bit lane become one byte
+            __m128i quads[4];
+            for (int i = 0; i < 4; i++) {
+                const __m128i indices = toIndices(_mm_loadu_si128(in + byte / 4 + i),
+                                                  palette_.data(), paletteSize, found);
+                valid = valid && _mm_movemask_epi8(found) == 0xffff;
+                found = _mm_setzero_si128();
+                const __m128i half = _mm_or_si128(indices, _mm_srli_epi32(indices, 6));
+                quads[i] = _mm_and_si128(_mm_or_si128(half, _mm_srli_epi32(half, 12)), byteMask);
+            }
+            packed = _mm_packus_epi16(_mm_packs_epi32(quads[0], quads[1]),
+                                      _mm_packs_epi32(quads[2], quads[3]));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(row + byte), packed);
+    }
+#endif
+
+    const int cellsPerByte = 1 << cellsPerByteShift_;
+    for (int x = int(byte) << cellsPerByteShift_; x < width_ && valid; x += cellsPerByte, byte++) {
+        uint8_t packed = 0;
+        for (int i = 0; i < cellsPerByte && x + i < width_; i++) {
+            const uint8_t index = indexOf_[uint8_t(cells[x + i])];
+            valid = valid && index != kNoIndex;
+            packed |= uint8_t((index & indexMask_) << (i * bits_));
+        }
+        row[byte] = packed;
+    }
+    return valid;
+}
+
+bool PackedCells::set(int x, int y, char value) {
+    uint8_t index = indexOf_[uint8_t(value)];
+    if (index == kNoIndex) {
+        if (palette_.size() == size_t(kMaxPalette)) {
+            return false;
+        }
+        if (palette_.size() == size_t(1) << bits_) {
+            widen();
+        }
+        index = uint8_t(palette_.size());
+        palette_.push_back(value);
+        updateTables();
+    }
+
+    uint8_t &byte = cells_[size_t(y) * rowBytes_ + (x >> cellsPerByteShift_)];
+    const int shift = (x & cellInByteMask_) * bits_;
+    byte = uint8_t((byte & ~(indexMask_ << shift)) | (index << shift));
+    return true;
+}
+
+void PackedCells::serialize(std::vector<uint8_t> &out) const {
+    out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+    out.push_back(kFormatVersion);
+    out.push_back(uint8_t(bits_));
+    out.push_back(uint8_t(palette_.size()));
+    out.push_back(0);
+    appendUint32(out, uint32_t(width_));
+    appendUint32(out, uint32_t(height_));
+    out.insert(out.end(), palette_.begin(), palette_.end());
+    out.insert(out.end(), cells_.begin(), cells_.end());
+}
+
+bool PackedCells::deserialize(const uint8_t *data, size_t size, PackedCells &outCells) {
+    if (size < kHeaderBytes || memcmp(data, kMagic, sizeof(kMagic)) != 0
+        || data[4] != kFormatVersion) {
+        return false;
+    }
+
+    const int bits = data[5];
+    const size_t paletteSize = data[6];
+    const uint32_t width = readUint32(data + 8);
+    const uint32_t height = readUint32(data + 12);
+    if ((bits != 2 && bits != 4) || paletteSize == 0 || paletteSize > (size_t(1) << bits)
+        || width > kMaxSide || height > kMaxSide) {
+        return false;
+    }
+    const size_t rowBytes = (size_t(width) * bits + 7) / 8;
+    if (size != kHeaderBytes + paletteSize + rowBytes * height) {
+        return false;
+    }
+
+    const uint8_t *palette = data + kHeaderBytes;
+    outCells.palette_.assign(palette, palette + paletteSize);
+    outCells.setLayout(int(width), int(height), bits);
+    outCells.updateTables();
+    memcpy(outCells.cells_.data(), palette + paletteSize, outCells.cells_.size());
+    return true;
+}
+
+size_t PackedCells::getMemoryBytes() const {
+    return sizeof(*this) + palette_.capacity() + cells_.capacity();
+}
+
+void PackedCells::setLayout(int width, int height, int bits) {
+    width_ = width > 0 ? width : 0;
+    height_ = height > 0 ? height : 0;
+    bits_ = bits;
+    cellsPerByteShift_ = bits == 2 ? 2 : 1;
+    cellInByteMask_ = (1 << cellsPerByteShift_) - 1;
+    indexMask_ = (1 << bits) - 1;
+    rowBytes_ = (size_t(width_) * bits + 7) / 8;
+    cells_.assign(rowBytes_ * height_, 0);
+}
+
+void PackedCells::updateTables() {
+    memset(indexOf_, kNoIndex, sizeof(indexOf_));
+    for (size_t i = 0; i < palette_.size(); i++) {
+        indexOf_[uint8_t(palette_[i])] = uint8_t(i);
+    }
+    for (int i = 0; i < kMaxPalette; i++) {
+        paletteTable_[i] = size_t(i) < palette_.size() ? palette_[i] : palette_[0];
+    }
+
+    const int cellsPerByte = 1 << cellsPerByteShift_;
+    for (int packed = 0; packed < 256; packed++) {
+        char cells[4] = {};
+        for (int i = 0; i < cellsPerByte; i++) {
+            cells[i] = paletteTable_[(packed >> (i * bits_)) & indexMask_];
+        }
+        memcpy(&expand_[packed], cells, sizeof(cells));
+    }
+}
+
+void PackedCells::widen() {
+    std::vector<char> cells(size_t(width_) * height_);
+    for (int y = 0; y < height_; y++) {
+        unpackRow(y, &cells[size_t(y) * width_]);
+    }
+    setLayout(width_, height_, 4);
+    updateTables();
+    for (int y = 0; y < height_; y++) {
+        packRow(y, &cells[size_t(y) * width_]);
+    }
+}
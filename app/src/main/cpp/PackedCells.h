@@ -0,0 +1,147 @@
+#ifndef SCROLLER_PACKEDCELLS_H
+#define SCROLLER_PACKEDCELLS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MapData.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define SCROLLER_PACK_NEON 1
+#elif defined(__SSE2__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define SCROLLER_PACK_SSE2 1
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define SCROLLER_PACK_SSSE3 1
+#endif
+#endif
+
+/*!
+ * Map cells packed into 2 or 4 bits each. A map only uses a handful of cell values, so cells store
+ * an index into a palette of up to 16 values, which makes the map 2-4x smaller than MapData in
+ * memory, on the network and in session logs.
+ *
+ * Whole rows are packed and unpacked with NEON on arm64 and SSE on x86, random access goes through
+ * get() and set(). Within a byte the first cell is in the lowest bits.
+ */
+class PackedCells {
+public:
+    //! The most values a map can use, the palette of 4 bit cells
+    static constexpr int kMaxPalette = 16;
+
+    PackedCells();
+
+    /*!
+     * Packs a map, with 2 bits per cell if it uses up to 4 values and 4 bits otherwise. Empty
+     * cells (' ') always get index 0.
+     * @return false if the map uses more than kMaxPalette values, @a outCells is left empty then
+     */
+    static bool pack(const MapData &map, PackedCells &outCells);
+
+    /*!
+     * Resizes to 2 bit cells that all hold @a fill
+     */
+    void reset(int width, int height, char fill = ' ');
+
+    /*!
+     * Writes every cell into @a outMap, resizing it
+     */
+    void unpack(MapData &outMap) const;
+
+    /*!
+     * Writes the @a width cells of row @a y into @a outCells
+     */
+    void unpackRow(int y, char *outCells) const;
+
+    /*!
+     * Replaces row @a y with @a cells
+     * @return false if a cell is not in the palette, the row is partly written then
+     */
+    bool packRow(int y, const char *cells);
+
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    inline int getBitsPerCell() const { return bits_; }
+
+    inline const std::vector<char> &getPalette() const { return palette_; }
+
+    //! Bytes of one packed row, rows are stored without padding between them
+    inline size_t getRowBytes() const { return rowBytes_; }
+
+    inline const uint8_t *getRow(int y) const { return &cells_[size_t(y) * rowBytes_]; }
+
+    /*!
+     * @return the cell at a position, which has to be in bounds
+     */
+    inline char get(int x, int y) const {
+        const uint8_t byte = cells_[size_t(y) * rowBytes_ + (x >> cellsPerByteShift_)];
+        const int shift = (x & cellInByteMask_) * bits_;
+        return paletteTable_[(byte >> shift) & indexMask_];
+    }
+
+    /*!
+     * Changes the cell at a position, which has to be in bounds. A value that is not in the palette
+     * yet is added, which repacks the map once if it outgrows 2 bit cells.
+     * @return false if the palette is full
+     */
+    bool set(int x, int y, char value);
+
+    /*!
+     * Appends the network and session log form: "PCEL", a version byte, bits per cell, palette
+     * size, a zero byte, width and height as little endian uint32, the palette and the rows.
+     */
+    void serialize(std::vector<uint8_t> &out) const;
+
+    /*!
+     * Reads what serialize() wrote
+     * @return false if the data is truncated or malformed
+     */
+    static bool deserialize(const uint8_t *data, size_t size, PackedCells &outCells);
+
+    /*!
+     * @return the bytes of CPU memory held by the cells and lookup tables
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    static constexpr uint8_t kNoIndex = 0xff;
+
+    /*!
+     * Sets the cell width and sizes the rows, every cell becomes index 0
+     */
+    void setLayout(int width, int height, int bits);
+
+    /*!
+     * Rebuilds the lookup tables after the palette changed
+     */
+    void updateTables();
+
+    /*!
+     * Turns 2 bit cells into 4 bit cells, keeping their values
+     */
+    void widen();
+
+    int width_;
+    int height_;
+    //! 2 or 4
+    int bits_;
+    int cellsPerByteShift_;
+    int cellInByteMask_;
+    int indexMask_;
+    size_t rowBytes_;
+    std::vector<char> palette_;
+    std::vector<uint8_t> cells_;
+    //! the palette padded to kMaxPalette, indices past its end read as the first value
+    char paletteTable_[kMaxPalette];
+    //! palette index of every char value, kNoIndex if it is not in the palette
+    uint8_t indexOf_[256];
+    //! the cells of every packed byte value, used by the scalar unpack
+    uint32_t expand_[256];
+};
+
+#endif //SCROLLER_PACKEDCELLS_H
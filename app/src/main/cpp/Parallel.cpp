@@ -0,0 +1,17 @@
+#include "Parallel.h"
+
+#include "JobSystem.h"
+
+void Parallel::forEachSlice(int count, bool parallel,
+                            const std::function<void(int begin, int end)> &work) {
+    JobSystem &jobs = JobSystem::instance();
+    const int threadCount = parallel ? jobs.getThreadCount() : 1;
+    if (threadCount == 1 || count < threadCount) {
+        work(0, count);
+        return;
+    }
+
+    // One slice per thread, the waiting thread works on them too
+    const int slice = (count + threadCount - 1) / threadCount;
+    jobs.wait(jobs.parallelFor(count, slice, work));
+}
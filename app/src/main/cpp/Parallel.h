@@ -0,0 +1,27 @@
+#ifndef SCROLLER_PARALLEL_H
+#define SCROLLER_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+/*!
+ * Splits loops over map rows or columns across the cores, for the passes that rebuild whole maps.
+ * The slices run as JobSystem jobs, so this may be called from inside a job as well.
+ */
+namespace Parallel {
+    /*!
+     * Maps with fewer cells are rebuilt on the calling thread, scheduling the slices would cost
+     * more than it saves. One threshold for every pass, they all do a little work per cell.
+     */
+    constexpr size_t kMinCells = 512 * 512;
+
+    /*!
+     * Calls @a work on consecutive slices [begin, end) of [0, count) and returns once all of them
+     * ran. The calling thread works on the slices while it waits.
+     * @param parallel false runs everything on the calling thread, for work too small to be worth
+     *                 starting threads
+     */
+    void forEachSlice(int count, bool parallel, const std::function<void(int begin, int end)> &work);
+}
+
+#endif //SCROLLER_PARALLEL_H
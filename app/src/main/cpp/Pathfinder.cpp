@@ -0,0 +1,161 @@
+#include "Pathfinder.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "Trace.h"
+
+/*!
+ * Move costs scaled by ten so diagonal steps can stay integer (14 ~ 10 * sqrt(2))
+ */
+static constexpr uint32_t kStraightCost = 10;
+static constexpr uint32_t kDiagonalCost = 14;
+
+static constexpr uint32_t kNoParent = UINT32_MAX;
+
+/*!
+ * The default search limit, enough to cross a 1024x1024 map with obstacles
+ */
+static constexpr int kDefaultMaxExpandedNodes = 1 << 20;
+
+static inline uint32_t octileDistance(int x0, int y0, int x1, int y1) {
+    uint32_t dx = std::abs(x1 - x0);
+    uint32_t dy = std::abs(y1 - y0);
+    return kStraightCost * std::max(dx, dy) + (kDiagonalCost - kStraightCost) * std::min(dx, dy);
+}
+
+Pathfinder::Pathfinder()
+        : maxExpandedNodes_(kDefaultMaxExpandedNodes),
+          lastExpandedNodes_(0),
+          currentGeneration_(0) {}
+
+bool Pathfinder::isWalkable(const MapData &map, int x, int y) {
+    if (x < 0 || x >= map.width || y < 0 || y >= map.height) {
+        return false;
+    }
+    char cell = map.data[y * map.width + x];
+    return cell != 'o' && cell != 'O' && cell != 'x' && cell != 'X';
+}
+
+bool Pathfinder::findPath(
+        const MapData &map,
+        int startX,
+        int startY,
+        int goalX,
+        int goalY,
+        std::vector<std::pair<int, int>> &outPath) {
+    SCROLLER_TRACE_SCOPE("Pathfinder::findPath");
+    outPath.clear();
+    lastExpandedNodes_ = 0;
+
+    if (startX < 0 || startX >= map.width || startY < 0 || startY >= map.height
+        || !isWalkable(map, goalX, goalY)) {
+        return false;
+    }
+    if (startX == goalX && startY == goalY) {
+        return true;
+    }
+
+    const size_t cellCount = size_t(map.width) * map.height;
+    if (generation_.size() != cellCount) {
+        generation_.assign(cellCount, 0);
+        cost_.resize(cellCount);
+        parent_.resize(cellCount);
+        closed_.resize(cellCount);
+        currentGeneration_ = 0;
+    }
+    if (++currentGeneration_ == 0) {
+        // wrapped around, old stamps could look current again
+        std::fill(generation_.begin(), generation_.end(), 0);
+        currentGeneration_ = 1;
+    }
+    open_.clear();
+
+    const uint32_t startIndex = uint32_t(startY) * map.width + startX;
+    const uint32_t goalIndex = uint32_t(goalY) * map.width + goalX;
+
+    generation_[startIndex] = currentGeneration_;
+    cost_[startIndex] = 0;
+    parent_[startIndex] = kNoParent;
+    closed_[startIndex] = 0;
+    pushOpen({octileDistance(startX, startY, goalX, goalY), startIndex});
+
+    static constexpr int kNeighborX[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+    static constexpr int kNeighborY[8] = {-1, 0, 1, 0, -1, 1, 1, -1};
+
+    bool found = false;
+    while (!open_.empty() && lastExpandedNodes_ < maxExpandedNodes_) {
+        OpenNode node = popOpen();
+        if (closed_[node.index]) {
+            // stale entry, a cheaper one was already expanded
+            continue;
+        }
+        if (node.index == goalIndex) {
+            found = true;
+            break;
+        }
+        closed_[node.index] = 1;
+        lastExpandedNodes_++;
+
+        const int x = node.index % map.width;
+        const int y = node.index / map.width;
+        for (int direction = 0; direction < 8; direction++) {
+            const int nx = x + kNeighborX[direction];
+            const int ny = y + kNeighborY[direction];
+            if (!isWalkable(map, nx, ny)) {
+                continue;
+            }
+
+            const bool diagonal = direction >= 4;
+            if (diagonal && (!isWalkable(map, nx, y) || !isWalkable(map, x, ny))) {
+                // no squeezing between two blocked cells
+                continue;
+            }
+
+            const uint32_t neighbor = uint32_t(ny) * map.width + nx;
+            const uint32_t newCost = cost_[node.index] + (diagonal ? kDiagonalCost : kStraightCost);
+            if (generation_[neighbor] != currentGeneration_) {
+                generation_[neighbor] = currentGeneration_;
+                closed_[neighbor] = 0;
+            } else if (closed_[neighbor] || newCost >= cost_[neighbor]) {
+                continue;
+            }
+
+            cost_[neighbor] = newCost;
+            parent_[neighbor] = node.index;
+            pushOpen({newCost + octileDistance(nx, ny, goalX, goalY), neighbor});
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    for (uint32_t index = goalIndex; index != startIndex; index = parent_[index]) {
+        outPath.emplace_back(index % map.width, index / map.width);
+    }
+    std::reverse(outPath.begin(), outPath.end());
+    return true;
+}
+
+size_t Pathfinder::getMemoryBytes() const {
+    return (generation_.capacity() + cost_.capacity() + parent_.capacity()) * sizeof(uint32_t)
+           + closed_.capacity() * sizeof(uint8_t)
+           + open_.capacity() * sizeof(OpenNode);
+}
+
+void Pathfinder::pushOpen(OpenNode node) {
+    open_.push_back(node);
+    std::push_heap(open_.begin(), open_.end(), [](const OpenNode &a, const OpenNode &b) {
+        return a.estimate > b.estimate;
+    });
+}
+
+Pathfinder::OpenNode Pathfinder::popOpen() {
+    std::pop_heap(open_.begin(), open_.end(), [](const OpenNode &a, const OpenNode &b) {
+        return a.estimate > b.estimate;
+    });
+    OpenNode node = open_.back();
+    open_.pop_back();
+    return node;
+}
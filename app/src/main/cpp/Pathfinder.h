@@ -0,0 +1,80 @@
+#ifndef SCROLLER_PATHFINDER_H
+#define SCROLLER_PATHFINDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "MapData.h"
+
+/*!
+ * A* search over the map grid. Units move in eight directions, objects and other tanks block the
+ * way and diagonal moves may not cut the corner of a blocked cell.
+ *
+ * The search buffers are kept between calls so repeated queries on the same map do not allocate.
+ */
+class Pathfinder {
+public:
+    Pathfinder();
+
+    /*!
+     * Finds the shortest path between two cells.
+     * @param map the map to search
+     * @param startX the column the search starts from, this cell is never part of the path
+     * @param startY the row the search starts from
+     * @param goalX the destination column, has to be an empty cell
+     * @param goalY the destination row
+     * @param outPath receives the cells to visit, in order, ending with the goal
+     * @return true if a path was found
+     */
+    bool findPath(
+            const MapData &map,
+            int startX,
+            int startY,
+            int goalX,
+            int goalY,
+            std::vector<std::pair<int, int>> &outPath);
+
+    /*!
+     * @return true if a unit may stand on the given cell
+     */
+    static bool isWalkable(const MapData &map, int x, int y);
+
+    /*!
+     * Limits how many cells a single search may expand, so unreachable goals on huge maps fail in
+     * bounded time.
+     */
+    inline void setMaxExpandedNodes(int maxExpandedNodes) { maxExpandedNodes_ = maxExpandedNodes; }
+
+    inline int getLastExpandedNodes() const { return lastExpandedNodes_; }
+
+    /*!
+     * @return the bytes of CPU memory held by the search buffers
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    struct OpenNode {
+        uint32_t estimate;
+        uint32_t index;
+    };
+
+    void pushOpen(OpenNode node);
+    OpenNode popOpen();
+
+    int maxExpandedNodes_;
+    int lastExpandedNodes_;
+
+    // Per cell search state, stamped with a generation so it does not need clearing between searches
+    std::vector<uint32_t> generation_;
+    std::vector<uint32_t> cost_;
+    std::vector<uint32_t> parent_;
+    std::vector<uint8_t> closed_;
+    uint32_t currentGeneration_;
+
+    // Binary min-heap of open nodes
+    std::vector<OpenNode> open_;
+};
+
+#endif //SCROLLER_PATHFINDER_H
@@ -0,0 +1,382 @@
+#include "RegionLabeler.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "Parallel.h"
+#include "Trace.h"
+
+//! The eight neighbours of a cell in ring order, the even ones share an edge with the cell
+static constexpr int kRingX[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+static constexpr int kRingY[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+
+RegionLabeler::RegionLabeler() : searchEpoch_(0) {
+    clear();
+}
+
+bool RegionLabeler::isOpen(char cell) {
+    // Matches Pathfinder::isWalkable
+    return cell != 'o' && cell != 'O' && cell != 'x' && cell != 'X';
+}
+
+void RegionLabeler::rebuild(const MapData &map) {
+    SCROLLER_TRACE_SCOPE("RegionLabeler::rebuild");
+    width_ = map.width;
+    height_ = map.height;
+    labels_.resize(size_t(width_) * height_);
+    for (size_t i = 0; i < labels_.size(); i++) {
+        labels_[i] = isOpen(map.data[i]) ? 1 : kNoRegion;
+    }
+    relabel();
+}
+
+void RegionLabeler::clear() {
+    width_ = 0;
+    height_ = 0;
+    regionCount_ = 0;
+    needsRebuild_ = false;
+    labels_ = {};
+    parents_ = {kNoRegion};
+    sizes_ = {0};
+    marks_ = {};
+    searchEpoch_ = 0;
+}
+
+void RegionLabeler::setCell(int x, int y, char value) {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+        return;
+    }
+    if (isOpen(value)) {
+        openCell(x, y);
+    } else {
+        closeCell(x, y);
+    }
+}
+
+void RegionLabeler::flush() {
+    if (needsRebuild_) {
+        SCROLLER_TRACE_SCOPE("RegionLabeler::flush");
+        relabel();
+    }
+}
+
+uint32_t RegionLabeler::getRegion(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+        return kNoRegion;
+    }
+    return findRoot(labels_[getIndex(x, y)]);
+}
+
+uint32_t RegionLabeler::getRegionSize(uint32_t region) const {
+    return region < sizes_.size() ? sizes_[region] : 0;
+}
+
+bool RegionLabeler::canReach(int fromX, int fromY, int toX, int toY) const {
+    const uint32_t goal = getRegion(toX, toY);
+    if (goal == kNoRegion) {
+        return false;
+    }
+    if (getRegion(fromX, fromY) == goal) {
+        return true;
+    }
+    for (int i = 0; i < 8; i += 2) {
+        if (getRegion(fromX + kRingX[i], fromY + kRingY[i]) == goal) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RegionLabeler::exportColors(const Rect &rect, uint32_t *outColors, int stride) const {
+    for (int y = rect.y0; y < rect.y1; y++) {
+        uint32_t *out = outColors + size_t(y - rect.y0) * stride;
+        for (int x = rect.x0; x < rect.x1; x++) {
+            const uint32_t region = findRoot(labels_[getIndex(x, y)]);
+            // A hash of the region picks the color, the top byte is alpha
+            out[x - rect.x0] = region == kNoRegion
+                               ? 0 : ((region * 2654435761u) & 0x00ffffffu) | 0x60000000u;
+        }
+    }
+}
+
+size_t RegionLabeler::getMemoryBytes() const {
+    size_t bytes = (labels_.capacity() + parents_.capacity() + sizes_.capacity()
+                    + marks_.capacity()) * sizeof(uint32_t);
+    for (const auto &search: searches_) {
+        bytes += (search.frontier.capacity() + search.visited.capacity()) * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+void RegionLabeler::relabel() {
+    const size_t cells = size_t(width_) * height_;
+    parents_.resize(cells + 1);
+    parents_[0] = kNoRegion;
+    marks_.assign(cells, 0);
+    searchEpoch_ = 0;
+    needsRebuild_ = false;
+
+    // Bands of rows are labelled on their own, then joined where they meet
+    const bool parallel = cells >= Parallel::kMinCells;
+    std::mutex bandsMutex;
+    std::vector<int> bandStarts;
+    Parallel::forEachSlice(height_, parallel, [this, &bandsMutex, &bandStarts](int begin, int end) {
+        labelRows(begin, end);
+        std::lock_guard<std::mutex> lock(bandsMutex);
+        bandStarts.push_back(begin);
+    });
+    for (int y: bandStarts) {
+        if (y == 0) {
+            continue;
+        }
+        for (int x = 0; x < width_; x++) {
+            const uint32_t index = getIndex(x, y);
+            if (labels_[index] != kNoRegion && labels_[index - width_] != kNoRegion) {
+                const uint32_t a = find(labels_[index]);
+                const uint32_t b = find(labels_[index - width_]);
+                parents_[std::max(a, b)] = std::min(a, b);
+            }
+        }
+    }
+
+    // Every cell gets its root, then every label points straight at it. The second pass only
+    // writes the labels of its own rows, so it can run while others read.
+    Parallel::forEachSlice(height_, parallel, [this](int begin, int end) {
+        for (uint32_t i = getIndex(0, begin); i < getIndex(0, end); i++) {
+            labels_[i] = findRoot(labels_[i]);
+        }
+    });
+    Parallel::forEachSlice(height_, parallel, [this](int begin, int end) {
+        for (uint32_t i = getIndex(0, begin); i < getIndex(0, end); i++) {
+            parents_[i + 1] = labels_[i] != kNoRegion ? labels_[i] : i + 1;
+        }
+    });
+
+    sizes_.assign(cells + 1, 0);
+    regionCount_ = 0;
+    for (uint32_t i = 0; i < cells; i++) {
+        if (labels_[i] != kNoRegion) {
+            sizes_[labels_[i]]++;
+            regionCount_ += labels_[i] == i + 1;
+        }
+    }
+}
+
+void RegionLabeler::labelRows(int firstRow, int lastRow) {
+    // Labels of these rows are cell index + 1, so bands never touch each other's parents
+    for (int y = firstRow; y < lastRow; y++) {
+        for (int x = 0; x < width_; x++) {
+            const uint32_t index = getIndex(x, y);
+            if (labels_[index] == kNoRegion) {
+                continue;
+            }
+            uint32_t root = index + 1;
+            labels_[index] = root;
+            parents_[root] = root;
+            if (x > 0 && labels_[index - 1] != kNoRegion) {
+                root = find(labels_[index - 1]);
+                parents_[index + 1] = root;
+            }
+            if (y > firstRow && labels_[index - width_] != kNoRegion) {
+                const uint32_t above = find(labels_[index - width_]);
+                if (above != root) {
+                    parents_[std::max(root, above)] = std::min(root, above);
+                }
+            }
+        }
+    }
+}
+
+uint32_t RegionLabeler::find(uint32_t label) {
+    while (parents_[label] != label) {
+        parents_[label] = parents_[parents_[label]];
+        label = parents_[label];
+    }
+    return label;
+}
+
+uint32_t RegionLabeler::findRoot(uint32_t label) const {
+    while (parents_[label] != label) {
+        label = parents_[label];
+    }
+    return label;
+}
+
+uint32_t RegionLabeler::unite(uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+        return a;
+    }
+    // The smaller region goes under the larger one, which keeps the trees flat
+    if (sizes_[a] < sizes_[b]) {
+        std::swap(a, b);
+    }
+    parents_[b] = a;
+    sizes_[a] += sizes_[b];
+    sizes_[b] = 0;
+    regionCount_--;
+    return a;
+}
+
+uint32_t RegionLabeler::newLabel() {
+    const auto label = uint32_t(parents_.size());
+    parents_.push_back(label);
+    sizes_.push_back(0);
+    // Labels only ever grow between rebuilds, compact them once they doubled
+    if (parents_.size() > 2 * labels_.size() + 64) {
+        needsRebuild_ = true;
+    }
+    return label;
+}
+
+void RegionLabeler::openCell(int x, int y) {
+    const uint32_t index = getIndex(x, y);
+    if (labels_[index] != kNoRegion) {
+        return;
+    }
+
+    uint32_t root = kNoRegion;
+    for (int i = 0; i < 8; i += 2) {
+        const int nx = x + kRingX[i];
+        const int ny = y + kRingY[i];
+        if (isOpenAt(nx, ny)) {
+            const uint32_t neighbour = labels_[getIndex(nx, ny)];
+            root = root == kNoRegion ? find(neighbour) : unite(root, neighbour);
+        }
+    }
+    if (root == kNoRegion) {
+        root = newLabel();
+        regionCount_++;
+    }
+    labels_[index] = root;
+    sizes_[root]++;
+}
+
+void RegionLabeler::closeCell(int x, int y) {
+    const uint32_t index = getIndex(x, y);
+    if (labels_[index] == kNoRegion) {
+        return;
+    }
+
+    const uint32_t root = find(labels_[index]);
+    labels_[index] = kNoRegion;
+    if (--sizes_[root] == 0) {
+        regionCount_--;
+        return;
+    }
+
+    // Runs of open cells around the ring are joined without the closed cell, so the cells that
+    // share an edge with it only need a search if they lie on different runs
+    bool ringOpen[8];
+    int start = -1;
+    for (int i = 0; i < 8; i++) {
+        ringOpen[i] = isOpenAt(x + kRingX[i], y + kRingY[i]);
+        if (!ringOpen[i]) {
+            start = i;
+        }
+    }
+    if (start < 0) {
+        return;
+    }
+
+    uint32_t seeds[4];
+    int seedCount = 0;
+    bool runHasSeed = false;
+    for (int step = 1; step <= 8; step++) {
+        const int i = (start + step) % 8;
+        if (!ringOpen[i]) {
+            runHasSeed = false;
+        } else if (i % 2 == 0 && !runHasSeed) {
+            seeds[seedCount++] = getIndex(x + kRingX[i], y + kRingY[i]);
+            runHasSeed = true;
+        }
+    }
+    if (seedCount > 1 && !splitRegion(seeds, seedCount)) {
+        needsRebuild_ = true;
+    }
+}
+
+bool RegionLabeler::splitRegion(const uint32_t *seeds, int seedCount) {
+    SCROLLER_TRACE_SCOPE("RegionLabeler::splitRegion");
+    if (searchEpoch_ > UINT32_MAX - 8) {
+        std::fill(marks_.begin(), marks_.end(), 0);
+        searchEpoch_ = 0;
+    }
+    searchEpoch_ += 4;
+
+    for (int side = 0; side < seedCount; side++) {
+        Search &search = searches_[side];
+        search.merged = side;
+        search.done = false;
+        search.frontier.assign(1, seeds[side]);
+        search.visited.assign(1, seeds[side]);
+        marks_[seeds[side]] = searchEpoch_ + side;
+    }
+    auto resolve = [this](int side) {
+        while (searches_[side].merged != side) {
+            side = searches_[side].merged;
+        }
+        return side;
+    };
+
+    // Every side takes one step in turn. A side that runs out of cells is cut off from the
+    // others, sides that meet are joined, and once one side is left it keeps the old label.
+    const uint32_t root = find(labels_[seeds[0]]);
+    int active = seedCount;
+    size_t searched = seedCount;
+    while (active > 1) {
+        for (int side = 0; side < seedCount && active > 1; side++) {
+            Search &search = searches_[side];
+            if (search.merged != side || search.done) {
+                continue;
+            }
+            if (search.frontier.empty()) {
+                const uint32_t label = newLabel();
+                for (uint32_t cell: search.visited) {
+                    labels_[cell] = label;
+                }
+                sizes_[label] = uint32_t(search.visited.size());
+                sizes_[root] -= sizes_[label];
+                regionCount_++;
+                search.done = true;
+                active--;
+                continue;
+            }
+
+            const uint32_t cell = search.frontier.back();
+            search.frontier.pop_back();
+            const int cellX = int(cell % uint32_t(width_));
+            const int cellY = int(cell / uint32_t(width_));
+            for (int i = 0; i < 8; i += 2) {
+                const int nx = cellX + kRingX[i];
+                const int ny = cellY + kRingY[i];
+                if (!isOpenAt(nx, ny)) {
+                    continue;
+                }
+                const uint32_t neighbour = getIndex(nx, ny);
+                const uint32_t mark = marks_[neighbour];
+                if (mark >= searchEpoch_ && mark < searchEpoch_ + 4) {
+                    const int other = resolve(int(mark - searchEpoch_));
+                    if (other != side) {
+                        Search &joined = searches_[other];
+                        joined.merged = side;
+                        search.frontier.insert(search.frontier.end(), joined.frontier.begin(),
+                                               joined.frontier.end());
+                        search.visited.insert(search.visited.end(), joined.visited.begin(),
+                                              joined.visited.end());
+                        active--;
+                    }
+                    continue;
+                }
+                marks_[neighbour] = searchEpoch_ + side;
+                search.frontier.push_back(neighbour);
+                search.visited.push_back(neighbour);
+                if (++searched > size_t(kMaxSearchCells)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,170 @@
+#ifndef SCROLLER_REGIONLABELER_H
+#define SCROLLER_REGIONLABELER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MapData.h"
+
+/*!
+ * Connected regions of open cells, the cells Pathfinder::isWalkable accepts, for reachability
+ * checks and territory scoring. Two open cells share a region if a path of open cells joins them,
+ * moving up, down, left or right.
+ *
+ * rebuild() labels the map with union-find, in bands of rows on several threads, then joins the
+ * bands along their seams. Afterwards a cell that opens joins the regions around it in near
+ * constant time. A cell that closes can split its region: when the cells around it are not joined
+ * through its eight neighbours, a search runs from each side at once until all but one side is
+ * fully explored, and the explored sides get new labels. Searches give up after kMaxSearchCells
+ * and leave a full rebuild to the next flush().
+ */
+class RegionLabeler {
+public:
+    //! The region of closed cells
+    static constexpr uint32_t kNoRegion = 0;
+    //! Cells a split search may visit before a full rebuild is cheaper
+    static constexpr int kMaxSearchCells = 8192;
+
+    struct Rect {
+        int x0, y0, x1, y1; // inclusive-exclusive cell bounds
+
+        inline bool empty() const { return x1 <= x0 || y1 <= y0; }
+    };
+
+    RegionLabeler();
+
+    /*!
+     * @return true if units can drive through a cell with this value
+     */
+    static bool isOpen(char cell);
+
+    /*!
+     * Labels every cell of a map
+     */
+    void rebuild(const MapData &map);
+
+    /*!
+     * Frees the labels, every cell is closed until the next rebuild()
+     */
+    void clear();
+
+    /*!
+     * Updates the regions after a cell changed. Cells outside the map are ignored.
+     */
+    void setCell(int x, int y, char value);
+
+    /*!
+     * Rebuilds the labels if a split search gave up since the last call
+     */
+    void flush();
+
+    /*!
+     * @return the region of a cell, kNoRegion for closed cells and cells outside the map. Ids stay
+     *         the same until the next change.
+     */
+    uint32_t getRegion(int x, int y) const;
+
+    /*!
+     * @return the number of cells in a region
+     */
+    uint32_t getRegionSize(uint32_t region) const;
+
+    inline int getRegionCount() const { return regionCount_; }
+
+    /*!
+     * @return true if a unit standing on one cell can drive to another. The start cell may be
+     *         closed, as the unit standing on it closes it.
+     */
+    bool canReach(int fromX, int fromY, int toX, int toY) const;
+
+    /*!
+     * Writes a color per cell for tinting regions, RGBA8 with the same color for every cell of a
+     * region and transparent closed cells
+     * @param outColors destination for the first row of @a rect
+     * @param stride texels between two rows in @a outColors
+     */
+    void exportColors(const Rect &rect, uint32_t *outColors, int stride) const;
+
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    inline bool isEmpty() const { return width_ == 0 || height_ == 0; }
+
+    /*!
+     * @return the bytes of CPU memory held by the labels
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    //! A search from one side of a closed cell
+    struct Search {
+        //! the side this search was merged into, or itself
+        int merged;
+        bool done;
+        std::vector<uint32_t> frontier;
+        std::vector<uint32_t> visited;
+    };
+
+    /*!
+     * Labels every open cell from scratch, cells with a label are open
+     */
+    void relabel();
+
+    /*!
+     * Labels rows [firstRow, lastRow) on their own, with cell index + 1 as the first label of
+     * every cell
+     */
+    void labelRows(int firstRow, int lastRow);
+
+    /*!
+     * Finds the root label, halving the path on the way
+     */
+    uint32_t find(uint32_t label);
+
+    uint32_t findRoot(uint32_t label) const;
+
+    /*!
+     * Joins two regions
+     * @return the root of the joined region
+     */
+    uint32_t unite(uint32_t a, uint32_t b);
+
+    uint32_t newLabel();
+
+    void openCell(int x, int y);
+
+    void closeCell(int x, int y);
+
+    /*!
+     * Splits off the sides of a closed cell that are no longer joined
+     * @param seeds open neighbours of the closed cell in separate groups
+     * @return false if the search gave up
+     */
+    bool splitRegion(const uint32_t *seeds, int seedCount);
+
+    inline uint32_t getIndex(int x, int y) const { return uint32_t(y) * uint32_t(width_) + x; }
+
+    inline bool isOpenAt(int x, int y) const {
+        return x >= 0 && y >= 0 && x < width_ && y < height_
+               && labels_[getIndex(x, y)] != kNoRegion;
+    }
+
+    int width_;
+    int height_;
+    int regionCount_;
+    bool needsRebuild_;
+    //! the label of every cell, kNoRegion for closed cells
+    std::vector<uint32_t> labels_;
+    //! union-find parent of every label, roots are their own parent
+    std::vector<uint32_t> parents_;
+    //! the cell count of every root label
+    std::vector<uint32_t> sizes_;
+    //! which search visited a cell, searchEpoch_ plus the side
+    std::vector<uint32_t> marks_;
+    uint32_t searchEpoch_;
+    Search searches_[4];
+};
+
+#endif //SCROLLER_REGIONLABELER_H
@@ -0,0 +1,213 @@
+#include "RegionStats.h"
+
+#include <algorithm>
+
+#include "Parallel.h"
+#include "Trace.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCROLLER_STATS_NEON 1
+#elif defined(__SSE2__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define SCROLLER_STATS_SSE2 1
+#endif
+
+RegionStats::RegionStats() {
+    clear();
+}
+
+RegionStats::Type RegionStats::classify(char cell) {
+    switch (cell) {
+        case 'x':
+        case 'X':
+            return kTypeTank;
+        case 'o':
+        case 'O':
+            return kTypeObject;
+        case '1':
+            return kTypeGreen;
+        case '2':
+            return kTypeBlue;
+        case '3':
+            return kTypeYellow;
+        default:
+            return kTypeCount;
+    }
+}
+
+void RegionStats::rebuild(const MapData &map) {
+    SCROLLER_TRACE_SCOPE("RegionStats::rebuild");
+    width_ = map.width;
+    height_ = map.height;
+    stride_ = size_t(width_) + 1;
+    types_.resize(size_t(width_) * height_);
+    for (size_t i = 0; i < types_.size(); i++) {
+        types_[i] = classify(map.data[i]);
+    }
+    for (auto &sums: sums_) {
+        // Row 0 and column 0 stay zero
+        sums.assign(stride_ * (height_ + 1), 0);
+    }
+    pending_.clear();
+    rebuildRows(0);
+}
+
+void RegionStats::clear() {
+    width_ = 0;
+    height_ = 0;
+    stride_ = 1;
+    types_ = {};
+    for (auto &sums: sums_) {
+        sums = {0};
+    }
+    pending_.clear();
+    dirtyRow_ = 0;
+}
+
+void RegionStats::setCell(int x, int y, char value) {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+        return;
+    }
+    const size_t index = size_t(y) * width_ + x;
+    const Type before = Type(types_[index]);
+    const Type after = classify(value);
+    if (before == after) {
+        return;
+    }
+
+    types_[index] = after;
+    if (before != kTypeCount) {
+        pending_.push_back({x, y, before, -1});
+    }
+    if (after != kTypeCount) {
+        pending_.push_back({x, y, after, 1});
+    }
+    dirtyRow_ = std::min(dirtyRow_, y);
+    if (pending_.size() > kMaxPendingEdits) {
+        flush();
+    }
+}
+
+void RegionStats::flush() {
+    if (pending_.empty()) {
+        return;
+    }
+    SCROLLER_TRACE_SCOPE("RegionStats::flush");
+    rebuildRows(dirtyRow_);
+    pending_.clear();
+}
+
+uint32_t RegionStats::count(Type type, int x0, int y0, int x1, int y1) const {
+    x0 = std::clamp(x0, 0, width_);
+    x1 = std::clamp(x1, 0, width_);
+    y0 = std::clamp(y0, 0, height_);
+    y1 = std::clamp(y1, 0, height_);
+    if (x1 <= x0 || y1 <= y0) {
+        return 0;
+    }
+
+    // Differences wrap around in uint32_t, which gives the right count
+    const std::vector<uint32_t> &sums = sums_[type];
+    uint32_t total = sums[getIndex(x1, y1)] - sums[getIndex(x1, y0)] - sums[getIndex(x0, y1)]
+                     + sums[getIndex(x0, y0)];
+    for (const Edit &edit: pending_) {
+        if (edit.type == type && edit.x >= x0 && edit.x < x1 && edit.y >= y0 && edit.y < y1) {
+            total += uint32_t(edit.delta);
+        }
+    }
+    return total;
+}
+
+size_t RegionStats::getMemoryBytes() const {
+    size_t bytes = types_.capacity() + pending_.capacity() * sizeof(Edit);
+    for (const auto &sums: sums_) {
+        bytes += sums.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+void RegionStats::rebuildRows(int firstRow) {
+    const int rows = height_ - firstRow;
+    const bool parallel = size_t(rows) * width_ >= Parallel::kMinCells;
+    if (rows > 0) {
+        // Rows are independent in the first pass and columns in the second
+        for (int type = 0; type < kTypeCount; type++) {
+            Parallel::forEachSlice(rows, parallel, [this, type, firstRow](int begin, int end) {
+                scanRows(Type(type), firstRow + begin, firstRow + end);
+            });
+            Parallel::forEachSlice(width_, parallel, [this, type, firstRow](int begin, int end) {
+                accumulateColumns(Type(type), firstRow, begin, end);
+            });
+        }
+    }
+    dirtyRow_ = height_;
+}
+
+void RegionStats::scanRows(Type type, int firstRow, int lastRow) {
+    for (int y = firstRow; y < lastRow; y++) {
+        const uint8_t *types = &types_[size_t(y) * width_];
+        // Table row y + 1 holds the cells of map row y, column 0 is the zero column
+        uint32_t *out = &sums_[type][getIndex(1, y + 1)];
+        uint32_t running = 0;
+        int x = 0;
+
+        // 16 cells per iteration: compare, widen to four registers of 32 bit lanes and turn each
+        // into a prefix sum with two shifted adds
+#if SCROLLER_STATS_NEON
+        const uint8x16_t match = vdupq_n_u8(type);
+        const uint8x16_t one = vdupq_n_u8(1);
+        const uint32x4_t zero = vdupq_n_u32(0);
+        for (; x + 16 <= width_; x += 16) {
+            const uint8x16_t hits = vandq_u8(vceqq_u8(vld1q_u8(types + x), match), one);
+            const uint16x8_t low = vmovl_u8(vget_low_u8(hits));
+            const uint16x8_t high = vmovl_u8(vget_high_u8(hits));
+            const uint32x4_t quads[4] = {vmovl_u16(vget_low_u16(low)), vmovl_u16(vget_high_u16(low)),
+                                         vmovl_u16(vget_low_u16(high)), vmovl_u16(vget_high_u16(high))};
+            for (int i = 0; i < 4; i++) {
+                uint32x4_t sum = vaddq_u32(quads[i], vextq_u32(zero, quads[i], 3));
+                sum = vaddq_u32(sum, vextq_u32(zero, sum, 2));
+                sum = vaddq_u32(sum, vdupq_n_u32(running));
+                vst1q_u32(out + x + i * 4, sum);
+                running = vgetq_lane_u32(sum, 3);
+            }
+        }
+#elif SCROLLER_STATS_SSE2
+        const __m128i match = _mm_set1_epi8(char(type));
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 16 <= width_; x += 16) {
+            const __m128i cells = _mm_loadu_si128(reinterpret_cast<const __m128i *>(types + x));
+            const __m128i hits = _mm_and_si128(_mm_cmpeq_epi8(cells, match), one);
+            const __m128i low = _mm_unpacklo_epi8(hits, zero);
+            const __m128i high = _mm_unpackhi_epi8(hits, zero);
+            const __m128i quads[4] = {_mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+                                      _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)};
+            for (int i = 0; i < 4; i++) {
+                __m128i sum = _mm_add_epi32(quads[i], _mm_slli_si128(quads[i], 4));
+                sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+                sum = _mm_add_epi32(sum, _mm_set1_epi32(int(running)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x + i * 4), sum);
+                running = uint32_t(_mm_cvtsi128_si32(_mm_shuffle_epi32(sum, 0xff)));
+            }
+        }
+#endif
+
+        for (; x < width_; x++) {
+            running += types[x] == type;
+            out[x] = running;
+        }
+    }
+}
+
+void RegionStats::accumulateColumns(Type type, int firstRow, int firstColumn, int lastColumn) {
+    std::vector<uint32_t> &sums = sums_[type];
+    // Column 0 is all zeros, the slices cover the map columns at table columns 1 to width
+    for (int y = firstRow; y < height_; y++) {
+        const uint32_t *above = &sums[getIndex(1, y)];
+        uint32_t *row = &sums[getIndex(1, y + 1)];
+        for (int x = firstColumn; x < lastColumn; x++) {
+            row[x] += above[x];
+        }
+    }
+}
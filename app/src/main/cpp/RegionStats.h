@@ -0,0 +1,116 @@
+#ifndef SCROLLER_REGIONSTATS_H
+#define SCROLLER_REGIONSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MapData.h"
+
+/*!
+ * Counts of each kind of cell in any rectangle of the map in O(1), for box selection and sector
+ * overlays. Every kind has a summed-area table, (width + 1) x (height + 1) running totals, so a
+ * rectangle is four lookups.
+ *
+ * rebuild() scans rows with NEON or SSE2 prefix sums, on several threads for large maps. Cell edits
+ * are kept in a short list that count() adds on top of the tables, and once the list is full the
+ * tables are rebuilt from the first edited row down.
+ */
+class RegionStats {
+public:
+    enum Type : uint8_t {
+        kTypeTank,
+        kTypeObject,
+        kTypeGreen,
+        kTypeBlue,
+        kTypeYellow,
+        kTypeCount,
+    };
+
+    //! Cell edits count() adds up before the tables are rebuilt
+    static constexpr size_t kMaxPendingEdits = 64;
+
+    RegionStats();
+
+    /*!
+     * @return the type of a cell value, kTypeCount for empty cells, which are not counted
+     */
+    static Type classify(char cell);
+
+    /*!
+     * Rebuilds every table from a map, e.g. after it was loaded
+     */
+    void rebuild(const MapData &map);
+
+    /*!
+     * Frees the tables, counts are 0 until the next rebuild()
+     */
+    void clear();
+
+    /*!
+     * Notes that a cell changed, cheap until kMaxPendingEdits edits piled up. Cells outside the
+     * tables are ignored.
+     */
+    void setCell(int x, int y, char value);
+
+    /*!
+     * Applies the pending edits to the tables
+     */
+    void flush();
+
+    /*!
+     * @return how many cells of @a type are in the rectangle, bounds are inclusive-exclusive and
+     *         clamped to the map
+     */
+    uint32_t count(Type type, int x0, int y0, int x1, int y1) const;
+
+    inline uint32_t getTotal(Type type) const { return count(type, 0, 0, width_, height_); }
+
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    /*!
+     * @return the bytes of CPU memory held by the tables
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    struct Edit {
+        int x;
+        int y;
+        Type type;
+        int delta;
+    };
+
+    /*!
+     * Recomputes the tables below @a firstRow from types_
+     */
+    void rebuildRows(int firstRow);
+
+    /*!
+     * Writes the prefix sums of rows [firstRow, lastRow) of one type, without the rows above
+     */
+    void scanRows(Type type, int firstRow, int lastRow);
+
+    /*!
+     * Adds each table row to the one below it, from @a firstRow down, in columns
+     * [firstColumn, lastColumn)
+     */
+    void accumulateColumns(Type type, int firstRow, int firstColumn, int lastColumn);
+
+    inline size_t getIndex(int x, int y) const { return size_t(y) * stride_ + x; }
+
+    int width_;
+    int height_;
+    //! width_ + 1
+    size_t stride_;
+    //! the type of every cell
+    std::vector<uint8_t> types_;
+    std::vector<uint32_t> sums_[kTypeCount];
+    std::vector<Edit> pending_;
+    //! the first row with a pending edit
+    int dirtyRow_;
+};
+
+#endif //SCROLLER_REGIONSTATS_H
@@ -2,20 +2,43 @@
 
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <GLES3/gl3.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <memory>
 #include <vector>
 #include <android/bitmap.h>
 #include <jni.h>
 #include <cmath>
 
+#include "AllocationTracker.h"
 #include "AndroidOut.h"
+#include "GridLayout.h"
+#include "GridMesh.h"
+#include "JobSystem.h"
+#include "MapGeneration.h"
+#include "Metrics.h"
 #include "Shader.h"
 #include "Utility.h"
 #include "NetworkDownloader.h"
+#include "OverlayTexture.h"
+#include "SessionRecording.h"
+#include "SimulationClock.h"
+#include "StartupTimeline.h"
+#include "TileStore.h"
+#include "Trace.h"
 
 //! executes glGetString and outputs the result to logcat
 #define PRINT_GL_STRING(s) {aout << #s": "<< glGetString(s) << std::endl;}
 
+/*!
+ * Every GL extension is logged at startup only when the build asks for it, the list runs to a few
+ * hundred lines on most devices.
+ */
+#ifndef SCROLLER_LOG_GL_EXTENSIONS
+#define SCROLLER_LOG_GL_EXTENSIONS 0
+#endif
+
 /*!
  * @brief if glGetString returns a space separated list of elements, prints each one on a new line
  *
@@ -45,12 +68,11 @@ in vec3 inColor;
 
 out vec3 fragColor;
 
-uniform mat4 uModel;
-uniform mat4 uProjection;
+uniform mat4 uViewProjection;
 
 void main() {
     fragColor = inColor;
-    gl_Position = uProjection * uModel * vec4(inPosition, 1.0);
+    gl_Position = uViewProjection * vec4(inPosition, 1.0);
 }
 )vertex";
 
@@ -74,12 +96,11 @@ in vec2 inTexCoord;
 
 out vec2 fragTexCoord;
 
-uniform mat4 uModel;
-uniform mat4 uProjection;
+uniform mat4 uViewProjection;
 
 void main() {
     fragTexCoord = inTexCoord;
-    gl_Position = uProjection * uModel * vec4(inPosition, 1.0);
+    gl_Position = uViewProjection * vec4(inPosition, 1.0);
 }
 )vertex";
 
@@ -98,6 +119,38 @@ void main() {
 }
 )fragment";
 
+// Fragment shader for the fog of war overlay, darkens cells by the team visibility mask
+static const char *fogFragment = R"fragment(#version 300 es
+precision mediump float;
+
+in vec2 fragTexCoord;
+
+out vec4 outColor;
+
+uniform sampler2D uTexture;
+
+void main() {
+    float visibility = texture(uTexture, fragTexCoord).r;
+    outColor = vec4(0.0, 0.0, 0.0, 0.85 * (1.0 - visibility));
+}
+)fragment";
+
+// Fragment shader for the heat map overlay, tints cells where tanks cluster from yellow to red
+static const char *heatFragment = R"fragment(#version 300 es
+precision mediump float;
+
+in vec2 fragTexCoord;
+
+out vec4 outColor;
+
+uniform sampler2D uTexture;
+
+void main() {
+    float heat = texture(uTexture, fragTexCoord).r;
+    outColor = vec4(1.0, 0.9 - 0.7 * heat, 0.1, 0.6 * heat);
+}
+)fragment";
+
 /*!
  * Half the height of the projection matrix. This gives you a renderable area of height 4 ranging
  * from -2 to 2
@@ -116,7 +169,164 @@ static constexpr float kProjectionNearPlane = -1.f;
  */
 static constexpr float kProjectionFarPlane = 1.f;
 
+/*!
+ * Sessions are recorded in debug builds unless the build says otherwise. Recording costs a buffered
+ * write per input event and frame.
+ */
+#ifndef SCROLLER_RECORD_SESSIONS
+#ifdef NDEBUG
+#define SCROLLER_RECORD_SESSIONS 0
+#else
+#define SCROLLER_RECORD_SESSIONS 1
+#endif
+#endif
+
+/*!
+ * Session log names inside the app's internal data directory. Pushing a recording to the replay
+ * name (e.g. with adb) makes the next start replay it instead of going online.
+ */
+static constexpr char kRecordingFileName[] = "last_session.srec";
+static constexpr char kReplayFileName[] = "replay.srec";
+static constexpr char kReplayReportFileName[] = "replay_timings.txt";
+
+/*!
+ * Metrics are written here (inside the internal data directory) when a replay ends and on
+ * shutdown. Debug builds also serve them on this local port, reachable through adb forward.
+ */
+static constexpr char kMetricsFileName[] = "metrics.json";
+static constexpr int kMetricsPort = 8686;
+
+/*!
+ * Maps too large for a mesh are streamed from a tile file in the internal data directory. A map
+ * being built writes the next file while the current map may still be reading from its own.
+ */
+static constexpr char kTileFileName[] = "map.tiles";
+static constexpr char kNextTileFileName[] = "map.tiles.next";
+
+/*!
+ * The tanks server. A first line in the server file (inside the internal data directory) points the
+ * client elsewhere, e.g. at loadtest/StandInServer through adb reverse tcp:8585 tcp:8585 with
+ * http://127.0.0.1:8585 in the file.
+ */
+static constexpr char kDefaultServerUrl[] = "http://nasmo2.myqnapcloud.com:8585";
+static constexpr char kServerUrlFileName[] = "server_url.txt";
+
+/*!
+ * Frames per second, a number in the frame rate file (inside the internal data directory) asks for
+ * another rate such as 30, 90 or 120. 0 draws on every vsync.
+ */
+static constexpr int kDefaultFrameRate = 60;
+static constexpr char kFrameRateFileName[] = "frame_rate.txt";
+//! GPU memory the resident tiles of a tiled map may use
+static constexpr size_t kTileBudgetBytes = 32 * 1024 * 1024;
+
+/*!
+ * How far (in cells) a tank can see through the fog of war.
+ */
+static constexpr int kSightRadius = 6;
+
+/*!
+ * The team whose view is rendered. The map format has no notion of teams yet, so every tank is on
+ * this team.
+ */
+static constexpr int kLocalTeam = 0;
+
+/*!
+ * The map generated when the download fails
+ */
+static constexpr uint32_t kFallbackMapSeed = 1;
+static constexpr int kFallbackMapSize = 64;
+
+/*!
+ * Map cells per heat map texel in each direction. The heat map only shows clusters, so a coarser
+ * grid keeps the texture and the kernels small.
+ */
+static constexpr int kHeatCellsPerTexel = 2;
+
+/*!
+ * Largest heat map side in texels, larger maps get more cells per texel
+ */
+static constexpr int kMaxHeatTexels = 1024;
+
+/*!
+ * What every frame and the cached map layer are cleared to, black for better grid visibility
+ */
+static constexpr float kClearColor[] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+/*!
+ * Texture data uploaded per step of a GL task, about a millisecond of upload on most devices
+ */
+static constexpr size_t kUploadBandBytes = 256 * 1024;
+
+/*!
+ * Pixels added around every damaged rectangle, for line widths and linear filtering
+ */
+static constexpr int kDamagePaddingPixels = 2;
+
+/*!
+ * Tanks are drawn in this color while there is no tank texture, as the map used to draw them
+ */
+static constexpr Vector3 kUnitColor = {1.0f, 0.0f, 0.0f};
+
+/*!
+ * @return true if @a name is one of the space separated @a extensions
+ */
+static bool hasExtension(const char *extensions, const char *name) {
+    const size_t length = strlen(name);
+    for (const char *found = extensions ? strstr(extensions, name) : nullptr; found;
+         found = strstr(found + length, name)) {
+        const bool starts = found == extensions || found[-1] == ' ';
+        const bool ends = found[length] == ' ' || found[length] == '\0';
+        if (starts && ends) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * A quad over the top left @a cellsX x @a cellsY cells of the map, texture rows run top to bottom
+ * like map rows
+ */
+static TexturedModel createMapQuad(const GridLayout &layout, int cellsX, int cellsY) {
+    float left = -layout.extent;
+    float top = layout.extent;
+    float right = left + cellsX * GridLayout::kCellSpacing;
+    float bottom = top - cellsY * GridLayout::kCellSpacing;
+
+    std::vector<TexturedVertex> vertices;
+    vertices.emplace_back(Vector3{left, top, 0}, Vector2{0.0f, 0.0f}); // Top-left
+    vertices.emplace_back(Vector3{right, top, 0}, Vector2{1.0f, 0.0f}); // Top-right
+    vertices.emplace_back(Vector3{right, bottom, 0}, Vector2{1.0f, 1.0f}); // Bottom-right
+    vertices.emplace_back(Vector3{left, bottom, 0}, Vector2{0.0f, 1.0f}); // Bottom-left
+
+    std::vector<Index> indices = {0, 1, 2, 0, 2, 3};
+    return TexturedModel(std::move(vertices), std::move(indices));
+}
+
 Renderer::~Renderer() {
+    // A load in flight is aborted rather than waited out, the transfer stops at its next read
+    if (mapLoadJob_) {
+        mapLoadCancelled_.store(true, std::memory_order_relaxed);
+        NetworkDownloader::setCancelled(true);
+        JobSystem::instance().wait(mapLoadJob_);
+        NetworkDownloader::setCancelled(false);
+    }
+    delete pendingGeneration_.exchange(nullptr, std::memory_order_acquire);
+
+    aout << "Heap allocations: " << AllocationTracker::summarize() << std::endl;
+    aout << getMemoryReport() << std::endl;
+    dumpMetrics();
+    Metrics::stopHttpEndpoint();
+
+    // GL objects have to go while the context is still current, queued tasks hold some as well
+    glTasks_.clear();
+    fogTexture_.reset();
+    heatTexture_.reset();
+    tileCache_.reset();
+    tankTexture_.reset();
+    layerCache_.reset();
+
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         if (context_ != EGL_NO_CONTEXT) {
@@ -133,6 +343,9 @@ Renderer::~Renderer() {
 }
 
 void Renderer::render() {
+    SCROLLER_TRACE_SCOPE("Renderer::render");
+    static Metrics::Counter &drawCalls = Metrics::counter("render.draw_calls");
+    const uint64_t drawCallsBefore = drawCalls.get();
     // Check to see if the surface has changed size. This is _necessary_ to do every frame when
     // using immersive mode as you'll get no other notification that your renderable area has
     // changed.
@@ -146,47 +359,126 @@ void Renderer::render() {
         shaderNeedsNewProjectionMatrix_ = false;
     }
 
-    // Create model matrix with scroll translation
-    memset(modelMatrix_, 0, sizeof(modelMatrix_));
-    Utility::buildTranslationMatrix(modelMatrix_, scrollX_, scrollY_);
-    shader_->setModelMatrix(modelMatrix_);
+    // Uploads and other GL work queued by loading get what is left of the frame before drawing
+    glTasks_.run(framePacer_.getDeadlineNanos());
+    const int64_t drawStartNanos = SimulationClock::nowNanos();
+
+    // Every program gets the same combined matrix, scrolling moves the camera
+    const float *viewProjection = camera_.getViewProjection().data();
+    shader_->setViewProjectionMatrix(viewProjection);
+
+    // Units and the highlight are drawn between the last two simulation ticks
+    const float alpha = frameAlpha_;
+    // Once more after the last unit stopped, the last meshes were built short of where it stopped
+    const bool unitsMoving = simulation_.hasMovingUnits();
+    if (unitsMoving || unitsWereMoving_) {
+        createUnitModels(alpha);
+    }
+    unitsWereMoving_ = unitsMoving;
+    if (hasTankSelected_) {
+        createHighlightOverlay(alpha);
+    }
+
+    float left, top, right, bottom;
+    camera_.screenToWorld(0.f, 0.f, left, top);
+    camera_.screenToWorld(float(width_), float(height_), right, bottom);
+    if (mapDataLoaded_) {
+        const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
+        int x0, y0, x1, y1;
+        layout.worldToCell(left, top, x0, y0);
+        layout.worldToCell(right, bottom, x1, y1);
+        static Metrics::Gauge &tanksInView = Metrics::gauge("map.tanks_in_view", "tanks");
+        tanksInView.set(regionStats_.count(RegionStats::kTypeTank, x0, y0, x1 + 1, y1 + 1));
+    }
+
+    // The map layer and the overlay textures are brought up to date before anything is drawn to
+    // the surface, they tell what changed on it
+    const uint64_t contentVersion = uint64_t(staticLayerVersion_) << 32
+                                    | (tileCache_ ? tileCache_->getVersion() : 0);
+    if (layerCache_) {
+        // The map comes from the cached layer, which only draws what scrolled into it
+        const float pixelsPerUnit = camera_.getPixelsPerUnit();
+        const float centerX = -camera_.getPositionX();
+        const float centerY = -camera_.getPositionY();
+        if (tileCache_) {
+            // Tiles are streamed in for all the layer may cover, the margin included
+            float areaLeft, areaBottom, areaRight, areaTop;
+            layerCache_->getCoveredArea(centerX, centerY, pixelsPerUnit, areaLeft, areaBottom,
+                                        areaRight, areaTop);
+            tileCache_->update(areaLeft, areaBottom, areaRight, areaTop);
+        }
+        layerCache_->update(centerX, centerY, pixelsPerUnit, contentVersion, kClearColor,
+                            [this](const float *layerViewProjection) {
+                                drawStaticLayer(layerViewProjection);
+                            });
+    } else if (tileCache_) {
+        // The part of the map in view decides which tiles are streamed in
+        tileCache_->update(left, bottom, right, top);
+    }
+    updateHeatMap();
+    updateFogOfWar();
+    trackDamage(alpha, contentVersion);
 
-    // clear the color buffer
+    // Only what changed since the back buffer was drawn is cleared and drawn again
+    beginDamagedFrame();
     glClear(GL_COLOR_BUFFER_BIT);
 
     // Render all the models. There's no depth testing in this sample so they're accepted in the
     // order provided. But the sample EGL setup requests a 24 bit depth buffer so you could
     // configure it at the end of initRenderer
-    if (!models_.empty()) {
-        for (const auto &model: models_) {
-            shader_->drawModel(model);
-        }
+    if (layerCache_) {
+        layerCache_->draw(*textureShader_, viewProjection);
+        shader_->activate();
+        shader_->setViewProjectionMatrix(viewProjection);
+    } else {
+        drawStaticLayer(viewProjection);
     }
-    
-    // Render triangle models with triangle shader
-    if (!triangleModels_.empty()) {
-        triangleShader_->activate();
-        triangleShader_->setProjectionMatrix(projectionMatrix_);
-        triangleShader_->setModelMatrix(modelMatrix_);
-        
-        for (const auto &model: triangleModels_) {
-            triangleShader_->drawTriangles(model);
+
+    // Tint where tanks cluster, under the tanks themselves
+    if (!heatModels_.empty() && heatTexture_) {
+        heatShader_->activate();
+        heatShader_->setViewProjectionMatrix(viewProjection);
+        heatShader_->setTexture(heatTexture_->getTextureID());
+
+        for (const auto &model: heatModels_) {
+            heatShader_->drawTexturedModel(model);
         }
-        
+
         shader_->activate(); // Switch back to line shader
     }
-    
+
     // Render textured models (tanks) with texture shader
-    if (!texturedModels_.empty() && tankTextureLoaded_) {
+    if (!texturedModels_.empty() && tankTexture_) {
         textureShader_->activate();
-        textureShader_->setProjectionMatrix(projectionMatrix_);
-        textureShader_->setModelMatrix(modelMatrix_);
-        textureShader_->setTexture(tankTextureId_);
+        textureShader_->setViewProjectionMatrix(viewProjection);
+        textureShader_->setTexture(tankTexture_->getTextureID());
         
         for (const auto &model: texturedModels_) {
             textureShader_->drawTexturedModel(model);
         }
         
+        shader_->activate(); // Switch back to line shader
+    } else if (!unitColorModels_.empty()) {
+        triangleShader_->activate();
+        triangleShader_->setViewProjectionMatrix(viewProjection);
+
+        for (const auto &model: unitColorModels_) {
+            triangleShader_->drawTriangles(model);
+        }
+
+        shader_->activate(); // Switch back to line shader
+    }
+
+    // Darken everything the local team cannot see
+    if (!fogModels_.empty() && fogTexture_) {
+        fogShader_->activate();
+        fogShader_->setViewProjectionMatrix(viewProjection);
+        fogShader_->setTexture(fogTexture_->getTextureID());
+
+        for (const auto &model: fogModels_) {
+            fogShader_->drawTexturedModel(model);
+        }
+
         shader_->activate(); // Switch back to line shader
     }
     
@@ -199,11 +491,98 @@ void Renderer::render() {
     }
 
     // Present the rendered image. This is an implicit glFlush.
-    auto swapResult = eglSwapBuffers(display_, surface_);
-    assert(swapResult == EGL_TRUE);
+    const int64_t drawNanos = SimulationClock::nowNanos() - drawStartNanos;
+    if (presentationTime_) {
+        presentationTime_(display_, surface_, framePacer_.getPresentationNanos());
+    }
+    auto swapResult = presentDamagedFrame();
+    assert(swapResult);
+    framePacer_.endFrame(drawNanos);
+
+    if (startup_.mark("first frame")) {
+        Metrics::gauge("startup.time_to_first_frame", "ms").set(
+                startup_.getMilestoneNanos("first frame") / 1000000);
+    }
+    if (mapDataLoaded_ && startup_.mark("first map frame")) {
+        Metrics::gauge("startup.time_to_first_map_frame", "ms").set(
+                startup_.getMilestoneNanos("first map frame") / 1000000);
+        aout << startup_.report() << std::endl;
+    }
+
+    if (player_) {
+        player_->addFrameTime(SimulationClock::nowNanos() - frameStartNanos_);
+    }
+
+    // Everything allocated from the frame arena is gone from here on
+    frameArena_.reset();
+    frameAllocations_ = AllocationTracker::endFrame();
+    SCROLLER_TRACE_COUNTER("frame allocations", frameAllocations_);
+
+    // Metric objects exist from their first use on, recording into them does not allocate
+    static Metrics::Histogram &frameTime = Metrics::histogram("frame.cpu_time", "us");
+    static Metrics::Histogram &frameDrawCalls = Metrics::histogram("frame.draw_calls", "calls");
+    static Metrics::Histogram &frameAllocations = Metrics::histogram("frame.allocations", "allocations");
+    frameTime.record(uint64_t(SimulationClock::nowNanos() - frameStartNanos_) / 1000);
+    frameDrawCalls.record(drawCalls.get() - drawCallsBefore);
+    frameAllocations.record(frameAllocations_);
+    framesSinceChange_++;
+}
+
+void Renderer::update() {
+    SCROLLER_TRACE_SCOPE("Renderer::update");
+    // Run as many fixed ticks as the real time since the last frame allows, or exactly as many as
+    // the recorded session ran
+    int ticks;
+    if (player_) {
+        ticks = replayTicks_;
+        frameAlpha_ = replayAlpha_;
+    } else {
+        ticks = clock_.advance(SimulationClock::nowNanos());
+        frameAlpha_ = clock_.getAlpha();
+    }
+    if (mapLoadJob_ && JobSystem::isDone(mapLoadJob_)) {
+        applyDownloadedMap();
+    }
+    if (recorder_) {
+        recorder_->recordFrameEnd(ticks, frameAlpha_);
+    }
+
+    for (int tick = 0; tick < ticks; tick++) {
+        simulation_.step(clock_.getTickSeconds(), mapData_);
+    }
+
+    // Units that drove into a new cell change what their team can see
+    for (int unitId: simulation_.getMovedUnits()) {
+        const auto &unit = simulation_.getUnits()[unitId];
+        visibility_.setUnit(unitId, kLocalTeam, unit.cellX, unit.cellY);
+        influence_.setUnit(unitId, unit.cellX, unit.cellY);
+        if (hasTankSelected_ && unitId == selectedUnitId_) {
+            selectedTankX_ = unit.cellX;
+            selectedTankY_ = unit.cellY;
+        }
+    }
+    for (const auto &cell: simulation_.getChangedCells()) {
+        const char value = mapData_.data[cell.second * mapData_.width + cell.first];
+        regionStats_.setCell(cell.first, cell.second, value);
+        regions_.setCell(cell.first, cell.second, value);
+    }
+    regions_.flush();
+    simulation_.clearMovedUnits();
 }
 
 void Renderer::initRenderer() {
+    SCROLLER_TRACE_SCOPE("Renderer::initRenderer");
+    startup_.mark("window created");
+
+    // A replayed session brings its own map, so only go online when not replaying. The downloads
+    // need neither EGL nor GL, so they run while the context and the shaders are set up.
+    {
+        StartupTimeline::Phase phase(startup_, "session");
+        startSession();
+    }
+    reloadMap();
+
+    StartupTimeline::Phase eglPhase(startup_, "egl");
     // Choose your render attributes
     constexpr EGLint attribs[] = {
             EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
@@ -267,6 +646,31 @@ void Renderer::initRenderer() {
     surface_ = surface;
     context_ = context;
 
+    // Partial redraws, see DamageTracker. Without buffer age every frame is drawn completely, the
+    // compositor can still be told what changed.
+    const char *eglExtensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (hasExtension(eglExtensions, "EGL_KHR_partial_update")) {
+        setDamageRegion_ = reinterpret_cast<PFNEGLSETDAMAGEREGIONKHRPROC>(
+                eglGetProcAddress("eglSetDamageRegionKHR"));
+    }
+    bufferAgeSupported_ = setDamageRegion_ || hasExtension(eglExtensions, "EGL_EXT_buffer_age");
+    if (hasExtension(eglExtensions, "EGL_KHR_swap_buffers_with_damage")) {
+        swapBuffersWithDamage_ = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+    } else if (hasExtension(eglExtensions, "EGL_EXT_swap_buffers_with_damage")) {
+        // The same signature under another name
+        swapBuffersWithDamage_ = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+                eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+    }
+    // Frames are shown on the vsync the pacer scheduled them for, not as soon as they are swapped
+    if (hasExtension(eglExtensions, "EGL_ANDROID_presentation_time")) {
+        presentationTime_ = reinterpret_cast<PFNEGLPRESENTATIONTIMEANDROIDPROC>(
+                eglGetProcAddress("eglPresentationTimeANDROID"));
+    }
+    aout << "Presentation time: " << (presentationTime_ != nullptr) << ", partial update: "
+         << (setDamageRegion_ != nullptr) << ", buffer age: " << bufferAgeSupported_
+         << ", swap with damage: " << (swapBuffersWithDamage_ != nullptr) << std::endl;
+
     // make width and height invalid so it gets updated the first frame in @a updateRenderArea()
     width_ = -1;
     height_ = -1;
@@ -274,42 +678,60 @@ void Renderer::initRenderer() {
     PRINT_GL_STRING(GL_VENDOR);
     PRINT_GL_STRING(GL_RENDERER);
     PRINT_GL_STRING(GL_VERSION);
+#if SCROLLER_LOG_GL_EXTENSIONS
     PRINT_GL_STRING_AS_LIST(GL_EXTENSIONS);
+#endif
+    eglPhase.end();
 
+    StartupTimeline::Phase shaderPhase(startup_, "shaders");
     shader_ = std::unique_ptr<Shader>(
-            Shader::loadShader(vertex, fragment, "inPosition", "inColor", "uModel", "uProjection"));
+            Shader::loadShader(vertex, fragment, "inPosition", "inColor", "uViewProjection"));
     assert(shader_);
 
     triangleShader_ = std::unique_ptr<Shader>(
-            Shader::loadShader(vertex, fragment, "inPosition", "inColor", "uModel", "uProjection"));
+            Shader::loadShader(vertex, fragment, "inPosition", "inColor", "uViewProjection"));
     assert(triangleShader_);
 
     textureShader_ = std::unique_ptr<TextureShader>(
-            TextureShader::loadShader(textureVertex, textureFragment, "inPosition", "inTexCoord", "uModel", "uProjection", "uTexture"));
+            TextureShader::loadShader(textureVertex, textureFragment, "inPosition", "inTexCoord", "uViewProjection", "uTexture"));
     assert(textureShader_);
 
+    fogShader_ = std::unique_ptr<TextureShader>(
+            TextureShader::loadShader(textureVertex, fogFragment, "inPosition", "inTexCoord", "uViewProjection", "uTexture"));
+    assert(fogShader_);
+
+    heatShader_ = std::unique_ptr<TextureShader>(
+            TextureShader::loadShader(textureVertex, heatFragment, "inPosition", "inTexCoord", "uViewProjection", "uTexture"));
+    assert(heatShader_);
+
     // Note: there's only one shader in this demo, so I'll activate it here. For a more complex game
     // you'll want to track the active shader and activate/deactivate it as necessary
     shader_->activate();
 
     // setup any other gl related global states
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // Black background for better grid visibility
+    glClearColor(kClearColor[0], kClearColor[1], kClearColor[2], kClearColor[3]);
+
+    camera_.setProjection(kProjectionHalfHeight, kProjectionNearPlane, kProjectionFarPlane);
 
     // enable alpha globally for now, you probably don't want to do this in a game
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    shaderPhase.end();
     
-    // Initialize texture variables
-    tankTextureId_ = 0;
-    tankTextureWidth_ = 0;
-    tankTextureHeight_ = 0;
-    tankTextureLoaded_ = false;
+    // Caches that can be rebuilt, cheapest first. Scratch memory is only released between frames,
+    // when nothing is allocated from it.
+    resources_.registerCache("frame arena", [this]() { return frameArena_.releaseMemory(); });
+    resources_.registerCache("map tiles", [this]() {
+        return tileCache_ ? tileCache_->evictAll() : 0;
+    });
+
+#if SCROLLER_METRICS_HTTP
+    Metrics::startHttpEndpoint(kMetricsPort);
+#endif
 
     // get some demo models into memory
+    StartupTimeline::Phase modelPhase(startup_, "placeholder grid");
     createModels();
-    
-    // Download map data in a separate thread to avoid blocking
-    downloadMapData();
 }
 
 void Renderer::updateRenderArea() {
@@ -320,10 +742,19 @@ void Renderer::updateRenderArea() {
     eglQuerySurface(display_, surface_, EGL_HEIGHT, &height);
 
     if (width != width_ || height != height_) {
+        markFrameChanged();
         width_ = width;
         height_ = height;
         glViewport(0, 0, width, height);
 
+        // The cached map layer is as large as the surface plus its margin
+        layerCache_ = LayerCache::create(width, height);
+        damage_.resize(width, height);
+
+        if (recorder_) {
+            recorder_->recordSurfaceSize(width, height);
+        }
+
         // make sure that we lazily recreate the projection matrix before we render
         shaderNeedsNewProjectionMatrix_ = true;
     }
@@ -338,420 +769,443 @@ void Renderer::createModels() {
 }
 
 void Renderer::downloadMapData() {
+    SCROLLER_TRACE_SCOPE("Renderer::downloadMapData");
     aout << "Starting map data download..." << std::endl;
     
-    // Download JSON map data from the new endpoint
-    if (NetworkDownloader::downloadJSON("http://nasmo2.myqnapcloud.com:8585/tanks/index.php", mapData_)) {
-        aout << "Map JSON downloaded successfully" << std::endl;
-        
-        // Download tank image
-        if (NetworkDownloader::downloadImage("http://nasmo2.myqnapcloud.com:8585/maps/tank.png", tankImageData_)) {
-            aout << "Tank image downloaded successfully" << std::endl;
-            
-            // Decode PNG to texture
-            if (decodePNGToTexture()) {
-                aout << "Tank texture loaded successfully" << std::endl;
-            } else {
-                aout << "Failed to decode tank PNG, using colored squares" << std::endl;
-            }
-            
-            mapDataLoaded_ = true;
-            
-            // Debug: Print the entire map for analysis
-            aout << "=== MAP DATA DEBUG ===" << std::endl;
-            aout << "Map size: " << mapData_.width << "x" << mapData_.height << std::endl;
-            aout << "Total cells: " << mapData_.data.size() << std::endl;
-            aout << "Map content:" << std::endl;
-            for (int y = 0; y < mapData_.height; y++) {
-                std::string row = "";
-                for (int x = 0; x < mapData_.width; x++) {
-                    char cell = mapData_.data[y * mapData_.width + x];
-                    row += cell;
-                    if (cell == 'x' || cell == 'X') {
-                        aout << "Tank found at (" << x << ", " << y << ")" << std::endl;
-                    }
-                    if (cell == 'o' || cell == 'O') {
-                        aout << "Object found at (" << x << ", " << y << ")" << std::endl;
-                    }
-                }
-                aout << "Row " << y << ": '" << row << "'" << std::endl;
-            }
-            aout << "=== END MAP DEBUG ===" << std::endl;
-            
-            // Recreate models with map data
-            models_.clear();
-            createColoredGrid();
-        } else {
-            aout << "Failed to download tank image, using fallback data" << std::endl;
-            createFallbackMapData();
-        }
-    } else {
+    // The packed form is a fraction of the JSON. A server that does not know it ignores the query
+    // and sends JSON, which downloadPacked() parses as well.
+    {
+        StartupTimeline::Phase phase(startup_, "download map");
+        downloadedMapOk_ = NetworkDownloader::downloadPacked(
+                serverUrl_ + "/tanks/index.php?format=packed", downloadedMap_, downloadedMapBody_);
+    }
+
+    // Download tank image, it is only used together with a map
+    if (downloadedMapOk_ && !mapLoadCancelled_.load(std::memory_order_relaxed)) {
+        StartupTimeline::Phase phase(startup_, "download tank image");
+        downloadedImageOk_ = NetworkDownloader::downloadImage(serverUrl_ + "/maps/tank.png",
+                                                              downloadedTankImage_);
+    }
+}
+
+void Renderer::reloadMap() {
+    // A replay brings its own maps, and one load at a time is enough
+    if (player_ || mapLoadJob_) {
+        return;
+    }
+    std::string tilePath;
+    if (app_->activity && app_->activity->internalDataPath) {
+        tilePath = std::string(app_->activity->internalDataPath) + "/" + kNextTileFileName;
+    }
+    mapLoadSpan_.emplace("map load");
+
+    // The download blocks on the network and the build takes many frames, so both are background
+    // jobs, which the render thread never picks up while it waits for something else
+    JobSystem &jobs = JobSystem::instance();
+    JobSystem::Handle download = jobs.schedule([this]() { downloadMapData(); }, {}, true);
+    mapLoadJob_ = jobs.schedule([this, tilePath]() { buildDownloadedMap(tilePath); }, {download},
+                                true);
+}
+
+void Renderer::buildDownloadedMap(const std::string &tilePath) {
+    SCROLLER_TRACE_SCOPE("Renderer::buildDownloadedMap");
+    // Without the image the fallback map is used, see applyDownloadedMap()
+    if (!downloadedMapOk_ || !downloadedImageOk_
+        || mapLoadCancelled_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    StartupTimeline::Phase phase(startup_, "build map");
+    MapGeneration *built = MapGeneration::build(std::move(downloadedMap_), tilePath).release();
+    // The render thread takes it from here at the start of a frame
+    delete pendingGeneration_.exchange(built, std::memory_order_acq_rel);
+}
+
+void Renderer::applyDownloadedMap() {
+    SCROLLER_TRACE_SCOPE("Renderer::applyDownloadedMap");
+    mapLoadJob_.reset();
+    mapLoadSpan_.reset();
+    markFrameChanged();
+    const std::vector<uint8_t> mapBody = std::move(downloadedMapBody_);
+
+    // A reload that failed keeps the map on screen
+    if (mapDataLoaded_ && (!downloadedMapOk_ || !downloadedImageOk_)) {
+        aout << "Failed to reload the map, keeping the current one" << std::endl;
+        return;
+    }
+    if (!downloadedMapOk_) {
         aout << "Failed to download map JSON, using fallback data" << std::endl;
         createFallbackMapData();
+        return;
+    }
+    aout << "Map JSON downloaded successfully" << std::endl;
+
+    // Completions are recorded when they are applied, so a replay applies them on the same frame.
+    // The replay takes the map from the snapshot recorded once it is loaded, not the response.
+    if (recorder_) {
+        recorder_->recordNetworkCompletion(SessionLog::kRequestMapJson, true,
+                                           mapBody.data(), mapBody.size());
+    }
+
+    if (!downloadedImageOk_) {
+        aout << "Failed to download tank image, using fallback data" << std::endl;
+        createFallbackMapData();
+        return;
     }
+    aout << "Tank image downloaded successfully" << std::endl;
+    if (recorder_) {
+        recorder_->recordNetworkCompletion(SessionLog::kRequestTankImage, true,
+                                           downloadedTankImage_.data(),
+                                           downloadedTankImage_.size());
+    }
+
+    // Decoded and uploaded over the next frames. Until then tanks keep the texture of the previous
+    // map, or are red squares, see createUnitModels().
+    loadTankTexture(std::move(downloadedTankImage_));
+
+    std::unique_ptr<MapGeneration> generation(
+            pendingGeneration_.exchange(nullptr, std::memory_order_acq_rel));
+    adoptGeneration(std::move(generation), nullptr);
 }
 
 void Renderer::createFallbackMapData() {
     aout << "Creating fallback map data for demonstration" << std::endl;
-    
-    // Create a test map with various cell types including tanks (x) and objects (o)
-    mapData_.width = 10;
-    mapData_.height = 10;
-    mapData_.data = {
-        'x', 'x', ' ', 'x', ' ', ' ', ' ', ' ', ' ', 'x',
-        ' ', ' ', 'o', 'o', ' ', ' ', 'x', ' ', ' ', ' ',
-        ' ', ' ', ' ', ' ', ' ', 'x', ' ', ' ', ' ', ' ',
-        ' ', ' ', ' ', ' ', ' ', ' ', ' ', 'x', ' ', ' ',
-        ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
-        ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', 'x', ' ',
-        ' ', ' ', ' ', ' ', ' ', ' ', ' ', 'x', ' ', ' ',
-        ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
-        ' ', ' ', ' ', 'x', ' ', ' ', ' ', ' ', ' ', ' ',
-        ' ', ' ', ' ', ' ', 'x', ' ', ' ', ' ', ' ', ' '
-    };
-    
+
+    // The same map every time, so sessions without network can be compared
+    MapGenerator::Params params;
+    params.seed = kFallbackMapSeed;
+    params.width = kFallbackMapSize;
+    params.height = kFallbackMapSize;
+    MapGenerator(params).generate(mapData_);
+
     mapDataLoaded_ = true;
-    
+
     // Recreate models with fallback data
-    models_.clear();
-    createColoredGrid();
-    
+    onMapLoaded(&params);
+
     aout << "Fallback map created: " << mapData_.width << "x" << mapData_.height << " with tank positions ('x') and objects ('o')" << std::endl;
 }
 
-void Renderer::createColoredGrid() {
-    // Grid parameters
-    const int gridSize = mapDataLoaded_ ? std::max(mapData_.width, mapData_.height) : 10;
-    const float gridSpacing = 0.4f; // Space between grid lines
-    const float gridExtent = gridSize * gridSpacing * 0.5f; // Half the total grid size
-    
-    std::vector<Vertex> lineVertices;
-    std::vector<Index> lineIndices;
-    std::vector<Vertex> triangleVertices;
-    std::vector<Index> triangleIndices;
-    std::vector<TexturedVertex> texturedVertices;
-    std::vector<Index> texturedIndices;
-    
-    // Default white color for grid lines
-    Vector3 gridColor = {1.0f, 1.0f, 1.0f};
-    
-    if (mapDataLoaded_) {
-        aout << "Creating colored grid with map data: " << mapData_.width << "x" << mapData_.height << std::endl;
-        
-        // Create grid cells based on map data
-        for (int y = 0; y < mapData_.height; y++) {
-            for (int x = 0; x < mapData_.width; x++) {
-                char cellType = mapData_.data[y * mapData_.width + x];
-                Vector3 cellColor = {0.5f, 0.5f, 0.5f}; // Default gray
-                
-                // Color code based on cell content
-                switch (cellType) {
-                    case 'x':
-                    case 'X':
-                        cellColor = {1.0f, 0.0f, 0.0f}; // Red for tank positions
-                        break;
-                    case 'o':
-                    case 'O':
-                        cellColor = {1.0f, 0.5f, 0.0f}; // Orange for objects
-                        break;
-                    case '1':
-                        cellColor = {0.0f, 1.0f, 0.0f}; // Green
-                        break;
-                    case '2':
-                        cellColor = {0.0f, 0.0f, 1.0f}; // Blue
-                        break;
-                    case '3':
-                        cellColor = {1.0f, 1.0f, 0.0f}; // Yellow
-                        break;
-                    case ' ':
-                    default:
-                        cellColor = {0.2f, 0.2f, 0.2f}; // Dark gray for empty
-                        break;
-                }
-                
-                // Calculate cell position
-                float cellX = -gridExtent + (x + 0.5f) * gridSpacing;
-                float cellY = gridExtent - (y + 0.5f) * gridSpacing;
-                float cellSize = gridSpacing * 0.8f; // Make cells slightly smaller than grid spacing
-                
-                // For tank positions, create textured quads; for objects, create filled squares; for others, just outline
-                if (cellType == 'x' || cellType == 'X') {
-                    // Create a textured quad for tank position
-                    Index baseIndex = texturedVertices.size();
-                    
-                    // Add vertices with texture coordinates for tank texture
-                    texturedVertices.emplace_back(Vector3{cellX - cellSize/2, cellY + cellSize/2, 0}, Vector2{0.0f, 0.0f}); // Top-left
-                    texturedVertices.emplace_back(Vector3{cellX + cellSize/2, cellY + cellSize/2, 0}, Vector2{1.0f, 0.0f}); // Top-right
-                    texturedVertices.emplace_back(Vector3{cellX + cellSize/2, cellY - cellSize/2, 0}, Vector2{1.0f, 1.0f}); // Bottom-right
-                    texturedVertices.emplace_back(Vector3{cellX - cellSize/2, cellY - cellSize/2, 0}, Vector2{0.0f, 1.0f}); // Bottom-left
-                    
-                    // Add triangle indices for textured quad (two triangles)
-                    texturedIndices.push_back(baseIndex);     texturedIndices.push_back(baseIndex + 1); texturedIndices.push_back(baseIndex + 2); // First triangle
-                    texturedIndices.push_back(baseIndex);     texturedIndices.push_back(baseIndex + 2); texturedIndices.push_back(baseIndex + 3); // Second triangle
-                } else if (cellType == 'o' || cellType == 'O') {
-                    // Create filled triangles for objects
-                    Index baseIndex = triangleVertices.size();
-                    
-                    // Add vertices for filled square (two triangles)
-                    triangleVertices.emplace_back(Vector3{cellX - cellSize/2, cellY + cellSize/2, 0}, cellColor); // Top-left
-                    triangleVertices.emplace_back(Vector3{cellX + cellSize/2, cellY + cellSize/2, 0}, cellColor); // Top-right
-                    triangleVertices.emplace_back(Vector3{cellX + cellSize/2, cellY - cellSize/2, 0}, cellColor); // Bottom-right
-                    triangleVertices.emplace_back(Vector3{cellX - cellSize/2, cellY - cellSize/2, 0}, cellColor); // Bottom-left
-                    
-                    // Add triangle indices for filled quad (two triangles)
-                    triangleIndices.push_back(baseIndex);     triangleIndices.push_back(baseIndex + 1); triangleIndices.push_back(baseIndex + 2); // First triangle
-                    triangleIndices.push_back(baseIndex);     triangleIndices.push_back(baseIndex + 2); triangleIndices.push_back(baseIndex + 3); // Second triangle
-                } else {
-                    // Create outline for other cell types
-                    Index baseIndex = lineVertices.size();
-                    
-                    // Add vertices for cell corners
-                    lineVertices.emplace_back(Vector3{cellX - cellSize/2, cellY + cellSize/2, 0}, cellColor); // Top-left
-                    lineVertices.emplace_back(Vector3{cellX + cellSize/2, cellY + cellSize/2, 0}, cellColor); // Top-right
-                    lineVertices.emplace_back(Vector3{cellX + cellSize/2, cellY - cellSize/2, 0}, cellColor); // Bottom-right
-                    lineVertices.emplace_back(Vector3{cellX - cellSize/2, cellY - cellSize/2, 0}, cellColor); // Bottom-left
-                    
-                    // Add indices for cell outline (4 lines)
-                    lineIndices.push_back(baseIndex);     lineIndices.push_back(baseIndex + 1); // Top
-                    lineIndices.push_back(baseIndex + 1); lineIndices.push_back(baseIndex + 2); // Right
-                    lineIndices.push_back(baseIndex + 2); lineIndices.push_back(baseIndex + 3); // Bottom
-                    lineIndices.push_back(baseIndex + 3); lineIndices.push_back(baseIndex);     // Left
-                }
-            }
-        }
-    } else {
-        // Create basic white grid lines as before
-        aout << "Creating basic grid (no map data)" << std::endl;
-        
-        // Create vertical lines
-        for (int i = 0; i <= gridSize; i++) {
-            float x = -gridExtent + i * gridSpacing;
-            
-            // Add vertices for vertical line
-            lineVertices.emplace_back(Vector3{x, -gridExtent, 0}, gridColor);
-            lineVertices.emplace_back(Vector3{x, gridExtent, 0}, gridColor);
-            
-            // Add indices for this line
-            Index baseIndex = (i * 2);
-            lineIndices.push_back(baseIndex);
-            lineIndices.push_back(baseIndex + 1);
-        }
-        
-        // Create horizontal lines
-        for (int i = 0; i <= gridSize; i++) {
-            float y = -gridExtent + i * gridSpacing;
-            
-            // Add vertices for horizontal line
-            lineVertices.emplace_back(Vector3{-gridExtent, y, 0}, gridColor);
-            lineVertices.emplace_back(Vector3{gridExtent, y, 0}, gridColor);
-            
-            // Add indices for this line
-            Index baseIndex = ((gridSize + 1) * 2) + (i * 2);
-            lineIndices.push_back(baseIndex);
-            lineIndices.push_back(baseIndex + 1);
+void Renderer::onMapLoaded(const MapGenerator::Params *generatedFrom) {
+    SCROLLER_TRACE_SCOPE("Renderer::onMapLoaded");
+    std::string tilePath;
+    if (app_->activity && app_->activity->internalDataPath) {
+        tilePath = std::string(app_->activity->internalDataPath) + "/" + kNextTileFileName;
+    }
+    adoptGeneration(MapGeneration::build(std::move(mapData_), tilePath), generatedFrom);
+}
+
+void Renderer::adoptGeneration(std::unique_ptr<MapGeneration> generation,
+                               const MapGenerator::Params *generatedFrom) {
+    SCROLLER_TRACE_SCOPE("Renderer::adoptGeneration");
+    markFrameChanged();
+
+    // Swapping only exchanges pointers, the previous map leaves with the generation
+    const bool tiled = generation->tiled;
+    std::swap(mapData_, generation->map);
+    std::swap(models_, generation->lines);
+    std::swap(triangleModels_, generation->triangles);
+    staticLayerVersion_++;
+    std::swap(regionStats_, generation->regionStats);
+    std::swap(regions_, generation->regions);
+    mapDataLoaded_ = true;
+    retireGeneration(std::move(generation));
+
+    if (recorder_) {
+        if (generatedFrom) {
+            recorder_->recordGeneratedMap(*generatedFrom);
+        } else {
+            recorder_->recordMapSnapshot(mapData_);
         }
     }
 
-    // Clear existing models
-    models_.clear();
-    triangleModels_.clear();
-    texturedModels_.clear();
+    hasTankSelected_ = false;
+    selectedUnitId_ = -1;
     highlightModels_.clear();
 
-    // Create models for lines if we have any
-    if (!lineVertices.empty()) {
-        models_.emplace_back(lineVertices, lineIndices);
-        aout << "Created line model with " << lineVertices.size() << " vertices and " << lineIndices.size() << " indices" << std::endl;
-    }
-    
-    // Create models for triangles if we have any  
-    if (!triangleVertices.empty()) {
-        triangleModels_.emplace_back(triangleVertices, triangleIndices);
-        aout << "Created triangle model with " << triangleVertices.size() << " vertices and " << triangleIndices.size() << " indices" << std::endl;
-    }
-    
-    // Create models for textured quads (tanks) if we have any
-    if (!texturedVertices.empty()) {
-        texturedModels_.emplace_back(texturedVertices, texturedIndices);
-        aout << "Created textured model with " << texturedVertices.size() << " vertices and " << texturedIndices.size() << " indices" << std::endl;
+    tileCache_.reset();
+    if (tiled) {
+        openTileCache();
     }
-}
 
-void Renderer::handleInput() {
-    // handle all queued inputs
-    auto *inputBuffer = android_app_swap_input_buffers(app_);
-    if (!inputBuffer) {
-        // no inputs yet.
-        return;
-    }
+    // Units start where the map puts them, the clock restarts so no time is owed to the new map
+    simulation_.reset(mapData_);
+    clock_.reset();
+    createUnitModels(0.0f);
 
-    // handle motion events (motionEventsCounts can be 0).
-    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
-        auto &motionEvent = inputBuffer->motionEvents[i];
-        auto action = motionEvent.action;
+    createFogOfWar();
+    createHeatMap();
+    trackMemory();
+}
 
-        // Find the pointer index, mask and bitshift to turn it into a readable value.
-        auto pointerIndex = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
-                >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+void Renderer::retireGeneration(std::unique_ptr<MapGeneration> generation) {
+    // The meshes are client side arrays, which GL reads during the draw call, so nothing on the
+    // GPU refers to them anymore. Freeing a large map takes a while, that happens on a worker.
+    MapGeneration *retired = generation.release();
+    JobSystem::instance().schedule([retired]() { delete retired; }, {}, true);
+}
 
-        int pointerCount = motionEvent.pointerCount;
+void Renderer::createColoredGrid() {
+    SCROLLER_TRACE_SCOPE("Renderer::createColoredGrid");
 
-        // determine the action type and process the event accordingly.
-        switch (action & AMOTION_EVENT_ACTION_MASK) {
-            case AMOTION_EVENT_ACTION_DOWN: {
-                // First finger down
-                auto &pointer = motionEvent.pointers[0];
-                auto x = GameActivityPointerAxes_getX(&pointer);
-                auto y = GameActivityPointerAxes_getY(&pointer);
-                
-                convertScreenToWorld(x, y, touch1_.x, touch1_.y);
-                touch1_.active = true;
-                touch2_.active = false;
-                isPinching_ = false;
-                isScrolling_ = true;
-                
-                lastTouchX_ = touch1_.x;
-                lastTouchY_ = touch1_.y;
-                
-                // Check for tank selection on single touch down
-                checkTankSelection(touch1_.x, touch1_.y);
-                
-                aout << "Touch Down: (" << touch1_.x << ", " << touch1_.y << ")" << std::endl;
-                break;
-            }
-            
-            case AMOTION_EVENT_ACTION_POINTER_DOWN: {
-                // Second finger down - start pinch gesture
-                if (pointerCount >= 2) {
-                    auto &pointer1 = motionEvent.pointers[0];
-                    auto &pointer2 = motionEvent.pointers[1];
-                    
-                    float x1 = GameActivityPointerAxes_getX(&pointer1);
-                    float y1 = GameActivityPointerAxes_getY(&pointer1);
-                    float x2 = GameActivityPointerAxes_getX(&pointer2);
-                    float y2 = GameActivityPointerAxes_getY(&pointer2);
-                    
-                    convertScreenToWorld(x1, y1, touch1_.x, touch1_.y);
-                    convertScreenToWorld(x2, y2, touch2_.x, touch2_.y);
-                    
-                    touch1_.active = true;
-                    touch2_.active = true;
-                    isPinching_ = true;
-                    isScrolling_ = false;
-                    
-                    lastPinchDistance_ = calculateDistance(touch1_.x, touch1_.y, touch2_.x, touch2_.y);
-                    
-                    aout << "Pinch Start: distance=" << lastPinchDistance_ << std::endl;
-                }
-                break;
-            }
+    // The previous grid's storage is refilled instead of allocating new vectors
+    gridBuilder_.recycle(models_);
+    gridBuilder_.recycle(triangleModels_);
 
-            case AMOTION_EVENT_ACTION_UP:
-            case AMOTION_EVENT_ACTION_CANCEL: {
-                // All fingers up
-                touch1_.active = false;
-                touch2_.active = false;
-                isPinching_ = false;
-                isScrolling_ = false;
-                aout << "All Touch Up" << std::endl;
-                break;
-            }
-            
-            case AMOTION_EVENT_ACTION_POINTER_UP: {
-                // One finger up - end pinch, potentially start scroll
-                if (isPinching_) {
-                    isPinching_ = false;
-                    
-                    // Determine which finger is still down
-                    if (pointerIndex == 0) {
-                        // First finger up, second still down
-                        auto &pointer = motionEvent.pointers[1];
-                        auto x = GameActivityPointerAxes_getX(&pointer);
-                        auto y = GameActivityPointerAxes_getY(&pointer);
-                        convertScreenToWorld(x, y, touch1_.x, touch1_.y);
-                        touch2_.active = false;
-                    } else {
-                        // Second finger up, first still down
-                        auto &pointer = motionEvent.pointers[0];
-                        auto x = GameActivityPointerAxes_getX(&pointer);
-                        auto y = GameActivityPointerAxes_getY(&pointer);
-                        convertScreenToWorld(x, y, touch1_.x, touch1_.y);
-                        touch2_.active = false;
-                    }
-                    
-                    lastTouchX_ = touch1_.x;
-                    lastTouchY_ = touch1_.y;
-                    isScrolling_ = true;
-                    
-                    aout << "Pinch End - Switch to scroll" << std::endl;
-                } else {
-                    touch1_.active = false;
-                    touch2_.active = false;
-                    isScrolling_ = false;
-                }
-                break;
-            }
+    // Create basic white grid lines as before
+    aout << "Creating basic grid (no map data)" << std::endl;
+    GridMesh::buildEmpty(10, gridBuilder_, models_);
+    staticLayerVersion_++;
+}
 
-            case AMOTION_EVENT_ACTION_MOVE: {
-                if (isPinching_ && pointerCount >= 2) {
-                    // Handle pinch zoom
-                    auto &pointer1 = motionEvent.pointers[0];
-                    auto &pointer2 = motionEvent.pointers[1];
-                    
-                    float x1 = GameActivityPointerAxes_getX(&pointer1);
-                    float y1 = GameActivityPointerAxes_getY(&pointer1);
-                    float x2 = GameActivityPointerAxes_getX(&pointer2);
-                    float y2 = GameActivityPointerAxes_getY(&pointer2);
-                    
-                    convertScreenToWorld(x1, y1, touch1_.x, touch1_.y);
-                    convertScreenToWorld(x2, y2, touch2_.x, touch2_.y);
-                    
-                    float currentDistance = calculateDistance(touch1_.x, touch1_.y, touch2_.x, touch2_.y);
-                    
-                    if (lastPinchDistance_ > 0.0f) {
-                        float scale = currentDistance / lastPinchDistance_;
-                        float newZoom = zoomLevel_ * scale;
-                        
-                        // Clamp zoom level
-                        if (newZoom >= minZoom_ && newZoom <= maxZoom_) {
-                            zoomLevel_ = newZoom;
-                            shaderNeedsNewProjectionMatrix_ = true;
-                            
-                            aout << "Zoom: " << zoomLevel_ << " (scale=" << scale << ", dist=" << currentDistance << ")" << std::endl;
-                        }
-                    }
-                    
-                    lastPinchDistance_ = currentDistance;
-                    
-                } else if (isScrolling_ && !isPinching_) {
-                    // Handle single finger scroll
-                    auto &pointer = motionEvent.pointers[0];
-                    auto x = GameActivityPointerAxes_getX(&pointer);
-                    auto y = GameActivityPointerAxes_getY(&pointer);
-                    
-                    float worldX, worldY;
-                    convertScreenToWorld(x, y, worldX, worldY);
-                    
-                    // Calculate the delta movement
-                    float deltaX = worldX - lastTouchX_;
-                    float deltaY = worldY - lastTouchY_;
-                    
-                    // Update scroll position
-                    scrollX_ += deltaX;
-                    scrollY_ += deltaY;
-                    
-                    // Update last touch position
-                    lastTouchX_ = worldX;
-                    lastTouchY_ = worldY;
-                    
-                    aout << "Scroll: (" << scrollX_ << ", " << scrollY_ << ")" << std::endl;
-                }
-                break;
-            }
-            
-            default:
-                aout << "Unknown MotionEvent Action: " << action << std::endl;
+void Renderer::drawStaticLayer(const float *viewProjection) {
+    if (tileCache_) {
+        tileCache_->draw(*triangleShader_, *textureShader_, viewProjection);
+    }
+    shader_->activate();
+    shader_->setViewProjectionMatrix(viewProjection);
+    for (const auto &model: models_) {
+        shader_->drawModel(model);
+    }
+
+    // Render triangle models with triangle shader
+    if (!triangleModels_.empty()) {
+        triangleShader_->activate();
+        triangleShader_->setViewProjectionMatrix(viewProjection);
+
+        for (const auto &model: triangleModels_) {
+            triangleShader_->drawTriangles(model);
         }
+
+        shader_->activate(); // Switch back to line shader
+    }
+}
+
+bool Renderer::openTileCache() {
+    SCROLLER_TRACE_SCOPE("Renderer::openTileCache");
+    // The file of the previous map was closed with its cache, so the next one can replace it
+    const std::string dataPath(app_->activity->internalDataPath);
+    const std::string path = dataPath + "/" + kTileFileName;
+    if (rename((dataPath + "/" + kNextTileFileName).c_str(), path.c_str()) != 0) {
+        aout << "Failed to move the map tiles into place" << std::endl;
+        return false;
+    }
+    tileCache_ = TileCache::create(TileStore::open(path), kTileBudgetBytes);
+    if (tileCache_) {
+        aout << "Drawing the " << mapData_.width << "x" << mapData_.height
+             << " map from tiles" << std::endl;
+    } else {
+        aout << "Failed to open the map tiles" << std::endl;
+    }
+    return tileCache_ != nullptr;
+}
+
+void Renderer::createUnitModels(float alpha) {
+    SCROLLER_TRACE_SCOPE("Renderer::createUnitModels");
+    // Runs every frame while units drive, so the old models' storage is reused
+    unitBuilder_.recycle(texturedModels_);
+    unitColorBuilder_.recycle(unitColorModels_);
+    if (!mapDataLoaded_ || simulation_.getUnits().empty()) {
+        return;
+    }
+    if (!tankTexture_) {
+        createUnitColorModels(alpha);
+        return;
+    }
+
+    const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
+    const float cellSize = GridLayout::cellSize();
+
+    unitBuilder_.begin(MeshBuilder<TexturedVertex, TexturedModel>::kQuad,
+                       simulation_.getUnits().size(), texturedModels_);
+
+    for (const auto &unit: simulation_.getUnits()) {
+        // Units may be between two cells while driving
+        float unitX, unitY;
+        simulation_.getInterpolatedPosition(unit, alpha, unitX, unitY);
+        float cellX = layout.cellCenterX(unitX);
+        float cellY = layout.cellCenterY(unitY);
+
+        // A textured quad for the tank
+        unitBuilder_.addQuad(
+                TexturedVertex(Vector3{cellX - cellSize/2, cellY + cellSize/2, 0}, Vector2{0.0f, 0.0f}), // Top-left
+                TexturedVertex(Vector3{cellX + cellSize/2, cellY + cellSize/2, 0}, Vector2{1.0f, 0.0f}), // Top-right
+                TexturedVertex(Vector3{cellX + cellSize/2, cellY - cellSize/2, 0}, Vector2{1.0f, 1.0f}), // Bottom-right
+                TexturedVertex(Vector3{cellX - cellSize/2, cellY - cellSize/2, 0}, Vector2{0.0f, 1.0f})); // Bottom-left
+    }
+
+    unitBuilder_.finish();
+}
+
+void Renderer::createUnitColorModels(float alpha) {
+    const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
+    const float half = GridLayout::cellSize() / 2;
+
+    unitColorBuilder_.begin(MeshBuilder<Vertex, Model>::kQuad, simulation_.getUnits().size(),
+                            unitColorModels_);
+    for (const auto &unit: simulation_.getUnits()) {
+        float unitX, unitY;
+        simulation_.getInterpolatedPosition(unit, alpha, unitX, unitY);
+        const float cellX = layout.cellCenterX(unitX);
+        const float cellY = layout.cellCenterY(unitY);
+        unitColorBuilder_.addQuad(Vertex(Vector3{cellX - half, cellY + half, 0}, kUnitColor),
+                                  Vertex(Vector3{cellX + half, cellY + half, 0}, kUnitColor),
+                                  Vertex(Vector3{cellX + half, cellY - half, 0}, kUnitColor),
+                                  Vertex(Vector3{cellX - half, cellY - half, 0}, kUnitColor));
+    }
+    unitColorBuilder_.finish();
+}
+
+void Renderer::createFogOfWar() {
+    SCROLLER_TRACE_SCOPE("Renderer::createFogOfWar");
+    fogModels_.clear();
+    fogTexture_.reset();
+
+    if (!mapDataLoaded_) {
+        return;
+    }
+
+    // Every tank is a unit of the local team, with the same id as in the simulation
+    visibility_.reset(mapData_, kSightRadius);
+    for (const auto &unit: simulation_.getUnits()) {
+        visibility_.setUnit(unit.id, kLocalTeam, unit.cellX, unit.cellY);
+    }
+    int recomputed = visibility_.update();
+    aout << "Fog of war computed for " << recomputed << " units" << std::endl;
+
+    // One texel per cell, the mask itself is uploaded lazily in updateFogOfWar()
+    fogTexture_ = OverlayTexture::create(mapData_.width, mapData_.height, GL_R8);
+    if (!fogTexture_) {
+        aout << "Failed to create fog of war texture, rendering without fog" << std::endl;
+        return;
+    }
+
+    // A single quad covering every cell of the map
+    const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
+    fogModels_.push_back(createMapQuad(layout, mapData_.width, mapData_.height));
+}
+
+void Renderer::updateFogOfWar() {
+    SCROLLER_TRACE_SCOPE("Renderer::updateFogOfWar");
+    if (!fogTexture_) {
+        return;
+    }
+
+    // Only units that moved since the last frame are recomputed
+    visibility_.update();
+
+    VisibilityMap::Rect dirty;
+    if (visibility_.takeDirtyRect(kLocalTeam, dirty)) {
+        const int dirtyWidth = dirty.x1 - dirty.x0;
+        const int dirtyHeight = dirty.y1 - dirty.y0;
+
+        // The mask only lives until it is uploaded
+        uint8_t *mask = frameArena_.allocate<uint8_t>(size_t(dirtyWidth) * dirtyHeight);
+        visibility_.exportMask(kLocalTeam, dirty, mask, dirtyWidth);
+        fogTexture_->upload(dirty.x0, dirty.y0, dirtyWidth, dirtyHeight, mask, dirtyWidth);
+        addCellDamage(float(dirty.x0), float(dirty.y0), float(dirty.x1), float(dirty.y1));
+    }
+}
+
+void Renderer::createHeatMap() {
+    SCROLLER_TRACE_SCOPE("Renderer::createHeatMap");
+    heatModels_.clear();
+    heatTexture_.reset();
+
+    if (!mapDataLoaded_) {
+        return;
+    }
+
+    const int cellsPerTexel = std::max(
+            kHeatCellsPerTexel,
+            (std::max(mapData_.width, mapData_.height) + kMaxHeatTexels - 1) / kMaxHeatTexels);
+    influence_.reset(mapData_.width, mapData_.height, cellsPerTexel);
+    for (const auto &unit: simulation_.getUnits()) {
+        influence_.setUnit(unit.id, unit.cellX, unit.cellY);
+    }
+
+    // Linear filtering blends the coarse texels into smooth blobs
+    heatTexture_ = OverlayTexture::create(influence_.getWidth(), influence_.getHeight(), GL_R8,
+                                          GL_LINEAR);
+    if (!heatTexture_) {
+        aout << "Failed to create heat map texture, rendering without heat map" << std::endl;
+        return;
+    }
+
+    // Texels on the right and bottom edge can cover cells past the end of the map
+    const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
+    heatModels_.push_back(createMapQuad(layout, influence_.getWidth() * cellsPerTexel,
+                                        influence_.getHeight() * cellsPerTexel));
+}
+
+void Renderer::updateHeatMap() {
+    SCROLLER_TRACE_SCOPE("Renderer::updateHeatMap");
+    if (!heatTexture_) {
+        return;
+    }
+
+    InfluenceMap::Rect dirty;
+    if (influence_.takeDirtyRect(dirty)) {
+        const int dirtyWidth = dirty.x1 - dirty.x0;
+        const int dirtyHeight = dirty.y1 - dirty.y0;
+
+        uint8_t *mask = frameArena_.allocate<uint8_t>(size_t(dirtyWidth) * dirtyHeight);
+        influence_.exportMask(dirty, mask, dirtyWidth);
+        heatTexture_->upload(dirty.x0, dirty.y0, dirtyWidth, dirtyHeight, mask, dirtyWidth);
+
+        // Linear filtering blends each texel into its neighbours
+        const float cellsPerTexel = float(influence_.getCellsPerTexel());
+        addCellDamage((dirty.x0 - 1) * cellsPerTexel, (dirty.y0 - 1) * cellsPerTexel,
+                      (dirty.x1 + 1) * cellsPerTexel, (dirty.y1 + 1) * cellsPerTexel);
+    }
+}
+
+int Renderer::getFrameWaitMillis() {
+    return framePacer_.getWaitMillis(SimulationClock::nowNanos());
+}
+
+void Renderer::handleInput() {
+    SCROLLER_TRACE_SCOPE("Renderer::handleInput");
+    frameStartNanos_ = SimulationClock::nowNanos();
+    framePacer_.beginFrame(frameStartNanos_);
+    AllocationTracker::beginFrame(framesSinceChange_ >= kSteadyStateFrames);
+
+    // While replaying, the session log decides what happened this frame
+    if (player_) {
+        replayFrameInput();
+    }
+
+    // handle all queued inputs
+    auto *inputBuffer = android_app_swap_input_buffers(app_);
+    if (!inputBuffer) {
+        // no inputs yet.
+        return;
+    }
+    if (inputBuffer->motionEventsCount > 0 || inputBuffer->keyEventsCount > 0) {
+        markFrameChanged();
+    }
+
+    // handle motion events (motionEventsCounts can be 0).
+    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
+        auto &motionEvent = inputBuffer->motionEvents[i];
+
+        // Reduce the event to the pointers we use so it can be recorded and replayed
+        RecordedMotionEvent event;
+        event.action = motionEvent.action;
+        event.pointerCount = std::min<int>(motionEvent.pointerCount, RecordedMotionEvent::kMaxPointers);
+        for (int pointer = 0; pointer < event.pointerCount; pointer++) {
+            event.x[pointer] = GameActivityPointerAxes_getX(&motionEvent.pointers[pointer]);
+            event.y[pointer] = GameActivityPointerAxes_getY(&motionEvent.pointers[pointer]);
+        }
+
+        // Live touches would break the determinism of a replay
+        if (player_) {
+            continue;
+        }
+        if (recorder_) {
+            recorder_->recordMotionEvent(event);
+        }
+        processMotionEvent(event);
     }
     // clear the motion input count in this buffer for main thread to re-use.
     android_app_clear_motion_events(inputBuffer);
@@ -780,13 +1234,595 @@ void Renderer::handleInput() {
     android_app_clear_key_events(inputBuffer);
 }
 
-bool Renderer::decodePNGToTexture() {
-    if (tankImageData_.empty()) {
+void Renderer::processMotionEvent(const RecordedMotionEvent &event) {
+    auto action = event.action;
+
+    // Find the pointer index, mask and bitshift to turn it into a readable value.
+    auto pointerIndex = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
+            >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+
+    int pointerCount = event.pointerCount;
+
+    // determine the action type and process the event accordingly.
+    switch (action & AMOTION_EVENT_ACTION_MASK) {
+        case AMOTION_EVENT_ACTION_DOWN: {
+            // First finger down
+            auto x = event.x[0];
+            auto y = event.y[0];
+            
+            convertScreenToWorld(x, y, touch1_.x, touch1_.y);
+            touch1_.active = true;
+            touch2_.active = false;
+            isPinching_ = false;
+            isScrolling_ = true;
+            
+            lastTouchX_ = touch1_.x;
+            lastTouchY_ = touch1_.y;
+            
+            // Check for tank selection on single touch down, picking goes straight to grid space
+            float gridX, gridY;
+            camera_.screenToWorld(x, y, gridX, gridY);
+            checkTankSelection(gridX, gridY);
+            
+            aout << "Touch Down: (" << touch1_.x << ", " << touch1_.y << ")" << std::endl;
+            break;
+        }
+        
+        case AMOTION_EVENT_ACTION_POINTER_DOWN: {
+            // Second finger down - start pinch gesture
+            if (pointerCount >= 2) {
+                float x1 = event.x[0];
+                float y1 = event.y[0];
+                float x2 = event.x[1];
+                float y2 = event.y[1];
+                
+                convertScreenToWorld(x1, y1, touch1_.x, touch1_.y);
+                convertScreenToWorld(x2, y2, touch2_.x, touch2_.y);
+                
+                touch1_.active = true;
+                touch2_.active = true;
+                isPinching_ = true;
+                isScrolling_ = false;
+                
+                lastPinchDistance_ = calculateDistance(touch1_.x, touch1_.y, touch2_.x, touch2_.y);
+                
+                aout << "Pinch Start: distance=" << lastPinchDistance_ << std::endl;
+            }
+            break;
+        }
+
+        case AMOTION_EVENT_ACTION_UP:
+        case AMOTION_EVENT_ACTION_CANCEL: {
+            // All fingers up
+            touch1_.active = false;
+            touch2_.active = false;
+            isPinching_ = false;
+            isScrolling_ = false;
+            aout << "All Touch Up" << std::endl;
+            break;
+        }
+        
+        case AMOTION_EVENT_ACTION_POINTER_UP: {
+            // One finger up - end pinch, potentially start scroll
+            if (isPinching_) {
+                isPinching_ = false;
+                
+                // Determine which finger is still down
+                if (pointerIndex == 0) {
+                    // First finger up, second still down
+                    auto x = event.x[1];
+                    auto y = event.y[1];
+                    convertScreenToWorld(x, y, touch1_.x, touch1_.y);
+                    touch2_.active = false;
+                } else {
+                    // Second finger up, first still down
+                    auto x = event.x[0];
+                    auto y = event.y[0];
+                    convertScreenToWorld(x, y, touch1_.x, touch1_.y);
+                    touch2_.active = false;
+                }
+                
+                lastTouchX_ = touch1_.x;
+                lastTouchY_ = touch1_.y;
+                isScrolling_ = true;
+                
+                aout << "Pinch End - Switch to scroll" << std::endl;
+            } else {
+                touch1_.active = false;
+                touch2_.active = false;
+                isScrolling_ = false;
+            }
+            break;
+        }
+
+        case AMOTION_EVENT_ACTION_MOVE: {
+            if (isPinching_ && pointerCount >= 2) {
+                // Handle pinch zoom
+                float x1 = event.x[0];
+                float y1 = event.y[0];
+                float x2 = event.x[1];
+                float y2 = event.y[1];
+                
+                convertScreenToWorld(x1, y1, touch1_.x, touch1_.y);
+                convertScreenToWorld(x2, y2, touch2_.x, touch2_.y);
+                
+                float currentDistance = calculateDistance(touch1_.x, touch1_.y, touch2_.x, touch2_.y);
+                
+                if (lastPinchDistance_ > 0.0f) {
+                    float scale = currentDistance / lastPinchDistance_;
+                    float newZoom = zoomLevel_ * scale;
+                    
+                    // Clamp zoom level
+                    if (newZoom >= minZoom_ && newZoom <= maxZoom_) {
+                        zoomLevel_ = newZoom;
+                        shaderNeedsNewProjectionMatrix_ = true;
+                        
+                        aout << "Zoom: " << zoomLevel_ << " (scale=" << scale << ", dist=" << currentDistance << ")" << std::endl;
+                    }
+                }
+                
+                lastPinchDistance_ = currentDistance;
+                
+            } else if (isScrolling_ && !isPinching_) {
+                // Handle single finger scroll
+                auto x = event.x[0];
+                auto y = event.y[0];
+                
+                float worldX, worldY;
+                convertScreenToWorld(x, y, worldX, worldY);
+                
+                // Calculate the delta movement
+                float deltaX = worldX - lastTouchX_;
+                float deltaY = worldY - lastTouchY_;
+                
+                // Update scroll position
+                scrollX_ += deltaX;
+                scrollY_ += deltaY;
+                camera_.setPosition(scrollX_, scrollY_);
+                
+                // Update last touch position
+                lastTouchX_ = worldX;
+                lastTouchY_ = worldY;
+                
+                aout << "Scroll: (" << scrollX_ << ", " << scrollY_ << ")" << std::endl;
+            }
+            break;
+        }
+        
+        default:
+            aout << "Unknown MotionEvent Action: " << action << std::endl;
+    }
+}
+
+void Renderer::startSession() {
+    serverUrl_ = kDefaultServerUrl;
+    framePacer_.setTargetRate(kDefaultFrameRate);
+    if (!app_->activity || !app_->activity->internalDataPath) {
+        return;
+    }
+    const std::string dataPath(app_->activity->internalDataPath);
+
+    FILE *serverFile = fopen((dataPath + "/" + kServerUrlFileName).c_str(), "r");
+    if (serverFile) {
+        char line[256];
+        if (fgets(line, sizeof(line), serverFile)) {
+            std::string url(line);
+            // trailing whitespace and slashes, the paths are appended with their own slash
+            while (!url.empty() && (isspace(uint8_t(url.back())) || url.back() == '/')) {
+                url.pop_back();
+            }
+            if (!url.empty()) {
+                serverUrl_ = url;
+                aout << "Using tanks server " << serverUrl_ << std::endl;
+            }
+        }
+        fclose(serverFile);
+    }
+
+    FILE *frameRateFile = fopen((dataPath + "/" + kFrameRateFileName).c_str(), "r");
+    if (frameRateFile) {
+        int frameRate = 0;
+        if (fscanf(frameRateFile, "%d", &frameRate) == 1 && frameRate >= 0) {
+            framePacer_.setTargetRate(frameRate);
+        }
+        fclose(frameRateFile);
+    }
+    aout << "Target frame rate " << framePacer_.getTargetRate() << ", "
+         << framePacer_.getFramePeriodNanos() / 1000 << " us per frame" << std::endl;
+
+    player_ = SessionPlayer::open(dataPath + "/" + kReplayFileName);
+    if (player_) {
+        return;
+    }
+
+#if SCROLLER_RECORD_SESSIONS
+    recorder_ = SessionRecorder::open(dataPath + "/" + kRecordingFileName);
+#endif
+}
+
+void Renderer::replayFrameInput() {
+    SessionLog::Record record;
+    while (player_->readRecord(record)) {
+        if (record.type != SessionLog::kRecordFrameEnd) {
+            markFrameChanged();
+        }
+
+        switch (record.type) {
+            case SessionLog::kRecordMotionEvent: {
+                RecordedMotionEvent event;
+                if (!SessionPlayer::decodeMotionEvent(record, event)) {
+                    break;
+                }
+                // Touches are in pixels of the recording device's surface
+                if (replaySurfaceWidth_ > 0 && replaySurfaceHeight_ > 0) {
+                    for (int pointer = 0; pointer < event.pointerCount; pointer++) {
+                        event.x[pointer] *= float(width_) / replaySurfaceWidth_;
+                        event.y[pointer] *= float(height_) / replaySurfaceHeight_;
+                    }
+                }
+                processMotionEvent(event);
+                break;
+            }
+
+            case SessionLog::kRecordSurfaceSize:
+                SessionPlayer::decodeSurfaceSize(record, replaySurfaceWidth_, replaySurfaceHeight_);
+                break;
+
+            case SessionLog::kRecordNetworkCompletion: {
+                SessionLog::NetworkRequest request;
+                bool success;
+                std::vector<uint8_t> data;
+                if (!SessionPlayer::decodeNetworkCompletion(record, request, success, data)) {
+                    break;
+                }
+                aout << "Replaying network completion " << int(request) << ", success: " << success
+                     << ", " << data.size() << " bytes" << std::endl;
+                if (request == SessionLog::kRequestTankImage && success) {
+                    loadTankTexture(std::move(data));
+                }
+                break;
+            }
+
+            case SessionLog::kRecordMapSnapshot:
+            case SessionLog::kRecordPackedMapSnapshot:
+            case SessionLog::kRecordGeneratedMap:
+                if (SessionPlayer::decodeMapSnapshot(record, mapData_)) {
+                    mapDataLoaded_ = true;
+                    onMapLoaded();
+                }
+                break;
+
+            case SessionLog::kRecordFrameEnd:
+                SessionPlayer::decodeFrameEnd(record, replayTicks_, replayAlpha_);
+                return;
+
+            default:
+                aout << "Skipping unknown session record " << int(record.type) << std::endl;
+                break;
+        }
+    }
+
+    // End of the log, report and hand control back to live input
+    finishReplay();
+}
+
+void Renderer::finishReplay() {
+    markFrameChanged();
+    std::string summary = player_->summarizeFrameTimes();
+    std::string allocations = AllocationTracker::summarize();
+    aout << "Replay finished: " << summary << std::endl;
+    aout << "Heap allocations: " << allocations << std::endl;
+    aout << getMemoryReport() << std::endl;
+    dumpMetrics();
+
+    if (app_->activity && app_->activity->internalDataPath) {
+        std::string reportPath =
+                std::string(app_->activity->internalDataPath) + "/" + kReplayReportFileName;
+        FILE *report = fopen(reportPath.c_str(), "w");
+        if (report) {
+            fprintf(report, "%s\n", summary.c_str());
+            fprintf(report, "allocations: %s\n", allocations.c_str());
+            fclose(report);
+        }
+    }
+
+    player_.reset();
+    replayTicks_ = 0;
+    replayAlpha_ = 0.0f;
+}
+
+void Renderer::onLowMemory() {
+    SCROLLER_TRACE_SCOPE("Renderer::onLowMemory");
+    markFrameChanged();
+    trackMemory();
+    aout << "Low memory, before eviction: " << resources_.report() << std::endl;
+
+    size_t freed = resources_.evictCaches();
+    trackMemory();
+    aout << "Freed " << freed << " bytes, after eviction: " << resources_.report() << std::endl;
+}
+
+std::string Renderer::getMemoryReport() {
+    trackMemory();
+    return resources_.report();
+}
+
+void Renderer::trackMemory() {
+    using Category = ResourceManager::Category;
+
+    resources_.track("map cells", Category::kCategoryMap, mapData_.data.capacity());
+
+    size_t gridBytes = 0;
+    for (const auto &model: models_) {
+        gridBytes += model.getMemoryBytes();
+    }
+    for (const auto &model: triangleModels_) {
+        gridBytes += model.getMemoryBytes();
+    }
+    size_t unitBytes = 0;
+    for (const auto &model: texturedModels_) {
+        unitBytes += model.getMemoryBytes();
+    }
+    for (const auto &model: unitColorModels_) {
+        unitBytes += model.getMemoryBytes();
+    }
+    size_t overlayBytes = 0;
+    for (const auto &model: highlightModels_) {
+        overlayBytes += model.getMemoryBytes();
+    }
+    for (const auto &model: fogModels_) {
+        overlayBytes += model.getMemoryBytes();
+    }
+    for (const auto &model: heatModels_) {
+        overlayBytes += model.getMemoryBytes();
+    }
+    resources_.track("grid meshes", Category::kCategoryMeshes, gridBytes);
+    resources_.track("unit meshes", Category::kCategoryMeshes, unitBytes);
+    resources_.track("overlay meshes", Category::kCategoryMeshes, overlayBytes);
+
+    resources_.track("encoded tank image", Category::kCategoryImages, tankImageBytes_);
+
+    resources_.track("tank texture", Category::kCategoryTextures, 0,
+                     tankTexture_ ? size_t(tankTexture_->getWidth()) * tankTexture_->getHeight() * 4
+                                  : 0);
+    resources_.track("map layer cache", Category::kCategoryTextures, 0,
+                     layerCache_ ? layerCache_->getTextureBytes() : 0);
+    resources_.track("map tiles", Category::kCategoryTextures, 0,
+                     tileCache_ ? tileCache_->getResidentBytes() : 0);
+    resources_.track("fog texture", Category::kCategoryTextures, 0,
+                     fogTexture_ ? size_t(fogTexture_->getWidth()) * fogTexture_->getHeight() : 0);
+    resources_.track("heat map texture", Category::kCategoryTextures, 0,
+                     heatTexture_ ? size_t(heatTexture_->getWidth()) * heatTexture_->getHeight() : 0);
+
+    resources_.track("visibility", Category::kCategoryGameState, visibility_.getMemoryBytes());
+    resources_.track("influence", Category::kCategoryGameState, influence_.getMemoryBytes());
+    resources_.track("simulation", Category::kCategoryGameState, simulation_.getMemoryBytes());
+    resources_.track("region stats", Category::kCategoryGameState, regionStats_.getMemoryBytes());
+    resources_.track("region labels", Category::kCategoryGameState, regions_.getMemoryBytes());
+
+    resources_.track("frame arena", Category::kCategoryScratch, frameArena_.getCapacityBytes());
+}
+
+void Renderer::dumpMetrics() {
+    Metrics::logDump();
+    if (app_->activity && app_->activity->internalDataPath) {
+        Metrics::writeDump(std::string(app_->activity->internalDataPath) + "/" + kMetricsFileName);
+    }
+}
+
+void Renderer::markFrameChanged() {
+    framesSinceChange_ = 0;
+    AllocationTracker::leaveSteadyState();
+}
+
+void Renderer::trackDamage(float alpha, uint64_t contentVersion) {
+    // Scrolling, zooming or a new map move everything on the surface
+    if (camera_.getVersion() != damageCameraVersion_ || contentVersion != damageContentVersion_) {
+        damageCameraVersion_ = camera_.getVersion();
+        damageContentVersion_ = contentVersion;
+        damage_.addFull();
+    }
+
+    // Units that moved since the last frame, where they were and where they are now
+    const auto &units = simulation_.getUnits();
+    if (unitDamagePositions_.size() != units.size() * 2) {
+        unitDamagePositions_.assign(units.size() * 2, 0.f);
+        damage_.addFull();
+    }
+    for (size_t i = 0; i < units.size(); i++) {
+        float x, y;
+        simulation_.getInterpolatedPosition(units[i], alpha, x, y);
+        float &lastX = unitDamagePositions_[i * 2];
+        float &lastY = unitDamagePositions_[i * 2 + 1];
+        if (x != lastX || y != lastY) {
+            addCellDamage(lastX, lastY, lastX + 1.f, lastY + 1.f);
+            addCellDamage(x, y, x + 1.f, y + 1.f);
+            lastX = x;
+            lastY = y;
+        }
+    }
+
+    // The highlight pulses, so it changes every frame while a tank is selected
+    DamageTracker::Rect highlight = {0, 0, 0, 0};
+    for (const auto &model: highlightModels_) {
+        const Vertex *vertices = model.getVertexData();
+        const Index *indices = model.getIndexData();
+        float left = vertices[indices[0]].position.x;
+        float right = left;
+        float bottom = vertices[indices[0]].position.y;
+        float top = bottom;
+        for (size_t i = 1; i < model.getIndexCount(); i++) {
+            const Vector3 &position = vertices[indices[i]].position;
+            left = std::min(left, position.x);
+            right = std::max(right, position.x);
+            bottom = std::min(bottom, position.y);
+            top = std::max(top, position.y);
+        }
+        highlight = worldToPixels(left, bottom, right, top);
+    }
+    damage_.add(highlightDamage_);
+    damage_.add(highlight);
+    highlightDamage_ = highlight;
+}
+
+DamageTracker::Rect Renderer::worldToPixels(float left, float bottom, float right, float top) {
+    const float corners[4] = {left, bottom, right, top};
+    float ndc[4];
+    camera_.getViewProjection().transformPoints(corners, ndc, 2);
+    // y points up in normalized device coordinates and in window coordinates alike
+    return {int(std::floor((ndc[0] + 1.f) * 0.5f * width_)) - kDamagePaddingPixels,
+            int(std::floor((ndc[1] + 1.f) * 0.5f * height_)) - kDamagePaddingPixels,
+            int(std::ceil((ndc[2] + 1.f) * 0.5f * width_)) + kDamagePaddingPixels,
+            int(std::ceil((ndc[3] + 1.f) * 0.5f * height_)) + kDamagePaddingPixels};
+}
+
+void Renderer::addCellDamage(float x0, float y0, float x1, float y1) {
+    if (!mapDataLoaded_ || damage_.isFull()) {
+        return;
+    }
+    // Rows run top to bottom, so the first row is the top edge
+    const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
+    const float half = GridLayout::kCellSpacing * 0.5f;
+    damage_.add(worldToPixels(layout.cellCenterX(x0) - half, layout.cellCenterY(y1) + half,
+                              layout.cellCenterX(x1) - half, layout.cellCenterY(y0) + half));
+}
+
+void Renderer::beginDamagedFrame() {
+    static Metrics::Histogram &redrawnArea = Metrics::histogram("frame.redrawn_area", "%");
+    EGLint bufferAge = 0;
+    if (bufferAgeSupported_
+        && !eglQuerySurface(display_, surface_, EGL_BUFFER_AGE_KHR, &bufferAge)) {
+        bufferAge = 0;
+    }
+    DamageTracker::Rect rects[DamageTracker::kMaxRects];
+    int count = damage_.getRedrawRects(bufferAge, rects);
+    if (count == 0) {
+        // No rectangles would mean the whole surface to EGL. The frame is still swapped, which
+        // keeps the loop on vsync, so a single pixel is redrawn.
+        rects[0] = {0, 0, 1, 1};
+        count = 1;
+    }
+
+    if (setDamageRegion_) {
+        EGLint eglRects[DamageTracker::kMaxRects * 4];
+        for (int i = 0; i < count; i++) {
+            eglRects[i * 4] = rects[i].x0;
+            eglRects[i * 4 + 1] = rects[i].y0;
+            eglRects[i * 4 + 2] = rects[i].getWidth();
+            eglRects[i * 4 + 3] = rects[i].getHeight();
+        }
+        setDamageRegion_(display_, surface_, eglRects, count);
+    }
+
+    // One scissor around all of it, drawing is cheap next to the fill it saves
+    const DamageTracker::Rect bounds = DamageTracker::getBounds(rects, count);
+    if (bounds.getWidth() < width_ || bounds.getHeight() < height_) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(bounds.x0, bounds.y0, bounds.getWidth(), bounds.getHeight());
+    }
+    redrawnArea.record(uint64_t(bounds.getWidth()) * bounds.getHeight() * 100
+                       / std::max(1, width_ * height_));
+}
+
+bool Renderer::presentDamagedFrame() {
+    glDisable(GL_SCISSOR_TEST);
+    bool swapped;
+    if (swapBuffersWithDamage_) {
+        DamageTracker::Rect rects[DamageTracker::kMaxRects];
+        int count = damage_.getFrameRects(rects);
+        if (count == 0) {
+            rects[0] = {0, 0, 1, 1};
+            count = 1;
+        }
+        EGLint eglRects[DamageTracker::kMaxRects * 4];
+        for (int i = 0; i < count; i++) {
+            eglRects[i * 4] = rects[i].x0;
+            eglRects[i * 4 + 1] = rects[i].y0;
+            eglRects[i * 4 + 2] = rects[i].getWidth();
+            eglRects[i * 4 + 3] = rects[i].getHeight();
+        }
+        swapped = swapBuffersWithDamage_(display_, surface_, eglRects, count) == EGL_TRUE;
+    } else {
+        swapped = eglSwapBuffers(display_, surface_) == EGL_TRUE;
+    }
+    damage_.endFrame();
+    return swapped;
+}
+
+const char *Renderer::describeTankFallback() const {
+    return tankTexture_ ? "keeping the previous tank texture" : "drawing tanks as red squares";
+}
+
+void Renderer::loadTankTexture(std::vector<uint8_t> png) {
+    // What an upload keeps between its steps: decode, create the texture, then bands of rows. The
+    // PNG is the upload's own, releasing caches on low memory cannot take it from under the decode.
+    struct Upload {
+        std::vector<uint8_t> png;
+        std::vector<uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+        std::unique_ptr<OverlayTexture> texture;
+        int row = 0;
+    };
+    auto upload = std::make_shared<Upload>();
+    upload->png = std::move(png);
+    tankImageBytes_ += upload->png.capacity();
+
+    glTasks_.post("Renderer::loadTankTexture", GlTaskQueue::kPriorityVisible, [this, upload]() {
+        if (upload->pixels.empty()) {
+            const bool decoded = decodeTankImage(upload->png, upload->pixels, upload->width,
+                                                 upload->height);
+            // The PNG was only staging for the upload
+            tankImageBytes_ -= upload->png.capacity();
+            std::vector<uint8_t>().swap(upload->png);
+            if (!decoded) {
+                aout << "Failed to decode tank PNG, " << describeTankFallback() << std::endl;
+                return true;
+            }
+            return false;
+        }
+        if (!upload->texture) {
+            upload->texture = OverlayTexture::create(upload->width, upload->height, GL_RGBA8,
+                                                     GL_LINEAR);
+            if (!upload->texture) {
+                aout << "Failed to create tank texture, " << describeTankFallback() << std::endl;
+                return true;
+            }
+            return false;
+        }
+
+        const size_t rowBytes = size_t(upload->width) * 4;
+        const int rows = std::clamp(int(kUploadBandBytes / rowBytes), 1,
+                                    upload->height - upload->row);
+        upload->texture->upload(0, upload->row, upload->width, rows,
+                                upload->pixels.data() + upload->row * rowBytes, upload->width);
+        upload->row += rows;
+        if (upload->row < upload->height) {
+            return false;
+        }
+
+        // Replaces the texture of a previous map only now, tanks never go without one
+        tankTexture_ = std::move(upload->texture);
+        // The red quads tanks were drawn as until now are replaced by textured ones
+        createUnitModels(frameAlpha_);
+        damage_.addFull();
+        aout << "Tank texture created using BitmapFactory, ID: " << tankTexture_->getTextureID()
+             << std::endl;
+        startup_.mark("tank texture");
+        trackMemory();
+        return true;
+    });
+}
+
+bool Renderer::decodeTankImage(const std::vector<uint8_t> &png, std::vector<uint8_t> &outPixels,
+                               int &outWidth, int &outHeight) {
+    SCROLLER_TRACE_SCOPE("Renderer::decodeTankImage");
+    if (png.empty()) {
         aout << "No tank image data to decode" << std::endl;
         return false;
     }
     
-    aout << "Decoding PNG data using BitmapFactory, size: " << tankImageData_.size() << " bytes" << std::endl;
+    aout << "Decoding PNG data using BitmapFactory, size: " << png.size() << " bytes" << std::endl;
     
     JNIEnv* env = getJNIEnv();
     if (!env) {
@@ -795,14 +1831,14 @@ bool Renderer::decodePNGToTexture() {
     }
     
     // Create byte array from image data
-    jbyteArray byteArray = env->NewByteArray(tankImageData_.size());
+    jbyteArray byteArray = env->NewByteArray(png.size());
     if (!byteArray) {
         aout << "Failed to create byte array" << std::endl;
         return false;
     }
     
-    env->SetByteArrayRegion(byteArray, 0, tankImageData_.size(), 
-                           reinterpret_cast<const jbyte*>(tankImageData_.data()));
+    env->SetByteArrayRegion(byteArray, 0, png.size(), 
+                           reinterpret_cast<const jbyte*>(png.data()));
     
     // Get BitmapFactory class and decodeByteArray method
     jclass bitmapFactoryClass = env->FindClass("android/graphics/BitmapFactory");
@@ -824,7 +1860,7 @@ bool Renderer::decodePNGToTexture() {
     
     // Decode the image
     jobject bitmap = env->CallStaticObjectMethod(bitmapFactoryClass, decodeByteArrayMethod, 
-                                                byteArray, 0, tankImageData_.size());
+                                                byteArray, 0, png.size());
     
     if (!bitmap) {
         aout << "Failed to decode bitmap" << std::endl;
@@ -844,10 +1880,18 @@ bool Renderer::decodePNGToTexture() {
         return false;
     }
     
-    tankTextureWidth_ = bitmapInfo.width;
-    tankTextureHeight_ = bitmapInfo.height;
+    // PNGs decode to RGBA_8888 unless they were asked not to
+    if (bitmapInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        aout << "Unexpected bitmap format: " << bitmapInfo.format << std::endl;
+        env->DeleteLocalRef(bitmap);
+        env->DeleteLocalRef(byteArray);
+        env->DeleteLocalRef(bitmapFactoryClass);
+        return false;
+    }
+    outWidth = int(bitmapInfo.width);
+    outHeight = int(bitmapInfo.height);
     
-    aout << "Tank image dimensions: " << tankTextureWidth_ << "x" << tankTextureHeight_ << std::endl;
+    aout << "Tank image dimensions: " << outWidth << "x" << outHeight << std::endl;
     
     // Lock bitmap pixels
     void* bitmapPixels;
@@ -860,21 +1904,14 @@ bool Renderer::decodePNGToTexture() {
         return false;
     }
     
-    // Create OpenGL texture
-    glGenTextures(1, &tankTextureId_);
-    glBindTexture(GL_TEXTURE_2D, tankTextureId_);
-    
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    
-    // Upload texture data - BitmapFactory typically returns RGBA_8888
-    GLenum format = (bitmapInfo.format == ANDROID_BITMAP_FORMAT_RGBA_8888) ? GL_RGBA : GL_RGB;
-    glTexImage2D(GL_TEXTURE_2D, 0, format, tankTextureWidth_, tankTextureHeight_, 0, 
-                format, GL_UNSIGNED_BYTE, bitmapPixels);
-    
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // Copied out so the bitmap can go now, the upload takes a few frames
+    const size_t rowBytes = size_t(outWidth) * 4;
+    outPixels.resize(rowBytes * outHeight);
+    for (int y = 0; y < outHeight; y++) {
+        memcpy(outPixels.data() + y * rowBytes,
+               static_cast<const uint8_t *>(bitmapPixels) + size_t(y) * bitmapInfo.stride,
+               rowBytes);
+    }
     
     // Unlock bitmap pixels
     AndroidBitmap_unlockPixels(env, bitmap);
@@ -884,9 +1921,6 @@ bool Renderer::decodePNGToTexture() {
     env->DeleteLocalRef(byteArray);
     env->DeleteLocalRef(bitmapFactoryClass);
     
-    tankTextureLoaded_ = true;
-    aout << "Tank texture created successfully using BitmapFactory, ID: " << tankTextureId_ << std::endl;
-    
     return true;
 }
 
@@ -915,38 +1949,17 @@ void Renderer::checkTankSelection(float worldX, float worldY) {
         return;
     }
     
-    // Input coordinates are already in world space, just account for scroll
-    float adjustedWorldX = worldX - scrollX_;
-    float adjustedWorldY = worldY - scrollY_;
-    
-    // Grid parameters (same as in createColoredGrid)
-    const int gridSize = std::max(mapData_.width, mapData_.height);
-    const float gridSpacing = 0.4f;
-    const float gridExtent = gridSize * gridSpacing * 0.5f;
-    
-    // Convert world coordinates to grid coordinates
-    // Reverse the formula used in createColoredGrid:
-    // cellX = -gridExtent + (x + 0.5f) * gridSpacing  =>  x = (cellX + gridExtent) / gridSpacing - 0.5
-    // cellY = gridExtent - (y + 0.5f) * gridSpacing   =>  y = (gridExtent - cellY) / gridSpacing - 0.5
-    float gridX = (adjustedWorldX + gridExtent) / gridSpacing - 0.5f;
-    float gridY = (gridExtent - adjustedWorldY) / gridSpacing - 0.5f;
+    // Convert world coordinates to the nearest grid cell
+    const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
+    int gx, gy;
+    const bool inBounds = layout.worldToCell(worldX, worldY, gx, gy);
     
-    // Convert to integer grid coordinates with proper rounding
-    int gx = (int)round(gridX);
-    int gy = (int)round(gridY);
-    
-    aout << "Touch conversion: world(" << worldX << ", " << worldY << ") -> adjusted(" << adjustedWorldX << ", " << adjustedWorldY << ") -> grid_float(" << gridX << ", " << gridY << ") -> grid_int(" << gx << ", " << gy << ")" << std::endl;
-    aout << "Grid extent: " << gridExtent << ", Grid spacing: " << gridSpacing << ", Scroll: (" << scrollX_ << ", " << scrollY_ << "), Zoom: " << zoomLevel_ << std::endl;
-    
-    // Debug: show expected cell center for this grid position
-    if (gx >= 0 && gx < mapData_.width && gy >= 0 && gy < mapData_.height) {
-        float expectedCellX = -gridExtent + (gx + 0.5f) * gridSpacing;
-        float expectedCellY = gridExtent - (gy + 0.5f) * gridSpacing;
-        aout << "Expected cell center for grid(" << gx << "," << gy << "): world(" << expectedCellX << ", " << expectedCellY << ")" << std::endl;
-    }
+    aout << "Touch conversion: world(" << worldX << ", " << worldY << ") -> grid(" << gx << ", " << gy << ")" << std::endl;
+    aout << "Grid extent: " << layout.extent << ", Grid spacing: " << GridLayout::kCellSpacing << ", Scroll: (" << scrollX_ << ", " << scrollY_ << "), Zoom: " << zoomLevel_ << std::endl;
     
     // Check if coordinates are within grid bounds
-    if (gx >= 0 && gx < mapData_.width && gy >= 0 && gy < mapData_.height) {
+    if (inBounds) {
+        aout << "Expected cell center for grid(" << gx << "," << gy << "): world(" << layout.cellCenterX(float(gx)) << ", " << layout.cellCenterY(float(gy)) << ")" << std::endl;
         char cellType = mapData_.data[gy * mapData_.width + gx];
         
         aout << "=== GRID CELL ANALYSIS ===" << std::endl;
@@ -957,19 +1970,27 @@ void Renderer::checkTankSelection(float worldX, float worldY) {
         
         if (cellType == 'x' || cellType == 'X') {
             // Tank found! Select it
+            aout << "Previous selection: " << (hasTankSelected_ ? "Yes" : "No") << std::endl;
             selectedTankX_ = gx;
             selectedTankY_ = gy;
+            selectedUnitId_ = simulation_.findUnitAt(gx, gy);
             hasTankSelected_ = true;
             
             aout << "*** TANK SELECTED! ***" << std::endl;
-            aout << "Selected tank at grid position (" << gx << ", " << gy << ")" << std::endl;
-            aout << "Previous selection: " << (hasTankSelected_ ? "Yes" : "No") << std::endl;
+            aout << "Selected tank at grid position (" << gx << ", " << gy << "), unit " << selectedUnitId_ << std::endl;
             
             // Create highlight overlay for selected tank
-            createHighlightOverlay();
+            createHighlightOverlay(frameAlpha_);
             
             // Send highlight request to server
             sendHighlightRequest(gx, gy);
+        } else if (hasTankSelected_
+                   && (regions_.isEmpty()
+                       || regions_.canReach(selectedTankX_, selectedTankY_, gx, gy))
+                   && simulation_.orderMove(selectedUnitId_, gx, gy, mapData_)) {
+            // Tapping a reachable cell sends the selected tank there, it stays selected. Cells in
+            // another region are turned down without a path search.
+            aout << "Selected tank ordered to grid position (" << gx << ", " << gy << ")" << std::endl;
         } else {
             // No tank at this position, clear selection
             aout << "No tank found - clearing selection" << std::endl;
@@ -989,61 +2010,42 @@ void Renderer::checkTankSelection(float worldX, float worldY) {
     }
 }
 
-void Renderer::createHighlightOverlay() {
-    aout << "=== CREATING HIGHLIGHT OVERLAY ===" << std::endl;
-    aout << "Has tank selected: " << (hasTankSelected_ ? "YES" : "NO") << std::endl;
-    
+void Renderer::createHighlightOverlay(float alpha) {
+    // Called every frame while a tank is selected, so this stays quiet in the log
     if (!hasTankSelected_) {
         highlightModels_.clear();
-        aout << "No tank selected - clearing highlight models" << std::endl;
         return;
     }
     
-    aout << "Selected tank position: (" << selectedTankX_ << ", " << selectedTankY_ << ")" << std::endl;
+    const GridLayout layout = GridLayout::forMap(mapData_.width, mapData_.height);
     
-    // Grid parameters (same as in createColoredGrid)
-    const int gridSize = std::max(mapData_.width, mapData_.height);
-    const float gridSpacing = 0.4f;
-    const float gridExtent = gridSize * gridSpacing * 0.5f;
-    const float cellSize = gridSpacing * 0.8f;
+    // Follow the selected tank while it drives, otherwise stay on the selected cell
+    float tankX = selectedTankX_;
+    float tankY = selectedTankY_;
+    if (selectedUnitId_ >= 0 && selectedUnitId_ < (int) simulation_.getUnits().size()) {
+        simulation_.getInterpolatedPosition(
+                simulation_.getUnits()[selectedUnitId_], alpha, tankX, tankY);
+    }
     
     // Calculate position of selected tank
-    float cellX = -gridExtent + (selectedTankX_ + 0.5f) * gridSpacing;
-    float cellY = gridExtent - (selectedTankY_ + 0.5f) * gridSpacing;
+    float cellX = layout.cellCenterX(tankX);
+    float cellY = layout.cellCenterY(tankY);
     
-    // Create red highlight overlay (slightly larger than the tank)
-    float highlightSize = cellSize * 1.1f; // 10% larger for visible border
+    // Create red highlight overlay (slightly larger than the tank), pulsing with simulation time
+    float pulse = 0.05f * std::sin(simulation_.getAnimationTime(alpha) * 2.0f * float(M_PI));
+    float highlightSize = GridLayout::cellSize() * (1.1f + pulse); // 10% larger for visible border
     Vector3 highlightColor = {1.0f, 0.0f, 0.0f}; // Red
     
-    std::vector<Vertex> highlightVertices;
-    std::vector<Index> highlightIndices;
-    
-    // Create highlight border (outline only)
-    Index baseIndex = highlightVertices.size();
-    
-    // Add vertices for highlight border
-    highlightVertices.emplace_back(Vector3{cellX - highlightSize/2, cellY + highlightSize/2, 0.01f}, highlightColor); // Top-left (slightly above)
-    highlightVertices.emplace_back(Vector3{cellX + highlightSize/2, cellY + highlightSize/2, 0.01f}, highlightColor); // Top-right
-    highlightVertices.emplace_back(Vector3{cellX + highlightSize/2, cellY - highlightSize/2, 0.01f}, highlightColor); // Bottom-right
-    highlightVertices.emplace_back(Vector3{cellX - highlightSize/2, cellY - highlightSize/2, 0.01f}, highlightColor); // Bottom-left
-    
-    // Add indices for highlight outline (thick lines)
-    highlightIndices.push_back(baseIndex);     highlightIndices.push_back(baseIndex + 1); // Top
-    highlightIndices.push_back(baseIndex + 1); highlightIndices.push_back(baseIndex + 2); // Right  
-    highlightIndices.push_back(baseIndex + 2); highlightIndices.push_back(baseIndex + 3); // Bottom
-    highlightIndices.push_back(baseIndex + 3); highlightIndices.push_back(baseIndex);     // Left
-    
-    // Clear and create new highlight model
-    highlightModels_.clear();
-    if (!highlightVertices.empty()) {
-        highlightModels_.emplace_back(highlightVertices, highlightIndices);
-        aout << "Created highlight overlay for tank at (" << selectedTankX_ << ", " << selectedTankY_ << ")" << std::endl;
-        aout << "Highlight model: " << highlightVertices.size() << " vertices, " << highlightIndices.size() << " indices" << std::endl;
-        aout << "Highlight position: (" << cellX << ", " << cellY << "), size: " << highlightSize << std::endl;
-    } else {
-        aout << "ERROR: No highlight vertices created!" << std::endl;
-    }
-    aout << "=== END HIGHLIGHT CREATION ===" << std::endl;
+    // Highlight border (outline only), slightly above the tank
+    const float half = highlightSize / 2;
+    highlightBuilder_.recycle(highlightModels_);
+    highlightBuilder_.begin(MeshBuilder<Vertex, Model>::kOutline, 1, highlightModels_);
+    highlightBuilder_.addOutline(
+            Vertex(Vector3{cellX - half, cellY + half, 0.01f}, highlightColor),
+            Vertex(Vector3{cellX + half, cellY + half, 0.01f}, highlightColor),
+            Vertex(Vector3{cellX + half, cellY - half, 0.01f}, highlightColor),
+            Vertex(Vector3{cellX - half, cellY - half, 0.01f}, highlightColor));
+    highlightBuilder_.finish();
 }
 
 float Renderer::calculateDistance(float x1, float y1, float x2, float y2) {
@@ -1053,43 +2055,22 @@ float Renderer::calculateDistance(float x1, float y1, float x2, float y2) {
 }
 
 void Renderer::updateProjectionMatrixWithZoom() {
-    // Clear the projection matrix
-    memset(projectionMatrix_, 0, sizeof(projectionMatrix_));
+    // Logs, which is fine outside the steady state
+    markFrameChanged();
 
-    // Apply zoom to the projection matrix by scaling the half height
-    float zoomedHalfHeight = kProjectionHalfHeight / zoomLevel_;
-    
-    // Build an orthographic projection matrix for 2d rendering with zoom
-    Utility::buildOrthographicMatrix(
-            projectionMatrix_,
-            zoomedHalfHeight,
-            float(width_) / height_,
-            kProjectionNearPlane,
-            kProjectionFarPlane);
-
-    // Send the matrix to all shaders
-    shader_->setProjectionMatrix(projectionMatrix_);
-    if (triangleShader_) {
-        triangleShader_->setProjectionMatrix(projectionMatrix_);
-    }
-    if (textureShader_) {
-        textureShader_->setProjectionMatrix(projectionMatrix_);
-    }
+    // The camera rebuilds its matrices lazily, render() sends them to the shaders
+    camera_.setViewport(width_, height_);
+    camera_.setZoom(zoomLevel_);
     
     aout << "Updated projection matrix with zoom level: " << zoomLevel_ << std::endl;
 }
 
 void Renderer::convertScreenToWorld(float screenX, float screenY, float& worldX, float& worldY) {
-    // Convert screen coordinates to world coordinates with zoom support
-    float aspect = float(width_) / float(height_);
-    float zoomedHalfHeight = kProjectionHalfHeight / zoomLevel_;
-    float zoomedHalfWidth = zoomedHalfHeight * aspect;
-    
-    float normalizedX = ((screenX / float(width_)) * 2.0f - 1.0f) * zoomedHalfWidth;
-    float normalizedY = -(((screenY / float(height_)) * 2.0f - 1.0f) * zoomedHalfHeight);
-    
-    worldX = normalizedX;
-    worldY = normalizedY;
+    // Gestures work relative to the camera, which moves along while scrolling, so the scroll is
+    // added back to the grid space position
+    camera_.screenToWorld(screenX, screenY, worldX, worldY);
+    worldX += camera_.getPositionX();
+    worldY += camera_.getPositionY();
 }
 
 void Renderer::sendHighlightRequest(int gridX, int gridY) {
@@ -1104,9 +2085,20 @@ void Renderer::sendHighlightRequest(int gridX, int gridY) {
     
     aout << "JSON payload: " << jsonPayload << std::endl;
     
+    // A replay must not talk to the server, the recorded response is in the log
+    if (player_) {
+        aout << "Highlight request skipped during replay" << std::endl;
+        return;
+    }
+
     // Send POST request
     std::string response;
-    bool success = NetworkDownloader::postJSON("http://nasmo2.myqnapcloud.com:8585/tanks/index.php", jsonPayload, response);
+    bool success = NetworkDownloader::postJSON(serverUrl_ + "/tanks/index.php", jsonPayload,
+                                               response);
+    if (recorder_) {
+        recorder_->recordNetworkCompletion(SessionLog::kRequestHighlightPost, success,
+                                           response.data(), response.size());
+    }
     
     if (success) {
         aout << "Highlight request sent successfully!" << std::endl;
@@ -2,12 +2,37 @@
 #define ANDROIDGLINVESTIGATIONS_RENDERER_H
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <atomic>
 #include <memory>
+#include <optional>
 
+#include "Camera.h"
+#include "DamageTracker.h"
+#include "FramePacer.h"
+#include "GlTaskQueue.h"
+#include "InfluenceMap.h"
+#include "LayerCache.h"
+#include "JobSystem.h"
+#include "MapGeneration.h"
+#include "MapGenerator.h"
+#include "MeshBuilder.h"
 #include "Model.h"
 #include "Shader.h"
 #include "TextureShader.h"
 #include "NetworkDownloader.h"
+#include "OverlayTexture.h"
+#include "RegionLabeler.h"
+#include "RegionStats.h"
+#include "ResourceManager.h"
+#include "ScratchArena.h"
+#include "SessionRecording.h"
+#include "Simulation.h"
+#include "SimulationClock.h"
+#include "StartupTimeline.h"
+#include "TileCache.h"
+#include "Trace.h"
+#include "VisibilityMap.h"
 #include <jni.h>
 
 struct android_app;
@@ -26,6 +51,8 @@ public:
             height_(0),
             shaderNeedsNewProjectionMatrix_(true),
             mapDataLoaded_(false),
+            tankImageBytes_(0),
+            staticLayerVersion_(0),
             scrollX_(0.0f),
             scrollY_(0.0f),
             lastTouchX_(0.0f),
@@ -38,7 +65,29 @@ public:
             lastPinchDistance_(0.0f),
             selectedTankX_(-1),
             selectedTankY_(-1),
-            hasTankSelected_(false) {
+            selectedUnitId_(-1),
+            hasTankSelected_(false),
+            clock_(kSimulationTickRate),
+            frameAlpha_(0.0f),
+            unitsWereMoving_(false),
+            frameStartNanos_(0),
+            replayTicks_(0),
+            replayAlpha_(0.0f),
+            replaySurfaceWidth_(0),
+            replaySurfaceHeight_(0),
+            presentationTime_(nullptr),
+            setDamageRegion_(nullptr),
+            swapBuffersWithDamage_(nullptr),
+            bufferAgeSupported_(false),
+            damageCameraVersion_(0),
+            damageContentVersion_(0),
+            highlightDamage_{0, 0, 0, 0},
+            framesSinceChange_(0),
+            frameAllocations_(0),
+            pendingGeneration_(nullptr),
+            downloadedMapOk_(false),
+            downloadedImageOk_(false),
+            mapLoadCancelled_(false) {
         touch1_.active = false;
         touch2_.active = false;
         initRenderer();
@@ -46,6 +95,12 @@ public:
 
     virtual ~Renderer();
 
+    /*!
+     * @return how long the loop can wait for events before the next frame is due in milliseconds,
+     *         0 if it is due now. A frame is handleInput(), update() and render().
+     */
+    int getFrameWaitMillis();
+
     /*!
      * Handles input from the android_app.
      *
@@ -53,12 +108,72 @@ public:
      */
     void handleInput();
 
+    /*!
+     * Advances the simulation by however many fixed ticks fit into the time since the last call.
+     * Call this once per frame, before @a render().
+     */
+    void update();
+
     /*!
      * Renders all the models in the renderer
      */
     void render();
 
+    /*!
+     * Frees what can be rebuilt when the system runs low on memory (APP_CMD_LOW_MEMORY)
+     */
+    void onLowMemory();
+
+    /*!
+     * @return a breakdown of the CPU and GPU memory the renderer holds
+     */
+    std::string getMemoryReport();
+
+    /*!
+     * Downloads the map again and builds it in the background. The current map stays on screen
+     * and is swapped for the new one at the start of the frame after the build finished. Does
+     * nothing while replaying or while a load is already running.
+     */
+    void reloadMap();
+
 private:
+    /*!
+     * Applies a single motion event, live or replayed, to scrolling, zoom and selection
+     */
+    void processMotionEvent(const RecordedMotionEvent &event);
+
+    /*!
+     * Picks the tanks server, then starts replaying a session log if one was provided, otherwise
+     * starts recording one when session recording is enabled
+     */
+    void startSession();
+
+    /*!
+     * Feeds the recorded input, network completions and map snapshots of the next frame
+     */
+    void replayFrameInput();
+
+    /*!
+     * Reports the replay frame timings and returns to live input
+     */
+    void finishReplay();
+
+    /*!
+     * Notes that something happened this frame that is allowed to allocate (input, a new map, a
+     * resize...), which ends the steady state for a while
+     */
+    void markFrameChanged();
+
+    /*!
+     * Updates the sizes of every resource in @a resources_
+     */
+    void trackMemory();
+
+    /*!
+     * Writes every metric to logcat and to the metrics file
+     */
+    void dumpMetrics();
+
     /*!
      * Performs necessary OpenGL initialization. Customize this if you want to change your EGL
      * context or application-wide settings.
@@ -78,24 +193,147 @@ private:
     void createModels();
     
     /*!
-     * Downloads and processes map data
+     * Downloads the map and the tank image. Runs as a background job and only touches the
+     * downloaded* members.
      */
     void downloadMapData();
+
+    /*!
+     * Builds the downloaded map into pendingGeneration_. Runs as @a mapLoadJob_ once the download
+     * finished.
+     * @param tilePath where a map too large for a mesh is written
+     */
+    void buildDownloadedMap(const std::string &tilePath);
+
+    /*!
+     * Takes over the built map and the tank image once @a mapLoadJob_ is done and decodes the
+     * image, or falls back to the test map if a download failed
+     */
+    void applyDownloadedMap();
     
     /*!
-     * Creates fallback test map data when network download fails
+     * Generates a map to play on when the network download fails
      */
     void createFallbackMapData();
     
     /*!
-     * Creates colored grid based on map data
+     * Builds everything derived from mapData_ right away after a new map was loaded, for maps
+     * that have to be on screen this frame: replays and the small fallback map
+     * @param generatedFrom the parameters mapData_ was generated from, recordings store them
+     *                      instead of the cells
+     */
+    void onMapLoaded(const MapGenerator::Params *generatedFrom = nullptr);
+
+    /*!
+     * Swaps a built map in for the current one and resets everything that depends on the map:
+     * units, selection, fog of war and the heat map
+     */
+    void adoptGeneration(std::unique_ptr<MapGeneration> generation,
+                         const MapGenerator::Params *generatedFrom);
+
+    /*!
+     * Frees a map that was swapped out, off the render thread
+     */
+    void retireGeneration(std::unique_ptr<MapGeneration> generation);
+
+    /*!
+     * Creates the white grid shown until a map is loaded
      */
     void createColoredGrid();
+
+    /*!
+     * Draws what only changes with the map: the tiles or the cell outlines and objects. Leaves the
+     * line shader active with @a viewProjection.
+     */
+    void drawStaticLayer(const float *viewProjection);
+
+    /*!
+     * Moves the tile file of a newly adopted map into place and opens a tile cache on it
+     * @return false if the tile file could not be opened, the map is not drawn then
+     */
+    bool openTileCache();
+
+    /*!
+     * Creates the tank quads from the simulation, interpolated between the last two ticks. They are
+     * textured once the tank texture is uploaded and plain red until then, or if it failed.
+     * @param alpha the interpolation factor from the simulation clock
+     */
+    void createUnitModels(float alpha);
+
+    /*!
+     * The red quads of @a createUnitModels()
+     */
+    void createUnitColorModels(float alpha);
     
     /*!
-     * Decodes PNG image data and creates OpenGL texture using BitmapFactory (API 24+ compatible)
+     * Computes the fog of war for the current map and creates the overlay that displays it
+     */
+    void createFogOfWar();
+
+    /*!
+     * Recomputes visibility for units that moved and uploads the changed part of the fog mask
+     */
+    void updateFogOfWar();
+
+    /*!
+     * Stamps every tank into the influence map and creates the heat map overlay
      */
-    bool decodePNGToTexture();
+    void createHeatMap();
+
+    /*!
+     * Uploads the part of the heat map that changed since the last frame
+     */
+    void updateHeatMap();
+    
+    /*!
+     * Queues the tank image to be decoded and uploaded on the GL thread, a band of rows per step,
+     * replacing the tank texture once the whole image is uploaded
+     * @param png the encoded image, owned by the upload until it is decoded
+     */
+    void loadTankTexture(std::vector<uint8_t> png);
+
+    /*!
+     * @return how tanks are drawn when a tank texture cannot be made, for the log
+     */
+    const char *describeTankFallback() const;
+
+    /*!
+     * Decodes a PNG into RGBA pixels using BitmapFactory (API 24+ compatible)
+     * @return false if the image could not be decoded
+     */
+    bool decodeTankImage(const std::vector<uint8_t> &png, std::vector<uint8_t> &outPixels,
+                         int &outWidth, int &outHeight);
+
+    /*!
+     * Damages what changed since the last frame besides the overlay textures, which damage what
+     * they upload themselves: everything after scrolling, zooming or a new map, otherwise the
+     * units that moved and the highlight
+     * @param contentVersion the version of the map layer this frame draws
+     */
+    void trackDamage(float alpha, uint64_t contentVersion);
+
+    /*!
+     * @return the pixels of the surface a rectangle in grid space covers, with some padding
+     */
+    DamageTracker::Rect worldToPixels(float left, float bottom, float right, float top);
+
+    /*!
+     * Damages a rectangle of map cells, fractional for things between cells
+     * @param x1, y1 the exclusive end
+     */
+    void addCellDamage(float x0, float y0, float x1, float y1);
+
+    /*!
+     * Tells EGL which part of the back buffer is drawn and limits drawing to it with the scissor
+     */
+    void beginDamagedFrame();
+
+    /*!
+     * Swaps, telling the compositor what changed where EGL supports that, and starts tracking the
+     * damage of the next frame
+     * @return false if the swap failed
+     */
+    bool presentDamagedFrame();
     
     /*!
      * Helper function to get JNI environment
@@ -103,14 +341,15 @@ private:
     JNIEnv* getJNIEnv();
     
     /*!
-     * Converts screen coordinates to grid coordinates and checks for tank selection
+     * Finds the grid cell at a position in grid space and checks for tank selection
      */
     void checkTankSelection(float worldX, float worldY);
     
     /*!
      * Creates highlight overlay for selected tank
+     * @param alpha the interpolation factor from the simulation clock
      */
-    void createHighlightOverlay();
+    void createHighlightOverlay(float alpha);
     
     /*!
      * Helper methods for zoom functionality
@@ -143,21 +382,52 @@ private:
     std::unique_ptr<Shader> shader_;
     std::unique_ptr<Shader> triangleShader_;
     std::unique_ptr<TextureShader> textureShader_;
+    std::unique_ptr<TextureShader> fogShader_;
+    std::unique_ptr<TextureShader> heatShader_;
     std::vector<Model> models_;
     std::vector<Model> triangleModels_;
     std::vector<TexturedModel> texturedModels_;
+    //! the tanks as red quads while there is no tank texture
+    std::vector<Model> unitColorModels_;
     std::vector<Model> highlightModels_;
+    std::vector<TexturedModel> fogModels_;
+    std::vector<TexturedModel> heatModels_;
+
+    // Mesh builders keep the storage of the models they rebuild, see MeshBuilder
+    MeshBuilder<Vertex, Model> gridBuilder_;
+    MeshBuilder<Vertex, Model> highlightBuilder_;
+    MeshBuilder<TexturedVertex, TexturedModel> unitBuilder_;
+    MeshBuilder<Vertex, Model> unitColorBuilder_;
     
     // Map data
     NetworkDownloader::MapData mapData_;
     bool mapDataLoaded_;
-    std::vector<uint8_t> tankImageData_;
+    //! the encoded tank images uploads hold until they decode them, for the memory report
+    size_t tankImageBytes_;
     
-    // Tank texture data
-    GLuint tankTextureId_;
-    int tankTextureWidth_;
-    int tankTextureHeight_;
-    bool tankTextureLoaded_;
+    //! the tank sprite, null until the image is decoded and uploaded
+    std::unique_ptr<OverlayTexture> tankTexture_;
+
+    //! Cell counts per rectangle, kept in step with mapData_
+    RegionStats regionStats_;
+    //! Connected open cells, kept in step with mapData_, answers whether a cell can be reached
+    RegionLabeler regions_;
+
+    // Fog of war
+    VisibilityMap visibility_;
+    std::unique_ptr<OverlayTexture> fogTexture_;
+
+    // Where tanks cluster
+    InfluenceMap influence_;
+    std::unique_ptr<OverlayTexture> heatTexture_;
+
+    //! Draws maps larger than MapGeneration::kMaxMeshCells instead of the grid meshes
+    std::unique_ptr<TileCache> tileCache_;
+
+    //! The map as drawn by drawStaticLayer(), null if the GPU cannot render to a texture that size
+    std::unique_ptr<LayerCache> layerCache_;
+    //! changes whenever drawStaticLayer() draws different meshes
+    uint32_t staticLayerVersion_;
     
     // Scrolling variables
     float scrollX_;
@@ -181,14 +451,85 @@ private:
     bool isPinching_;
     float lastPinchDistance_;
     
-    // Matrix storage for sharing between shaders
-    float projectionMatrix_[16];
-    float modelMatrix_[16];
+    //! Zoom and scroll as matrices, shared by every shader
+    Camera camera_;
     
     // Selection tracking
     int selectedTankX_;
     int selectedTankY_;
+    int selectedUnitId_;
     bool hasTankSelected_;
+
+    // Fixed timestep simulation
+    //! Simulation ticks per second, independent of the display refresh rate
+    static constexpr int kSimulationTickRate = 30;
+    SimulationClock clock_;
+    Simulation simulation_;
+    float frameAlpha_;
+    //! whether units moved in the last frame, their meshes are rebuilt once more after they stop
+    bool unitsWereMoving_;
+
+    // Session recording and deterministic replay
+    std::unique_ptr<SessionRecorder> recorder_;
+    std::unique_ptr<SessionPlayer> player_;
+    int64_t frameStartNanos_;
+    int replayTicks_;
+    float replayAlpha_;
+    int replaySurfaceWidth_;
+    int replaySurfaceHeight_;
+
+    // GL thread work spread over frames
+    GlTaskQueue glTasks_;
+
+    // Frame pacing, presentationTime_ is null where EGL does not have it
+    FramePacer framePacer_;
+    PFNEGLPRESENTATIONTIMEANDROIDPROC presentationTime_;
+
+    // Partial redraws, the extension functions are null where EGL does not have them
+    DamageTracker damage_;
+    PFNEGLSETDAMAGEREGIONKHRPROC setDamageRegion_;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapBuffersWithDamage_;
+    //! EGL_BUFFER_AGE_KHR can be queried, without it every frame is drawn completely
+    bool bufferAgeSupported_;
+    //! what the last frame was drawn with, a change damages everything
+    uint32_t damageCameraVersion_;
+    uint64_t damageContentVersion_;
+    //! where every unit was drawn in the last frame, in cells, x and y interleaved
+    std::vector<float> unitDamagePositions_;
+    //! where the highlight was drawn in the last frame
+    DamageTracker::Rect highlightDamage_;
+
+    // Per frame memory
+    //! Frames without input or other changes after which a frame must not allocate
+    static constexpr int kSteadyStateFrames = 30;
+    //! Transient data of the current frame, rewound at the end of render()
+    ScratchArena frameArena_;
+    int framesSinceChange_;
+    uint32_t frameAllocations_;
+
+    //! CPU and GPU memory accounting, refreshed by trackMemory()
+    ResourceManager resources_;
+
+    // Startup
+    StartupTimeline startup_;
+    //! Base URL of the tanks server, without a trailing slash
+    std::string serverUrl_;
+    //! Downloads and builds the map, the first time while EGL and the shaders are set up. The
+    //! downloaded* members and pendingGeneration_ are final once it is done.
+    JobSystem::Handle mapLoadJob_;
+    //! Async trace span of the load, from scheduling it here to taking the map over. The work in
+    //! between runs on other threads.
+    std::optional<TraceAsyncSpan> mapLoadSpan_;
+    //! A built map waiting for the next frame, handed over from the job in one atomic exchange
+    std::atomic<MapGeneration *> pendingGeneration_;
+    MapData downloadedMap_;
+    //! the map response as it came, for the session log
+    std::vector<uint8_t> downloadedMapBody_;
+    std::vector<uint8_t> downloadedTankImage_;
+    bool downloadedMapOk_;
+    bool downloadedImageOk_;
+    //! Set when the renderer goes away, the load skips what is left of it
+    std::atomic<bool> mapLoadCancelled_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "ResourceManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "AndroidOut.h"
+
+static constexpr double kBytesPerKiB = 1024.0;
+
+void ResourceManager::track(const char *name, Category category, size_t cpuBytes, size_t gpuBytes) {
+    for (auto &resource: resources_) {
+        if (strcmp(resource.name, name) == 0) {
+            resource.category = category;
+            resource.cpuBytes = cpuBytes;
+            resource.gpuBytes = gpuBytes;
+            return;
+        }
+    }
+    resources_.push_back({name, category, cpuBytes, gpuBytes});
+}
+
+void ResourceManager::untrack(const char *name) {
+    resources_.erase(
+            std::remove_if(resources_.begin(), resources_.end(), [name](const Resource &resource) {
+                return strcmp(resource.name, name) == 0;
+            }),
+            resources_.end());
+}
+
+void ResourceManager::registerCache(const char *name, EvictFunction evict) {
+    caches_.push_back({name, std::move(evict)});
+}
+
+size_t ResourceManager::evictCaches() {
+    size_t freed = 0;
+    for (auto &cache: caches_) {
+        size_t bytes = cache.evict();
+        if (bytes > 0) {
+            aout << "Evicted " << cache.name << ": " << bytes / kBytesPerKiB << " KiB" << std::endl;
+        }
+        freed += bytes;
+    }
+    return freed;
+}
+
+size_t ResourceManager::getCpuBytes(Category category) const {
+    size_t bytes = 0;
+    for (const auto &resource: resources_) {
+        if (resource.category == category) {
+            bytes += resource.cpuBytes;
+        }
+    }
+    return bytes;
+}
+
+size_t ResourceManager::getGpuBytes(Category category) const {
+    size_t bytes = 0;
+    for (const auto &resource: resources_) {
+        if (resource.category == category) {
+            bytes += resource.gpuBytes;
+        }
+    }
+    return bytes;
+}
+
+size_t ResourceManager::getTotalCpuBytes() const {
+    size_t bytes = 0;
+    for (const auto &resource: resources_) {
+        bytes += resource.cpuBytes;
+    }
+    return bytes;
+}
+
+size_t ResourceManager::getTotalGpuBytes() const {
+    size_t bytes = 0;
+    for (const auto &resource: resources_) {
+        bytes += resource.gpuBytes;
+    }
+    return bytes;
+}
+
+std::string ResourceManager::report() const {
+    std::ostringstream report;
+    report.setf(std::ios::fixed);
+    report.precision(1);
+
+    report << "Memory: cpu " << getTotalCpuBytes() / kBytesPerKiB << " KiB, gpu "
+           << getTotalGpuBytes() / kBytesPerKiB << " KiB\n";
+    for (int category = 0; category < kCategoryCount; category++) {
+        const auto current = Category(category);
+        report << "  " << getCategoryName(current) << ": cpu " << getCpuBytes(current) / kBytesPerKiB
+               << " KiB, gpu " << getGpuBytes(current) / kBytesPerKiB << " KiB\n";
+        for (const auto &resource: resources_) {
+            if (resource.category == current) {
+                report << "    " << resource.name << ": cpu " << resource.cpuBytes / kBytesPerKiB
+                       << " KiB, gpu " << resource.gpuBytes / kBytesPerKiB << " KiB\n";
+            }
+        }
+    }
+    return report.str();
+}
+
+const char *ResourceManager::getCategoryName(Category category) {
+    switch (category) {
+        case kCategoryMap:
+            return "map";
+        case kCategoryMeshes:
+            return "meshes";
+        case kCategoryImages:
+            return "images";
+        case kCategoryTextures:
+            return "textures";
+        case kCategoryGameState:
+            return "game state";
+        case kCategoryScratch:
+            return "scratch";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef SCROLLER_RESOURCEMANAGER_H
+#define SCROLLER_RESOURCEMANAGER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*!
+ * Keeps book of the memory the app holds on the CPU and on the GPU, and of the caches that can give
+ * memory back when the system runs low.
+ *
+ * Resources are identified by a name that must outlive the manager (a string literal), and report
+ * their size whenever it changes. GPU sizes are estimates from the texture and buffer formats,
+ * drivers add their own overhead.
+ */
+class ResourceManager {
+public:
+    enum Category {
+        kCategoryMap,
+        kCategoryMeshes,
+        kCategoryImages,
+        kCategoryTextures,
+        kCategoryGameState,
+        kCategoryScratch,
+        kCategoryCount,
+    };
+
+    /*!
+     * Frees memory of a cache
+     * @return the number of bytes freed
+     */
+    typedef std::function<size_t()> EvictFunction;
+
+    /*!
+     * Sets the current size of a resource, adding it if it is new
+     * @param name the resource, must stay valid as long as the manager exists
+     * @param category where the resource is counted in the report
+     * @param cpuBytes bytes held in main memory
+     * @param gpuBytes bytes held in GL objects
+     */
+    void track(const char *name, Category category, size_t cpuBytes, size_t gpuBytes = 0);
+
+    /*!
+     * Forgets a resource, e.g. after its memory was freed
+     */
+    void untrack(const char *name);
+
+    /*!
+     * Registers a cache that can be emptied under memory pressure. Caches are evicted in the order
+     * they were registered, so register the cheapest to rebuild first.
+     */
+    void registerCache(const char *name, EvictFunction evict);
+
+    /*!
+     * Empties every registered cache
+     * @return the number of bytes freed
+     */
+    size_t evictCaches();
+
+    size_t getCpuBytes(Category category) const;
+    size_t getGpuBytes(Category category) const;
+    size_t getTotalCpuBytes() const;
+    size_t getTotalGpuBytes() const;
+
+    /*!
+     * @return a multi line breakdown of every category and resource
+     */
+    std::string report() const;
+
+    static const char *getCategoryName(Category category);
+
+private:
+    struct Resource {
+        const char *name;
+        Category category;
+        size_t cpuBytes;
+        size_t gpuBytes;
+    };
+
+    struct Cache {
+        const char *name;
+        EvictFunction evict;
+    };
+
+    std::vector<Resource> resources_;
+    std::vector<Cache> caches_;
+};
+
+#endif //SCROLLER_RESOURCEMANAGER_H
@@ -0,0 +1,77 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+
+ScratchArena::ScratchArena(size_t blockSize)
+        : blockSize_(std::max<size_t>(blockSize, 64)),
+          currentBlock_(0),
+          offset_(0),
+          usedBytes_(0),
+          blockAllocations_(0) {
+    // blocks_ is reserved up front so growing it never shows up as an allocation after startup
+    blocks_.reserve(8);
+}
+
+void ScratchArena::reset() {
+    if (blocks_.size() > 1) {
+        // The last round did not fit into one block, replace them all with one that fits
+        size_t total = getCapacityBytes();
+        blocks_.clear();
+        addBlock(total);
+    }
+
+    currentBlock_ = 0;
+    offset_ = 0;
+    usedBytes_ = 0;
+}
+
+size_t ScratchArena::releaseMemory() {
+    size_t freed = getCapacityBytes();
+    blocks_.clear();
+    currentBlock_ = 0;
+    offset_ = 0;
+    usedBytes_ = 0;
+    return freed;
+}
+
+size_t ScratchArena::getCapacityBytes() const {
+    size_t capacity = 0;
+    for (const auto &block: blocks_) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+
+void *ScratchArena::allocateBytes(size_t size, size_t alignment) {
+    if (blocks_.empty()) {
+        addBlock(std::max(blockSize_, size + alignment));
+    }
+
+    while (true) {
+        Block &block = blocks_[currentBlock_];
+        auto base = reinterpret_cast<uintptr_t>(block.memory.get());
+        uintptr_t aligned = (base + offset_ + alignment - 1) & ~uintptr_t(alignment - 1);
+        size_t newOffset = (aligned - base) + size;
+
+        if (newOffset <= block.size) {
+            usedBytes_ += newOffset - offset_;
+            offset_ = newOffset;
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        // Move on to the next block, creating one big enough if there is none
+        if (currentBlock_ + 1 >= blocks_.size()) {
+            addBlock(std::max(block.size * 2, size + alignment));
+        }
+        currentBlock_++;
+        offset_ = 0;
+    }
+}
+
+void ScratchArena::addBlock(size_t minimumSize) {
+    Block block;
+    block.memory.reset(new uint8_t[minimumSize]);
+    block.size = minimumSize;
+    blocks_.push_back(std::move(block));
+    blockAllocations_++;
+}
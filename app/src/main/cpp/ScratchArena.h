@@ -0,0 +1,79 @@
+#ifndef SCROLLER_SCRATCHARENA_H
+#define SCROLLER_SCRATCHARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*!
+ * A bump allocator for short lived scratch data. Allocations are never freed individually, the
+ * whole arena is rewound with @a reset() instead. Memory is kept across resets, and if a round of
+ * allocations needed more than one block the blocks are merged, so after the first round of a
+ * repeated workload the arena stops touching the system allocator.
+ *
+ * Only trivially destructible types may be allocated, nothing is destroyed on reset.
+ */
+class ScratchArena {
+public:
+    /*!
+     * @param blockSize the size of the first block, later blocks grow to fit
+     */
+    explicit ScratchArena(size_t blockSize = 64 * 1024);
+
+    /*!
+     * @return uninitialized storage for @a count objects, valid until the next @a reset()
+     */
+    template<typename T>
+    inline T *allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "ScratchArena never runs destructors");
+        return static_cast<T *>(allocateBytes(count * sizeof(T), alignof(T)));
+    }
+
+    /*!
+     * Rewinds the arena, invalidating everything allocated from it
+     */
+    void reset();
+
+    /*!
+     * Frees every block, invalidating everything allocated from the arena. The next allocation
+     * starts over with a block of the initial size.
+     * @return the number of bytes freed
+     */
+    size_t releaseMemory();
+
+    /*!
+     * @return the bytes handed out since the last reset
+     */
+    inline size_t getUsedBytes() const { return usedBytes_; }
+
+    /*!
+     * @return the bytes owned by the arena
+     */
+    size_t getCapacityBytes() const;
+
+    /*!
+     * @return how many times the arena had to get memory from the system allocator
+     */
+    inline size_t getBlockAllocations() const { return blockAllocations_; }
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size;
+    };
+
+    void *allocateBytes(size_t size, size_t alignment);
+    void addBlock(size_t minimumSize);
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    size_t currentBlock_;
+    size_t offset_;
+    size_t usedBytes_;
+    size_t blockAllocations_;
+};
+
+#endif //SCROLLER_SCRATCHARENA_H
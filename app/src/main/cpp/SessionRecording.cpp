@@ -0,0 +1,380 @@
+#include "SessionRecording.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <sstream>
+
+#include "AndroidOut.h"
+#include "PackedCells.h"
+#include "SimulationClock.h"
+
+static constexpr char kMagic[4] = {'S', 'R', 'E', 'C'};
+
+/*!
+ * Frames buffered before the recorder flushes to disk
+ */
+static constexpr int kFramesPerFlush = 60;
+
+static void appendVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+static void appendFloat(std::vector<uint8_t> &out, float value) {
+    uint8_t bytes[sizeof(float)];
+    memcpy(bytes, &value, sizeof(float));
+    out.insert(out.end(), bytes, bytes + sizeof(float));
+}
+
+static void appendBytes(std::vector<uint8_t> &out, const void *data, size_t size) {
+    auto *bytes = static_cast<const uint8_t *>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+/*!
+ * Bounds checked reading of a record payload
+ */
+struct PayloadReader {
+    const uint8_t *data;
+    size_t remaining;
+
+    bool readVarint(uint64_t &outValue) {
+        outValue = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (remaining == 0) {
+                return false;
+            }
+            uint8_t byte = *data++;
+            remaining--;
+            outValue |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readFloat(float &outValue) {
+        return readBytes(&outValue, sizeof(float));
+    }
+
+    bool readBytes(void *outData, size_t size) {
+        if (remaining < size) {
+            return false;
+        }
+        memcpy(outData, data, size);
+        data += size;
+        remaining -= size;
+        return true;
+    }
+};
+
+std::unique_ptr<SessionRecorder> SessionRecorder::open(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        aout << "Failed to create session log " << path << std::endl;
+        return nullptr;
+    }
+
+    uint8_t header[6];
+    memcpy(header, kMagic, sizeof(kMagic));
+    header[4] = uint8_t(SessionLog::kVersion & 0xff);
+    header[5] = uint8_t(SessionLog::kVersion >> 8);
+    fwrite(header, 1, sizeof(header), file);
+
+    aout << "Recording session to " << path << std::endl;
+    auto recorder = std::unique_ptr<SessionRecorder>(new SessionRecorder(file));
+    recorder->lastTimestampNanos_ = SimulationClock::nowNanos();
+    return recorder;
+}
+
+SessionRecorder::~SessionRecorder() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void SessionRecorder::recordMotionEvent(const RecordedMotionEvent &event) {
+    payload_.clear();
+    const int pointerCount = std::min<int>(event.pointerCount, RecordedMotionEvent::kMaxPointers);
+    appendVarint(payload_, uint32_t(event.action));
+    appendVarint(payload_, uint32_t(pointerCount));
+    for (int i = 0; i < pointerCount; i++) {
+        appendFloat(payload_, event.x[i]);
+        appendFloat(payload_, event.y[i]);
+    }
+    writeRecord(SessionLog::kRecordMotionEvent);
+}
+
+void SessionRecorder::recordSurfaceSize(int width, int height) {
+    payload_.clear();
+    appendVarint(payload_, uint32_t(width));
+    appendVarint(payload_, uint32_t(height));
+    writeRecord(SessionLog::kRecordSurfaceSize);
+}
+
+void SessionRecorder::recordNetworkCompletion(
+        SessionLog::NetworkRequest request, bool success, const void *data, size_t size) {
+    payload_.clear();
+    payload_.push_back(request);
+    payload_.push_back(success ? 1 : 0);
+    appendVarint(payload_, size);
+    appendBytes(payload_, data, size);
+    writeRecord(SessionLog::kRecordNetworkCompletion);
+}
+
+void SessionRecorder::recordMapSnapshot(const MapData &mapData) {
+    payload_.clear();
+    PackedCells packed;
+    if (PackedCells::pack(mapData, packed)) {
+        packed.serialize(payload_);
+        writeRecord(SessionLog::kRecordPackedMapSnapshot);
+        return;
+    }
+
+    appendVarint(payload_, uint32_t(mapData.width));
+    appendVarint(payload_, uint32_t(mapData.height));
+    appendBytes(payload_, mapData.data.data(), mapData.data.size());
+    writeRecord(SessionLog::kRecordMapSnapshot);
+}
+
+void SessionRecorder::recordGeneratedMap(const MapGenerator::Params &params) {
+    payload_.clear();
+    appendVarint(payload_, params.seed);
+    appendVarint(payload_, uint32_t(params.width));
+    appendVarint(payload_, uint32_t(params.height));
+    appendVarint(payload_, uint32_t(params.featureSize));
+    appendFloat(payload_, params.objectDensity);
+    appendFloat(payload_, params.tankDensity);
+    appendFloat(payload_, params.colorDensity);
+    writeRecord(SessionLog::kRecordGeneratedMap);
+}
+
+void SessionRecorder::recordFrameEnd(int ticks, float alpha) {
+    payload_.clear();
+    appendVarint(payload_, uint32_t(ticks));
+    appendFloat(payload_, alpha);
+    writeRecord(SessionLog::kRecordFrameEnd);
+
+    if (++framesSinceFlush_ >= kFramesPerFlush) {
+        fflush(file_);
+        framesSinceFlush_ = 0;
+    }
+}
+
+void SessionRecorder::writeRecord(SessionLog::RecordType type) {
+    int64_t now = SimulationClock::nowNanos();
+    int64_t delta = std::max<int64_t>(0, now - lastTimestampNanos_);
+    lastTimestampNanos_ = now;
+
+    record_.clear();
+    record_.push_back(type);
+    appendVarint(record_, uint64_t(delta));
+    appendVarint(record_, payload_.size());
+    appendBytes(record_, payload_.data(), payload_.size());
+    fwrite(record_.data(), 1, record_.size(), file_);
+}
+
+std::unique_ptr<SessionPlayer> SessionPlayer::open(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return nullptr;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t bytesRead;
+    while ((bytesRead = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + bytesRead);
+    }
+    fclose(file);
+
+    if (data.size() < 6 || memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+        aout << "Not a session log: " << path << std::endl;
+        return nullptr;
+    }
+    uint16_t version = uint16_t(data[4] | (data[5] << 8));
+    if (version != SessionLog::kVersion) {
+        aout << "Unsupported session log version " << version << " in " << path << std::endl;
+        return nullptr;
+    }
+
+    aout << "Replaying session from " << path << " (" << data.size() << " bytes)" << std::endl;
+    auto player = std::unique_ptr<SessionPlayer>(new SessionPlayer(std::move(data)));
+
+    // Size the timing buffer up front so replayed frames measure no allocations of the player
+    player->position_ = 6;
+    SessionLog::Record record;
+    size_t frames = 0;
+    while (player->readRecord(record)) {
+        frames += record.type == SessionLog::kRecordFrameEnd;
+    }
+    player->frameTimes_.reserve(frames);
+    player->position_ = 6;
+    player->timestampNanos_ = 0;
+    return player;
+}
+
+bool SessionPlayer::readRecord(SessionLog::Record &outRecord) {
+    if (position_ >= data_.size()) {
+        return false;
+    }
+
+    PayloadReader reader{data_.data() + position_, data_.size() - position_};
+    uint8_t type;
+    uint64_t delta, size;
+    if (!reader.readBytes(&type, 1) || !reader.readVarint(delta) || !reader.readVarint(size)
+        || size > reader.remaining) {
+        aout << "Session log truncated at byte " << position_ << std::endl;
+        position_ = data_.size();
+        return false;
+    }
+
+    timestampNanos_ += int64_t(delta);
+    outRecord.type = SessionLog::RecordType(type);
+    outRecord.timestampNanos = timestampNanos_;
+    outRecord.payload = reader.data;
+    outRecord.payloadSize = size_t(size);
+
+    position_ = (reader.data - data_.data()) + size_t(size);
+    return true;
+}
+
+bool SessionPlayer::decodeMotionEvent(
+        const SessionLog::Record &record, RecordedMotionEvent &outEvent) {
+    PayloadReader reader{record.payload, record.payloadSize};
+    uint64_t action, pointerCount;
+    if (!reader.readVarint(action) || !reader.readVarint(pointerCount)
+        || pointerCount > RecordedMotionEvent::kMaxPointers) {
+        return false;
+    }
+
+    outEvent.action = int32_t(action);
+    outEvent.pointerCount = int32_t(pointerCount);
+    for (int i = 0; i < outEvent.pointerCount; i++) {
+        if (!reader.readFloat(outEvent.x[i]) || !reader.readFloat(outEvent.y[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SessionPlayer::decodeSurfaceSize(
+        const SessionLog::Record &record, int &outWidth, int &outHeight) {
+    PayloadReader reader{record.payload, record.payloadSize};
+    uint64_t width, height;
+    if (!reader.readVarint(width) || !reader.readVarint(height)) {
+        return false;
+    }
+    outWidth = int(width);
+    outHeight = int(height);
+    return true;
+}
+
+bool SessionPlayer::decodeFrameEnd(const SessionLog::Record &record, int &outTicks, float &outAlpha) {
+    PayloadReader reader{record.payload, record.payloadSize};
+    uint64_t ticks;
+    if (!reader.readVarint(ticks) || !reader.readFloat(outAlpha)) {
+        return false;
+    }
+    outTicks = int(ticks);
+    return true;
+}
+
+bool SessionPlayer::decodeNetworkCompletion(
+        const SessionLog::Record &record,
+        SessionLog::NetworkRequest &outRequest,
+        bool &outSuccess,
+        std::vector<uint8_t> &outData) {
+    PayloadReader reader{record.payload, record.payloadSize};
+    uint8_t request, success;
+    uint64_t size;
+    if (!reader.readBytes(&request, 1) || !reader.readBytes(&success, 1)
+        || !reader.readVarint(size) || size > reader.remaining) {
+        return false;
+    }
+
+    outRequest = SessionLog::NetworkRequest(request);
+    outSuccess = success != 0;
+    outData.assign(reader.data, reader.data + size);
+    return true;
+}
+
+bool SessionPlayer::decodeMapSnapshot(
+        const SessionLog::Record &record, MapData &outMapData) {
+    if (record.type == SessionLog::kRecordPackedMapSnapshot) {
+        PackedCells packed;
+        if (!PackedCells::deserialize(record.payload, record.payloadSize, packed)) {
+            return false;
+        }
+        packed.unpack(outMapData);
+        return true;
+    }
+
+    PayloadReader reader{record.payload, record.payloadSize};
+    if (record.type == SessionLog::kRecordGeneratedMap) {
+        uint64_t seed, width, height, featureSize;
+        MapGenerator::Params params;
+        if (!reader.readVarint(seed) || !reader.readVarint(width) || !reader.readVarint(height)
+            || !reader.readVarint(featureSize) || !reader.readFloat(params.objectDensity)
+            || !reader.readFloat(params.tankDensity) || !reader.readFloat(params.colorDensity)) {
+            return false;
+        }
+        params.seed = uint32_t(seed);
+        params.width = int(std::min<uint64_t>(width, MapGenerator::kMaxSize));
+        params.height = int(std::min<uint64_t>(height, MapGenerator::kMaxSize));
+        params.featureSize = int(std::min<uint64_t>(featureSize, UINT16_MAX));
+        MapGenerator(params).generate(outMapData);
+        return true;
+    }
+
+    // The sizes come from the file, both are bounded before they are multiplied so the product
+    // cannot wrap, and nothing is allocated unless the cells are all there
+    uint64_t width, height;
+    if (!reader.readVarint(width) || !reader.readVarint(height) || width == 0 || height == 0
+        || width > INT_MAX || height > INT_MAX || width * height != reader.remaining) {
+        return false;
+    }
+
+    outMapData.width = int(width);
+    outMapData.height = int(height);
+    outMapData.data.assign(reader.data, reader.data + reader.remaining);
+    return true;
+}
+
+void SessionPlayer::addFrameTime(int64_t frameNanos) {
+    frameTimes_.push_back(frameNanos);
+}
+
+std::string SessionPlayer::summarizeFrameTimes() const {
+    if (frameTimes_.empty()) {
+        return "no frames replayed";
+    }
+
+    std::vector<int64_t> sorted = frameTimes_;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&sorted](double p) {
+        size_t index = std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5));
+        return sorted[index] / 1e6;
+    };
+
+    double totalMs = 0.0;
+    for (int64_t frameTime: sorted) {
+        totalMs += frameTime / 1e6;
+    }
+
+    std::ostringstream summary;
+    summary << "frames=" << sorted.size()
+            << " mean=" << totalMs / sorted.size() << "ms"
+            << " p50=" << percentile(0.50) << "ms"
+            << " p90=" << percentile(0.90) << "ms"
+            << " p99=" << percentile(0.99) << "ms"
+            << " max=" << sorted.back() / 1e6 << "ms";
+    return summary.str();
+}
@@ -0,0 +1,159 @@
+#ifndef SCROLLER_SESSIONRECORDING_H
+#define SCROLLER_SESSIONRECORDING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MapData.h"
+#include "MapGenerator.h"
+
+/*!
+ * A motion event reduced to what Renderer::handleInput() uses, independent of GameActivity so it
+ * can be stored and fed back on any platform.
+ */
+struct RecordedMotionEvent {
+    static constexpr int kMaxPointers = 4;
+
+    int32_t action;
+    int32_t pointerCount;
+    float x[kMaxPointers];
+    float y[kMaxPointers];
+};
+
+/*!
+ * Binary session log format shared by SessionRecorder and SessionPlayer.
+ *
+ * The file starts with the magic "SREC" and a 16 bit version. Every record is a type byte, the
+ * nanoseconds since the previous record and the payload length (both LEB128 varints), followed by
+ * the payload. A frame end record closes everything that happened during one frame, including how
+ * many simulation ticks ran, which is what makes replays deterministic.
+ */
+namespace SessionLog {
+    enum RecordType : uint8_t {
+        kRecordFrameEnd = 1,
+        kRecordMotionEvent = 2,
+        kRecordSurfaceSize = 3,
+        kRecordNetworkCompletion = 4,
+        kRecordMapSnapshot = 5,
+        //! a map snapshot in the PackedCells form, written whenever the map fits its palette
+        kRecordPackedMapSnapshot = 6,
+        //! the parameters of a generated map, which the replay generates again
+        kRecordGeneratedMap = 7,
+    };
+
+    enum NetworkRequest : uint8_t {
+        //! the map response, packed or JSON
+        kRequestMapJson = 0,
+        kRequestTankImage = 1,
+        kRequestHighlightPost = 2,
+    };
+
+    static constexpr uint16_t kVersion = 1;
+
+    struct Record {
+        RecordType type;
+        int64_t timestampNanos;
+        const uint8_t *payload;
+        size_t payloadSize;
+    };
+}
+
+/*!
+ * Writes a session log while the app runs. Records go through the stdio buffer of the file, which
+ * is flushed every few frames, so recording an event copies it rather than making a syscall.
+ */
+class SessionRecorder {
+public:
+    /*!
+     * @param path the file to create, an existing file is overwritten
+     * @return the recorder, or null if the file cannot be created
+     */
+    static std::unique_ptr<SessionRecorder> open(const std::string &path);
+
+    ~SessionRecorder();
+
+    void recordMotionEvent(const RecordedMotionEvent &event);
+    void recordSurfaceSize(int width, int height);
+    void recordNetworkCompletion(
+            SessionLog::NetworkRequest request, bool success, const void *data, size_t size);
+    void recordMapSnapshot(const MapData &mapData);
+    void recordGeneratedMap(const MapGenerator::Params &params);
+
+    /*!
+     * Closes the current frame
+     * @param ticks how many simulation ticks ran this frame
+     * @param alpha the interpolation factor used to render it
+     */
+    void recordFrameEnd(int ticks, float alpha);
+
+private:
+    inline SessionRecorder(FILE *file) : file_(file), lastTimestampNanos_(0), framesSinceFlush_(0) {}
+
+    void writeRecord(SessionLog::RecordType type);
+
+    FILE *file_;
+    int64_t lastTimestampNanos_;
+    int framesSinceFlush_;
+    // payload of the record being built and the encoded record, reused between records
+    std::vector<uint8_t> payload_;
+    std::vector<uint8_t> record_;
+};
+
+/*!
+ * Reads a session log back record by record and collects frame timings while it is replayed.
+ */
+class SessionPlayer {
+public:
+    /*!
+     * Loads a whole session log into memory
+     * @return the player, or null if the file is missing or not a session log
+     */
+    static std::unique_ptr<SessionPlayer> open(const std::string &path);
+
+    /*!
+     * Reads the next record. The payload stays valid as long as the player exists.
+     * @return false at the end of the log or if the log is truncated
+     */
+    bool readRecord(SessionLog::Record &outRecord);
+
+    static bool decodeMotionEvent(const SessionLog::Record &record, RecordedMotionEvent &outEvent);
+    static bool decodeSurfaceSize(const SessionLog::Record &record, int &outWidth, int &outHeight);
+    static bool decodeFrameEnd(const SessionLog::Record &record, int &outTicks, float &outAlpha);
+    static bool decodeNetworkCompletion(
+            const SessionLog::Record &record,
+            SessionLog::NetworkRequest &outRequest,
+            bool &outSuccess,
+            std::vector<uint8_t> &outData);
+    /*!
+     * Decodes kRecordMapSnapshot and kRecordPackedMapSnapshot records, and generates the map of
+     * kRecordGeneratedMap records
+     */
+    static bool decodeMapSnapshot(const SessionLog::Record &record,
+                                  MapData &outMapData);
+
+    /*!
+     * Adds the CPU time of one replayed frame to the timing report
+     */
+    void addFrameTime(int64_t frameNanos);
+
+    /*!
+     * @return a one line summary of the frame timings (count, mean and percentiles)
+     */
+    std::string summarizeFrameTimes() const;
+
+    inline size_t getFramesReplayed() const { return frameTimes_.size(); }
+
+private:
+    inline SessionPlayer(std::vector<uint8_t> data) : data_(std::move(data)), position_(0),
+                                                      timestampNanos_(0) {}
+
+    std::vector<uint8_t> data_;
+    size_t position_;
+    int64_t timestampNanos_;
+    std::vector<int64_t> frameTimes_;
+};
+
+#endif //SCROLLER_SESSIONRECORDING_H
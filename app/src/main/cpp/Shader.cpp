@@ -1,6 +1,7 @@
 #include "Shader.h"
 
 #include "AndroidOut.h"
+#include "Metrics.h"
 #include "Model.h"
 #include "Utility.h"
 
@@ -9,8 +10,7 @@ Shader *Shader::loadShader(
         const std::string &fragmentSource,
         const std::string &positionAttributeName,
         const std::string &colorAttributeName,
-        const std::string &modelMatrixUniformName,
-        const std::string &projectionMatrixUniformName) {
+        const std::string &viewProjectionUniformName) {
     Shader *shader = nullptr;
 
     GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexSource);
@@ -50,23 +50,20 @@ Shader *Shader::loadShader(
             // indices with layout= in your shader, but it is not done in this sample
             GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
             GLint colorAttribute = glGetAttribLocation(program, colorAttributeName.c_str());
-            GLint modelMatrixUniform = glGetUniformLocation(program, modelMatrixUniformName.c_str());
-            GLint projectionMatrixUniform = glGetUniformLocation(
+            GLint viewProjectionUniform = glGetUniformLocation(
                     program,
-                    projectionMatrixUniformName.c_str());
+                    viewProjectionUniformName.c_str());
 
             // Only create a new shader if all the attributes are found.
             if (positionAttribute != -1
                 && colorAttribute != -1
-                && modelMatrixUniform != -1
-                && projectionMatrixUniform != -1) {
+                && viewProjectionUniform != -1) {
 
                 shader = new Shader(
                         program,
                         positionAttribute,
                         colorAttribute,
-                        modelMatrixUniform,
-                        projectionMatrixUniform);
+                        viewProjectionUniform);
             } else {
                 glDeleteProgram(program);
             }
@@ -144,6 +141,7 @@ void Shader::drawModel(const Model &model) const {
 
     // Draw as indexed lines
     glDrawElements(GL_LINES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
+    recordDrawCall(model.getIndexCount());
 
     glDisableVertexAttribArray(color_);
     glDisableVertexAttribArray(position_);
@@ -174,15 +172,19 @@ void Shader::drawTriangles(const Model &model) const {
 
     // Draw as indexed triangles
     glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
+    recordDrawCall(model.getIndexCount());
 
     glDisableVertexAttribArray(color_);
     glDisableVertexAttribArray(position_);
 }
 
-void Shader::setModelMatrix(float *modelMatrix) const {
-    glUniformMatrix4fv(modelMatrix_, 1, false, modelMatrix);
+void Shader::setViewProjectionMatrix(const float *viewProjection) const {
+    glUniformMatrix4fv(viewProjection_, 1, false, viewProjection);
 }
 
-void Shader::setProjectionMatrix(float *projectionMatrix) const {
-    glUniformMatrix4fv(projectionMatrix_, 1, false, projectionMatrix);
+void Shader::recordDrawCall(size_t indexCount) {
+    static Metrics::Counter &drawCalls = Metrics::counter("render.draw_calls");
+    static Metrics::Counter &indicesSubmitted = Metrics::counter("render.indices_submitted");
+    drawCalls.add();
+    indicesSubmitted.add(indexCount);
 }
\ No newline at end of file
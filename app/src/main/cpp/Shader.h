@@ -9,7 +9,7 @@ class Model;
 /*!
  * A class representing a simple shader program for grid lines. It consists of vertex and fragment 
  * components. The input attributes are a position (as a Vector3) and a color (as a Vector3). 
- * It also takes a uniform to be used as the entire model/view/projection matrix. The shader 
+ * It also takes a uniform to be used as the entire view/projection matrix. The shader 
  * renders colored lines without textures.
  */
 class Shader {
@@ -23,8 +23,7 @@ public:
      * @param fragmentSource The full source code of your fragment program
      * @param positionAttributeName The name of the position attribute in your vertex program
      * @param colorAttributeName The name of the color attribute in your vertex program
-     * @param modelMatrixUniformName The name of your model matrix uniform
-     * @param projectionMatrixUniformName The name of your projection matrix uniform
+     * @param viewProjectionUniformName The name of your view-projection matrix uniform
      * @return a valid Shader on success, otherwise null.
      */
     static Shader *loadShader(
@@ -32,8 +31,7 @@ public:
             const std::string &fragmentSource,
             const std::string &positionAttributeName,
             const std::string &colorAttributeName,
-            const std::string &modelMatrixUniformName,
-            const std::string &projectionMatrixUniformName);
+            const std::string &viewProjectionUniformName);
 
     inline ~Shader() {
         if (program_) {
@@ -65,16 +63,16 @@ public:
     void drawTriangles(const Model &model) const;
 
     /*!
-     * Sets the model matrix in the shader.
-     * @param modelMatrix sixteen floats, column major, defining an OpenGL model matrix.
+     * Sets the view-projection matrix in the shader, which has to be active.
+     * @param viewProjection sixteen floats, column major, e.g. from Camera::getViewProjection().
      */
-    void setModelMatrix(float *modelMatrix) const;
+    void setViewProjectionMatrix(const float *viewProjection) const;
 
     /*!
-     * Sets the projection matrix in the shader.
-     * @param projectionMatrix sixteen floats, column major, defining an OpenGL projection matrix.
+     * Counts a draw call and the indices it submits in the render metrics, for every shader
+     * @param indexCount the index count passed to glDrawElements
      */
-    void setProjectionMatrix(float *projectionMatrix) const;
+    static void recordDrawCall(size_t indexCount);
 
 private:
     /*!
@@ -90,26 +88,22 @@ private:
      * @param program the GL program id of the shader
      * @param position the attribute location of the position
      * @param color the attribute location of the color
-     * @param modelMatrix the uniform location of the model matrix
-     * @param projectionMatrix the uniform location of the projection matrix
+     * @param viewProjection the uniform location of the view-projection matrix
      */
     constexpr Shader(
             GLuint program,
             GLint position,
             GLint color,
-            GLint modelMatrix,
-            GLint projectionMatrix)
+            GLint viewProjection)
             : program_(program),
               position_(position),
               color_(color),
-              modelMatrix_(modelMatrix),
-              projectionMatrix_(projectionMatrix) {}
+              viewProjection_(viewProjection) {}
 
     GLuint program_;
     GLint position_;
     GLint color_;
-    GLint modelMatrix_;
-    GLint projectionMatrix_;
+    GLint viewProjection_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_SHADER_H
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "AndroidOut.h"
+
+/*!
+ * How fast tanks drive, in cells per second
+ */
+static constexpr float kUnitSpeed = 4.0f;
+
+Simulation::Simulation() : animationTime_(0.0f), previousAnimationTime_(0.0f) {}
+
+void Simulation::reset(const MapData &map) {
+    units_.clear();
+    movedUnits_.clear();
+    changedCells_.clear();
+    animationTime_ = 0.0f;
+    previousAnimationTime_ = 0.0f;
+
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            char cellType = map.data[y * map.width + x];
+            if (cellType == 'x' || cellType == 'X') {
+                Unit unit;
+                unit.id = (int) units_.size();
+                unit.cellType = cellType;
+                unit.cellX = x;
+                unit.cellY = y;
+                unit.terrain = ' ';
+                unit.x = unit.previousX = float(x);
+                unit.y = unit.previousY = float(y);
+                unit.pathIndex = 0;
+                units_.push_back(std::move(unit));
+            }
+        }
+    }
+
+    aout << "Simulation reset with " << units_.size() << " units" << std::endl;
+}
+
+bool Simulation::orderMove(int unitId, int goalX, int goalY, const MapData &map) {
+    if (unitId < 0 || unitId >= (int) units_.size()) {
+        return false;
+    }
+
+    Unit &unit = units_[unitId];
+    if (!pathfinder_.findPath(map, unit.cellX, unit.cellY, goalX, goalY, unit.path)) {
+        aout << "No path for unit " << unitId << " to (" << goalX << ", " << goalY << "), expanded "
+             << pathfinder_.getLastExpandedNodes() << " cells" << std::endl;
+        unit.path.clear();
+        unit.pathIndex = 0;
+        return false;
+    }
+
+    unit.pathIndex = 0;
+    aout << "Unit " << unitId << " moving to (" << goalX << ", " << goalY << ") in "
+         << unit.path.size() << " steps" << std::endl;
+    return true;
+}
+
+void Simulation::step(float tickSeconds, MapData &map) {
+    previousAnimationTime_ = animationTime_;
+    animationTime_ += tickSeconds;
+
+    for (auto &unit: units_) {
+        unit.previousX = unit.x;
+        unit.previousY = unit.y;
+
+        float travel = kUnitSpeed * tickSeconds;
+        while (travel > 0.0f && unit.pathIndex < unit.path.size()) {
+            const auto &next = unit.path[unit.pathIndex];
+
+            // Claim the next cell before driving into it, so two tanks never share a cell
+            if (unit.cellX != next.first || unit.cellY != next.second) {
+                if (!Pathfinder::isWalkable(map, next.first, next.second)) {
+                    // someone else got there first, stop where we are
+                    unit.path.clear();
+                    unit.pathIndex = 0;
+                    break;
+                }
+                // Colored cells are walkable, they come back once the tank drove across
+                char &nextCell = map.data[next.second * map.width + next.first];
+                map.data[unit.cellY * map.width + unit.cellX] = unit.terrain;
+                unit.terrain = nextCell;
+                nextCell = unit.cellType;
+                changedCells_.emplace_back(unit.cellX, unit.cellY);
+                changedCells_.push_back(next);
+                unit.cellX = next.first;
+                unit.cellY = next.second;
+                movedUnits_.push_back(unit.id);
+            }
+
+            float dx = float(next.first) - unit.x;
+            float dy = float(next.second) - unit.y;
+            float distance = std::sqrt(dx * dx + dy * dy);
+            if (distance <= travel) {
+                unit.x = float(next.first);
+                unit.y = float(next.second);
+                travel -= distance;
+                unit.pathIndex++;
+            } else {
+                unit.x += dx / distance * travel;
+                unit.y += dy / distance * travel;
+                travel = 0.0f;
+            }
+        }
+
+        if (unit.pathIndex >= unit.path.size() && !unit.path.empty()) {
+            unit.path.clear();
+            unit.pathIndex = 0;
+        }
+    }
+}
+
+int Simulation::findUnitAt(int x, int y) const {
+    for (const auto &unit: units_) {
+        if (unit.cellX == x && unit.cellY == y) {
+            return unit.id;
+        }
+    }
+    return -1;
+}
+
+void Simulation::getInterpolatedPosition(
+        const Unit &unit, float alpha, float &outX, float &outY) const {
+    outX = unit.previousX + (unit.x - unit.previousX) * alpha;
+    outY = unit.previousY + (unit.y - unit.previousY) * alpha;
+}
+
+float Simulation::getAnimationTime(float alpha) const {
+    return previousAnimationTime_ + (animationTime_ - previousAnimationTime_) * alpha;
+}
+
+bool Simulation::hasMovingUnits() const {
+    return std::any_of(units_.begin(), units_.end(), [](const Unit &unit) {
+        return unit.isMoving();
+    });
+}
+
+size_t Simulation::getMemoryBytes() const {
+    size_t bytes = units_.capacity() * sizeof(Unit) + movedUnits_.capacity() * sizeof(int)
+                   + changedCells_.capacity() * sizeof(std::pair<int, int>)
+                   + pathfinder_.getMemoryBytes();
+    for (const auto &unit: units_) {
+        bytes += unit.path.capacity() * sizeof(std::pair<int, int>);
+    }
+    return bytes;
+}
@@ -0,0 +1,106 @@
+#ifndef SCROLLER_SIMULATION_H
+#define SCROLLER_SIMULATION_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "MapData.h"
+#include "Pathfinder.h"
+
+/*!
+ * Game state advanced in fixed ticks by the SimulationClock: tank movement along paths and
+ * animation time. Every value the renderer draws keeps its state from the previous tick as well,
+ * so frames between two ticks can be interpolated.
+ */
+class Simulation {
+public:
+    struct Unit {
+        int id;
+        char cellType;
+        // the cell the unit occupies on the map, claimed as soon as the unit starts moving into it
+        int cellX, cellY;
+        // the map value under the unit, written back to the cell when the unit leaves it
+        char terrain;
+        // position in cells at the current and at the previous tick
+        float x, y;
+        float previousX, previousY;
+        // remaining cells to visit
+        std::vector<std::pair<int, int>> path;
+        size_t pathIndex;
+
+        inline bool isMoving() const { return pathIndex < path.size() || x != previousX || y != previousY; }
+    };
+
+    Simulation();
+
+    /*!
+     * Drops all units and creates one for every tank on the map
+     */
+    void reset(const MapData &map);
+
+    /*!
+     * Sends a unit to the given cell along the shortest path.
+     * @return false if the unit does not exist or the cell cannot be reached
+     */
+    bool orderMove(int unitId, int goalX, int goalY, const MapData &map);
+
+    /*!
+     * Advances the simulation by one tick. Units that enter a new cell update @a map.
+     * @param tickSeconds the fixed duration of a tick
+     */
+    void step(float tickSeconds, MapData &map);
+
+    /*!
+     * @return the id of the unit occupying the cell, or -1
+     */
+    int findUnitAt(int x, int y) const;
+
+    /*!
+     * Blends the unit's last two tick positions
+     * @param alpha the interpolation factor from SimulationClock::getAlpha()
+     */
+    void getInterpolatedPosition(const Unit &unit, float alpha, float &outX, float &outY) const;
+
+    /*!
+     * @return the animation time in seconds, interpolated like unit positions
+     */
+    float getAnimationTime(float alpha) const;
+
+    /*!
+     * @return true if any unit moved during the last tick or still has a path to follow
+     */
+    bool hasMovingUnits() const;
+
+    inline const std::vector<Unit> &getUnits() const { return units_; }
+
+    /*!
+     * Ids of units that changed cells since the last @a clearMovedUnits()
+     */
+    inline const std::vector<int> &getMovedUnits() const { return movedUnits_; }
+
+    /*!
+     * Cells whose value changed since the last @a clearMovedUnits(), a cell can be listed twice
+     */
+    inline const std::vector<std::pair<int, int>> &getChangedCells() const { return changedCells_; }
+
+    inline void clearMovedUnits() {
+        movedUnits_.clear();
+        changedCells_.clear();
+    }
+
+    /*!
+     * @return the bytes of CPU memory held by units, their paths and the pathfinder
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    std::vector<Unit> units_;
+    std::vector<int> movedUnits_;
+    std::vector<std::pair<int, int>> changedCells_;
+    Pathfinder pathfinder_;
+    float animationTime_;
+    float previousAnimationTime_;
+};
+
+#endif //SCROLLER_SIMULATION_H
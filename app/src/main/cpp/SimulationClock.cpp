@@ -0,0 +1,55 @@
+#include "SimulationClock.h"
+
+#include <algorithm>
+#include <chrono>
+
+static constexpr int64_t kNanosPerSecond = 1000000000;
+
+SimulationClock::SimulationClock(int ticksPerSecond, int maxTicksPerFrame)
+        : ticksPerSecond_(0),
+          maxTicksPerFrame_(std::max(1, maxTicksPerFrame)),
+          tickNanos_(0),
+          accumulatorNanos_(0),
+          lastNanos_(0),
+          tickCount_(0),
+          started_(false) {
+    setTickRate(ticksPerSecond);
+}
+
+void SimulationClock::setTickRate(int ticksPerSecond) {
+    ticksPerSecond_ = std::max(1, ticksPerSecond);
+    tickNanos_ = kNanosPerSecond / ticksPerSecond_;
+}
+
+int SimulationClock::advance(int64_t nowNanos) {
+    if (!started_) {
+        started_ = true;
+        lastNanos_ = nowNanos;
+        return 0;
+    }
+
+    int64_t elapsed = std::max<int64_t>(0, nowNanos - lastNanos_);
+    lastNanos_ = nowNanos;
+
+    // Never carry more than one frame's worth of ticks, the rest of a stall is simply dropped
+    accumulatorNanos_ = std::min(accumulatorNanos_ + elapsed, tickNanos_ * maxTicksPerFrame_);
+
+    int ticks = int(accumulatorNanos_ / tickNanos_);
+    accumulatorNanos_ -= ticks * tickNanos_;
+    tickCount_ += ticks;
+    return ticks;
+}
+
+void SimulationClock::reset() {
+    started_ = false;
+    accumulatorNanos_ = 0;
+}
+
+float SimulationClock::getAlpha() const {
+    return float(accumulatorNanos_) / float(tickNanos_);
+}
+
+int64_t SimulationClock::nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
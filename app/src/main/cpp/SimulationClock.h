@@ -0,0 +1,63 @@
+#ifndef SCROLLER_SIMULATIONCLOCK_H
+#define SCROLLER_SIMULATIONCLOCK_H
+
+#include <cstdint>
+
+/*!
+ * Fixed timestep clock. Real time is accumulated every frame and consumed in whole simulation ticks,
+ * so the simulation advances at the same rate whether the display runs at 60, 90 or 120 Hz. The
+ * leftover fraction of a tick is exposed as an interpolation factor for rendering.
+ */
+class SimulationClock {
+public:
+    /*!
+     * @param ticksPerSecond the simulation rate
+     * @param maxTicksPerFrame how many ticks a single frame may run before time is dropped, this
+     *     keeps a long stall (e.g. returning from the background) from snowballing
+     */
+    explicit SimulationClock(int ticksPerSecond = 30, int maxTicksPerFrame = 5);
+
+    /*!
+     * Changes the simulation rate, keeping the time already accumulated
+     */
+    void setTickRate(int ticksPerSecond);
+
+    /*!
+     * Accumulates the time elapsed since the previous call.
+     * @param nowNanos the current time from @a nowNanos()
+     * @return how many ticks the simulation has to run this frame
+     */
+    int advance(int64_t nowNanos);
+
+    /*!
+     * Forgets the accumulated time, the next @a advance() starts from scratch
+     */
+    void reset();
+
+    /*!
+     * @return how far the current time is between the last two ticks, in [0, 1)
+     */
+    float getAlpha() const;
+
+    inline float getTickSeconds() const { return float(tickNanos_) * 1e-9f; }
+
+    inline int getTickRate() const { return ticksPerSecond_; }
+
+    inline uint64_t getTickCount() const { return tickCount_; }
+
+    /*!
+     * @return a monotonic timestamp in nanoseconds
+     */
+    static int64_t nowNanos();
+
+private:
+    int ticksPerSecond_;
+    int maxTicksPerFrame_;
+    int64_t tickNanos_;
+    int64_t accumulatorNanos_;
+    int64_t lastNanos_;
+    uint64_t tickCount_;
+    bool started_;
+};
+
+#endif //SCROLLER_SIMULATIONCLOCK_H
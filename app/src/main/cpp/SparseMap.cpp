@@ -0,0 +1,147 @@
+#include "SparseMap.h"
+
+#include <algorithm>
+
+SparseMap::SparseMap(char fill)
+        : fill_(fill), width_(0), height_(0), blocksX_(0), blocksY_(0) {}
+
+void SparseMap::reset(int width, int height) {
+    width_ = std::max(0, width);
+    height_ = std::max(0, height);
+    blocksX_ = (width_ + kBlockSize - 1) >> kBlockShift;
+    blocksY_ = (height_ + kBlockSize - 1) >> kBlockShift;
+    blocks_.assign(size_t(blocksX_) * blocksY_, Block{kUniform, 0, fill_});
+    pool_.clear();
+    freeDense_.clear();
+}
+
+void SparseMap::assign(const MapData &map) {
+    reset(map.width, map.height);
+
+    for (int blockY = 0; blockY < blocksY_; blockY++) {
+        const int top = blockY << kBlockShift;
+        const int rows = std::min(kBlockSize, height_ - top);
+        for (int blockX = 0; blockX < blocksX_; blockX++) {
+            const int left = blockX << kBlockShift;
+            const int columns = std::min(kBlockSize, width_ - left);
+
+            // Blocks of a single value are the common case, so check that before copying anything
+            const char first = map.data[size_t(top) * width_ + left];
+            bool uniform = true;
+            for (int y = 0; y < rows && uniform; y++) {
+                const char *row = &map.data[size_t(top + y) * width_ + left];
+                uniform = std::all_of(row, row + columns, [first](char cell) {
+                    return cell == first;
+                });
+            }
+
+            Block &block = blocks_[size_t(blockY) * blocksX_ + blockX];
+            // Edge blocks are padded with their value, so a uniform edge block stays uniform
+            block.value = first;
+            if (uniform) {
+                continue;
+            }
+
+            makeDense(block, rows * columns);
+            char *cells = &pool_[size_t(block.dense) * kBlockCells];
+            int nonFill = 0;
+            for (int y = 0; y < rows; y++) {
+                char *row = cells + y * kBlockSize;
+                memcpy(row, &map.data[size_t(top + y) * width_ + left], size_t(columns));
+                nonFill += int(std::count_if(row, row + columns, [this](char cell) {
+                    return cell != fill_;
+                }));
+            }
+            block.nonFill = uint16_t(nonFill);
+        }
+    }
+}
+
+void SparseMap::toDense(MapData &outMap) const {
+    outMap.width = width_;
+    outMap.height = height_;
+    outMap.data.resize(size_t(width_) * height_);
+
+    for (int blockY = 0; blockY < blocksY_; blockY++) {
+        const int top = blockY << kBlockShift;
+        const int rows = std::min(kBlockSize, height_ - top);
+        for (int blockX = 0; blockX < blocksX_; blockX++) {
+            const Block &block = blocks_[size_t(blockY) * blocksX_ + blockX];
+            const int left = blockX << kBlockShift;
+            const int columns = std::min(kBlockSize, width_ - left);
+            for (int y = 0; y < rows; y++) {
+                char *row = &outMap.data[size_t(top + y) * width_ + left];
+                if (block.dense == kUniform) {
+                    memset(row, block.value, size_t(columns));
+                } else {
+                    memcpy(row, &pool_[size_t(block.dense) * kBlockCells + y * kBlockSize],
+                           size_t(columns));
+                }
+            }
+        }
+    }
+}
+
+void SparseMap::set(int x, int y, char value) {
+    Block &block = blocks_[getBlockIndex(x, y)];
+    if (block.dense == kUniform) {
+        if (block.value == value) {
+            return;
+        }
+        makeDense(block, getInMapCells(x, y));
+    }
+
+    char &cell = pool_[size_t(block.dense) * kBlockCells + getCellIndex(x, y)];
+    if (cell == value) {
+        return;
+    }
+    block.nonFill = uint16_t(block.nonFill - (cell != fill_) + (value != fill_));
+    cell = value;
+
+    if (block.nonFill == 0) {
+        makeUniform(block, fill_);
+    }
+}
+
+void SparseMap::materializeBlock(int blockX, int blockY, char *outCells) const {
+    const Block &block = blocks_[size_t(blockY) * blocksX_ + blockX];
+    if (block.dense == kUniform) {
+        memset(outCells, block.value, kBlockCells);
+    } else {
+        memcpy(outCells, &pool_[size_t(block.dense) * kBlockCells], kBlockCells);
+    }
+
+    // Padding holds whatever the block was made from, report it as empty
+    const int columns = std::min(kBlockSize, width_ - (blockX << kBlockShift));
+    const int rows = std::min(kBlockSize, height_ - (blockY << kBlockShift));
+    for (int y = 0; y < kBlockSize; y++) {
+        const int from = y < rows ? columns : 0;
+        if (from < kBlockSize) {
+            memset(outCells + y * kBlockSize + from, fill_, size_t(kBlockSize - from));
+        }
+    }
+}
+
+size_t SparseMap::getMemoryBytes() const {
+    return blocks_.capacity() * sizeof(Block) + pool_.capacity()
+           + freeDense_.capacity() * sizeof(uint32_t);
+}
+
+void SparseMap::makeDense(Block &block, int inMapCells) {
+    if (!freeDense_.empty()) {
+        block.dense = freeDense_.back();
+        freeDense_.pop_back();
+    } else {
+        block.dense = uint32_t(pool_.size() / kBlockCells);
+        pool_.resize(pool_.size() + kBlockCells);
+    }
+    memset(&pool_[size_t(block.dense) * kBlockCells], block.value, kBlockCells);
+    block.nonFill = uint16_t(block.value == fill_ ? 0 : inMapCells);
+}
+
+void SparseMap::makeUniform(Block &block, char value) {
+    freeDense_.push_back(block.dense);
+    block.dense = kUniform;
+    block.nonFill = 0;
+    block.value = value;
+}
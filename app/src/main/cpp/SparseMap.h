@@ -0,0 +1,207 @@
+#ifndef SCROLLER_SPARSEMAP_H
+#define SCROLLER_SPARSEMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MapData.h"
+
+/*!
+ * Map cells for worlds that are mostly empty. The map is split into square blocks. A block whose
+ * cells all hold the same value is stored as that value, only blocks with mixed content get their
+ * cells. A 16k x 16k world is a 2 MB block table plus 1 KB per block that holds a unit or object.
+ *
+ * Cell access is O(1): one lookup in the block table and, for mixed blocks, one in the block's
+ * cells. Blocks that become empty again (all cells the fill value) go back to a single value.
+ */
+class SparseMap {
+public:
+    static constexpr int kBlockShift = 5;
+    //! Width and height of a block in cells
+    static constexpr int kBlockSize = 1 << kBlockShift;
+    static constexpr int kBlockCells = kBlockSize * kBlockSize;
+
+    /*!
+     * @param fill the value of empty cells, never reported by @a forEachNonEmpty()
+     */
+    explicit SparseMap(char fill = ' ');
+
+    /*!
+     * Resizes the map and empties every cell
+     */
+    void reset(int width, int height);
+
+    /*!
+     * Replaces the content with a dense map, blocks of a single value stay compact
+     */
+    void assign(const MapData &map);
+
+    /*!
+     * Writes every cell into @a outMap, resizing it
+     */
+    void toDense(MapData &outMap) const;
+
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    inline char getFill() const { return fill_; }
+
+    inline bool isInBounds(int x, int y) const {
+        return x >= 0 && x < width_ && y >= 0 && y < height_;
+    }
+
+    /*!
+     * @return the cell at a position, which has to be in bounds
+     */
+    inline char get(int x, int y) const {
+        const Block &block = blocks_[getBlockIndex(x, y)];
+        return block.dense == kUniform
+               ? block.value
+               : pool_[size_t(block.dense) * kBlockCells + getCellIndex(x, y)];
+    }
+
+    /*!
+     * Changes the cell at a position, which has to be in bounds. Only the first change inside a
+     * uniform block allocates.
+     */
+    void set(int x, int y, char value);
+
+    inline int getBlocksX() const { return blocksX_; }
+
+    inline int getBlocksY() const { return blocksY_; }
+
+    /*!
+     * @return true if every cell of the block holds @a getBlockValue()
+     */
+    inline bool isBlockUniform(int blockX, int blockY) const {
+        return blocks_[blockY * blocksX_ + blockX].dense == kUniform;
+    }
+
+    inline char getBlockValue(int blockX, int blockY) const {
+        return blocks_[blockY * blocksX_ + blockX].value;
+    }
+
+    /*!
+     * Copies a block into kBlockCells row major cells, e.g. to build the block's mesh. Parts of
+     * edge blocks outside the map hold the fill value.
+     */
+    void materializeBlock(int blockX, int blockY, char *outCells) const;
+
+    /*!
+     * Calls visit(x, y, value) for every cell that is not the fill value, block by block. Empty
+     * blocks are skipped without looking at their cells, and empty runs inside mixed blocks are
+     * skipped eight cells at a time.
+     */
+    template<typename Visitor>
+    void forEachNonEmpty(Visitor &&visit) const {
+        uint64_t fillWord;
+        memset(&fillWord, fill_, sizeof(fillWord));
+
+        for (int blockY = 0; blockY < blocksY_; blockY++) {
+            const int top = blockY << kBlockShift;
+            const int rows = std::min(kBlockSize, height_ - top);
+            for (int blockX = 0; blockX < blocksX_; blockX++) {
+                const Block &block = blocks_[blockY * blocksX_ + blockX];
+                const int left = blockX << kBlockShift;
+                const int columns = std::min(kBlockSize, width_ - left);
+
+                if (block.dense == kUniform) {
+                    if (block.value != fill_) {
+                        for (int y = 0; y < rows; y++) {
+                            for (int x = 0; x < columns; x++) {
+                                visit(left + x, top + y, block.value);
+                            }
+                        }
+                    }
+                    continue;
+                }
+
+                const char *cells = &pool_[size_t(block.dense) * kBlockCells];
+                for (int y = 0; y < rows; y++) {
+                    const char *row = cells + y * kBlockSize;
+                    for (int x = 0; x < columns;) {
+                        uint64_t word;
+                        if (x + 8 <= columns) {
+                            memcpy(&word, row + x, sizeof(word));
+                            if (word == fillWord) {
+                                x += 8;
+                                continue;
+                            }
+                        }
+                        if (row[x] != fill_) {
+                            visit(left + x, top + y, row[x]);
+                        }
+                        x++;
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * @return how many blocks hold their cells
+     */
+    inline size_t getDenseBlockCount() const { return pool_.size() / kBlockCells - freeDense_.size(); }
+
+    /*!
+     * @return the bytes of CPU memory held by the map
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    static constexpr uint32_t kUniform = UINT32_MAX;
+    static constexpr int kCellMask = kBlockSize - 1;
+
+    struct Block {
+        //! index of the block's cells in pool_, kUniform if every cell is @a value
+        uint32_t dense;
+        //! cells inside the map that are not the fill value, counted while dense
+        uint16_t nonFill;
+        char value;
+    };
+
+    inline size_t getBlockIndex(int x, int y) const {
+        return size_t(y >> kBlockShift) * blocksX_ + (x >> kBlockShift);
+    }
+
+    static inline int getCellIndex(int x, int y) {
+        return ((y & kCellMask) << kBlockShift) + (x & kCellMask);
+    }
+
+    /*!
+     * @return the cells of the block holding (x, y) that are inside the map, edge blocks have fewer
+     */
+    inline int getInMapCells(int x, int y) const {
+        const int left = x & ~kCellMask;
+        const int top = y & ~kCellMask;
+        return std::min(kBlockSize, width_ - left) * std::min(kBlockSize, height_ - top);
+    }
+
+    /*!
+     * Gives a uniform block its own cells, all set to its value
+     * @param inMapCells the block's cells inside the map, from getInMapCells()
+     */
+    void makeDense(Block &block, int inMapCells);
+
+    /*!
+     * Turns a dense block back into a single value and recycles its cells
+     */
+    void makeUniform(Block &block, char value);
+
+    char fill_;
+    int width_;
+    int height_;
+    int blocksX_;
+    int blocksY_;
+    std::vector<Block> blocks_;
+    //! cells of the dense blocks, kBlockCells each
+    std::vector<char> pool_;
+    //! dense slots in pool_ that are free for reuse
+    std::vector<uint32_t> freeDense_;
+};
+
+#endif //SCROLLER_SPARSEMAP_H
@@ -0,0 +1,100 @@
+#include "StartupTimeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "SimulationClock.h"
+
+namespace {
+    // Taken by static initialization, i.e. when the process loads the library
+    const int64_t gLoadNanos = SimulationClock::nowNanos();
+    std::atomic<bool> gColdStartClaimed{false};
+
+    double toMillis(int64_t nanos) {
+        return double(nanos) / 1e6;
+    }
+}
+
+StartupTimeline::Phase::Phase(StartupTimeline &timeline, const char *name)
+        : timeline_(&timeline), index_(timeline.beginPhase(name)), span_(name) {}
+
+void StartupTimeline::Phase::end() {
+    if (timeline_) {
+        timeline_->endPhase(index_);
+        timeline_ = nullptr;
+        span_.end();
+    }
+}
+
+StartupTimeline::StartupTimeline() {
+    coldStart_ = !gColdStartClaimed.exchange(true);
+    originNanos_ = coldStart_ ? gLoadNanos : SimulationClock::nowNanos();
+    phases_.reserve(16);
+    milestones_.reserve(8);
+}
+
+bool StartupTimeline::mark(const char *name) {
+    const int64_t nanos = SimulationClock::nowNanos() - originNanos_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &milestone: milestones_) {
+        if (strcmp(milestone.name, name) == 0) {
+            return false;
+        }
+    }
+    milestones_.push_back({name, nanos});
+    return true;
+}
+
+int64_t StartupTimeline::getMilestoneNanos(const char *name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &milestone: milestones_) {
+        if (strcmp(milestone.name, name) == 0) {
+            return milestone.nanos;
+        }
+    }
+    return -1;
+}
+
+std::string StartupTimeline::report() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PhaseRecord> phases = phases_;
+    std::stable_sort(phases.begin(), phases.end(), [](const PhaseRecord &a, const PhaseRecord &b) {
+        return a.startNanos < b.startNanos;
+    });
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1);
+    report << (coldStart_ ? "Cold start" : "Warm start") << " timeline (ms from "
+           << (coldStart_ ? "library load" : "window creation") << "):\n";
+    for (const auto &phase: phases) {
+        report << "  " << std::setw(8) << toMillis(phase.startNanos) << " - ";
+        if (phase.endNanos < 0) {
+            report << "   still running  " << phase.name << "\n";
+        } else {
+            report << std::setw(8) << toMillis(phase.endNanos) << " ("
+                   << std::setw(7) << toMillis(phase.endNanos - phase.startNanos) << ")  "
+                   << phase.name << "\n";
+        }
+    }
+    for (const auto &milestone: milestones_) {
+        report << "  " << std::setw(8) << toMillis(milestone.nanos) << "  " << milestone.name
+               << "\n";
+    }
+    return report.str();
+}
+
+size_t StartupTimeline::beginPhase(const char *name) {
+    const int64_t nanos = SimulationClock::nowNanos() - originNanos_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    phases_.push_back({name, nanos, -1});
+    return phases_.size() - 1;
+}
+
+void StartupTimeline::endPhase(size_t index) {
+    const int64_t nanos = SimulationClock::nowNanos() - originNanos_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    phases_[index].endNanos = nanos;
+}
@@ -0,0 +1,90 @@
+#ifndef SCROLLER_STARTUPTIMELINE_H
+#define SCROLLER_STARTUPTIMELINE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+/*!
+ * Named startup phases and milestones on a monotonic clock, relative to the start of the
+ * timeline. Phases may run on any thread and overlap, so the report shows what ran concurrently.
+ *
+ *  StartupTimeline::Phase phase(startup_, "egl");
+ *  ...
+ *  startup_.mark("first frame");
+ */
+class StartupTimeline {
+public:
+    /*!
+     * Times a phase from construction to destruction or @a end(), and shows it as an async span
+     * in traces
+     */
+    class Phase {
+    public:
+        Phase(StartupTimeline &timeline, const char *name);
+
+        inline ~Phase() { end(); }
+
+        void end();
+
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+    private:
+        StartupTimeline *timeline_;
+        size_t index_;
+        TraceAsyncSpan span_;
+    };
+
+    /*!
+     * The first timeline of the process starts when the library was loaded, which makes its
+     * milestones cold start times. Later ones (the window was recreated) start when constructed.
+     */
+    StartupTimeline();
+
+    /*!
+     * Records a milestone the first time it is reached, later calls are ignored
+     * @param name must outlive the timeline (a string literal)
+     * @return true the first time
+     */
+    bool mark(const char *name);
+
+    /*!
+     * @return nanoseconds from the start of the timeline to the milestone, -1 if not reached yet
+     */
+    int64_t getMilestoneNanos(const char *name) const;
+
+    inline bool isColdStart() const { return coldStart_; }
+
+    /*!
+     * @return the phases ordered by start and the milestones, one per line
+     */
+    std::string report() const;
+
+private:
+    struct PhaseRecord {
+        const char *name;
+        int64_t startNanos;
+        // -1 while running
+        int64_t endNanos;
+    };
+
+    struct Milestone {
+        const char *name;
+        int64_t nanos;
+    };
+
+    size_t beginPhase(const char *name);
+    void endPhase(size_t index);
+
+    int64_t originNanos_;
+    bool coldStart_;
+    mutable std::mutex mutex_;
+    std::vector<PhaseRecord> phases_;
+    std::vector<Milestone> milestones_;
+};
+
+#endif //SCROLLER_STARTUPTIMELINE_H
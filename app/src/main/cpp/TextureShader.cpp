@@ -1,7 +1,9 @@
 #include "TextureShader.h"
 
 #include "AndroidOut.h"
+#include "Metrics.h"
 #include "Model.h"
+#include "Shader.h"
 #include "Utility.h"
 
 TextureShader *TextureShader::loadShader(
@@ -9,8 +11,7 @@ TextureShader *TextureShader::loadShader(
         const std::string &fragmentSource,
         const std::string &positionAttributeName,
         const std::string &texCoordAttributeName,
-        const std::string &modelMatrixUniformName,
-        const std::string &projectionMatrixUniformName,
+        const std::string &viewProjectionUniformName,
         const std::string &textureUniformName) {
     TextureShader *shader = nullptr;
 
@@ -48,22 +49,19 @@ TextureShader *TextureShader::loadShader(
         } else {
             GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
             GLint texCoordAttribute = glGetAttribLocation(program, texCoordAttributeName.c_str());
-            GLint modelMatrixUniform = glGetUniformLocation(program, modelMatrixUniformName.c_str());
-            GLint projectionMatrixUniform = glGetUniformLocation(program, projectionMatrixUniformName.c_str());
+            GLint viewProjectionUniform = glGetUniformLocation(program, viewProjectionUniformName.c_str());
             GLint textureUniform = glGetUniformLocation(program, textureUniformName.c_str());
 
             if (positionAttribute != -1
                 && texCoordAttribute != -1
-                && modelMatrixUniform != -1
-                && projectionMatrixUniform != -1
+                && viewProjectionUniform != -1
                 && textureUniform != -1) {
 
                 shader = new TextureShader(
                         program,
                         positionAttribute,
                         texCoordAttribute,
-                        modelMatrixUniform,
-                        projectionMatrixUniform,
+                        viewProjectionUniform,
                         textureUniform);
             } else {
                 aout << "Failed to get texture shader attributes/uniforms" << std::endl;
@@ -141,17 +139,14 @@ void TextureShader::drawTexturedModel(const TexturedModel &model) const {
 
     // Draw as indexed triangles
     glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
+    Shader::recordDrawCall(model.getIndexCount());
 
     glDisableVertexAttribArray(texCoord_);
     glDisableVertexAttribArray(position_);
 }
 
-void TextureShader::setModelMatrix(float *modelMatrix) const {
-    glUniformMatrix4fv(modelMatrix_, 1, false, modelMatrix);
-}
-
-void TextureShader::setProjectionMatrix(float *projectionMatrix) const {
-    glUniformMatrix4fv(projectionMatrix_, 1, false, projectionMatrix);
+void TextureShader::setViewProjectionMatrix(const float *viewProjection) const {
+    glUniformMatrix4fv(viewProjection_, 1, false, viewProjection);
 }
 
 void TextureShader::setTexture(GLuint textureId) const {
@@ -9,7 +9,7 @@ class TexturedModel;
 /*!
  * A class representing a shader program for textured quads. It consists of vertex and fragment 
  * components. The input attributes are a position (as a Vector3) and texture coordinates (as a Vector2). 
- * It also takes uniforms for the model/view/projection matrix and texture sampler.
+ * It also takes uniforms for the view/projection matrix and texture sampler.
  */
 class TextureShader {
 public:
@@ -23,8 +23,7 @@ public:
             const std::string &fragmentSource,
             const std::string &positionAttributeName,
             const std::string &texCoordAttributeName,
-            const std::string &modelMatrixUniformName,
-            const std::string &projectionMatrixUniformName,
+            const std::string &viewProjectionUniformName,
             const std::string &textureUniformName);
 
     inline ~TextureShader() {
@@ -51,16 +50,10 @@ public:
     void drawTexturedModel(const TexturedModel &model) const;
 
     /*!
-     * Sets the model matrix in the shader.
-     * @param modelMatrix sixteen floats, column major, defining an OpenGL model matrix.
+     * Sets the view-projection matrix in the shader, which has to be active.
+     * @param viewProjection sixteen floats, column major, e.g. from Camera::getViewProjection().
      */
-    void setModelMatrix(float *modelMatrix) const;
-
-    /*!
-     * Sets the projection matrix in the shader.
-     * @param projectionMatrix sixteen floats, column major, defining an OpenGL projection matrix.
-     */
-    void setProjectionMatrix(float *projectionMatrix) const;
+    void setViewProjectionMatrix(const float *viewProjection) const;
 
     /*!
      * Sets the texture to be used for rendering
@@ -81,21 +74,18 @@ private:
             GLuint program,
             GLint position,
             GLint texCoord,
-            GLint modelMatrix,
-            GLint projectionMatrix,
+            GLint viewProjection,
             GLint texture)
             : program_(program),
               position_(position),
               texCoord_(texCoord),
-              modelMatrix_(modelMatrix),
-              projectionMatrix_(projectionMatrix),
+              viewProjection_(viewProjection),
               texture_(texture) {}
 
     GLuint program_;
     GLint position_;
     GLint texCoord_;
-    GLint modelMatrix_;
-    GLint projectionMatrix_;
+    GLint viewProjection_;
     GLint texture_;
 };
 
@@ -0,0 +1,266 @@
+#include "TileCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "AndroidOut.h"
+#include "GridMesh.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+std::unique_ptr<TileCache> TileCache::create(std::unique_ptr<TileStore> store,
+                                             size_t budgetBytes) {
+    if (!store) {
+        return nullptr;
+    }
+    return std::unique_ptr<TileCache>(new TileCache(std::move(store), budgetBytes));
+}
+
+TileCache::TileCache(std::unique_ptr<TileStore> store, size_t budgetBytes)
+        : store_(std::move(store)),
+          budgetBytes_(budgetBytes),
+          layout_(GridLayout::forMap(store_->getWidth(), store_->getHeight())),
+          residentBytes_(0),
+          version_(0),
+          loading_(false),
+          stopping_(false) {}
+
+TileCache::~TileCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    // At most the tile being read is still finished
+    JobSystem::instance().wait(loadJob_);
+}
+
+void TileCache::update(float left, float bottom, float right, float top) {
+    SCROLLER_TRACE_SCOPE("TileCache::update");
+
+    // Newly loaded tiles first, so they are drawn this frame already
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const size_t count = std::min(loaded_.size(), size_t(kMaxUploadsPerFrame));
+        for (size_t i = 0; i < count; i++) {
+            pending_.erase(loaded_[i].key);
+            uploads_.push_back(std::move(loaded_[i]));
+        }
+        loaded_.erase(loaded_.begin(), loaded_.begin() + count);
+    }
+    for (auto &tile: uploads_) {
+        upload(tile);
+    }
+    uploads_.clear();
+
+    // Cells in view, plus a ring of one tile around them that is loaded but not drawn
+    const int tileSize = store_->getTileSize();
+    const float spacing = GridLayout::kCellSpacing;
+    auto toTile = [tileSize](float cell, int tileCount) {
+        return std::clamp(int(std::floor(cell / tileSize)), -1, tileCount);
+    };
+    const int firstX = toTile((left + layout_.extent) / spacing, store_->getTilesX());
+    const int lastX = toTile((right + layout_.extent) / spacing, store_->getTilesX());
+    const int firstY = toTile((layout_.extent - top) / spacing, store_->getTilesY());
+    const int lastY = toTile((layout_.extent - bottom) / spacing, store_->getTilesY());
+    const float centerX = (firstX + lastX) * 0.5f;
+    const float centerY = (firstY + lastY) * 0.5f;
+
+    static Metrics::CacheCounter &residency = Metrics::cache("tiles.residency");
+    visible_.clear();
+    wanted_.clear();
+    size_t touched = 0;
+    size_t placeholderCount = 0;
+    const int ringFirstX = std::max(0, firstX - 1);
+    const int ringLastX = std::min(lastX + 1, store_->getTilesX() - 1);
+    const int ringFirstY = std::max(0, firstY - 1);
+    const int ringLastY = std::min(lastY + 1, store_->getTilesY() - 1);
+    for (int tileY = ringFirstY; tileY <= ringLastY; tileY++) {
+        for (int tileX = ringFirstX; tileX <= ringLastX; tileX++) {
+            const bool inView = tileX >= firstX && tileX <= lastX
+                                && tileY >= firstY && tileY <= lastY;
+            const uint32_t key = getKey(tileX, tileY);
+            auto found = resident_.find(key);
+            if (found != resident_.end()) {
+                // Drawn or about to be, so it moves to the front of the LRU list
+                lru_.splice(lru_.begin(), lru_, found->second);
+                touched++;
+                if (inView) {
+                    visible_.push_back(&*found->second);
+                    residency.hit();
+                }
+                continue;
+            }
+            if (inView) {
+                placeholderCount++;
+                residency.miss();
+            }
+            const float dx = tileX - centerX;
+            const float dy = tileY - centerY;
+            wanted_.emplace_back(dx * dx + dy * dy, key);
+        }
+    }
+
+    // The nearest tiles are loaded first. Requests from earlier frames are dropped, the camera has
+    // moved on from them.
+    std::sort(wanted_.begin(), wanted_.end(), [](const auto &a, const auto &b) {
+        return a.first > b.first;
+    });
+    bool startLoading = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_.clear();
+        for (const auto &request: wanted_) {
+            if (!pending_.count(request.second)) {
+                requests_.push_back(request.second);
+            }
+        }
+        startLoading = !requests_.empty() && !loading_;
+        loading_ = loading_ || startLoading;
+    }
+    if (startLoading) {
+        // Reading blocks on the disk, so the job is a background one
+        loadJob_ = JobSystem::instance().schedule([this]() { loadTiles(); }, {}, true);
+    }
+
+    // Tiles in view and around it were just moved to the front, so only others are evicted
+    while (residentBytes_ > budgetBytes_ && lru_.size() > touched) {
+        Tile &oldest = lru_.back();
+        residentBytes_ -= oldest.bytes;
+        resident_.erase(oldest.key);
+        lru_.pop_back();
+    }
+    Metrics::gauge("tiles.resident_bytes", "bytes").set(int64_t(residentBytes_));
+
+    // Placeholders are rebuilt every frame into the previous frame's storage
+    placeholderBuilder_.recycle(placeholders_);
+    if (placeholderCount == 0) {
+        return;
+    }
+    const float half = spacing * 0.5f;
+    placeholderBuilder_.begin(MeshBuilder<Vertex, Model>::kQuad, placeholderCount, placeholders_);
+    for (int tileY = std::max(0, firstY); tileY <= std::min(lastY, ringLastY); tileY++) {
+        for (int tileX = std::max(0, firstX); tileX <= std::min(lastX, ringLastX); tileX++) {
+            if (resident_.count(getKey(tileX, tileY))) {
+                continue;
+            }
+            const int cellX = tileX * tileSize;
+            const int cellY = tileY * tileSize;
+            const float tileLeft = layout_.cellCenterX(float(cellX)) - half;
+            const float tileTop = layout_.cellCenterY(float(cellY)) + half;
+            const float tileRight = layout_.cellCenterX(
+                    float(std::min(cellX + tileSize, store_->getWidth()) - 1)) + half;
+            const float tileBottom = layout_.cellCenterY(
+                    float(std::min(cellY + tileSize, store_->getHeight()) - 1)) - half;
+            const Vector3 color = GridMesh::getCellColor(store_->getDominantCell(tileX, tileY));
+            placeholderBuilder_.addQuad(Vertex(Vector3{tileLeft, tileTop, 0}, color),
+                                        Vertex(Vector3{tileRight, tileTop, 0}, color),
+                                        Vertex(Vector3{tileRight, tileBottom, 0}, color),
+                                        Vertex(Vector3{tileLeft, tileBottom, 0}, color));
+        }
+    }
+    placeholderBuilder_.finish();
+}
+
+void TileCache::draw(const Shader &placeholderShader, const TextureShader &tileShader,
+                     const float *viewProjection) const {
+    if (!placeholders_.empty()) {
+        placeholderShader.activate();
+        placeholderShader.setViewProjectionMatrix(viewProjection);
+        for (const auto &model: placeholders_) {
+            placeholderShader.drawTriangles(model);
+        }
+    }
+
+    tileShader.activate();
+    tileShader.setViewProjectionMatrix(viewProjection);
+    for (const Tile *tile: visible_) {
+        tileShader.setTexture(tile->texture->getTextureID());
+        tileShader.drawTexturedModel(tile->quad);
+    }
+}
+
+size_t TileCache::evictAll() {
+    const size_t freed = residentBytes_;
+    visible_.clear();
+    resident_.clear();
+    lru_.clear();
+    residentBytes_ = 0;
+    return freed;
+}
+
+void TileCache::loadTiles() {
+    // Texel colors of every cell value
+    uint32_t colors[256];
+    for (int value = 0; value < 256; value++) {
+        const Vector3 color = GridMesh::getCellColor(char(value));
+        const uint8_t rgba[4] = {uint8_t(color.x * 255.f), uint8_t(color.y * 255.f),
+                                 uint8_t(color.z * 255.f), 255};
+        memcpy(&colors[value], rgba, sizeof(rgba));
+    }
+
+    MapData cells;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (stopping_ || requests_.empty()) {
+            // update() schedules a new job for the next requests
+            loading_ = false;
+            return;
+        }
+        const uint32_t key = requests_.back();
+        requests_.pop_back();
+        pending_.insert(key);
+        lock.unlock();
+
+        SCROLLER_TRACE_SCOPE("TileCache::loadTile");
+        const int tileX = int(key % uint32_t(store_->getTilesX()));
+        const int tileY = int(key / uint32_t(store_->getTilesX()));
+        LoadedTile tile{key, 0, 0, {}};
+        if (store_->readTile(tileX, tileY, cells)) {
+            tile.width = cells.width;
+            tile.height = cells.height;
+            tile.texels.resize(cells.data.size() * 4);
+            for (size_t i = 0; i < cells.data.size(); i++) {
+                memcpy(&tile.texels[i * 4], &colors[uint8_t(cells.data[i])], 4);
+            }
+        }
+
+        lock.lock();
+        // A tile that failed to read stays pending, so it keeps its placeholder instead of being
+        // read again every frame
+        if (tile.width > 0) {
+            loaded_.push_back(std::move(tile));
+        }
+    }
+}
+
+void TileCache::upload(LoadedTile &tile) {
+    SCROLLER_TRACE_SCOPE("TileCache::upload");
+    auto texture = OverlayTexture::create(tile.width, tile.height, GL_RGBA8);
+    if (!texture) {
+        return;
+    }
+    texture->upload(0, 0, tile.width, tile.height, tile.texels.data(), tile.width);
+
+    // Texel rows run top to bottom like map rows, as for the fog of war
+    const int tileSize = store_->getTileSize();
+    const int cellX = int(tile.key % uint32_t(store_->getTilesX())) * tileSize;
+    const int cellY = int(tile.key / uint32_t(store_->getTilesX())) * tileSize;
+    const float half = GridLayout::kCellSpacing * 0.5f;
+    const float left = layout_.cellCenterX(float(cellX)) - half;
+    const float top = layout_.cellCenterY(float(cellY)) + half;
+    const float right = left + tile.width * GridLayout::kCellSpacing;
+    const float bottom = top - tile.height * GridLayout::kCellSpacing;
+    std::vector<TexturedVertex> vertices;
+    vertices.emplace_back(Vector3{left, top, 0}, Vector2{0.0f, 0.0f});
+    vertices.emplace_back(Vector3{right, top, 0}, Vector2{1.0f, 0.0f});
+    vertices.emplace_back(Vector3{right, bottom, 0}, Vector2{1.0f, 1.0f});
+    vertices.emplace_back(Vector3{left, bottom, 0}, Vector2{0.0f, 1.0f});
+
+    const size_t bytes = tile.texels.size();
+    lru_.push_front(Tile{tile.key, bytes, std::move(texture),
+                         TexturedModel(std::move(vertices), {0, 1, 2, 0, 2, 3})});
+    resident_[tile.key] = lru_.begin();
+    residentBytes_ += bytes;
+    version_++;
+}
@@ -0,0 +1,140 @@
+#ifndef SCROLLER_TILECACHE_H
+#define SCROLLER_TILECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "GridLayout.h"
+#include "JobSystem.h"
+#include "MeshBuilder.h"
+#include "Model.h"
+#include "OverlayTexture.h"
+#include "Shader.h"
+#include "TextureShader.h"
+#include "TileStore.h"
+
+/*!
+ * Draws a map from a TileStore, keeping only the tiles near the camera on the GPU. Each resident
+ * tile is a texture with one texel per cell. Tiles are read and colored by a background job of the
+ * JobSystem, which runs while there are tiles to load. The GL thread only uploads them, a few per frame, and evicts the least recently drawn tiles once the
+ * budget is exceeded. Tiles that are not resident yet are drawn as a quad in the color of their
+ * most common cell, so scrolling never waits for the disk.
+ *
+ * Only the GPU memory of the map is bounded, see TileStore for what stays in memory.
+ */
+class TileCache {
+public:
+    //! Tiles uploaded per frame at most, the rest wait for the next frame
+    static constexpr int kMaxUploadsPerFrame = 4;
+
+    /*!
+     * @param budgetBytes the GPU memory resident tiles may use
+     */
+    static std::unique_ptr<TileCache> create(std::unique_ptr<TileStore> store, size_t budgetBytes);
+
+    /*!
+     * Waits for the tile being loaded and frees every texture, needs the GL context
+     */
+    ~TileCache();
+
+    /*!
+     * Uploads tiles the loader finished, asks for the tiles in view and evicts what is over budget.
+     * Call once per frame on the GL thread before draw().
+     * @param left, bottom, right, top the visible part of grid space
+     */
+    void update(float left, float bottom, float right, float top);
+
+    /*!
+     * Draws the tiles in view, placeholders first. Leaves @a tileShader active.
+     */
+    void draw(const Shader &placeholderShader, const TextureShader &tileShader,
+              const float *viewProjection) const;
+
+    /*!
+     * Frees every resident tile, tiles in view are loaded again
+     * @return the GPU bytes freed
+     */
+    size_t evictAll();
+
+    inline const GridLayout &getLayout() const { return layout_; }
+
+    inline size_t getResidentBytes() const { return residentBytes_; }
+
+    inline size_t getResidentCount() const { return resident_.size(); }
+
+    /*!
+     * Counts uploads, after which draw() shows a tile where it showed a placeholder before
+     */
+    inline uint32_t getVersion() const { return version_; }
+
+private:
+    struct Tile {
+        uint32_t key;
+        size_t bytes;
+        std::unique_ptr<OverlayTexture> texture;
+        TexturedModel quad;
+    };
+
+    struct LoadedTile {
+        uint32_t key;
+        int width;
+        int height;
+        //! RGBA8, row major
+        std::vector<uint8_t> texels;
+    };
+
+    TileCache(std::unique_ptr<TileStore> store, size_t budgetBytes);
+
+    /*!
+     * The loader job: reads the most wanted tiles, colors them and queues them for upload until no
+     * request is left
+     */
+    void loadTiles();
+
+    /*!
+     * Makes a loaded tile resident
+     */
+    void upload(LoadedTile &tile);
+
+    inline uint32_t getKey(int tileX, int tileY) const {
+        return uint32_t(tileY) * uint32_t(store_->getTilesX()) + uint32_t(tileX);
+    }
+
+    std::unique_ptr<TileStore> store_;
+    const size_t budgetBytes_;
+    const GridLayout layout_;
+
+    // GL thread only
+    //! resident tiles, the most recently drawn first
+    std::list<Tile> lru_;
+    std::unordered_map<uint32_t, std::list<Tile>::iterator> resident_;
+    size_t residentBytes_;
+    uint32_t version_;
+    //! resident tiles in view, refreshed by update()
+    std::vector<const Tile *> visible_;
+    std::vector<std::pair<float, uint32_t>> wanted_;
+    std::vector<LoadedTile> uploads_;
+    MeshBuilder<Vertex, Model> placeholderBuilder_;
+    std::vector<Model> placeholders_;
+
+    //! the loader job, the last one scheduled
+    JobSystem::Handle loadJob_;
+
+    // Shared with the loader job, guarded by mutex_
+    std::mutex mutex_;
+    //! tiles to load, the most wanted last
+    std::vector<uint32_t> requests_;
+    //! tiles the loader took, until they are uploaded
+    std::unordered_set<uint32_t> pending_;
+    std::vector<LoadedTile> loaded_;
+    //! a loader job is scheduled or running, it clears this once it ran out of requests
+    bool loading_;
+    bool stopping_;
+};
+
+#endif //SCROLLER_TILECACHE_H
@@ -0,0 +1,214 @@
+#include "TileStore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "AndroidOut.h"
+#include "PackedCells.h"
+#include "Trace.h"
+
+static constexpr char kMagic[4] = {'S', 'T', 'I', 'L'};
+static constexpr uint16_t kVersion = 1;
+static constexpr size_t kHeaderBytes = 16;
+static constexpr size_t kIndexEntryBytes = 16;
+
+static void putUint16(uint8_t *out, uint16_t value) {
+    out[0] = uint8_t(value);
+    out[1] = uint8_t(value >> 8);
+}
+
+static void putUint32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = uint8_t(value >> (i * 8));
+    }
+}
+
+static uint16_t getUint16(const uint8_t *data) {
+    return uint16_t(data[0] | data[1] << 8);
+}
+
+static uint32_t getUint32(const uint8_t *data) {
+    return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16
+           | uint32_t(data[3]) << 24;
+}
+
+/*!
+ * pread() until @a size bytes arrived
+ */
+static bool readFully(int fd, void *outData, size_t size, uint64_t offset) {
+    auto *out = static_cast<uint8_t *>(outData);
+    while (size > 0) {
+        const ssize_t count = pread(fd, out, size, off_t(offset));
+        if (count <= 0) {
+            return false;
+        }
+        out += count;
+        size -= size_t(count);
+        offset += uint64_t(count);
+    }
+    return true;
+}
+
+bool TileStore::write(const std::string &path, int width, int height, int tileSize,
+                      const RowSource &readRow) {
+    SCROLLER_TRACE_SCOPE("TileStore::write");
+    if (width <= 0 || height <= 0 || tileSize <= 0 || tileSize > UINT16_MAX) {
+        aout << "Invalid tile file layout " << width << "x" << height << ", tiles of "
+             << tileSize << std::endl;
+        return false;
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        aout << "Failed to create tile file " << path << std::endl;
+        return false;
+    }
+
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    const size_t tileCount = size_t(tilesX) * tilesY;
+
+    // The index is written last, once the tile offsets are known
+    uint8_t header[kHeaderBytes];
+    memcpy(header, kMagic, sizeof(kMagic));
+    putUint16(header + 4, kVersion);
+    putUint16(header + 6, uint16_t(tileSize));
+    putUint32(header + 8, uint32_t(width));
+    putUint32(header + 12, uint32_t(height));
+    std::vector<uint8_t> index(tileCount * kIndexEntryBytes, 0);
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header)
+              && fwrite(index.data(), 1, index.size(), file) == index.size();
+
+    std::vector<char> band(size_t(width) * tileSize);
+    MapData tile;
+    PackedCells packed;
+    std::vector<uint8_t> payload;
+    uint64_t offset = kHeaderBytes + index.size();
+    for (int tileY = 0; tileY < tilesY && ok; tileY++) {
+        const int top = tileY * tileSize;
+        const int rows = std::min(tileSize, height - top);
+        for (int y = 0; y < rows; y++) {
+            readRow(top + y, &band[size_t(y) * width]);
+        }
+
+        for (int tileX = 0; tileX < tilesX && ok; tileX++) {
+            const int left = tileX * tileSize;
+            tile.width = std::min(tileSize, width - left);
+            tile.height = rows;
+            tile.data.resize(size_t(tile.width) * tile.height);
+            size_t counts[256] = {};
+            for (int y = 0; y < rows; y++) {
+                const char *row = &band[size_t(y) * width + left];
+                std::copy(row, row + tile.width, &tile.data[size_t(y) * tile.width]);
+                for (int x = 0; x < tile.width; x++) {
+                    counts[uint8_t(row[x])]++;
+                }
+            }
+
+            if (!PackedCells::pack(tile, packed)) {
+                aout << "Tile " << tileX << "," << tileY << " uses too many cell values"
+                     << std::endl;
+                ok = false;
+                break;
+            }
+            payload.clear();
+            packed.serialize(payload);
+            ok = fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+
+            uint8_t *entry = &index[(size_t(tileY) * tilesX + tileX) * kIndexEntryBytes];
+            putUint32(entry, uint32_t(offset));
+            putUint32(entry + 4, uint32_t(offset >> 32));
+            putUint32(entry + 8, uint32_t(payload.size()));
+            entry[12] = uint8_t(std::max_element(counts, counts + 256) - counts);
+            offset += payload.size();
+        }
+    }
+
+    ok = ok && fseek(file, long(kHeaderBytes), SEEK_SET) == 0
+         && fwrite(index.data(), 1, index.size(), file) == index.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        aout << "Failed to write tile file " << path << std::endl;
+        remove(path.c_str());
+        return false;
+    }
+
+    aout << "Wrote " << tileCount << " tiles (" << offset / 1024 << " KiB) to " << path
+         << std::endl;
+    return true;
+}
+
+bool TileStore::write(const std::string &path, const MapData &map, int tileSize) {
+    return write(path, map.width, map.height, tileSize, [&map](int y, char *outRow) {
+        const char *row = &map.data[size_t(y) * map.width];
+        std::copy(row, row + map.width, outRow);
+    });
+}
+
+std::unique_ptr<TileStore> TileStore::open(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        aout << "Failed to open tile file " << path << std::endl;
+        return nullptr;
+    }
+
+    uint8_t header[kHeaderBytes];
+    if (!readFully(fd, header, sizeof(header), 0) || memcmp(header, kMagic, sizeof(kMagic)) != 0
+        || getUint16(header + 4) != kVersion) {
+        aout << "Not a tile file: " << path << std::endl;
+        close(fd);
+        return nullptr;
+    }
+
+    const int tileSize = getUint16(header + 6);
+    const uint32_t width = getUint32(header + 8);
+    const uint32_t height = getUint32(header + 12);
+    if (tileSize == 0 || width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX) {
+        aout << "Corrupt tile file header in " << path << std::endl;
+        close(fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<TileStore> store(new TileStore(fd, int(width), int(height), tileSize));
+    const size_t tileCount = size_t(store->tilesX_) * store->tilesY_;
+    std::vector<uint8_t> index(tileCount * kIndexEntryBytes);
+    if (!readFully(fd, index.data(), index.size(), kHeaderBytes)) {
+        aout << "Truncated tile index in " << path << std::endl;
+        return nullptr;
+    }
+
+    store->index_.resize(tileCount);
+    for (size_t i = 0; i < tileCount; i++) {
+        const uint8_t *entry = &index[i * kIndexEntryBytes];
+        store->index_[i].offset = getUint32(entry) | uint64_t(getUint32(entry + 4)) << 32;
+        store->index_[i].size = getUint32(entry + 8);
+        store->index_[i].dominant = char(entry[12]);
+    }
+
+    aout << "Opened tile file " << path << ": " << width << "x" << height << " cells in "
+         << store->tilesX_ << "x" << store->tilesY_ << " tiles" << std::endl;
+    return store;
+}
+
+TileStore::~TileStore() {
+    close(fd_);
+}
+
+bool TileStore::readTile(int tileX, int tileY, MapData &outTile) const {
+    SCROLLER_TRACE_SCOPE("TileStore::readTile");
+    const IndexEntry &entry = index_[size_t(tileY) * tilesX_ + tileX];
+    std::vector<uint8_t> payload(entry.size);
+    PackedCells packed;
+    if (!readFully(fd_, payload.data(), payload.size(), entry.offset)
+        || !PackedCells::deserialize(payload.data(), payload.size(), packed)
+        || packed.getWidth() != std::min(tileSize_, width_ - tileX * tileSize_)
+        || packed.getHeight() != std::min(tileSize_, height_ - tileY * tileSize_)) {
+        aout << "Failed to read tile " << tileX << "," << tileY << std::endl;
+        return false;
+    }
+    packed.unpack(outTile);
+    return true;
+}
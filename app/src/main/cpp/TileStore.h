@@ -0,0 +1,102 @@
+#ifndef SCROLLER_TILESTORE_H
+#define SCROLLER_TILESTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MapData.h"
+
+/*!
+ * A map split into square tiles in a file, for worlds too large to keep in memory. Only the index
+ * is loaded, tiles are read one at a time and can be read from any thread.
+ *
+ * The file starts with the magic "STIL", a 16 bit version and the tile size, then the map width and
+ * height as uint32 (everything little endian). The index follows with one entry per tile, row
+ * major: the offset and size of the tile and its most common cell. Tiles are stored in the
+ * PackedCells form, edge tiles only hold the cells inside the map.
+ *
+ * The renderer only bounds what the map costs on the GPU with it so far: the simulation, the fog
+ * of war and pathfinding still read the whole map from a MapData, which stays in memory next to
+ * the tile file. A map therefore still has to fit into memory once, one byte per cell.
+ */
+class TileStore {
+public:
+    static constexpr int kDefaultTileSize = 64;
+
+    /*!
+     * Fills @a outRow with the @a width cells of row @a y
+     */
+    typedef std::function<void(int y, char *outRow)> RowSource;
+
+    /*!
+     * Writes a tile file row by row, so only one row of tiles is in memory at a time
+     * @return false if the file cannot be written or a tile uses more values than PackedCells can
+     *         hold
+     */
+    static bool write(const std::string &path, int width, int height, int tileSize,
+                      const RowSource &readRow);
+
+    /*!
+     * Writes a tile file from a map in memory
+     */
+    static bool write(const std::string &path, const MapData &map,
+                      int tileSize = kDefaultTileSize);
+
+    /*!
+     * Opens a tile file and loads its index
+     * @return the store, or null if the file is missing or not a tile file
+     */
+    static std::unique_ptr<TileStore> open(const std::string &path);
+
+    ~TileStore();
+
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    inline int getTileSize() const { return tileSize_; }
+
+    inline int getTilesX() const { return tilesX_; }
+
+    inline int getTilesY() const { return tilesY_; }
+
+    /*!
+     * @return the most common cell of a tile, good enough to draw the tile before it is loaded
+     */
+    inline char getDominantCell(int tileX, int tileY) const {
+        return index_[size_t(tileY) * tilesX_ + tileX].dominant;
+    }
+
+    /*!
+     * Reads one tile. Safe to call from several threads at once.
+     * @param outTile receives the cells, edge tiles are smaller than the tile size
+     * @return false if the tile cannot be read or is corrupt
+     */
+    bool readTile(int tileX, int tileY, MapData &outTile) const;
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint32_t size;
+        char dominant;
+    };
+
+    inline TileStore(int fd, int width, int height, int tileSize)
+            : fd_(fd), width_(width), height_(height), tileSize_(tileSize),
+              tilesX_((width + tileSize - 1) / tileSize),
+              tilesY_((height + tileSize - 1) / tileSize) {}
+
+    int fd_;
+    int width_;
+    int height_;
+    int tileSize_;
+    int tilesX_;
+    int tilesY_;
+    std::vector<IndexEntry> index_;
+};
+
+#endif //SCROLLER_TILESTORE_H
@@ -0,0 +1,233 @@
+#include "Trace.h"
+
+#include <atomic>
+
+#ifdef __ANDROID__
+#include <android/trace.h>
+#include <dlfcn.h>
+#else
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#endif
+
+#include "AndroidOut.h"
+
+static std::atomic<int32_t> gNextAsyncCookie{1};
+
+int32_t Trace::newAsyncCookie() {
+    return gNextAsyncCookie.fetch_add(1, std::memory_order_relaxed);
+}
+
+#if !SCROLLER_TRACING
+
+void Trace::startCapture(const std::string &) {}
+
+bool Trace::stopCapture() { return true; }
+
+bool Trace::isEnabled() { return false; }
+
+void Trace::beginSection(const char *) {}
+
+void Trace::endSection() {}
+
+void Trace::beginAsyncSection(const char *, int32_t) {}
+
+void Trace::endAsyncSection(const char *, int32_t) {}
+
+void Trace::setCounter(const char *, int64_t) {}
+
+#elif defined(__ANDROID__)
+
+/*!
+ * Async sections and counters need API level 29, above the app's minimum, so they are looked up
+ * at runtime and silently dropped on older devices.
+ */
+namespace {
+    typedef void (*AsyncSectionFunction)(const char *, int32_t);
+    typedef void (*CounterFunction)(const char *, int64_t);
+
+    struct AsyncTraceApi {
+        AsyncSectionFunction beginAsyncSection = nullptr;
+        AsyncSectionFunction endAsyncSection = nullptr;
+        CounterFunction setCounter = nullptr;
+
+        AsyncTraceApi() {
+            void *library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+            if (library) {
+                beginAsyncSection = reinterpret_cast<AsyncSectionFunction>(
+                        dlsym(library, "ATrace_beginAsyncSection"));
+                endAsyncSection = reinterpret_cast<AsyncSectionFunction>(
+                        dlsym(library, "ATrace_endAsyncSection"));
+                setCounter = reinterpret_cast<CounterFunction>(dlsym(library, "ATrace_setCounter"));
+            }
+        }
+    };
+
+    const AsyncTraceApi &asyncTraceApi() {
+        static AsyncTraceApi api;
+        return api;
+    }
+}
+
+void Trace::startCapture(const std::string &path) {
+    aout << "Trace capture to " << path << " is not supported on Android, use Perfetto" << std::endl;
+}
+
+bool Trace::stopCapture() {
+    return true;
+}
+
+bool Trace::isEnabled() {
+    return ATrace_isEnabled();
+}
+
+void Trace::beginSection(const char *name) {
+    ATrace_beginSection(name);
+}
+
+void Trace::endSection() {
+    ATrace_endSection();
+}
+
+void Trace::beginAsyncSection(const char *name, int32_t cookie) {
+    if (auto function = asyncTraceApi().beginAsyncSection) {
+        function(name, cookie);
+    }
+}
+
+void Trace::endAsyncSection(const char *name, int32_t cookie) {
+    if (auto function = asyncTraceApi().endAsyncSection) {
+        function(name, cookie);
+    }
+}
+
+void Trace::setCounter(const char *name, int64_t value) {
+    if (auto function = asyncTraceApi().setCounter) {
+        function(name, value);
+    }
+}
+
+#else
+
+/*!
+ * Spans collected for the Chrome trace event format. Sections become B/E pairs on the thread that
+ * recorded them, async sections b/e pairs matched by id, counters C events.
+ */
+namespace {
+    struct Event {
+        char phase;
+        const char *name;
+        int64_t timestampMicros;
+        int32_t threadId;
+        int64_t value;
+    };
+
+    std::atomic<bool> gCapturing{false};
+    std::mutex gMutex;
+    std::vector<Event> gEvents;
+    std::string gPath;
+    std::atomic<int32_t> gNextThreadId{1};
+
+    int32_t currentThreadId() {
+        thread_local int32_t threadId = gNextThreadId.fetch_add(1, std::memory_order_relaxed);
+        return threadId;
+    }
+
+    int64_t nowMicros() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void addEvent(char phase, const char *name, int64_t value) {
+        if (!gCapturing.load(std::memory_order_relaxed)) {
+            return;
+        }
+        Event event{phase, name, nowMicros(), currentThreadId(), value};
+        std::lock_guard<std::mutex> lock(gMutex);
+        gEvents.push_back(event);
+    }
+
+    void writeEscaped(FILE *file, const char *text) {
+        for (const char *c = text; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                fputc('\\', file);
+            }
+            fputc(*c, file);
+        }
+    }
+}
+
+void Trace::startCapture(const std::string &path) {
+    std::lock_guard<std::mutex> lock(gMutex);
+    gEvents.clear();
+    gEvents.reserve(1 << 16);
+    gPath = path;
+    gCapturing = true;
+}
+
+bool Trace::stopCapture() {
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (!gCapturing) {
+        return true;
+    }
+    gCapturing = false;
+
+    FILE *file = fopen(gPath.c_str(), "w");
+    if (!file) {
+        aout << "Failed to write trace " << gPath << std::endl;
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < gEvents.size(); i++) {
+        const Event &event = gEvents[i];
+        fprintf(file, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%lld",
+                i == 0 ? "" : ",\n", event.phase, event.threadId,
+                (long long) event.timestampMicros);
+        if (event.name) {
+            fprintf(file, ",\"name\":\"");
+            writeEscaped(file, event.name);
+            fprintf(file, "\"");
+        }
+        if (event.phase == 'b' || event.phase == 'e') {
+            fprintf(file, ",\"cat\":\"async\",\"id\":%lld", (long long) event.value);
+        } else if (event.phase == 'C') {
+            fprintf(file, ",\"args\":{\"value\":%lld}", (long long) event.value);
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    aout << "Wrote " << gEvents.size() << " trace events to " << gPath << std::endl;
+    gEvents.clear();
+    return true;
+}
+
+bool Trace::isEnabled() {
+    return gCapturing;
+}
+
+void Trace::beginSection(const char *name) {
+    addEvent('B', name, 0);
+}
+
+void Trace::endSection() {
+    addEvent('E', nullptr, 0);
+}
+
+void Trace::beginAsyncSection(const char *name, int32_t cookie) {
+    addEvent('b', name, cookie);
+}
+
+void Trace::endAsyncSection(const char *name, int32_t cookie) {
+    addEvent('e', name, cookie);
+}
+
+void Trace::setCounter(const char *name, int64_t value) {
+    addEvent('C', name, value);
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef SCROLLER_TRACE_H
+#define SCROLLER_TRACE_H
+
+#include <cstdint>
+#include <string>
+
+/*!
+ * Trace markers are compiled in unless the build says otherwise. On Android they go to ATrace and
+ * show up in Perfetto and systrace captures (and cost next to nothing while no capture runs). On
+ * other platforms they are collected in memory once @a Trace::startCapture() was called and
+ * written as a Chrome trace event file, which chrome://tracing and ui.perfetto.dev open.
+ */
+#ifndef SCROLLER_TRACING
+#define SCROLLER_TRACING 1
+#endif
+
+/*!
+ * Span names must be string literals or otherwise outlive the capture.
+ */
+namespace Trace {
+    /*!
+     * Starts collecting spans for @a stopCapture(). Does nothing on Android, use Perfetto there.
+     * @param path the Chrome trace event JSON file to write
+     */
+    void startCapture(const std::string &path);
+
+    /*!
+     * Writes the collected spans and stops collecting
+     * @return false if the file could not be written
+     */
+    bool stopCapture();
+
+    /*!
+     * @return true if spans are currently recorded anywhere
+     */
+    bool isEnabled();
+
+    void beginSection(const char *name);
+    void endSection();
+
+    /*!
+     * @return a new id for an async span, unique for the process
+     */
+    int32_t newAsyncCookie();
+
+    /*!
+     * Async spans may begin and end on different threads. @a name and @a cookie together identify
+     * the span and have to match between begin and end.
+     */
+    void beginAsyncSection(const char *name, int32_t cookie);
+    void endAsyncSection(const char *name, int32_t cookie);
+
+    /*!
+     * Records the value of a counter track
+     */
+    void setCounter(const char *name, int64_t value);
+}
+
+/*!
+ * Traces the enclosing scope, see SCROLLER_TRACE_SCOPE
+ */
+class TraceScope {
+public:
+    inline explicit TraceScope(const char *name) { Trace::beginSection(name); }
+
+    inline ~TraceScope() { Trace::endSection(); }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+};
+
+/*!
+ * An async span that ends when @a end() is called or the object is destroyed, whichever comes
+ * first. It can be moved to the thread that finishes the work.
+ */
+class TraceAsyncSpan {
+public:
+    inline explicit TraceAsyncSpan(const char *name)
+            : name_(name), cookie_(Trace::newAsyncCookie()) {
+        Trace::beginAsyncSection(name_, cookie_);
+    }
+
+    inline TraceAsyncSpan(TraceAsyncSpan &&other) noexcept
+            : name_(other.name_), cookie_(other.cookie_) {
+        other.name_ = nullptr;
+    }
+
+    inline ~TraceAsyncSpan() { end(); }
+
+    inline void end() {
+        if (name_) {
+            Trace::endAsyncSection(name_, cookie_);
+            name_ = nullptr;
+        }
+    }
+
+    TraceAsyncSpan(const TraceAsyncSpan &) = delete;
+    TraceAsyncSpan &operator=(const TraceAsyncSpan &) = delete;
+    TraceAsyncSpan &operator=(TraceAsyncSpan &&) = delete;
+
+private:
+    const char *name_;
+    int32_t cookie_;
+};
+
+#define SCROLLER_TRACE_CONCAT_INNER(a, b) a##b
+#define SCROLLER_TRACE_CONCAT(a, b) SCROLLER_TRACE_CONCAT_INNER(a, b)
+
+#if SCROLLER_TRACING
+//! Traces from here to the end of the enclosing scope
+#define SCROLLER_TRACE_SCOPE(name) TraceScope SCROLLER_TRACE_CONCAT(traceScope_, __LINE__)(name)
+//! Records the value of a counter track
+#define SCROLLER_TRACE_COUNTER(name, value) Trace::setCounter(name, value)
+#else
+#define SCROLLER_TRACE_SCOPE(name)
+#define SCROLLER_TRACE_COUNTER(name, value)
+#endif
+
+#endif //SCROLLER_TRACE_H
@@ -25,75 +25,3 @@ bool Utility::checkAndLogGlError(bool alwaysLog) {
         return false;
     }
 }
-
-float *
-Utility::buildOrthographicMatrix(float *outMatrix, float halfHeight, float aspect, float near,
-                                 float far) {
-    float halfWidth = halfHeight * aspect;
-
-    // column 1
-    outMatrix[0] = 1.f / halfWidth;
-    outMatrix[1] = 0.f;
-    outMatrix[2] = 0.f;
-    outMatrix[3] = 0.f;
-
-    // column 2
-    outMatrix[4] = 0.f;
-    outMatrix[5] = 1.f / halfHeight;
-    outMatrix[6] = 0.f;
-    outMatrix[7] = 0.f;
-
-    // column 3
-    outMatrix[8] = 0.f;
-    outMatrix[9] = 0.f;
-    outMatrix[10] = -2.f / (far - near);
-    outMatrix[11] = -(far + near) / (far - near);
-
-    // column 4
-    outMatrix[12] = 0.f;
-    outMatrix[13] = 0.f;
-    outMatrix[14] = 0.f;
-    outMatrix[15] = 1.f;
-
-    return outMatrix;
-}
-
-float *Utility::buildIdentityMatrix(float *outMatrix) {
-    // column 1
-    outMatrix[0] = 1.f;
-    outMatrix[1] = 0.f;
-    outMatrix[2] = 0.f;
-    outMatrix[3] = 0.f;
-
-    // column 2
-    outMatrix[4] = 0.f;
-    outMatrix[5] = 1.f;
-    outMatrix[6] = 0.f;
-    outMatrix[7] = 0.f;
-
-    // column 3
-    outMatrix[8] = 0.f;
-    outMatrix[9] = 0.f;
-    outMatrix[10] = 1.f;
-    outMatrix[11] = 0.f;
-
-    // column 4
-    outMatrix[12] = 0.f;
-    outMatrix[13] = 0.f;
-    outMatrix[14] = 0.f;
-    outMatrix[15] = 1.f;
-
-    return outMatrix;
-}
-
-float *Utility::buildTranslationMatrix(float *outMatrix, float x, float y) {
-    // Start with identity matrix
-    buildIdentityMatrix(outMatrix);
-    
-    // Set translation values in the 4th column
-    outMatrix[12] = x;  // x translation
-    outMatrix[13] = y;  // y translation
-    // z translation (outMatrix[14]) remains 0
-    
-    return outMatrix;
-}
\ No newline at end of file
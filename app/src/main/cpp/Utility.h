@@ -8,37 +8,6 @@ public:
     static bool checkAndLogGlError(bool alwaysLog = false);
 
     static inline void assertGlError() { assert(checkAndLogGlError()); }
-
-    /**
-     * Generates an orthographic projection matrix given the half height, aspect ratio, near, and far
-     * planes
-     *
-     * @param outMatrix the matrix to write into
-     * @param halfHeight half of the height of the screen
-     * @param aspect the width of the screen divided by the height
-     * @param near the distance of the near plane
-     * @param far the distance of the far plane
-     * @return the generated matrix, this will be the same as @a outMatrix so you can chain calls
-     *     together if needed
-     */
-    static float *buildOrthographicMatrix(
-            float *outMatrix,
-            float halfHeight,
-            float aspect,
-            float near,
-            float far);
-
-    static float *buildIdentityMatrix(float *outMatrix);
-
-    /**
-     * Builds a translation matrix with the given x and y offsets
-     *
-     * @param outMatrix the matrix to write into
-     * @param x the translation along the x-axis
-     * @param y the translation along the y-axis
-     * @return the generated matrix, this will be the same as @a outMatrix
-     */
-    static float *buildTranslationMatrix(float *outMatrix, float x, float y);
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_UTILITY_H
\ No newline at end of file
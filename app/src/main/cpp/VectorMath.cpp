@@ -0,0 +1,90 @@
+#include "VectorMath.h"
+
+#include <cmath>
+
+void Mat4::transformPoints(const float *points, float *outPoints, size_t count) const {
+    size_t i = 0;
+
+    // Four points per iteration, split into a register of x and one of y
+#if SCROLLER_MATH_NEON
+    for (; i + 4 <= count; i += 4) {
+        float32x4x2_t xy = vld2q_f32(points + i * 2);
+        float32x4_t x = vmlaq_n_f32(vdupq_n_f32(m[12]), xy.val[0], m[0]);
+        x = vmlaq_n_f32(x, xy.val[1], m[4]);
+        float32x4_t y = vmlaq_n_f32(vdupq_n_f32(m[13]), xy.val[0], m[1]);
+        y = vmlaq_n_f32(y, xy.val[1], m[5]);
+        xy.val[0] = x;
+        xy.val[1] = y;
+        vst2q_f32(outPoints + i * 2, xy);
+    }
+#elif SCROLLER_MATH_SSE
+    const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]);
+    const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]);
+    const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 low = _mm_loadu_ps(points + i * 2);
+        const __m128 high = _mm_loadu_ps(points + i * 2 + 4);
+        const __m128 x = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 y = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 outX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m0), _mm_mul_ps(y, m4)), m12);
+        const __m128 outY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m1), _mm_mul_ps(y, m5)), m13);
+        _mm_storeu_ps(outPoints + i * 2, _mm_unpacklo_ps(outX, outY));
+        _mm_storeu_ps(outPoints + i * 2 + 4, _mm_unpackhi_ps(outX, outY));
+    }
+#endif
+
+    for (; i < count; i++) {
+        const float x = points[i * 2];
+        const float y = points[i * 2 + 1];
+        outPoints[i * 2] = m[0] * x + m[4] * y + m[12];
+        outPoints[i * 2 + 1] = m[1] * x + m[5] * y + m[13];
+    }
+}
+
+bool Mat4::inverse(Mat4 &outInverse) const {
+    // Cofactor expansion, only run when a camera changes so it is kept scalar
+    float inv[16];
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15]
+             + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15]
+             - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15]
+             + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14]
+              - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15]
+             - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15]
+             + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15]
+             - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14]
+              + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15]
+             + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15]
+             - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15]
+              + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14]
+              - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11]
+             - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11]
+             + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11]
+              - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10]
+              + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    const float determinant = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (std::fabs(determinant) < 1e-12f) {
+        return false;
+    }
+
+    const float scale = 1.f / determinant;
+    for (int i = 0; i < 16; i++) {
+        outInverse.m[i] = inv[i] * scale;
+    }
+    return true;
+}
@@ -0,0 +1,125 @@
+#ifndef SCROLLER_VECTORMATH_H
+#define SCROLLER_VECTORMATH_H
+
+#include <cstddef>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCROLLER_MATH_NEON 1
+#elif defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define SCROLLER_MATH_SSE 1
+#endif
+
+/*!
+ * A point or direction in homogeneous coordinates, aligned so it loads into one SIMD register
+ */
+struct alignas(16) Vec4 {
+    float x;
+    float y;
+    float z;
+    float w;
+
+    static constexpr Vec4 point(float x, float y, float z = 0.f) { return {x, y, z, 1.f}; }
+};
+
+/*!
+ * A 4x4 matrix in column major order, the layout glUniformMatrix4fv expects without transposing.
+ * Builders are constexpr so constant matrices cost nothing at runtime, products and transforms
+ * use NEON on ARM and SSE on x86 with a scalar fallback elsewhere.
+ */
+struct alignas(16) Mat4 {
+    float m[16];
+
+    static constexpr Mat4 identity() {
+        return {{1.f, 0.f, 0.f, 0.f,
+                 0.f, 1.f, 0.f, 0.f,
+                 0.f, 0.f, 1.f, 0.f,
+                 0.f, 0.f, 0.f, 1.f}};
+    }
+
+    static constexpr Mat4 translation(float x, float y, float z = 0.f) {
+        return {{1.f, 0.f, 0.f, 0.f,
+                 0.f, 1.f, 0.f, 0.f,
+                 0.f, 0.f, 1.f, 0.f,
+                 x, y, z, 1.f}};
+    }
+
+    static constexpr Mat4 scale(float x, float y, float z = 1.f) {
+        return {{x, 0.f, 0.f, 0.f,
+                 0.f, y, 0.f, 0.f,
+                 0.f, 0.f, z, 0.f,
+                 0.f, 0.f, 0.f, 1.f}};
+    }
+
+    /*!
+     * An orthographic projection centered on the origin
+     * @param halfHeight half of the visible height
+     * @param aspect the width of the screen divided by the height
+     * @param near the distance of the near plane
+     * @param far the distance of the far plane
+     */
+    static constexpr Mat4 orthographic(float halfHeight, float aspect, float near, float far) {
+        return {{1.f / (halfHeight * aspect), 0.f, 0.f, 0.f,
+                 0.f, 1.f / halfHeight, 0.f, 0.f,
+                 0.f, 0.f, -2.f / (far - near), 0.f,
+                 0.f, 0.f, -(far + near) / (far - near), 1.f}};
+    }
+
+    inline const float *data() const { return m; }
+
+    inline Mat4 operator*(const Mat4 &other) const {
+        Mat4 result;
+        for (int column = 0; column < 4; column++) {
+            transformColumn(other.m + column * 4, result.m + column * 4);
+        }
+        return result;
+    }
+
+    inline Vec4 operator*(const Vec4 &vector) const {
+        Vec4 result;
+        transformColumn(&vector.x, &result.x);
+        return result;
+    }
+
+    /*!
+     * Transforms 2D points (z = 0, w = 1) in place of a loop over operator*. Only the x and y rows
+     * are applied, so this is for affine matrices and orthographic projections, where w stays 1.
+     * @param points interleaved x, y pairs
+     * @param outPoints receives the transformed pairs, may be @a points
+     */
+    void transformPoints(const float *points, float *outPoints, size_t count) const;
+
+    /*!
+     * @param outInverse receives the inverse, untouched if there is none
+     * @return false if the matrix is singular
+     */
+    bool inverse(Mat4 &outInverse) const;
+
+private:
+    /*!
+     * out = this * column, for one column of four floats. Both must be 16 byte aligned.
+     */
+    inline void transformColumn(const float *column, float *out) const {
+#if SCROLLER_MATH_NEON
+        float32x4_t result = vmulq_n_f32(vld1q_f32(m), column[0]);
+        result = vmlaq_n_f32(result, vld1q_f32(m + 4), column[1]);
+        result = vmlaq_n_f32(result, vld1q_f32(m + 8), column[2]);
+        result = vmlaq_n_f32(result, vld1q_f32(m + 12), column[3]);
+        vst1q_f32(out, result);
+#elif SCROLLER_MATH_SSE
+        __m128 result = _mm_mul_ps(_mm_load_ps(m), _mm_set1_ps(column[0]));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_load_ps(m + 4), _mm_set1_ps(column[1])));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_load_ps(m + 8), _mm_set1_ps(column[2])));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_load_ps(m + 12), _mm_set1_ps(column[3])));
+        _mm_store_ps(out, result);
+#else
+        for (int row = 0; row < 4; row++) {
+            out[row] = m[row] * column[0] + m[4 + row] * column[1]
+                       + m[8 + row] * column[2] + m[12 + row] * column[3];
+        }
+#endif
+    }
+};
+
+#endif //SCROLLER_VECTORMATH_H
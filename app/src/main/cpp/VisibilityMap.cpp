@@ -0,0 +1,353 @@
+#include "VisibilityMap.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include "AndroidOut.h"
+#include "Trace.h"
+
+/*!
+ * Quadrants scanned around every unit. Rows grow away from the unit along the primary axis while
+ * columns run across it.
+ */
+enum Quadrant {
+    kQuadrantNorth = 0,
+    kQuadrantEast,
+    kQuadrantSouth,
+    kQuadrantWest,
+    kQuadrantCount
+};
+
+static inline int floorDiv(int numerator, int denominator) {
+    // denominator is always positive here
+    int quotient = numerator / denominator;
+    if ((numerator % denominator) != 0 && numerator < 0) {
+        quotient--;
+    }
+    return quotient;
+}
+
+static inline int ceilDiv(int numerator, int denominator) {
+    return -floorDiv(-numerator, denominator);
+}
+
+static inline VisibilityMap::Rect emptyRect() {
+    return {INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+}
+
+VisibilityMap::VisibilityMap() : width_(0), height_(0), sightRadius_(0) {
+    for (auto &team: teams_) {
+        team.dirty = emptyRect();
+    }
+}
+
+void VisibilityMap::reset(const MapData &map, int sightRadius) {
+    width_ = map.width;
+    height_ = map.height;
+    sightRadius_ = sightRadius;
+
+    const size_t cellCount = size_t(width_) * height_;
+    const size_t wordCount = (cellCount + 63) / 64;
+
+    opaqueBits_.assign(wordCount, 0);
+    for (size_t i = 0; i < cellCount && i < map.data.size(); i++) {
+        char cell = map.data[i];
+        if (cell == 'o' || cell == 'O') {
+            setBit(opaqueBits_, i, true);
+        }
+    }
+    scanMarks_.assign(wordCount, 0);
+
+    units_.clear();
+    for (auto &team: teams_) {
+        team.refCounts.assign(cellCount, 0);
+        team.visibleBits.assign(wordCount, 0);
+        team.exploredBits.assign(wordCount, 0);
+        // the whole mask has to be uploaded once
+        team.dirty = {0, 0, width_, height_};
+    }
+
+    aout << "VisibilityMap reset: " << width_ << "x" << height_ << ", sight radius "
+         << sightRadius_ << std::endl;
+}
+
+void VisibilityMap::setUnit(int unitId, int team, int x, int y) {
+    if (unitId < 0 || team < 0 || team >= kMaxTeams) {
+        return;
+    }
+    if (unitId >= (int) units_.size()) {
+        units_.resize(unitId + 1, Unit{false, false, 0, 0, 0, {}});
+    }
+
+    Unit &unit = units_[unitId];
+    if (unit.active && unit.team == team && unit.x == x && unit.y == y) {
+        return;
+    }
+    if (unit.active && unit.team != team) {
+        // the old team loses this unit's sight right away
+        removeContribution(unit);
+        unit.visibleCells.clear();
+    }
+
+    unit.active = true;
+    unit.dirty = true;
+    unit.team = team;
+    unit.x = x;
+    unit.y = y;
+}
+
+void VisibilityMap::removeUnit(int unitId) {
+    if (unitId < 0 || unitId >= (int) units_.size() || !units_[unitId].active) {
+        return;
+    }
+
+    Unit &unit = units_[unitId];
+    removeContribution(unit);
+    unit.visibleCells.clear();
+    unit.active = false;
+    unit.dirty = false;
+}
+
+void VisibilityMap::setOpaque(int x, int y, bool opaque) {
+    if (x < 0 || x >= width_ || y < 0 || y >= height_) {
+        return;
+    }
+
+    uint32_t index = uint32_t(y) * width_ + x;
+    if (testBit(opaqueBits_, index) == opaque) {
+        return;
+    }
+    setBit(opaqueBits_, index, opaque);
+
+    // only units within sight range of the cell can be affected
+    for (auto &unit: units_) {
+        if (unit.active
+            && std::abs(unit.x - x) <= sightRadius_
+            && std::abs(unit.y - y) <= sightRadius_) {
+            unit.dirty = true;
+        }
+    }
+}
+
+int VisibilityMap::update() {
+    SCROLLER_TRACE_SCOPE("VisibilityMap::update");
+    int recomputed = 0;
+
+    for (auto &unit: units_) {
+        if (!unit.active || !unit.dirty) {
+            continue;
+        }
+
+        // Add the new field of view before removing the old one, so cells seen from both positions
+        // never drop to zero and do not show up in the dirty region.
+        previousCells_.swap(unit.visibleCells);
+        computeFieldOfView(unit);
+        addContribution(unit);
+
+        previousCells_.swap(unit.visibleCells);
+        removeContribution(unit);
+        previousCells_.swap(unit.visibleCells);
+
+        unit.dirty = false;
+        recomputed++;
+    }
+
+    return recomputed;
+}
+
+bool VisibilityMap::isVisible(int team, int x, int y) const {
+    if (team < 0 || team >= kMaxTeams || x < 0 || x >= width_ || y < 0 || y >= height_) {
+        return false;
+    }
+    return testBit(teams_[team].visibleBits, uint32_t(y) * width_ + x);
+}
+
+bool VisibilityMap::isExplored(int team, int x, int y) const {
+    if (team < 0 || team >= kMaxTeams || x < 0 || x >= width_ || y < 0 || y >= height_) {
+        return false;
+    }
+    return testBit(teams_[team].exploredBits, uint32_t(y) * width_ + x);
+}
+
+bool VisibilityMap::takeDirtyRect(int team, Rect &outRect) {
+    if (team < 0 || team >= kMaxTeams || teams_[team].dirty.empty()) {
+        return false;
+    }
+
+    outRect = teams_[team].dirty;
+    teams_[team].dirty = emptyRect();
+    return true;
+}
+
+void VisibilityMap::exportMask(int team, const Rect &rect, uint8_t *outMask, int stride) const {
+    if (team < 0 || team >= kMaxTeams) {
+        return;
+    }
+
+    const Team &source = teams_[team];
+    for (int y = rect.y0; y < rect.y1; y++) {
+        uint8_t *row = outMask + size_t(y - rect.y0) * stride;
+        uint32_t index = uint32_t(y) * width_ + rect.x0;
+        for (int x = rect.x0; x < rect.x1; x++, index++) {
+            if (testBit(source.visibleBits, index)) {
+                row[x - rect.x0] = kMaskVisible;
+            } else if (testBit(source.exploredBits, index)) {
+                row[x - rect.x0] = kMaskExplored;
+            } else {
+                row[x - rect.x0] = kMaskHidden;
+            }
+        }
+    }
+}
+
+void VisibilityMap::computeFieldOfView(Unit &unit) {
+    unit.visibleCells.clear();
+    if (unit.x < 0 || unit.x >= width_ || unit.y < 0 || unit.y >= height_) {
+        return;
+    }
+
+    // A unit always sees its own cell
+    uint32_t origin = uint32_t(unit.y) * width_ + unit.x;
+    setBit(scanMarks_, origin, true);
+    unit.visibleCells.push_back(origin);
+
+    for (int quadrant = 0; quadrant < kQuadrantCount; quadrant++) {
+        scanRow(unit, quadrant, 1, Slope{-1, 1}, Slope{1, 1});
+    }
+
+    // Quadrant edges overlap, the marks only exist to avoid counting those cells twice
+    for (uint32_t index: unit.visibleCells) {
+        setBit(scanMarks_, index, false);
+    }
+}
+
+void VisibilityMap::scanRow(Unit &unit, int quadrant, int depth, Slope start, Slope end) {
+    if (depth > sightRadius_) {
+        return;
+    }
+
+    // Columns covered by this row, rounding ties towards the centre of the row
+    const int minCol = floorDiv(2 * depth * start.num + start.den, 2 * start.den);
+    const int maxCol = ceilDiv(2 * depth * end.num - end.den, 2 * end.den);
+
+    // -1 until the first cell, then whether the previous cell blocked sight
+    int previousWall = -1;
+    for (int col = minCol; col <= maxCol; col++) {
+        const bool wall = isOpaqueAt(unit, quadrant, depth, col);
+
+        // Floor cells are only revealed when the unit would also be visible from them (symmetry),
+        // walls are revealed whenever the scan reaches them.
+        const bool symmetric = col * start.den >= depth * start.num
+                               && col * end.den <= depth * end.num;
+        if (wall || symmetric) {
+            revealCell(unit, quadrant, depth, col);
+        }
+
+        if (previousWall == 1 && !wall) {
+            start = Slope{2 * col - 1, 2 * depth};
+        }
+        if (previousWall == 0 && wall) {
+            scanRow(unit, quadrant, depth + 1, start, Slope{2 * col - 1, 2 * depth});
+        }
+        previousWall = wall ? 1 : 0;
+    }
+
+    if (previousWall == 0) {
+        scanRow(unit, quadrant, depth + 1, start, end);
+    }
+}
+
+void VisibilityMap::revealCell(Unit &unit, int quadrant, int depth, int col) {
+    // keep the field of view round rather than square
+    if (depth * depth + col * col > sightRadius_ * sightRadius_ + sightRadius_) {
+        return;
+    }
+
+    int x, y;
+    if (!toMapCoordinates(unit, quadrant, depth, col, x, y)) {
+        return;
+    }
+
+    uint32_t index = uint32_t(y) * width_ + x;
+    if (!testBit(scanMarks_, index)) {
+        setBit(scanMarks_, index, true);
+        unit.visibleCells.push_back(index);
+    }
+}
+
+bool VisibilityMap::isOpaqueAt(const Unit &unit, int quadrant, int depth, int col) const {
+    int x, y;
+    if (!toMapCoordinates(unit, quadrant, depth, col, x, y)) {
+        // the map edge blocks sight like a wall
+        return true;
+    }
+    return testBit(opaqueBits_, uint32_t(y) * width_ + x);
+}
+
+bool VisibilityMap::toMapCoordinates(
+        const Unit &unit, int quadrant, int depth, int col, int &x, int &y) const {
+    switch (quadrant) {
+        case kQuadrantNorth:
+            x = unit.x + col;
+            y = unit.y - depth;
+            break;
+        case kQuadrantSouth:
+            x = unit.x + col;
+            y = unit.y + depth;
+            break;
+        case kQuadrantEast:
+            x = unit.x + depth;
+            y = unit.y + col;
+            break;
+        case kQuadrantWest:
+        default:
+            x = unit.x - depth;
+            y = unit.y + col;
+            break;
+    }
+    return x >= 0 && x < width_ && y >= 0 && y < height_;
+}
+
+void VisibilityMap::addContribution(const Unit &unit) {
+    Team &team = teams_[unit.team];
+    for (uint32_t index: unit.visibleCells) {
+        if (team.refCounts[index]++ == 0) {
+            setBit(team.visibleBits, index, true);
+            setBit(team.exploredBits, index, true);
+            markTeamDirty(team, index % width_, index / width_);
+        }
+    }
+}
+
+void VisibilityMap::removeContribution(const Unit &unit) {
+    Team &team = teams_[unit.team];
+    for (uint32_t index: unit.visibleCells) {
+        if (--team.refCounts[index] == 0) {
+            setBit(team.visibleBits, index, false);
+            markTeamDirty(team, index % width_, index / width_);
+        }
+    }
+}
+
+size_t VisibilityMap::getMemoryBytes() const {
+    size_t bytes = opaqueBits_.capacity() * sizeof(uint64_t)
+                   + units_.capacity() * sizeof(Unit)
+                   + scanMarks_.capacity() * sizeof(uint64_t)
+                   + previousCells_.capacity() * sizeof(uint32_t);
+    for (const auto &unit: units_) {
+        bytes += unit.visibleCells.capacity() * sizeof(uint32_t);
+    }
+    for (const auto &team: teams_) {
+        bytes += team.refCounts.capacity() * sizeof(uint16_t)
+                 + (team.visibleBits.capacity() + team.exploredBits.capacity()) * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+void VisibilityMap::markTeamDirty(Team &team, int x, int y) {
+    team.dirty.x0 = std::min(team.dirty.x0, x);
+    team.dirty.y0 = std::min(team.dirty.y0, y);
+    team.dirty.x1 = std::max(team.dirty.x1, x + 1);
+    team.dirty.y1 = std::max(team.dirty.y1, y + 1);
+}
@@ -0,0 +1,149 @@
+#ifndef SCROLLER_VISIBILITYMAP_H
+#define SCROLLER_VISIBILITYMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MapData.h"
+
+/*!
+ * Per-team fog of war for the tank map.
+ *
+ * Every unit computes its field of view with symmetric shadowcasting, where object cells ('o' and
+ * 'O') block sight. Each team keeps a reference count per cell so that a unit's old field of view
+ * can be subtracted and its new one added without touching anything else, which means only units
+ * that moved (or whose surroundings changed) are recomputed by @a update(). The merged result is
+ * kept as visible/explored bitplanes and can be exported as an R8 mask for the renderer.
+ *
+ * Costs are bounded by the sight radius: a recompute touches at most (2r + 1)^2 cells no matter how
+ * big the map is.
+ */
+class VisibilityMap {
+public:
+    static constexpr int kMaxTeams = 4;
+
+    //! Mask values written by @a exportMask
+    static constexpr uint8_t kMaskHidden = 0;
+    static constexpr uint8_t kMaskExplored = 96;
+    static constexpr uint8_t kMaskVisible = 255;
+
+    struct Rect {
+        int x0, y0, x1, y1; // inclusive-exclusive cell bounds
+
+        inline bool empty() const { return x1 <= x0 || y1 <= y0; }
+    };
+
+    VisibilityMap();
+
+    /*!
+     * Drops all units and rebuilds the opacity plane from the given map.
+     * @param map the map providing the obstacles
+     * @param sightRadius how far (in cells) every unit can see
+     */
+    void reset(const MapData &map, int sightRadius);
+
+    /*!
+     * Adds a unit or moves an existing one. The unit is only recomputed on the next @a update() if
+     * its position or team actually changed.
+     * @param unitId a small, dense, caller assigned id
+     */
+    void setUnit(int unitId, int team, int x, int y);
+
+    void removeUnit(int unitId);
+
+    /*!
+     * Changes whether a cell blocks sight. Units that could see the cell are recomputed.
+     */
+    void setOpaque(int x, int y, bool opaque);
+
+    /*!
+     * Recomputes the field of view of every dirty unit and merges it into its team.
+     * @return the number of units that were recomputed
+     */
+    int update();
+
+    bool isVisible(int team, int x, int y) const;
+    bool isExplored(int team, int x, int y) const;
+
+    /*!
+     * Returns and clears the region of the team's mask that changed since the last call.
+     * @return false if nothing changed
+     */
+    bool takeDirtyRect(int team, Rect &outRect);
+
+    /*!
+     * Writes the team's visibility for the given region as one byte per cell, using the kMask*
+     * values.
+     * @param outMask destination for the first row of @a rect
+     * @param stride bytes between two rows in @a outMask
+     */
+    void exportMask(int team, const Rect &rect, uint8_t *outMask, int stride) const;
+
+    inline int getWidth() const { return width_; }
+
+    inline int getHeight() const { return height_; }
+
+    /*!
+     * @return the bytes of CPU memory held by the masks and per unit state
+     */
+    size_t getMemoryBytes() const;
+
+private:
+    struct Unit {
+        bool active;
+        bool dirty;
+        int team;
+        int x, y;
+        // cells contributed to the team in the last update, reused between updates
+        std::vector<uint32_t> visibleCells;
+    };
+
+    struct Team {
+        std::vector<uint16_t> refCounts;
+        std::vector<uint64_t> visibleBits;
+        std::vector<uint64_t> exploredBits;
+        Rect dirty;
+    };
+
+    //! A slope expressed as an exact fraction, as shadowcasting needs exact tie breaking
+    struct Slope {
+        int num, den;
+    };
+
+    void computeFieldOfView(Unit &unit);
+    void scanRow(Unit &unit, int quadrant, int depth, Slope start, Slope end);
+    void revealCell(Unit &unit, int quadrant, int depth, int col);
+    bool isOpaqueAt(const Unit &unit, int quadrant, int depth, int col) const;
+    bool toMapCoordinates(const Unit &unit, int quadrant, int depth, int col, int &x, int &y) const;
+
+    void addContribution(const Unit &unit);
+    void removeContribution(const Unit &unit);
+    void markTeamDirty(Team &team, int x, int y);
+
+    static inline bool testBit(const std::vector<uint64_t> &bits, uint32_t index) {
+        return (bits[index >> 6] >> (index & 63)) & 1u;
+    }
+
+    static inline void setBit(std::vector<uint64_t> &bits, uint32_t index, bool value) {
+        uint64_t mask = uint64_t(1) << (index & 63);
+        if (value) {
+            bits[index >> 6] |= mask;
+        } else {
+            bits[index >> 6] &= ~mask;
+        }
+    }
+
+    int width_;
+    int height_;
+    int sightRadius_;
+    std::vector<uint64_t> opaqueBits_;
+    std::vector<Unit> units_;
+    Team teams_[kMaxTeams];
+    // marks cells already revealed during the current unit's scan, as quadrant edges overlap
+    std::vector<uint64_t> scanMarks_;
+    // scratch list holding a unit's previous field of view during @a update()
+    std::vector<uint32_t> previousCells_;
+};
+
+#endif //SCROLLER_VISIBILITYMAP_H
@@ -0,0 +1,504 @@
+/*!
+ * Host benchmarks of scroller_core. Every scenario runs over a few map sizes and reports the time
+ * per operation as JSON:
+ *
+ *  scroller_bench --out baseline.json
+ *  scroller_bench --baseline baseline.json --threshold 10
+ *
+ * With a baseline the run fails (exit code 1) if the median of any scenario got slower by more
+ * than the threshold in percent. Scenarios missing from the baseline are reported but never fail.
+ *
+ * --trace writes the trace markers of the run as a Chrome trace event file for ui.perfetto.dev.
+ * Every marker is kept in memory and costs time, so trace a filtered run with few samples:
+ *
+ *  scroller_bench --filter labels --samples 1 --trace labels.json
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AndroidOut.h"
+#include "Camera.h"
+#include "GridLayout.h"
+#include "GridMesh.h"
+#include "InfluenceMap.h"
+#include "MapData.h"
+#include "MapGeneration.h"
+#include "MapGenerator.h"
+#include "MapParser.h"
+#include "MeshBuilder.h"
+#include "PackedCells.h"
+#include "Pathfinder.h"
+#include "RegionLabeler.h"
+#include "RegionStats.h"
+#include "ScratchArena.h"
+#include "Simulation.h"
+#include "SparseMap.h"
+#include "Trace.h"
+#include "VectorMath.h"
+
+namespace {
+    constexpr int kMapSizes[] = {32, 128, 512};
+    // a sample runs at least this long, so timer resolution does not matter
+    constexpr double kMinSampleSeconds = 0.01;
+
+    struct Options {
+        std::string outPath;
+        std::string baselinePath;
+        std::string filter;
+        std::string tracePath;
+        double thresholdPercent = 10.0;
+        int samples = 15;
+        bool verbose = false;
+    };
+
+    struct Result {
+        std::string name;
+        int mapSize;
+        uint64_t iterations;
+        double medianNs;
+        double p90Ns;
+        double minNs;
+    };
+
+    /*!
+     * The generated map used for every scenario of a size. The corners are cleared so they can be
+     * used as path endpoints, and a staircase along the diagonal connects them, so a path between
+     * them exists whatever the seed placed around it.
+     */
+    MapData generateMap(int size, uint32_t seed) {
+        MapGenerator::Params params;
+        params.seed = seed;
+        params.width = size;
+        params.height = size;
+        params.tankDensity = 0.02f;
+        params.colorDensity = 0.03f;
+        MapData map;
+        MapGenerator(params).generate(map);
+        for (int y = 0; y < 3; y++) {
+            for (int x = 0; x < 3; x++) {
+                map.data[y * size + x] = ' ';
+                map.data[(size - 1 - y) * size + size - 1 - x] = ' ';
+            }
+        }
+        for (int i = 0; i < size; i++) {
+            map.data[i * size + i] = ' ';
+            if (i + 1 < size) {
+                map.data[i * size + i + 1] = ' ';
+            }
+        }
+        return map;
+    }
+
+    /*!
+     * Runs @a operation until a sample takes kMinSampleSeconds, then times @a samples samples of
+     * that many iterations
+     */
+    Result measure(const std::string &name, int mapSize, int samples,
+                   const std::function<void()> &operation) {
+        using Clock = std::chrono::steady_clock;
+        auto timeIterations = [&](uint64_t iterations) {
+            const auto start = Clock::now();
+            for (uint64_t i = 0; i < iterations; i++) {
+                operation();
+            }
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        };
+
+        uint64_t iterations = 1;
+        double seconds = timeIterations(iterations);
+        while (seconds < kMinSampleSeconds) {
+            iterations = seconds > 0
+                         ? std::max(iterations * 2, uint64_t(iterations * kMinSampleSeconds * 1.2 / seconds))
+                         : iterations * 10;
+            seconds = timeIterations(iterations);
+        }
+
+        std::vector<double> perIteration;
+        perIteration.reserve(samples);
+        for (int i = 0; i < samples; i++) {
+            perIteration.push_back(timeIterations(iterations) * 1e9 / iterations);
+        }
+        std::sort(perIteration.begin(), perIteration.end());
+
+        Result result;
+        result.name = name;
+        result.mapSize = mapSize;
+        result.iterations = iterations;
+        result.medianNs = perIteration[perIteration.size() / 2];
+        result.p90Ns = perIteration[std::min(perIteration.size() - 1, perIteration.size() * 9 / 10)];
+        result.minNs = perIteration.front();
+        return result;
+    }
+
+    // Keeps the optimizer from dropping work whose result is unused
+    volatile uint64_t gSink;
+
+    void runScenarios(const Options &options, std::vector<Result> &outResults) {
+        auto wanted = [&](const std::string &name) {
+            return options.filter.empty() || name.find(options.filter) != std::string::npos;
+        };
+        auto run = [&](const std::string &name, int mapSize, const std::function<void()> &operation) {
+            if (!wanted(name)) {
+                return;
+            }
+            outResults.push_back(measure(name, mapSize, options.samples, operation));
+            const Result &result = outResults.back();
+            fprintf(stderr, "%-16s %4d  median %12.1f ns  p90 %12.1f ns\n",
+                    name.c_str(), mapSize, result.medianNs, result.p90Ns);
+        };
+
+        for (int size: kMapSizes) {
+            const MapData map = generateMap(size, 12345u + size);
+            const GridLayout layout = GridLayout::forMap(map.width, map.height);
+
+            run("generate/map", size, [&] {
+                gSink = generateMap(size, 12345u + size).data.size();
+            });
+
+            const std::string json = MapGenerator::toJSON(map);
+            run("parse/json", size, [&] {
+                MapData parsed;
+                MapParser::parseJSON(json.c_str(), parsed);
+                gSink = parsed.data.size();
+            });
+
+            // Rebuilds reuse the storage of the previous build, as in the renderer
+            ScratchArena scratch;
+            MeshBuilder<Vertex, Model> builder;
+            std::vector<Model> lines;
+            std::vector<Model> triangles;
+            run("mesh/grid", size, [&] {
+                builder.recycle(lines);
+                builder.recycle(triangles);
+                GridMesh::build(map, layout, scratch, builder, lines, triangles);
+                gSink = lines.size() + triangles.size();
+            });
+
+            // Everything a map load builds off the render thread, including the frees
+            run("map/build", size, [&] {
+                MapData copy = map;
+                gSink = MapGeneration::build(std::move(copy), std::string())->lines.size();
+            });
+
+            Simulation simulation;
+            simulation.reset(map);
+            uint32_t seed = 1;
+            run("select/cell", size, [&] {
+                seed = seed * 1664525u + 1013904223u;
+                const float worldX = (float((seed >> 8) & 0xffff) / 0xffff * 2 - 1) * layout.extent;
+                const float worldY = (float(seed >> 16) / 0xffff * 2 - 1) * layout.extent;
+                int cellX, cellY;
+                if (layout.worldToCell(worldX, worldY, cellX, cellY)) {
+                    gSink = uint64_t(simulation.findUnitAt(cellX, cellY));
+                }
+            });
+
+            PackedCells packed;
+            run("packed/pack", size, [&] {
+                PackedCells::pack(map, packed);
+                gSink = packed.getRowBytes();
+            });
+            MapData unpacked;
+            run("packed/unpack", size, [&] {
+                packed.unpack(unpacked);
+                gSink = unpacked.data.size();
+            });
+
+            RegionStats regions;
+            run("region/rebuild", size, [&] {
+                regions.rebuild(map);
+                gSink = regions.getTotal(RegionStats::kTypeTank);
+            });
+            run("region/count", size, [&] {
+                seed = seed * 1664525u + 1013904223u;
+                const int x = int((seed >> 8) % uint32_t(size));
+                const int y = int((seed >> 4) % uint32_t(size));
+                gSink = regions.count(RegionStats::kTypeTank, x - 32, y - 32, x + 32, y + 32);
+            });
+
+            RegionLabeler labeler;
+            run("labels/rebuild", size, [&] {
+                labeler.rebuild(map);
+                gSink = uint64_t(labeler.getRegionCount());
+            });
+            // A tank driving through: one cell closes, the cell it left opens again
+            run("labels/toggle", size, [&] {
+                seed = seed * 1664525u + 1013904223u;
+                const int x = int((seed >> 8) % uint32_t(size));
+                const int y = int((seed >> 4) % uint32_t(size));
+                const char value = map.data[size_t(y) * size + x];
+                labeler.setCell(x, y, 'x');
+                labeler.setCell(x, y, value);
+                labeler.flush();
+                gSink = uint64_t(labeler.getRegionCount());
+            });
+
+            // A tick of 1024 units each stepping to a neighbouring cell, plus the texture export
+            constexpr int kInfluenceUnits = 1024;
+            InfluenceMap influence;
+            influence.reset(size, size, 2);
+            std::vector<std::pair<int, int>> positions(kInfluenceUnits);
+            for (int i = 0; i < kInfluenceUnits; i++) {
+                seed = seed * 1664525u + 1013904223u;
+                positions[i] = {int((seed >> 8) % uint32_t(size)), int((seed >> 4) % uint32_t(size))};
+                influence.setUnit(i, positions[i].first, positions[i].second);
+            }
+            std::vector<uint8_t> heat(size_t(influence.getWidth()) * influence.getHeight());
+            run("influence/tick", size, [&] {
+                for (int i = 0; i < kInfluenceUnits; i++) {
+                    seed = seed * 1664525u + 1013904223u;
+                    auto &position = positions[i];
+                    position.first = std::clamp(position.first + int(seed >> 30) - 1, 0, size - 1);
+                    position.second = std::clamp(position.second + int((seed >> 28) & 3) - 1, 0,
+                                                 size - 1);
+                    influence.setUnit(i, position.first, position.second);
+                }
+                InfluenceMap::Rect dirty;
+                if (influence.takeDirtyRect(dirty)) {
+                    influence.exportMask(dirty, heat.data(), dirty.x1 - dirty.x0);
+                }
+                gSink = heat[0];
+            });
+
+            // A failed search returns early and would time nothing but that
+            Pathfinder pathfinder;
+            std::vector<std::pair<int, int>> path;
+            if (!pathfinder.findPath(map, 0, 0, size - 1, size - 1, path)) {
+                fprintf(stderr, "path/corner %d: no path between the corners\n", size);
+                exit(1);
+            }
+            run("path/corner", size, [&] {
+                pathfinder.findPath(map, 0, 0, size - 1, size - 1, path);
+                gSink = path.size();
+            });
+        }
+
+        // Rows of the largest map the generator makes, as written into a tile file
+        MapGenerator::Params largest;
+        largest.width = MapGenerator::kMaxSize;
+        largest.height = MapGenerator::kMaxSize;
+        const MapGenerator largestGenerator(largest);
+        std::vector<char> row(size_t(largest.width));
+        int generatedRow = 0;
+        run("generate/row", largest.width, [&] {
+            largestGenerator.generateRow(generatedRow++ % largest.height, row.data());
+            gSink = uint64_t(row[0]);
+        });
+
+        // A large, mostly empty world with a few thousand units
+        constexpr int kSparseSize = 16384;
+        SparseMap sparse;
+        sparse.reset(kSparseSize, kSparseSize);
+        uint32_t sparseSeed = 7;
+        for (int i = 0; i < 4000; i++) {
+            sparseSeed = sparseSeed * 1664525u + 1013904223u;
+            sparse.set(int((sparseSeed >> 8) % kSparseSize), int((sparseSeed >> 4) % kSparseSize),
+                       char('1' + i % 3));
+        }
+        run("sparse/get", kSparseSize, [&] {
+            sparseSeed = sparseSeed * 1664525u + 1013904223u;
+            gSink = uint64_t(sparse.get(int((sparseSeed >> 8) % kSparseSize),
+                                        int((sparseSeed >> 4) % kSparseSize)));
+        });
+        run("sparse/scan", kSparseSize, [&] {
+            uint64_t units = 0;
+            sparse.forEachNonEmpty([&units](int, int, char) {
+                units++;
+            });
+            gSink = units;
+        });
+
+        float scroll = 0;
+        run("matrix/build", 0, [&] {
+            scroll += 0.01f;
+            const Mat4 viewProjection = Mat4::orthographic(4.f + scroll, 1.7f, -1.f, 1.f)
+                                        * Mat4::translation(scroll, -scroll);
+            gSink = uint64_t(viewProjection.m[12]);
+        });
+
+        // A frame worth of unit positions
+        std::vector<float> points(2048);
+        for (size_t i = 0; i < points.size(); i++) {
+            points[i] = float(i % 97) * 0.1f;
+        }
+        std::vector<float> transformed(points.size());
+        const Mat4 transform = Mat4::orthographic(4.f, 1.7f, -1.f, 1.f) * Mat4::translation(1.f, 2.f);
+        run("matrix/points", int(points.size() / 2), [&] {
+            transform.transformPoints(points.data(), transformed.data(), points.size() / 2);
+            gSink = uint64_t(transformed[7]);
+        });
+
+        // Picking while scrolling, so every call rebuilds the inverse
+        Camera camera;
+        camera.setProjection(2.f, -1.f, 1.f);
+        camera.setViewport(1080, 2400);
+        run("camera/pick", 0, [&] {
+            scroll += 0.01f;
+            camera.setPosition(scroll, -scroll);
+            float worldX, worldY;
+            camera.screenToWorld(540.f, 1200.f, worldX, worldY);
+            gSink = uint64_t(worldX);
+        });
+    }
+
+    std::string resultsToJSON(const std::vector<Result> &results) {
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(1) << "{\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result &result = results[i];
+            // one scenario per line, which is what readBaseline() expects
+            json << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name
+                 << "\", \"map_size\": " << result.mapSize
+                 << ", \"iterations\": " << result.iterations
+                 << ", \"median_ns\": " << result.medianNs
+                 << ", \"p90_ns\": " << result.p90Ns
+                 << ", \"min_ns\": " << result.minNs << "}";
+        }
+        json << "\n  ]\n}\n";
+        return json.str();
+    }
+
+    std::string getKey(const std::string &name, int mapSize) {
+        return name + "@" + std::to_string(mapSize);
+    }
+
+    /*!
+     * Reads the medians of a file written by resultsToJSON()
+     * @return false if the file cannot be read
+     */
+    bool readBaseline(const std::string &path, std::map<std::string, double> &outMedians) {
+        FILE *file = fopen(path.c_str(), "r");
+        if (!file) {
+            aout << "Failed to open baseline " << path << std::endl;
+            return false;
+        }
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            char name[128];
+            int mapSize;
+            unsigned long long iterations;
+            double median;
+            if (sscanf(line, " {\"name\": \"%127[^\"]\", \"map_size\": %d, \"iterations\": %llu, "
+                             "\"median_ns\": %lf", name, &mapSize, &iterations, &median) == 4) {
+                outMedians[getKey(name, mapSize)] = median;
+            }
+        }
+        fclose(file);
+        return true;
+    }
+
+    /*!
+     * @return the number of scenarios slower than the baseline by more than the threshold
+     */
+    int compareToBaseline(const std::vector<Result> &results,
+                          const std::map<std::string, double> &baseline,
+                          double thresholdPercent) {
+        int regressions = 0;
+        for (const auto &result: results) {
+            auto entry = baseline.find(getKey(result.name, result.mapSize));
+            if (entry == baseline.end()) {
+                fprintf(stderr, "%-16s %4d  not in baseline\n", result.name.c_str(), result.mapSize);
+                continue;
+            }
+            const double change = (result.medianNs / entry->second - 1.0) * 100.0;
+            const bool regressed = change > thresholdPercent;
+            regressions += regressed;
+            fprintf(stderr, "%-16s %4d  %+7.1f%%%s\n", result.name.c_str(), result.mapSize, change,
+                    regressed ? "  REGRESSION" : "");
+        }
+        return regressions;
+    }
+
+    void printUsage() {
+        fprintf(stderr,
+                "usage: scroller_bench [--out file] [--baseline file] [--threshold percent]\n"
+                "                      [--filter substring] [--samples count] [--verbose]\n"
+                "                      [--trace file]\n");
+    }
+
+    bool parseOptions(int argc, char **argv, Options &outOptions) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--out") == 0 && hasValue) {
+                outOptions.outPath = argv[++i];
+            } else if (strcmp(arg, "--baseline") == 0 && hasValue) {
+                outOptions.baselinePath = argv[++i];
+            } else if (strcmp(arg, "--threshold") == 0 && hasValue) {
+                outOptions.thresholdPercent = atof(argv[++i]);
+            } else if (strcmp(arg, "--filter") == 0 && hasValue) {
+                outOptions.filter = argv[++i];
+            } else if (strcmp(arg, "--samples") == 0 && hasValue) {
+                outOptions.samples = std::max(1, atoi(argv[++i]));
+            } else if (strcmp(arg, "--verbose") == 0) {
+                outOptions.verbose = true;
+            } else if (strcmp(arg, "--trace") == 0 && hasValue) {
+                outOptions.tracePath = argv[++i];
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!options.baselinePath.empty() && !readBaseline(options.baselinePath, baseline)) {
+        return 2;
+    }
+
+    // The core logs every parse, which would swamp the output and the timings
+    if (!options.verbose) {
+        aout.setstate(std::ios::badbit);
+    }
+    if (!options.tracePath.empty()) {
+        Trace::startCapture(options.tracePath);
+    }
+    std::vector<Result> results;
+    runScenarios(options, results);
+    aout.clear();
+    if (!options.tracePath.empty() && !Trace::stopCapture()) {
+        return 2;
+    }
+
+    const std::string json = resultsToJSON(results);
+    if (options.outPath.empty()) {
+        fputs(json.c_str(), stdout);
+    } else {
+        FILE *file = fopen(options.outPath.c_str(), "w");
+        if (!file) {
+            aout << "Failed to write " << options.outPath << std::endl;
+            return 2;
+        }
+        fputs(json.c_str(), file);
+        fclose(file);
+    }
+
+    if (!options.baselinePath.empty()) {
+        const int regressions = compareToBaseline(results, baseline, options.thresholdPercent);
+        if (regressions > 0) {
+            fprintf(stderr, "%d scenarios regressed by more than %.1f%%\n", regressions,
+                    options.thresholdPercent);
+            return 1;
+        }
+    }
+    return 0;
+}
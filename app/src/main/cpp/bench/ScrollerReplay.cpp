@@ -0,0 +1,206 @@
+/*!
+ * Replays a session log from the app (last_session.srec in its internal data directory) on the
+ * host and reports the CPU time per frame, the summary the app writes to replay_timings.txt:
+ *
+ *  adb shell run-as com.example.scroller cat files/last_session.srec > session.srec
+ *  scroller_replay --out timings.txt session.srec
+ *
+ * Every frame runs what the app's frame runs outside of GL: the maps of the log are built with
+ * MapGeneration::build() when they are reached, and the recorded number of simulation ticks is
+ * stepped, keeping the region tables up to date with the cells the units changed.
+ *
+ * Touches are counted but not applied, in the app they go through the camera and the tank
+ * selection of the Renderer. Units therefore stay where the map puts them, the host replay times
+ * map loads and ticks but not driving. Drawing, fog of war and the heat map are left to the app.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "AndroidOut.h"
+#include "MapGeneration.h"
+#include "SessionRecording.h"
+#include "Simulation.h"
+#include "SimulationClock.h"
+#include "Trace.h"
+
+namespace {
+    //! Renderer::kSimulationTickRate, the log only has the number of ticks per frame
+    constexpr int kDefaultTickRate = 30;
+
+    struct Options {
+        std::string logPath;
+        std::string outPath;
+        std::string tilePath;
+        std::string tracePath;
+        int tickRate = kDefaultTickRate;
+        bool verbose = false;
+    };
+
+    /*!
+     * What a replay has, the host's part of the Renderer
+     */
+    struct Replay {
+        std::unique_ptr<MapGeneration> generation;
+        Simulation simulation;
+        uint64_t maps = 0;
+        uint64_t ticks = 0;
+        uint64_t motionEvents = 0;
+        uint64_t skippedRecords = 0;
+    };
+
+    void loadMap(const Options &options, MapData map, Replay &replay) {
+        SCROLLER_TRACE_SCOPE("replay: build map");
+        replay.generation = MapGeneration::build(std::move(map), options.tilePath);
+        replay.simulation.reset(replay.generation->map);
+        replay.maps++;
+    }
+
+    void step(const Options &options, int ticks, Replay &replay) {
+        SCROLLER_TRACE_SCOPE("replay: ticks");
+        if (!replay.generation) {
+            return;
+        }
+        MapGeneration &generation = *replay.generation;
+        const float tickSeconds = 1.0f / float(options.tickRate);
+        for (int tick = 0; tick < ticks; tick++) {
+            replay.simulation.step(tickSeconds, generation.map);
+        }
+        replay.ticks += uint64_t(ticks);
+
+        for (const auto &cell: replay.simulation.getChangedCells()) {
+            const char value = generation.map.data[cell.second * generation.map.width + cell.first];
+            generation.regionStats.setCell(cell.first, cell.second, value);
+            generation.regions.setCell(cell.first, cell.second, value);
+        }
+        generation.regions.flush();
+        replay.simulation.clearMovedUnits();
+    }
+
+    /*!
+     * Runs the records of one frame, up to and including its frame end
+     * @return false at the end of the log
+     */
+    bool replayFrame(const Options &options, SessionPlayer &player, Replay &replay) {
+        SCROLLER_TRACE_SCOPE("replay: frame");
+        SessionLog::Record record;
+        while (player.readRecord(record)) {
+            switch (record.type) {
+                case SessionLog::kRecordMotionEvent:
+                    replay.motionEvents++;
+                    break;
+
+                case SessionLog::kRecordMapSnapshot:
+                case SessionLog::kRecordPackedMapSnapshot:
+                case SessionLog::kRecordGeneratedMap: {
+                    MapData map;
+                    if (SessionPlayer::decodeMapSnapshot(record, map)) {
+                        loadMap(options, std::move(map), replay);
+                    }
+                    break;
+                }
+
+                case SessionLog::kRecordFrameEnd: {
+                    int ticks = 0;
+                    float alpha;
+                    if (SessionPlayer::decodeFrameEnd(record, ticks, alpha)) {
+                        step(options, ticks, replay);
+                    }
+                    return true;
+                }
+
+                default:
+                    // Surface sizes and network completions only matter to the Renderer
+                    replay.skippedRecords++;
+                    break;
+            }
+        }
+        return false;
+    }
+
+    void printUsage() {
+        fprintf(stderr,
+                "usage: scroller_replay [--out file] [--tiles file] [--tick-rate ticks]\n"
+                "                       [--trace file] [--verbose] session.srec\n");
+    }
+
+    bool parseOptions(int argc, char **argv, Options &outOptions) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--out") == 0 && hasValue) {
+                outOptions.outPath = argv[++i];
+            } else if (strcmp(arg, "--tiles") == 0 && hasValue) {
+                outOptions.tilePath = argv[++i];
+            } else if (strcmp(arg, "--tick-rate") == 0 && hasValue) {
+                outOptions.tickRate = std::max(1, atoi(argv[++i]));
+            } else if (strcmp(arg, "--trace") == 0 && hasValue) {
+                outOptions.tracePath = argv[++i];
+            } else if (strcmp(arg, "--verbose") == 0) {
+                outOptions.verbose = true;
+            } else if (arg[0] != '-' && outOptions.logPath.empty()) {
+                outOptions.logPath = arg;
+            } else {
+                return false;
+            }
+        }
+        return !outOptions.logPath.empty();
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    std::unique_ptr<SessionPlayer> player = SessionPlayer::open(options.logPath);
+    if (!player) {
+        fprintf(stderr, "Failed to open the session log %s\n", options.logPath.c_str());
+        return 2;
+    }
+
+    // The core logs every map it builds, which would swamp the output and the timings
+    if (!options.verbose) {
+        aout.setstate(std::ios::badbit);
+    }
+    if (!options.tracePath.empty()) {
+        Trace::startCapture(options.tracePath);
+    }
+    Replay replay;
+    bool more = true;
+    while (more) {
+        const int64_t frameStartNanos = SimulationClock::nowNanos();
+        more = replayFrame(options, *player, replay);
+        if (more) {
+            player->addFrameTime(SimulationClock::nowNanos() - frameStartNanos);
+        }
+    }
+    aout.clear();
+    if (!options.tracePath.empty() && !Trace::stopCapture()) {
+        return 2;
+    }
+
+    const std::string summary = player->summarizeFrameTimes();
+    fprintf(stderr, "%llu maps, %llu ticks, %llu touches not applied, %llu records skipped\n",
+            (unsigned long long) replay.maps, (unsigned long long) replay.ticks,
+            (unsigned long long) replay.motionEvents, (unsigned long long) replay.skippedRecords);
+    if (options.outPath.empty()) {
+        printf("%s\n", summary.c_str());
+    } else {
+        FILE *file = fopen(options.outPath.c_str(), "w");
+        if (!file) {
+            aout << "Failed to write " << options.outPath << std::endl;
+            return 2;
+        }
+        fprintf(file, "%s\n", summary.c_str());
+        fclose(file);
+    }
+    return 0;
+}
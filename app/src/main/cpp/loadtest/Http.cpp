@@ -0,0 +1,218 @@
+#include "Http.h"
+
+#include <arpa/inet.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+    //! Longest status line plus headers accepted
+    constexpr size_t kMaxHeadBytes = 16 * 1024;
+
+    const char *getReason(int status) {
+        switch (status) {
+            case 200:
+                return "OK";
+            case 400:
+                return "Bad Request";
+            case 404:
+                return "Not Found";
+            case 503:
+                return "Service Unavailable";
+            default:
+                return "Error";
+        }
+    }
+
+    /*!
+     * Reads a message head and its body. Without a Content-Length the body ends when the peer
+     * closes the connection if @a bodyUntilClose, and is empty otherwise.
+     */
+    bool readMessage(int socket, bool bodyUntilClose, std::string &outStartLine,
+                     std::string &outBody) {
+        std::string buffer;
+        char chunk[64 * 1024];
+        size_t headEnd;
+        while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (buffer.size() > kMaxHeadBytes) {
+                return false;
+            }
+            ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                return false;
+            }
+            buffer.append(chunk, size_t(received));
+        }
+
+        const std::string head = buffer.substr(0, headEnd);
+        outStartLine = head.substr(0, head.find("\r\n"));
+
+        long long contentLength = -1;
+        size_t lineStart = outStartLine.size() + 2;
+        while (lineStart < head.size()) {
+            size_t lineEnd = head.find("\r\n", lineStart);
+            if (lineEnd == std::string::npos) {
+                lineEnd = head.size();
+            }
+            const size_t colon = head.find(':', lineStart);
+            if (colon < lineEnd) {
+                std::string name = head.substr(lineStart, colon - lineStart);
+                for (char &c : name) {
+                    c = char(tolower(uint8_t(c)));
+                }
+                if (name == "content-length") {
+                    contentLength = atoll(head.c_str() + colon + 1);
+                }
+            }
+            lineStart = lineEnd + 2;
+        }
+
+        outBody = buffer.substr(headEnd + 4);
+        if (contentLength >= 0) {
+            if (size_t(contentLength) > Http::kMaxMessageBytes) {
+                return false;
+            }
+            outBody.reserve(size_t(contentLength));
+            while (outBody.size() < size_t(contentLength)) {
+                ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    return false;
+                }
+                outBody.append(chunk, size_t(received));
+            }
+            outBody.resize(size_t(contentLength));
+        } else if (bodyUntilClose) {
+            while (true) {
+                ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+                if (received == 0) {
+                    break;
+                }
+                if (received < 0 || outBody.size() > Http::kMaxMessageBytes) {
+                    return false;
+                }
+                outBody.append(chunk, size_t(received));
+            }
+        } else {
+            outBody.clear();
+        }
+        return true;
+    }
+}
+
+int Http::listenOn(int port, bool loopbackOnly) {
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    address.sin_port = htons(uint16_t(port));
+    if (bind(listenSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || listen(listenSocket, SOMAXCONN) != 0) {
+        close(listenSocket);
+        return -1;
+    }
+    return listenSocket;
+}
+
+int Http::connectTo(const std::string &host, int port, int timeoutMs) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    int connected = -1;
+    for (addrinfo *address = addresses; address && connected < 0; address = address->ai_next) {
+        int candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (candidate < 0) {
+            continue;
+        }
+        timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        setsockopt(candidate, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(candidate, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        // Requests are written in one go, waiting for more to send only adds latency
+        int noDelay = 1;
+        setsockopt(candidate, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (connect(candidate, address->ai_addr, address->ai_addrlen) == 0) {
+            connected = candidate;
+        } else {
+            close(candidate);
+        }
+    }
+    freeaddrinfo(addresses);
+    return connected;
+}
+
+bool Http::sendAll(int socket, const char *data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        // A client that hung up must not kill the process with SIGPIPE
+        ssize_t result = send(socket, data + sent, size - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return false;
+        }
+        sent += size_t(result);
+    }
+    return true;
+}
+
+bool Http::readRequest(int socket, Request &outRequest) {
+    std::string requestLine;
+    if (!readMessage(socket, false, requestLine, outRequest.body)) {
+        return false;
+    }
+    // METHOD path HTTP/1.x, a query string is part of the path
+    const size_t methodEnd = requestLine.find(' ');
+    const size_t pathEnd = requestLine.find(' ', methodEnd + 1);
+    if (methodEnd == std::string::npos || pathEnd == std::string::npos) {
+        return false;
+    }
+    outRequest.method = requestLine.substr(0, methodEnd);
+    outRequest.path = requestLine.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+    return true;
+}
+
+bool Http::readResponse(int socket, Response &outResponse) {
+    std::string statusLine;
+    if (!readMessage(socket, true, statusLine, outResponse.body)) {
+        return false;
+    }
+    // HTTP/1.x status reason
+    const size_t versionEnd = statusLine.find(' ');
+    if (versionEnd == std::string::npos) {
+        return false;
+    }
+    outResponse.status = atoi(statusLine.c_str() + versionEnd + 1);
+    return outResponse.status > 0;
+}
+
+std::string Http::formatRequest(const std::string &host, int port, const Request &request) {
+    std::string message = request.method + " " + request.path + " HTTP/1.0\r\nHost: " + host
+                          + ":" + std::to_string(port) + "\r\n";
+    if (!request.body.empty()) {
+        message += "Content-Type: application/json\r\nContent-Length: "
+                   + std::to_string(request.body.size()) + "\r\n";
+    }
+    message += "Connection: close\r\n\r\n";
+    message += request.body;
+    return message;
+}
+
+std::string Http::formatHeaders(const Response &response) {
+    return "HTTP/1.0 " + std::to_string(response.status) + " " + getReason(response.status)
+           + "\r\nContent-Type: " + response.contentType + "\r\nContent-Length: "
+           + std::to_string(response.body.size()) + "\r\nConnection: close\r\n\r\n";
+}
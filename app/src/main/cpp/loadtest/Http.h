@@ -0,0 +1,63 @@
+#ifndef SCROLLER_HTTP_H
+#define SCROLLER_HTTP_H
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * Just enough HTTP/1.0 over blocking sockets for the stand-in tanks server and the load generator:
+ * one request per connection, bodies framed by Content-Length or by closing the connection.
+ */
+namespace Http {
+    //! Requests and responses larger than this are rejected, a 16k x 16k map is about 1.3 GB
+    constexpr size_t kMaxMessageBytes = size_t(2) << 30;
+
+    struct Request {
+        std::string method;
+        std::string path;
+        std::string body;
+    };
+
+    struct Response {
+        int status = 0;
+        std::string contentType;
+        std::string body;
+    };
+
+    /*!
+     * Opens a listening socket
+     * @param loopbackOnly accept connections from this machine only, e.g. through adb reverse
+     * @return the socket or -1
+     */
+    int listenOn(int port, bool loopbackOnly);
+
+    /*!
+     * Connects to a server, receiving gives up after @a timeoutMs
+     * @return the socket or -1
+     */
+    int connectTo(const std::string &host, int port, int timeoutMs);
+
+    bool sendAll(int socket, const char *data, size_t size);
+
+    /*!
+     * Reads a request up to the end of its body
+     */
+    bool readRequest(int socket, Request &outRequest);
+
+    /*!
+     * Reads a response up to the end of its body
+     */
+    bool readResponse(int socket, Response &outResponse);
+
+    /*!
+     * @return the request with its headers, ready to send
+     */
+    std::string formatRequest(const std::string &host, int port, const Request &request);
+
+    /*!
+     * @return the status line and the headers of a response, the body is sent after them
+     */
+    std::string formatHeaders(const Response &response);
+}
+
+#endif //SCROLLER_HTTP_H
@@ -0,0 +1,277 @@
+/*!
+ * Many simulated clients against a tanks server, scroller_server or the real one, measuring the
+ * round trips the app makes:
+ *
+ *  map       GET /tanks/index.php and MapParser::parseJSON(), a map refresh
+ *  image     GET /maps/tank.png, once per client like the app's startup
+ *  highlight POST /tanks/index.php of a random cell
+ *
+ *  scroller_loadgen --clients 64 --seconds 30 --highlight-every 4 --out latency.json
+ *
+ * Every client loops over requests on its own thread and connection per request, as the app does.
+ * Latencies of successful requests are reported per operation as JSON, requests that failed to
+ * connect, timed out, got a status other than 200 or an unparsable map count as errors.
+ *
+ * --trace writes every request, and the map parses, as a Chrome trace event file with a track per
+ * client.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "AndroidOut.h"
+#include "Http.h"
+#include "MapData.h"
+#include "MapParser.h"
+#include "Trace.h"
+
+namespace {
+    constexpr char kMapPath[] = "/tanks/index.php";
+    constexpr char kImagePath[] = "/maps/tank.png";
+
+    enum Operation {
+        kOperationMap,
+        kOperationImage,
+        kOperationHighlight,
+        kOperationCount,
+    };
+
+    constexpr const char *kOperationNames[kOperationCount] = {"map", "image", "highlight"};
+
+    struct Options {
+        std::string host = "127.0.0.1";
+        int port = 8585;
+        int clients = 16;
+        double seconds = 10.0;
+        //! every n-th request of a client is a highlight, 0 for none
+        int highlightEvery = 4;
+        int thinkMs = 0;
+        int timeoutMs = 10000;
+        uint32_t seed = 1;
+        std::string outPath;
+        std::string tracePath;
+        bool verbose = false;
+    };
+
+    struct Stats {
+        std::vector<double> latenciesMs;
+        uint64_t errors = 0;
+        uint64_t bytes = 0;
+    };
+
+    /*!
+     * One request on a new connection
+     * @return false if the request failed, @a outResponse holds the status if one came back
+     */
+    bool roundTrip(const Options &options, const Http::Request &request,
+                   Http::Response &outResponse) {
+        const int socket = Http::connectTo(options.host, options.port, options.timeoutMs);
+        if (socket < 0) {
+            return false;
+        }
+        const std::string message = Http::formatRequest(options.host, options.port, request);
+        const bool ok = Http::sendAll(socket, message.data(), message.size())
+                        && Http::readResponse(socket, outResponse);
+        close(socket);
+        return ok && outResponse.status == 200;
+    }
+
+    void runClient(const Options &options, int client,
+                   std::chrono::steady_clock::time_point end, Stats *outStats) {
+        using Clock = std::chrono::steady_clock;
+        // aout is per thread, parses would swamp the output and the timings
+        if (!options.verbose) {
+            aout.setstate(std::ios::badbit);
+        }
+        std::minstd_rand random(options.seed * 2654435761u + uint32_t(client));
+        // the size of the last map downloaded, highlights land inside it
+        MapData map{{}, 0, 0};
+
+        for (int i = 0; Clock::now() < end; i++) {
+            Operation operation = kOperationMap;
+            Http::Request request{"GET", kMapPath, std::string()};
+            if (i == 0) {
+                operation = kOperationImage;
+                request.path = kImagePath;
+            } else if (options.highlightEvery > 0 && map.width > 0
+                       && i % options.highlightEvery == 0) {
+                operation = kOperationHighlight;
+                request.method = "POST";
+                request.body = "{\n    \"x\": " + std::to_string(random() % map.width)
+                               + ",\n    \"y\": " + std::to_string(random() % map.height)
+                               + ",\n    \"value\": \"XH\"\n}";
+            }
+
+            const auto start = Clock::now();
+            Http::Response response;
+            bool ok;
+            {
+                SCROLLER_TRACE_SCOPE(kOperationNames[operation]);
+                ok = roundTrip(options, request, response);
+                if (ok && operation == kOperationMap) {
+                    ok = MapParser::parseJSON(response.body.c_str(), map);
+                }
+            }
+            const double latencyMs =
+                    std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            Stats &stats = outStats[operation];
+            if (ok) {
+                stats.latenciesMs.push_back(latencyMs);
+                stats.bytes += response.body.size();
+            } else {
+                stats.errors++;
+                if (options.verbose) {
+                    fprintf(stderr, "client %d: %s failed with status %d after %.1f ms\n", client,
+                            kOperationNames[operation], response.status, latencyMs);
+                }
+            }
+            if (options.thinkMs > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(options.thinkMs));
+            }
+        }
+    }
+
+    double getPercentile(const std::vector<double> &sorted, double percentile) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        const size_t index = size_t(percentile / 100.0 * double(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    std::string statsToJSON(const Options &options, double seconds, const Stats *stats) {
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(2) << "{\n  \"clients\": " << options.clients
+             << ",\n  \"seconds\": " << seconds << ",\n  \"operations\": [";
+        for (int operation = 0; operation < kOperationCount; operation++) {
+            std::vector<double> sorted = stats[operation].latenciesMs;
+            std::sort(sorted.begin(), sorted.end());
+            json << (operation ? ",\n" : "\n") << "    {\"name\": \""
+                 << kOperationNames[operation] << "\", \"requests\": " << sorted.size()
+                 << ", \"errors\": " << stats[operation].errors
+                 << ", \"per_second\": " << sorted.size() / seconds
+                 << ", \"p50_ms\": " << getPercentile(sorted, 50.0)
+                 << ", \"p90_ms\": " << getPercentile(sorted, 90.0)
+                 << ", \"p99_ms\": " << getPercentile(sorted, 99.0)
+                 << ", \"max_ms\": " << (sorted.empty() ? 0.0 : sorted.back())
+                 << ", \"kb_per_second\": " << stats[operation].bytes / 1024.0 / seconds << "}";
+        }
+        json << "\n  ]\n}\n";
+        return json.str();
+    }
+
+    void printUsage() {
+        fprintf(stderr,
+                "usage: scroller_loadgen [--host host] [--port port] [--clients count]\n"
+                "                        [--seconds seconds] [--highlight-every count]\n"
+                "                        [--think-ms ms] [--timeout-ms ms] [--seed seed]\n"
+                "                        [--out file] [--trace file] [--verbose]\n");
+    }
+
+    bool parseOptions(int argc, char **argv, Options &outOptions) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--host") == 0 && hasValue) {
+                outOptions.host = argv[++i];
+            } else if (strcmp(arg, "--port") == 0 && hasValue) {
+                outOptions.port = atoi(argv[++i]);
+            } else if (strcmp(arg, "--clients") == 0 && hasValue) {
+                outOptions.clients = std::max(1, atoi(argv[++i]));
+            } else if (strcmp(arg, "--seconds") == 0 && hasValue) {
+                outOptions.seconds = std::max(0.1, atof(argv[++i]));
+            } else if (strcmp(arg, "--highlight-every") == 0 && hasValue) {
+                outOptions.highlightEvery = std::max(0, atoi(argv[++i]));
+            } else if (strcmp(arg, "--think-ms") == 0 && hasValue) {
+                outOptions.thinkMs = std::max(0, atoi(argv[++i]));
+            } else if (strcmp(arg, "--timeout-ms") == 0 && hasValue) {
+                outOptions.timeoutMs = std::max(1, atoi(argv[++i]));
+            } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+                outOptions.seed = uint32_t(strtoul(argv[++i], nullptr, 10));
+            } else if (strcmp(arg, "--out") == 0 && hasValue) {
+                outOptions.outPath = argv[++i];
+            } else if (strcmp(arg, "--trace") == 0 && hasValue) {
+                outOptions.tracePath = argv[++i];
+            } else if (strcmp(arg, "--verbose") == 0) {
+                outOptions.verbose = true;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    using Clock = std::chrono::steady_clock;
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    if (!options.tracePath.empty()) {
+        Trace::startCapture(options.tracePath);
+    }
+    std::vector<Stats> stats(size_t(options.clients) * kOperationCount);
+    std::vector<std::thread> clients;
+    const auto start = Clock::now();
+    const auto end = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options.seconds));
+    for (int client = 0; client < options.clients; client++) {
+        clients.emplace_back(runClient, std::cref(options), client, end,
+                             &stats[size_t(client) * kOperationCount]);
+    }
+    for (std::thread &client : clients) {
+        client.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (!options.tracePath.empty() && !Trace::stopCapture()) {
+        return 2;
+    }
+
+    Stats total[kOperationCount];
+    for (int client = 0; client < options.clients; client++) {
+        for (int operation = 0; operation < kOperationCount; operation++) {
+            const Stats &clientStats = stats[size_t(client) * kOperationCount + operation];
+            total[operation].latenciesMs.insert(total[operation].latenciesMs.end(),
+                                                clientStats.latenciesMs.begin(),
+                                                clientStats.latenciesMs.end());
+            total[operation].errors += clientStats.errors;
+            total[operation].bytes += clientStats.bytes;
+        }
+    }
+
+    const std::string json = statsToJSON(options, seconds, total);
+    if (options.outPath.empty()) {
+        fputs(json.c_str(), stdout);
+    } else {
+        FILE *file = fopen(options.outPath.c_str(), "w");
+        if (!file) {
+            aout << "Failed to write " << options.outPath << std::endl;
+            return 2;
+        }
+        fputs(json.c_str(), file);
+        fclose(file);
+    }
+
+    // Nothing got through at all, most likely no server is listening
+    uint64_t succeeded = 0;
+    for (const Stats &operationStats : total) {
+        succeeded += operationStats.latenciesMs.size();
+    }
+    return succeeded > 0 ? 0 : 1;
+}
@@ -0,0 +1,481 @@
+/*!
+ * A local stand-in for the tanks server, speaking the same protocol as the real one:
+ *
+ *  GET  /tanks/index.php   the map as JSON, or with ?format=packed in the PackedCells form, which
+ *                          the real server does not know and answers with JSON
+ *  GET  /maps/tank.png     the tank image
+ *  POST /tanks/index.php   {"x": 3, "y": 4, "value": "XH"} stores the first character of value in
+ *                          a cell, later map downloads include it
+ *
+ * The map is generated with MapGenerator, or read from a JSON file. Every response can be delayed,
+ * throttled and made to fail, so the client and scroller_loadgen see a network that is slow and
+ * flaky in a repeatable way:
+ *
+ *  scroller_server --size 512 --latency-ms 80 --jitter-ms 40 --bandwidth-kbps 2000
+ *                  --error-rate 0.01 --reset-rate 0.01
+ *
+ * The app reaches it through adb reverse tcp:8585 tcp:8585 and http://127.0.0.1:8585 in its
+ * server_url.txt.
+ *
+ * --trace writes every connection as a Chrome trace event file when a run limited with --seconds
+ * ends.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "AndroidOut.h"
+#include "Http.h"
+#include "MapData.h"
+#include "MapGenerator.h"
+#include "MapParser.h"
+#include "Trace.h"
+
+namespace {
+    constexpr char kMapPath[] = "/tanks/index.php";
+    constexpr char kImagePath[] = "/maps/tank.png";
+    //! Size of the built in tank image
+    constexpr int kImageSize = 32;
+    //! Throttled responses are sent in slices of this many milliseconds
+    constexpr int kSliceMs = 10;
+    //! A client that sends nothing for this long is dropped
+    constexpr int kIdleTimeoutSeconds = 30;
+
+    struct Options {
+        int port = 8585;
+        bool loopbackOnly = true;
+        std::string mapPath;
+        std::string imagePath;
+        MapGenerator::Params map;
+        int latencyMs = 0;
+        int jitterMs = 0;
+        int bandwidthKbps = 0;
+        double errorRate = 0.0;
+        double resetRate = 0.0;
+        int seconds = 0;
+        std::string tracePath;
+        bool verbose = false;
+    };
+
+    /*!
+     * The map and the image served, shared by all connections
+     */
+    struct State {
+        Options options;
+        std::mutex mutex;
+        MapData map;
+        //! the JSON and the packed form of the current map, rebuilt on the first download after a
+        //! change
+        std::shared_ptr<const std::string> mapJSON;
+        std::shared_ptr<const std::string> mapPacked;
+        std::string image;
+        std::atomic<uint32_t> connections{0};
+        std::atomic<uint32_t> injectedErrors{0};
+        std::atomic<uint32_t> injectedResets{0};
+    };
+
+    uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+        static uint32_t table[256];
+        static std::once_flag tableOnce;
+        std::call_once(tableOnce, []() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[i] = c;
+            }
+        });
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void appendBigEndian(std::string &out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out += char(value >> shift);
+        }
+    }
+
+    void appendChunk(std::string &png, const char *type, const std::string &data) {
+        appendBigEndian(png, uint32_t(data.size()));
+        const std::string typed = std::string(type, 4) + data;
+        png += typed;
+        appendBigEndian(png, crc32(reinterpret_cast<const uint8_t *>(typed.data()), typed.size()));
+    }
+
+    /*!
+     * A round tank as an RGBA PNG. The pixels are stored uncompressed, which every decoder
+     * accepts and keeps the encoder a few lines long.
+     */
+    std::string createTankImage() {
+        std::string pixels;
+        for (int y = 0; y < kImageSize; y++) {
+            pixels += '\0'; // no filter
+            for (int x = 0; x < kImageSize; x++) {
+                const float dx = x + 0.5f - kImageSize / 2.0f;
+                const float dy = y + 0.5f - kImageSize / 2.0f;
+                const float distance = std::sqrt(dx * dx + dy * dy);
+                const bool barrel = std::abs(dx) < 2.0f && dy < 0.0f;
+                const bool body = distance < kImageSize * 0.35f;
+                pixels += char(barrel ? 0x20 : 0x30);
+                pixels += char(barrel ? 0x40 : 0x80);
+                pixels += char(0x30);
+                pixels += char(body || barrel ? 0xff : 0x00);
+            }
+        }
+
+        // zlib stream of stored deflate blocks
+        std::string zlib = "\x78\x01";
+        for (size_t offset = 0; offset < pixels.size(); offset += 0xffff) {
+            const size_t length = std::min<size_t>(0xffff, pixels.size() - offset);
+            zlib += char(offset + length == pixels.size() ? 1 : 0);
+            zlib += char(length & 0xff);
+            zlib += char(length >> 8);
+            zlib += char(~length & 0xff);
+            zlib += char((~length >> 8) & 0xff);
+            zlib.append(pixels, offset, length);
+        }
+        uint32_t a = 1, b = 0;
+        for (char c : pixels) {
+            a = (a + uint8_t(c)) % 65521;
+            b = (b + a) % 65521;
+        }
+        appendBigEndian(zlib, b << 16 | a);
+
+        std::string header;
+        appendBigEndian(header, kImageSize);
+        appendBigEndian(header, kImageSize);
+        header += "\x08\x06"; // 8 bits per channel, RGBA
+        header += std::string(3, '\0');
+
+        std::string png = "\x89PNG\r\n\x1a\n";
+        appendChunk(png, "IHDR", header);
+        appendChunk(png, "IDAT", zlib);
+        appendChunk(png, "IEND", std::string());
+        return png;
+    }
+
+    bool readFile(const std::string &path, std::string &outData) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", path.c_str());
+            return false;
+        }
+        char buffer[64 * 1024];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            outData.append(buffer, read);
+        }
+        fclose(file);
+        return true;
+    }
+
+    /*!
+     * Finds "key": in a flat JSON object
+     * @return the position after the colon, or npos
+     */
+    size_t findValue(const std::string &json, const char *key) {
+        const size_t keyPos = json.find(std::string("\"") + key + "\"");
+        if (keyPos == std::string::npos) {
+            return std::string::npos;
+        }
+        const size_t colon = json.find(':', keyPos);
+        return colon == std::string::npos ? colon : colon + 1;
+    }
+
+    /*!
+     * Applies a highlight POST to the map
+     */
+    Http::Response applyHighlight(State &state, const std::string &body) {
+        Http::Response response;
+        response.contentType = "application/json";
+
+        const size_t xPos = findValue(body, "x");
+        const size_t yPos = findValue(body, "y");
+        const size_t valuePos = findValue(body, "value");
+        const size_t quote = valuePos == std::string::npos ? valuePos : body.find('"', valuePos);
+        if (xPos == std::string::npos || yPos == std::string::npos
+            || quote == std::string::npos || quote + 1 >= body.size()) {
+            response.status = 400;
+            response.body = "{\"status\": \"error\", \"message\": \"expected x, y and value\"}";
+            return response;
+        }
+        const int x = atoi(body.c_str() + xPos);
+        const int y = atoi(body.c_str() + yPos);
+        const char value = body[quote + 1] == '"' ? ' ' : body[quote + 1];
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (x < 0 || y < 0 || x >= state.map.width || y >= state.map.height) {
+            response.status = 400;
+            response.body = "{\"status\": \"error\", \"message\": \"cell outside the map\"}";
+            return response;
+        }
+        state.map.data[size_t(y) * state.map.width + x] = value;
+        state.mapJSON.reset();
+        state.mapPacked.reset();
+        response.status = 200;
+        response.body = "{\"status\": \"ok\", \"x\": " + std::to_string(x) + ", \"y\": "
+                        + std::to_string(y) + "}";
+        return response;
+    }
+
+    Http::Response handle(State &state, const Http::Request &request) {
+        Http::Response response;
+        // the real server is PHP, query strings do not change what it returns. Only the packed
+        // form is understood here.
+        const size_t query = request.path.find('?');
+        const std::string path = request.path.substr(0, query);
+        const bool packed = query != std::string::npos
+                            && request.path.find("format=packed", query) != std::string::npos;
+        std::shared_ptr<const std::string> packedMap;
+        if (request.method == "GET" && path == kMapPath && packed) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            std::vector<uint8_t> bytes;
+            if (!state.mapPacked && MapGenerator::toPacked(state.map, bytes)) {
+                state.mapPacked = std::make_shared<const std::string>(bytes.begin(), bytes.end());
+            }
+            packedMap = state.mapPacked;
+        }
+        // Maps with more values than the packed form holds are sent as JSON, like the real server
+        if (packedMap) {
+            response.status = 200;
+            response.contentType = "application/octet-stream";
+            response.body = *packedMap;
+        } else if (request.method == "GET" && path == kMapPath) {
+            std::shared_ptr<const std::string> json;
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (!state.mapJSON) {
+                    state.mapJSON = std::make_shared<const std::string>(
+                            MapGenerator::toJSON(state.map));
+                }
+                json = state.mapJSON;
+            }
+            response.status = 200;
+            response.contentType = "application/json";
+            response.body = *json;
+        } else if (request.method == "GET" && path == kImagePath) {
+            response.status = 200;
+            response.contentType = "image/png";
+            response.body = state.image;
+        } else if (request.method == "POST" && path == kMapPath) {
+            response = applyHighlight(state, request.body);
+        } else {
+            response.status = 404;
+            response.contentType = "text/plain";
+            response.body = "not found";
+        }
+        return response;
+    }
+
+    /*!
+     * Sends at @a bytesPerSecond, in slices of kSliceMs so the rate holds for small responses too
+     */
+    bool sendThrottled(int socket, const std::string &data, double bytesPerSecond) {
+        using Clock = std::chrono::steady_clock;
+        if (bytesPerSecond <= 0.0) {
+            return Http::sendAll(socket, data.data(), data.size());
+        }
+        const size_t slice = std::max<size_t>(1, size_t(bytesPerSecond * kSliceMs / 1000.0));
+        const auto start = Clock::now();
+        for (size_t offset = 0; offset < data.size(); offset += slice) {
+            const auto due = start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(offset / bytesPerSecond));
+            std::this_thread::sleep_until(due);
+            if (!Http::sendAll(socket, data.data() + offset,
+                               std::min(slice, data.size() - offset))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void serveConnection(State &state, int client, uint32_t connection) {
+        const Options &options = state.options;
+        // aout is per thread, the core would log every map it writes
+        if (!options.verbose) {
+            aout.setstate(std::ios::badbit);
+        }
+        SCROLLER_TRACE_SCOPE("serve connection");
+        std::minstd_rand random(options.map.seed * 2654435761u + connection);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+        timeval timeout = {kIdleTimeoutSeconds, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        Http::Request request;
+        if (!Http::readRequest(client, request)) {
+            close(client);
+            return;
+        }
+
+        // Latency is added once per request, as a server far away would
+        const int jitter = options.jitterMs > 0
+                           ? std::uniform_int_distribution<int>(-options.jitterMs,
+                                                                options.jitterMs)(random) : 0;
+        const int delayMs = std::max(0, options.latencyMs + jitter);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+
+        if (unit(random) < options.resetRate) {
+            // Lingering for 0 seconds sends a reset instead of a clean close
+            linger abort = {1, 0};
+            setsockopt(client, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+            close(client);
+            state.injectedResets++;
+            return;
+        }
+
+        Http::Response response;
+        if (unit(random) < options.errorRate) {
+            response.status = 503;
+            response.contentType = "text/plain";
+            response.body = "injected error";
+            state.injectedErrors++;
+        } else {
+            response = handle(state, request);
+        }
+        if (options.verbose) {
+            fprintf(stderr, "%s %s -> %d, %zu bytes after %d ms\n", request.method.c_str(),
+                    request.path.c_str(), response.status, response.body.size(), delayMs);
+        }
+
+        const std::string message = Http::formatHeaders(response) + response.body;
+        sendThrottled(client, message, options.bandwidthKbps * 1000.0 / 8.0);
+        // Closing before the client read everything can turn into a reset, so wait for its close
+        shutdown(client, SHUT_WR);
+        char drain[256];
+        while (recv(client, drain, sizeof(drain), 0) > 0) {
+        }
+        close(client);
+    }
+
+    void printUsage() {
+        fprintf(stderr,
+                "usage: scroller_server [--port port] [--public] [--verbose] [--seconds count]\n"
+                "                       [--map file.json | --seed seed --size cells]\n"
+                "                       [--image file.png] [--latency-ms ms] [--jitter-ms ms]\n"
+                "                       [--bandwidth-kbps kbps]\n"
+                "                       [--error-rate fraction] [--reset-rate fraction]\n"
+                "                       [--trace file]\n");
+    }
+
+    bool parseOptions(int argc, char **argv, Options &outOptions) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (strcmp(arg, "--port") == 0 && hasValue) {
+                outOptions.port = atoi(argv[++i]);
+            } else if (strcmp(arg, "--public") == 0) {
+                outOptions.loopbackOnly = false;
+            } else if (strcmp(arg, "--verbose") == 0) {
+                outOptions.verbose = true;
+            } else if (strcmp(arg, "--seconds") == 0 && hasValue) {
+                outOptions.seconds = std::max(0, atoi(argv[++i]));
+            } else if (strcmp(arg, "--map") == 0 && hasValue) {
+                outOptions.mapPath = argv[++i];
+            } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+                outOptions.map.seed = uint32_t(strtoul(argv[++i], nullptr, 10));
+            } else if (strcmp(arg, "--size") == 0 && hasValue) {
+                outOptions.map.width = outOptions.map.height = atoi(argv[++i]);
+            } else if (strcmp(arg, "--image") == 0 && hasValue) {
+                outOptions.imagePath = argv[++i];
+            } else if (strcmp(arg, "--latency-ms") == 0 && hasValue) {
+                outOptions.latencyMs = std::max(0, atoi(argv[++i]));
+            } else if (strcmp(arg, "--jitter-ms") == 0 && hasValue) {
+                outOptions.jitterMs = std::max(0, atoi(argv[++i]));
+            } else if (strcmp(arg, "--bandwidth-kbps") == 0 && hasValue) {
+                outOptions.bandwidthKbps = std::max(0, atoi(argv[++i]));
+            } else if (strcmp(arg, "--error-rate") == 0 && hasValue) {
+                outOptions.errorRate = atof(argv[++i]);
+            } else if (strcmp(arg, "--reset-rate") == 0 && hasValue) {
+                outOptions.resetRate = atof(argv[++i]);
+            } else if (strcmp(arg, "--trace") == 0 && hasValue) {
+                outOptions.tracePath = argv[++i];
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    State state;
+    if (!parseOptions(argc, argv, state.options)) {
+        printUsage();
+        return 2;
+    }
+    const Options &options = state.options;
+    if (!options.tracePath.empty() && options.seconds == 0) {
+        fprintf(stderr, "--trace needs --seconds, the trace is written when the run ends\n");
+        return 2;
+    }
+    if (!options.tracePath.empty()) {
+        Trace::startCapture(options.tracePath);
+    }
+
+    // The core logs every parse, which would swamp the request log
+    if (!options.verbose) {
+        aout.setstate(std::ios::badbit);
+    }
+    if (options.mapPath.empty()) {
+        MapGenerator(options.map).generate(state.map);
+    } else {
+        std::string json;
+        if (!readFile(options.mapPath, json) || !MapParser::parseJSON(json.c_str(), state.map)) {
+            fprintf(stderr, "Failed to read the map from %s\n", options.mapPath.c_str());
+            return 2;
+        }
+    }
+    if (options.imagePath.empty()) {
+        state.image = createTankImage();
+    } else if (!readFile(options.imagePath, state.image)) {
+        return 2;
+    }
+
+    const int listenSocket = Http::listenOn(options.port, options.loopbackOnly);
+    if (listenSocket < 0) {
+        fprintf(stderr, "Failed to listen on port %d\n", options.port);
+        return 2;
+    }
+    fprintf(stderr, "Serving a %dx%d map on port %d\n", state.map.width, state.map.height,
+            options.port);
+
+    // Connections run on their own threads and are never joined, so a timed run just exits
+    if (options.seconds > 0) {
+        std::thread([&state, &options]() {
+            std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+            fprintf(stderr, "%u connections, %u injected errors, %u injected resets\n",
+                    state.connections.load(), state.injectedErrors.load(),
+                    state.injectedResets.load());
+            _exit(options.tracePath.empty() || Trace::stopCapture() ? 0 : 2);
+        }).detach();
+    }
+
+    while (true) {
+        const int client = accept(listenSocket, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        const uint32_t connection = state.connections++;
+        std::thread(serveConnection, std::ref(state), client, connection).detach();
+    }
+}
@@ -37,6 +37,12 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
                 delete pRenderer;
             }
             break;
+        case APP_CMD_LOW_MEMORY:
+            // The system is short on memory, give back whatever can be rebuilt
+            if (pApp->userData) {
+                reinterpret_cast<Renderer *>(pApp->userData)->onLowMemory();
+            }
+            break;
         default:
             break;
     }
@@ -80,8 +86,10 @@ void android_main(struct android_app *pApp) {
         // Process all pending events before running game logic.
         bool done = false;
         while (!done) {
-            // 0 is non-blocking.
-            int timeout = 0;
+            // 0 is non-blocking. With a renderer the loop sleeps until its next frame is due,
+            // events and vsync callbacks wake it up earlier.
+            auto *pPacedRenderer = reinterpret_cast<Renderer *>(pApp->userData);
+            int timeout = pPacedRenderer ? pPacedRenderer->getFrameWaitMillis() : 0;
             int events;
             android_poll_source *pSource;
             int result = ALooper_pollOnce(timeout, nullptr, &events,
@@ -111,9 +119,17 @@ void android_main(struct android_app *pApp) {
             // user data remember to change it here
             auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
 
+            // Frames start on the vsyncs the frame pacer picks for the target rate
+            if (pRenderer->getFrameWaitMillis() > 0) {
+                continue;
+            }
+
             // Process game input
             pRenderer->handleInput();
 
+            // Advance the simulation in fixed ticks, independent of the frame rate
+            pRenderer->update();
+
             // Render a frame
             pRenderer->render();
         }
@@ -10,16 +10,55 @@ import java.io.InputStreamReader;
 import java.io.OutputStream;
 import java.net.HttpURLConnection;
 import java.net.URL;
+import java.util.HashSet;
+import java.util.Set;
 import android.content.Context;
 
 public class NetworkHelper {
     
     private static Context appContext;
     
+    // Connections of downloadImageData in flight, closed by setCancelled
+    private static final Set<HttpURLConnection> openConnections = new HashSet<>();
+    private static volatile boolean cancelled;
+    
     public static void setContext(Context context) {
         appContext = context.getApplicationContext();
     }
     
+    /**
+     * Aborts the downloads of downloadImageData in flight and fails new ones until called with
+     * false. Closing a connection also ends a read that is blocked on the network.
+     */
+    public static void setCancelled(boolean cancel) {
+        synchronized (openConnections) {
+            cancelled = cancel;
+            if (cancel) {
+                for (HttpURLConnection connection : openConnections) {
+                    connection.disconnect();
+                }
+            }
+        }
+    }
+    
+    private static HttpURLConnection openConnection(String urlString) throws IOException {
+        HttpURLConnection connection = (HttpURLConnection) new URL(urlString).openConnection();
+        synchronized (openConnections) {
+            if (cancelled) {
+                throw new IOException("Download cancelled");
+            }
+            openConnections.add(connection);
+        }
+        return connection;
+    }
+    
+    private static void closeConnection(HttpURLConnection connection) {
+        synchronized (openConnections) {
+            openConnections.remove(connection);
+        }
+        connection.disconnect();
+    }
+    
     public static String downloadText(String urlString) {
         try {
             URL url = new URL(urlString);
@@ -116,9 +155,9 @@ public class NetworkHelper {
     }
     
     public static byte[] downloadImageData(String urlString) {
+        HttpURLConnection connection = null;
         try {
-            URL url = new URL(urlString);
-            HttpURLConnection connection = (HttpURLConnection) url.openConnection();
+            connection = openConnection(urlString);
             connection.setRequestMethod("GET");
             connection.setConnectTimeout(5000);
             connection.setReadTimeout(10000);
@@ -130,17 +169,23 @@ public class NetworkHelper {
             int bytesRead;
             
             while ((bytesRead = inputStream.read(buffer)) != -1) {
+                if (cancelled) {
+                    throw new IOException("Download cancelled");
+                }
                 outputStream.write(buffer, 0, bytesRead);
             }
             
             inputStream.close();
-            connection.disconnect();
             
             return outputStream.toByteArray();
             
         } catch (IOException e) {
             e.printStackTrace();
             return null;
+        } finally {
+            if (connection != null) {
+                closeConnection(connection);
+            }
         }
     }
     